@@ -43,6 +43,7 @@
 #include "tb-hash.h"
 #include "tb-context.h"
 #include "internal.h"
+#include "tb-async.h"
 
 /* -icount align implementation. */
 
@@ -188,7 +189,7 @@ static bool tb_lookup_cmp(const void *p, const void *d)
         tb->cs_base == desc->cs_base &&
         tb->flags == desc->flags &&
         tb->trace_vcpu_dstate == desc->trace_vcpu_dstate &&
-        tb_cflags(tb) == desc->cflags) {
+        tb_lookup_cflags(tb) == desc->cflags) {
         /* check next page if needed */
         tb_page_addr_t tb_phys_page1 = tb_page_addr1(tb);
         if (tb_phys_page1 == -1) {
@@ -240,6 +241,128 @@ static TranslationBlock *tb_htable_lookup(CPUState *cpu, target_ulong pc,
     return qht_lookup_custom(&tb_ctx.htable, &desc, h, tb_lookup_cmp);
 }
 
+/*
+ * The jump cache grows when more than 1/TB_JMP_CACHE_MISS_RATIO of the
+ * lookups in an epoch of TB_JMP_CACHE_EPOCH lookups missed it.
+ */
+#define TB_JMP_CACHE_EPOCH      (1u << 16)
+#define TB_JMP_CACHE_MISS_RATIO 8
+
+/* Check the parts of the lookup key other than pc against @tb. */
+static inline bool tb_jmp_cache_match(CPUState *cpu, TranslationBlock *tb,
+                                      target_ulong cs_base, uint32_t flags,
+                                      uint32_t cflags)
+{
+    return tb->cs_base == cs_base &&
+           tb->flags == flags &&
+           tb->trace_vcpu_dstate == *cpu->trace_dstate &&
+           tb_lookup_cflags(tb) == cflags;
+}
+
+static TranslationBlock *tb_victim_lookup(CPUState *cpu, CPUJumpCache *jc,
+                                          target_ulong pc,
+                                          target_ulong cs_base,
+                                          uint32_t flags, uint32_t cflags)
+{
+    uint32_t set = tb_jmp_cache_hash_func(pc, TB_VICTIM_CACHE_BITS);
+    int way;
+
+    for (way = 0; way < TB_VICTIM_CACHE_WAYS; way++) {
+        CPUJumpCacheEntry *e = &jc->victim[set][way];
+        /* Use acquire to ensure current load of pc from e. */
+        TranslationBlock *tb = qatomic_load_acquire(&e->tb);
+
+        if (tb && e->pc == pc &&
+            tb_jmp_cache_match(cpu, tb, cs_base, flags, cflags)) {
+            /* The TB moves back to the first level. */
+            qatomic_set(&e->tb, NULL);
+            return tb;
+        }
+    }
+    return NULL;
+}
+
+static void tb_victim_insert(CPUJumpCache *jc, target_ulong pc,
+                             TranslationBlock *tb)
+{
+    uint32_t set = tb_jmp_cache_hash_func(pc, TB_VICTIM_CACHE_BITS);
+    CPUJumpCacheEntry *e = jc->victim[set];
+    int way;
+
+    /* Evict the least recently used way. */
+    for (way = TB_VICTIM_CACHE_WAYS - 1; way > 0; way--) {
+        e[way].pc = e[way - 1].pc;
+        qatomic_store_release(&e[way].tb, qatomic_read(&e[way - 1].tb));
+    }
+    e[0].pc = pc;
+    qatomic_store_release(&e[0].tb, tb);
+}
+
+/*
+ * Replace the jump cache of @cpu with one twice as large.  Other threads
+ * may still be clearing entries in the old cache; anything they miss is
+ * an invalid TB, which never matches a lookup.
+ */
+static void tb_jmp_cache_grow(CPUState *cpu)
+{
+    CPUJumpCache *old = cpu->tb_jmp_cache;
+    unsigned bits = old->bits + 1;
+    CPUJumpCache *jc;
+    uint32_t i;
+
+    jc = g_malloc0(sizeof(*jc) + (sizeof(CPUJumpCacheEntry) << bits));
+    memcpy(jc->victim, old->victim, sizeof(jc->victim));
+    jc->bits = bits;
+
+    for (i = 0; i < 1u << old->bits; i++) {
+        TranslationBlock *tb = qatomic_load_acquire(&old->array[i].tb);
+
+        if (tb) {
+            target_ulong pc = (tb_cflags(tb) & CF_PCREL ?
+                               old->array[i].pc : tb->pc);
+            uint32_t h = tb_jmp_cache_hash_func(pc, bits);
+
+            jc->array[h].pc = pc;
+            jc->array[h].tb = tb;
+        }
+    }
+
+    qatomic_rcu_set(&cpu->tb_jmp_cache, jc);
+    g_free_rcu(old, rcu);
+}
+
+/*
+ * Add @tb to the jump cache, moving the entry it replaces to the victim
+ * cache.  Only called by the vCPU thread that owns the cache.
+ */
+static void tb_jmp_cache_insert(CPUState *cpu, target_ulong pc,
+                                TranslationBlock *tb)
+{
+    CPUJumpCache *jc = cpu->tb_jmp_cache;
+    TranslationBlock *old;
+    uint32_t h;
+
+    if (unlikely(jc->lookups >= TB_JMP_CACHE_EPOCH)) {
+        if (jc->misses > jc->lookups / TB_JMP_CACHE_MISS_RATIO &&
+            jc->bits < TB_JMP_CACHE_MAX_BITS) {
+            tb_jmp_cache_grow(cpu);
+            jc = cpu->tb_jmp_cache;
+        }
+        jc->lookups = 0;
+        jc->misses = 0;
+    }
+
+    h = tb_jmp_cache_hash_func(pc, jc->bits);
+    old = qatomic_read(&jc->array[h].tb);
+    if (old && old != tb) {
+        tb_victim_insert(jc, (tb_cflags(old) & CF_PCREL ?
+                              jc->array[h].pc : old->pc), old);
+    }
+    jc->array[h].pc = pc;
+    /* Use store_release on tb to ensure pc is written first. */
+    qatomic_store_release(&jc->array[h].tb, tb);
+}
+
 /* Might cause an exception, so have a longjmp destination ready */
 static inline TranslationBlock *tb_lookup(CPUState *cpu, target_ulong pc,
                                           target_ulong cs_base,
@@ -252,8 +375,9 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, target_ulong pc,
     /* we should never be trying to look up an INVALID tb */
     tcg_debug_assert(!(cflags & CF_INVALID));
 
-    hash = tb_jmp_cache_hash_func(pc);
     jc = cpu->tb_jmp_cache;
+    hash = tb_jmp_cache_hash_func(pc, jc->bits);
+    jc->lookups++;
 
     if (cflags & CF_PCREL) {
         /* Use acquire to ensure current load of pc from jc. */
@@ -261,39 +385,29 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, target_ulong pc,
 
         if (likely(tb &&
                    jc->array[hash].pc == pc &&
-                   tb->cs_base == cs_base &&
-                   tb->flags == flags &&
-                   tb->trace_vcpu_dstate == *cpu->trace_dstate &&
-                   tb_cflags(tb) == cflags)) {
+                   tb_jmp_cache_match(cpu, tb, cs_base, flags, cflags))) {
             return tb;
         }
-        tb = tb_htable_lookup(cpu, pc, cs_base, flags, cflags);
-        if (tb == NULL) {
-            return NULL;
-        }
-        jc->array[hash].pc = pc;
-        /* Use store_release on tb to ensure pc is written first. */
-        qatomic_store_release(&jc->array[hash].tb, tb);
     } else {
         /* Use rcu_read to ensure current load of pc from *tb. */
         tb = qatomic_rcu_read(&jc->array[hash].tb);
 
         if (likely(tb &&
                    tb->pc == pc &&
-                   tb->cs_base == cs_base &&
-                   tb->flags == flags &&
-                   tb->trace_vcpu_dstate == *cpu->trace_dstate &&
-                   tb_cflags(tb) == cflags)) {
+                   tb_jmp_cache_match(cpu, tb, cs_base, flags, cflags))) {
             return tb;
         }
+    }
+    jc->misses++;
+
+    tb = tb_victim_lookup(cpu, jc, pc, cs_base, flags, cflags);
+    if (tb == NULL) {
         tb = tb_htable_lookup(cpu, pc, cs_base, flags, cflags);
         if (tb == NULL) {
             return NULL;
         }
-        /* Use the pc value already stored in tb->pc. */
-        qatomic_set(&jc->array[hash].tb, tb);
     }
-
+    tb_jmp_cache_insert(cpu, pc, tb);
     return tb;
 }
 
@@ -883,6 +997,36 @@ static inline bool cpu_handle_interrupt(CPUState *cpu,
     return false;
 }
 
+/*
+ * The execution counter of @tb reached tb_superblock_threshold before
+ * the TB started executing.  Replace it with a superblock, which is found
+ * by the same lookups and is picked up by the next round of the main loop.
+ * With translator threads, @tb keeps running until the superblock is ready.
+ */
+static void cpu_exec_hot_tb(CPUState *cpu, TranslationBlock *tb)
+{
+    uint32_t cflags = tb_cflags(tb);
+    target_ulong cs_base, pc;
+    uint32_t flags;
+
+    if ((cflags & (CF_INVALID | CF_HOT)) || tb_page_addr0(tb) == -1) {
+        return;
+    }
+
+    cpu_get_tb_cpu_state(cpu->env_ptr, &pc, &cs_base, &flags);
+    if (tb_async_request(cpu, tb, pc, cs_base, flags)) {
+        return;
+    }
+
+    mmap_lock();
+    qemu_thread_jit_write();
+    tb_phys_invalidate(tb, -1);
+    tb_gen_code(cpu, pc, cs_base, flags, cflags | CF_HOT);
+    mmap_unlock();
+
+    qatomic_inc(&tb_ctx.tb_hot_count);
+}
+
 static inline void cpu_loop_exec_tb(CPUState *cpu, TranslationBlock *tb,
                                     target_ulong pc,
                                     TranslationBlock **last_tb, int *tb_exit)
@@ -891,6 +1035,11 @@ static inline void cpu_loop_exec_tb(CPUState *cpu, TranslationBlock *tb,
 
     trace_exec_tb(tb, pc);
     tb = cpu_tb_exec(cpu, tb, tb_exit);
+    if (*tb_exit == TB_EXIT_HOT) {
+        *last_tb = NULL;
+        cpu_exec_hot_tb(cpu, tb);
+        return;
+    }
     if (*tb_exit != TB_EXIT_REQUESTED) {
         *last_tb = tb;
         return;
@@ -971,8 +1120,6 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
 
             tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
             if (tb == NULL) {
-                uint32_t h;
-
                 mmap_lock();
                 tb = tb_gen_code(cpu, pc, cs_base, flags, cflags);
                 mmap_unlock();
@@ -980,9 +1127,7 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
                  * We add the TB in the virtual pc hash table
                  * for the fast lookup
                  */
-                h = tb_jmp_cache_hash_func(pc);
-                /* Use the pc value already stored in tb->pc. */
-                qatomic_set(&cpu->tb_jmp_cache->array[h].tb, tb);
+                tb_jmp_cache_insert(cpu, pc, tb);
             }
 
 #ifndef CONFIG_USER_ONLY
@@ -1075,7 +1220,10 @@ void tcg_exec_realizefn(CPUState *cpu, Error **errp)
         tcg_target_initialized = true;
     }
 
-    cpu->tb_jmp_cache = g_new0(CPUJumpCache, 1);
+    cpu->tb_jmp_cache = g_malloc0(sizeof(CPUJumpCache) +
+                                  sizeof(CPUJumpCacheEntry) *
+                                  TB_JMP_CACHE_SIZE);
+    cpu->tb_jmp_cache->bits = TB_JMP_CACHE_BITS;
     tlb_init(cpu);
 #ifndef CONFIG_USER_ONLY
     tcg_iommu_init_notifier_list(cpu);
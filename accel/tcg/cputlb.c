@@ -19,6 +19,7 @@
 
 #include "qemu/osdep.h"
 #include "qemu/main-loop.h"
+#include "qemu/cutils.h"
 #include "hw/core/tcg-cpu-ops.h"
 #include "exec/exec-all.h"
 #include "exec/memory.h"
@@ -101,16 +102,23 @@ static void tlb_window_reset(CPUTLBDesc *desc, int64_t ns,
 static void tb_jmp_cache_clear_page(CPUState *cpu, target_ulong page_addr)
 {
     CPUJumpCache *jc = cpu->tb_jmp_cache;
-    int i, i0;
+    int i, i0, way;
 
     if (unlikely(!jc)) {
         return;
     }
 
-    i0 = tb_jmp_cache_hash_page(page_addr);
-    for (i = 0; i < TB_JMP_PAGE_SIZE; i++) {
+    i0 = tb_jmp_cache_hash_page(page_addr, jc->bits);
+    for (i = 0; i < tb_jmp_page_size(jc->bits); i++) {
         qatomic_set(&jc->array[i0 + i].tb, NULL);
     }
+
+    i0 = tb_jmp_cache_hash_page(page_addr, TB_VICTIM_CACHE_BITS);
+    for (i = 0; i < tb_jmp_page_size(TB_VICTIM_CACHE_BITS); i++) {
+        for (way = 0; way < TB_VICTIM_CACHE_WAYS; way++) {
+            qatomic_set(&jc->victim[i0 + i][way].tb, NULL);
+        }
+    }
 }
 
 /**
@@ -234,8 +242,10 @@ static void tlb_mmu_flush_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast)
     desc->large_page_addr = -1;
     desc->large_page_mask = -1;
     desc->vindex = 0;
+    desc->lindex = 0;
     memset(fast->table, -1, sizeof_tlb(fast));
     memset(desc->vtable, -1, sizeof(desc->vtable));
+    memset(desc->ltable, 0, sizeof(desc->ltable));
 }
 
 static void tlb_flush_one_mmuidx_locked(CPUArchState *env, int mmu_idx,
@@ -270,6 +280,13 @@ static inline void tlb_n_used_entries_dec(CPUArchState *env, uintptr_t mmu_idx)
     env_tlb(env)->d[mmu_idx].n_used_entries--;
 }
 
+static inline void tlb_count_page_size(size_t *counts, int lg_page_size)
+{
+    int i = MIN(lg_page_size, CPU_TLB_PAGE_SIZES - 1);
+
+    qatomic_set(&counts[i], counts[i] + 1);
+}
+
 void tlb_init(CPUState *cpu)
 {
     CPUArchState *env = cpu->env_ptr;
@@ -301,21 +318,95 @@ void tlb_destroy(CPUState *cpu)
     }
 }
 
-/* flush_all_helper: run fn across all cpus
+static void tlb_flush_pending_work(CPUState *cpu, run_on_cpu_data data);
+static void tlb_flush_pending_safe_work(CPUState *cpu, run_on_cpu_data data);
+
+/* Called with tlb_c.lock held */
+static void tlb_queue_flush_locked(CPUTLBCommon *c, CPUTLBFlushRange r)
+{
+    target_ulong last = r.addr + r.len - 1;
+    unsigned i;
+
+    qatomic_set(&c->queued_flush_count, c->queued_flush_count + 1);
+
+    r.idxmap &= ~c->pending_full;
+    if (r.idxmap == 0) {
+        qatomic_set(&c->merged_flush_count, c->merged_flush_count + 1);
+        return;
+    }
+    if (r.bits < TARGET_PAGE_BITS) {
+        c->pending_full |= r.idxmap;
+        return;
+    }
+
+    /* Merge with a pending flush that overlaps or is adjacent. */
+    for (i = 0; i < c->pending_n; i++) {
+        CPUTLBFlushRange *p = &c->pending[i];
+        target_ulong p_last = p->addr + p->len - 1;
+
+        if (p->idxmap == r.idxmap && p->bits == r.bits &&
+            r.addr <= p_last + 1 && p->addr <= last + 1) {
+            p->addr = MIN(p->addr, r.addr);
+            p->len = MAX(p_last, last) - p->addr + 1;
+            qatomic_set(&c->merged_flush_count, c->merged_flush_count + 1);
+            return;
+        }
+    }
+
+    if (c->pending_n == CPU_TLB_PENDING_SIZE) {
+        /* Too many distinct ranges: flush all of the mmu_idx involved. */
+        for (i = 0; i < c->pending_n; i++) {
+            r.idxmap |= c->pending[i].idxmap;
+        }
+        c->pending_full |= r.idxmap;
+        c->pending_n = 0;
+        qatomic_set(&c->upgraded_flush_count, c->upgraded_flush_count + 1);
+        return;
+    }
+    c->pending[c->pending_n++] = r;
+}
+
+/*
+ * tlb_queue_flush: queue the flush @r for @cpu
  *
- * If the wait flag is set then the src cpu's helper will be queued as
- * "safe" work and the loop exited creating a synchronisation point
- * where all queued work will be finished before execution starts
- * again.
+ * The flush runs the next time @cpu processes its queued work, along
+ * with all of the other flushes queued for @cpu until then.  If @safe,
+ * they instead run as "safe" work, creating a synchronisation point
+ * where all queued work will be finished before execution starts again.
  */
-static void flush_all_helper(CPUState *src, run_on_cpu_func fn,
-                             run_on_cpu_data d)
+static void tlb_queue_flush(CPUState *cpu, CPUTLBFlushRange r, bool safe)
+{
+    CPUArchState *env = cpu->env_ptr;
+    CPUTLBCommon *c = &env_tlb(env)->c;
+    bool kick;
+
+    qemu_spin_lock(&c->lock);
+    tlb_queue_flush_locked(c, r);
+    if (safe) {
+        kick = !c->pending_safe;
+        c->pending_safe = true;
+    } else {
+        kick = !c->pending_queued;
+        c->pending_queued = true;
+    }
+    qemu_spin_unlock(&c->lock);
+
+    if (kick && safe) {
+        async_safe_run_on_cpu(cpu, tlb_flush_pending_safe_work,
+                              RUN_ON_CPU_NULL);
+    } else if (kick) {
+        async_run_on_cpu(cpu, tlb_flush_pending_work, RUN_ON_CPU_NULL);
+    }
+}
+
+/* Queue the flush @r for all cpus but @src. */
+static void tlb_queue_flush_others(CPUState *src, CPUTLBFlushRange r)
 {
     CPUState *cpu;
 
     CPU_FOREACH(cpu) {
         if (cpu != src) {
-            async_run_on_cpu(cpu, fn, d);
+            tlb_queue_flush(cpu, r, false);
         }
     }
 }
@@ -337,6 +428,58 @@ void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide)
     *pelide = elide;
 }
 
+void tlb_flush_batch_counts(size_t *pqueued, size_t *pmerged,
+                            size_t *pupgraded, size_t *pbatches)
+{
+    CPUState *cpu;
+    size_t queued = 0, merged = 0, upgraded = 0, batches = 0;
+
+    CPU_FOREACH(cpu) {
+        CPUArchState *env = cpu->env_ptr;
+
+        queued += qatomic_read(&env_tlb(env)->c.queued_flush_count);
+        merged += qatomic_read(&env_tlb(env)->c.merged_flush_count);
+        upgraded += qatomic_read(&env_tlb(env)->c.upgraded_flush_count);
+        batches += qatomic_read(&env_tlb(env)->c.flush_batch_count);
+    }
+    *pqueued = queued;
+    *pmerged = merged;
+    *pupgraded = upgraded;
+    *pbatches = batches;
+}
+
+void tlb_dump_page_size_info(GString *buf)
+{
+    size_t miss[CPU_TLB_PAGE_SIZES] = { };
+    size_t hit[CPU_TLB_PAGE_SIZES] = { };
+    size_t flush[CPU_TLB_PAGE_SIZES] = { };
+    CPUState *cpu;
+    int i;
+
+    CPU_FOREACH(cpu) {
+        CPUArchState *env = cpu->env_ptr;
+        CPUTLBCommon *c = &env_tlb(env)->c;
+
+        for (i = 0; i < CPU_TLB_PAGE_SIZES; i++) {
+            miss[i] += qatomic_read(&c->page_miss_count[i]);
+            hit[i] += qatomic_read(&c->page_hit_count[i]);
+            flush[i] += qatomic_read(&c->page_flush_count[i]);
+        }
+    }
+
+    for (i = 0; i < CPU_TLB_PAGE_SIZES; i++) {
+        g_autofree char *size = NULL;
+
+        if (!miss[i] && !hit[i] && !flush[i]) {
+            continue;
+        }
+        size = size_to_str(1ull << i);
+        g_string_append_printf(buf, "TLB %-8s pages  %zu fills, "
+                               "%zu large page hits, %zu flushes\n",
+                               size, miss[i], hit[i], flush[i]);
+    }
+}
+
 static void tlb_flush_by_mmuidx_async_work(CPUState *cpu, run_on_cpu_data data)
 {
     CPUArchState *env = cpu->env_ptr;
@@ -383,8 +526,9 @@ void tlb_flush_by_mmuidx(CPUState *cpu, uint16_t idxmap)
     tlb_debug("mmu_idx: 0x%" PRIx16 "\n", idxmap);
 
     if (cpu->created && !qemu_cpu_is_self(cpu)) {
-        async_run_on_cpu(cpu, tlb_flush_by_mmuidx_async_work,
-                         RUN_ON_CPU_HOST_INT(idxmap));
+        CPUTLBFlushRange r = { .idxmap = idxmap, .bits = 0 };
+
+        tlb_queue_flush(cpu, r, false);
     } else {
         tlb_flush_by_mmuidx_async_work(cpu, RUN_ON_CPU_HOST_INT(idxmap));
     }
@@ -397,12 +541,12 @@ void tlb_flush(CPUState *cpu)
 
 void tlb_flush_by_mmuidx_all_cpus(CPUState *src_cpu, uint16_t idxmap)
 {
-    const run_on_cpu_func fn = tlb_flush_by_mmuidx_async_work;
+    CPUTLBFlushRange r = { .idxmap = idxmap, .bits = 0 };
 
     tlb_debug("mmu_idx: 0x%"PRIx16"\n", idxmap);
 
-    flush_all_helper(src_cpu, fn, RUN_ON_CPU_HOST_INT(idxmap));
-    fn(src_cpu, RUN_ON_CPU_HOST_INT(idxmap));
+    tlb_queue_flush_others(src_cpu, r);
+    tlb_flush_by_mmuidx_async_work(src_cpu, RUN_ON_CPU_HOST_INT(idxmap));
 }
 
 void tlb_flush_all_cpus(CPUState *src_cpu)
@@ -412,12 +556,12 @@ void tlb_flush_all_cpus(CPUState *src_cpu)
 
 void tlb_flush_by_mmuidx_all_cpus_synced(CPUState *src_cpu, uint16_t idxmap)
 {
-    const run_on_cpu_func fn = tlb_flush_by_mmuidx_async_work;
+    CPUTLBFlushRange r = { .idxmap = idxmap, .bits = 0 };
 
     tlb_debug("mmu_idx: 0x%"PRIx16"\n", idxmap);
 
-    flush_all_helper(src_cpu, fn, RUN_ON_CPU_HOST_INT(idxmap));
-    async_safe_run_on_cpu(src_cpu, fn, RUN_ON_CPU_HOST_INT(idxmap));
+    tlb_queue_flush_others(src_cpu, r);
+    tlb_queue_flush(src_cpu, r, true);
 }
 
 void tlb_flush_all_cpus_synced(CPUState *src_cpu)
@@ -491,6 +635,65 @@ static inline void tlb_flush_vtlb_page_locked(CPUArchState *env, int mmu_idx,
     tlb_flush_vtlb_page_mask_locked(env, mmu_idx, page, -1);
 }
 
+/*
+ * Called with tlb_c.lock held.
+ * Drop the entries created for the large page @lp, and @lp itself.
+ */
+static void tlb_flush_large_page_locked(CPUArchState *env, int midx,
+                                        CPUTLBLargePage *lp)
+{
+    CPUTLBDescFast *f = &env_tlb(env)->f[midx];
+    size_t n_entries = tlb_n_entries(f);
+    target_ulong n_pages = (~lp->mask >> TARGET_PAGE_BITS) + 1;
+
+    if (n_pages <= n_entries) {
+        for (target_ulong i = 0; i < n_pages; i++) {
+            target_ulong page = lp->addr + (i << TARGET_PAGE_BITS);
+
+            if (tlb_flush_entry_locked(tlb_entry(env, midx, page), page)) {
+                tlb_n_used_entries_dec(env, midx);
+            }
+        }
+    } else {
+        /* The page covers more than the tlb; test each entry instead. */
+        for (size_t i = 0; i < n_entries; i++) {
+            if (tlb_flush_entry_mask_locked(&f->table[i],
+                                            lp->addr, lp->mask)) {
+                tlb_n_used_entries_dec(env, midx);
+            }
+        }
+    }
+    tlb_flush_vtlb_page_mask_locked(env, midx, lp->addr, lp->mask);
+
+    tlb_count_page_size(env_tlb(env)->c.page_flush_count,
+                        lp->full.lg_page_size);
+    lp->mask = 0;
+}
+
+/*
+ * Called with tlb_c.lock held.
+ * Drop the large pages that intersect [@addr, @addr + @len), comparing
+ * only the address bits in @mask.
+ */
+static void tlb_flush_large_pages_locked(CPUArchState *env, int midx,
+                                         target_ulong addr, target_ulong len,
+                                         target_ulong mask)
+{
+    CPUTLBDesc *d = &env_tlb(env)->d[midx];
+    target_ulong lo = addr & mask;
+    target_ulong hi = lo + len - 1;
+
+    for (int i = 0; i < CPU_LTLB_SIZE; i++) {
+        CPUTLBLargePage *lp = &d->ltable[i];
+        target_ulong lp_lo = lp->addr & mask;
+        target_ulong lp_hi = lp_lo + ~lp->mask;
+
+        if (lp->mask && lp_lo <= hi && lo <= lp_hi) {
+            tlb_flush_large_page_locked(env, midx, lp);
+        }
+    }
+}
+
 static void tlb_flush_page_locked(CPUArchState *env, int midx,
                                   target_ulong page)
 {
@@ -504,6 +707,7 @@ static void tlb_flush_page_locked(CPUArchState *env, int midx,
                   midx, lp_addr, lp_mask);
         tlb_flush_one_mmuidx_locked(env, midx, get_clock_realtime());
     } else {
+        tlb_flush_large_pages_locked(env, midx, page, TARGET_PAGE_SIZE, -1);
         if (tlb_flush_entry_locked(tlb_entry(env, midx, page), page)) {
             tlb_n_used_entries_dec(env, midx);
         }
@@ -547,50 +751,6 @@ static void tlb_flush_page_by_mmuidx_async_0(CPUState *cpu,
     tb_jmp_cache_clear_page(cpu, addr);
 }
 
-/**
- * tlb_flush_page_by_mmuidx_async_1:
- * @cpu: cpu on which to flush
- * @data: encoded addr + idxmap
- *
- * Helper for tlb_flush_page_by_mmuidx and friends, called through
- * async_run_on_cpu.  The idxmap parameter is encoded in the page
- * offset of the target_ptr field.  This limits the set of mmu_idx
- * that can be passed via this method.
- */
-static void tlb_flush_page_by_mmuidx_async_1(CPUState *cpu,
-                                             run_on_cpu_data data)
-{
-    target_ulong addr_and_idxmap = (target_ulong) data.target_ptr;
-    target_ulong addr = addr_and_idxmap & TARGET_PAGE_MASK;
-    uint16_t idxmap = addr_and_idxmap & ~TARGET_PAGE_MASK;
-
-    tlb_flush_page_by_mmuidx_async_0(cpu, addr, idxmap);
-}
-
-typedef struct {
-    target_ulong addr;
-    uint16_t idxmap;
-} TLBFlushPageByMMUIdxData;
-
-/**
- * tlb_flush_page_by_mmuidx_async_2:
- * @cpu: cpu on which to flush
- * @data: allocated addr + idxmap
- *
- * Helper for tlb_flush_page_by_mmuidx and friends, called through
- * async_run_on_cpu.  The addr+idxmap parameters are stored in a
- * TLBFlushPageByMMUIdxData structure that has been allocated
- * specifically for this helper.  Free the structure when done.
- */
-static void tlb_flush_page_by_mmuidx_async_2(CPUState *cpu,
-                                             run_on_cpu_data data)
-{
-    TLBFlushPageByMMUIdxData *d = data.host_ptr;
-
-    tlb_flush_page_by_mmuidx_async_0(cpu, d->addr, d->idxmap);
-    g_free(d);
-}
-
 void tlb_flush_page_by_mmuidx(CPUState *cpu, target_ulong addr, uint16_t idxmap)
 {
     tlb_debug("addr: "TARGET_FMT_lx" mmu_idx:%" PRIx16 "\n", addr, idxmap);
@@ -600,22 +760,15 @@ void tlb_flush_page_by_mmuidx(CPUState *cpu, target_ulong addr, uint16_t idxmap)
 
     if (qemu_cpu_is_self(cpu)) {
         tlb_flush_page_by_mmuidx_async_0(cpu, addr, idxmap);
-    } else if (idxmap < TARGET_PAGE_SIZE) {
-        /*
-         * Most targets have only a few mmu_idx.  In the case where
-         * we can stuff idxmap into the low TARGET_PAGE_BITS, avoid
-         * allocating memory for this operation.
-         */
-        async_run_on_cpu(cpu, tlb_flush_page_by_mmuidx_async_1,
-                         RUN_ON_CPU_TARGET_PTR(addr | idxmap));
     } else {
-        TLBFlushPageByMMUIdxData *d = g_new(TLBFlushPageByMMUIdxData, 1);
+        CPUTLBFlushRange r = {
+            .addr = addr,
+            .len = TARGET_PAGE_SIZE,
+            .idxmap = idxmap,
+            .bits = TARGET_LONG_BITS,
+        };
 
-        /* Otherwise allocate a structure, freed by the worker.  */
-        d->addr = addr;
-        d->idxmap = idxmap;
-        async_run_on_cpu(cpu, tlb_flush_page_by_mmuidx_async_2,
-                         RUN_ON_CPU_HOST_PTR(d));
+        tlb_queue_flush(cpu, r, false);
     }
 }
 
@@ -627,36 +780,17 @@ void tlb_flush_page(CPUState *cpu, target_ulong addr)
 void tlb_flush_page_by_mmuidx_all_cpus(CPUState *src_cpu, target_ulong addr,
                                        uint16_t idxmap)
 {
-    tlb_debug("addr: "TARGET_FMT_lx" mmu_idx:%"PRIx16"\n", addr, idxmap);
-
-    /* This should already be page aligned */
-    addr &= TARGET_PAGE_MASK;
+    CPUTLBFlushRange r = {
+        .addr = addr & TARGET_PAGE_MASK,
+        .len = TARGET_PAGE_SIZE,
+        .idxmap = idxmap,
+        .bits = TARGET_LONG_BITS,
+    };
 
-    /*
-     * Allocate memory to hold addr+idxmap only when needed.
-     * See tlb_flush_page_by_mmuidx for details.
-     */
-    if (idxmap < TARGET_PAGE_SIZE) {
-        flush_all_helper(src_cpu, tlb_flush_page_by_mmuidx_async_1,
-                         RUN_ON_CPU_TARGET_PTR(addr | idxmap));
-    } else {
-        CPUState *dst_cpu;
-
-        /* Allocate a separate data block for each destination cpu.  */
-        CPU_FOREACH(dst_cpu) {
-            if (dst_cpu != src_cpu) {
-                TLBFlushPageByMMUIdxData *d
-                    = g_new(TLBFlushPageByMMUIdxData, 1);
-
-                d->addr = addr;
-                d->idxmap = idxmap;
-                async_run_on_cpu(dst_cpu, tlb_flush_page_by_mmuidx_async_2,
-                                 RUN_ON_CPU_HOST_PTR(d));
-            }
-        }
-    }
+    tlb_debug("addr: "TARGET_FMT_lx" mmu_idx:%"PRIx16"\n", addr, idxmap);
 
-    tlb_flush_page_by_mmuidx_async_0(src_cpu, addr, idxmap);
+    tlb_queue_flush_others(src_cpu, r);
+    tlb_flush_page_by_mmuidx_async_0(src_cpu, r.addr, idxmap);
 }
 
 void tlb_flush_page_all_cpus(CPUState *src, target_ulong addr)
@@ -668,41 +802,17 @@ void tlb_flush_page_by_mmuidx_all_cpus_synced(CPUState *src_cpu,
                                               target_ulong addr,
                                               uint16_t idxmap)
 {
-    tlb_debug("addr: "TARGET_FMT_lx" mmu_idx:%"PRIx16"\n", addr, idxmap);
-
-    /* This should already be page aligned */
-    addr &= TARGET_PAGE_MASK;
+    CPUTLBFlushRange r = {
+        .addr = addr & TARGET_PAGE_MASK,
+        .len = TARGET_PAGE_SIZE,
+        .idxmap = idxmap,
+        .bits = TARGET_LONG_BITS,
+    };
 
-    /*
-     * Allocate memory to hold addr+idxmap only when needed.
-     * See tlb_flush_page_by_mmuidx for details.
-     */
-    if (idxmap < TARGET_PAGE_SIZE) {
-        flush_all_helper(src_cpu, tlb_flush_page_by_mmuidx_async_1,
-                         RUN_ON_CPU_TARGET_PTR(addr | idxmap));
-        async_safe_run_on_cpu(src_cpu, tlb_flush_page_by_mmuidx_async_1,
-                              RUN_ON_CPU_TARGET_PTR(addr | idxmap));
-    } else {
-        CPUState *dst_cpu;
-        TLBFlushPageByMMUIdxData *d;
-
-        /* Allocate a separate data block for each destination cpu.  */
-        CPU_FOREACH(dst_cpu) {
-            if (dst_cpu != src_cpu) {
-                d = g_new(TLBFlushPageByMMUIdxData, 1);
-                d->addr = addr;
-                d->idxmap = idxmap;
-                async_run_on_cpu(dst_cpu, tlb_flush_page_by_mmuidx_async_2,
-                                 RUN_ON_CPU_HOST_PTR(d));
-            }
-        }
+    tlb_debug("addr: "TARGET_FMT_lx" mmu_idx:%"PRIx16"\n", addr, idxmap);
 
-        d = g_new(TLBFlushPageByMMUIdxData, 1);
-        d->addr = addr;
-        d->idxmap = idxmap;
-        async_safe_run_on_cpu(src_cpu, tlb_flush_page_by_mmuidx_async_2,
-                              RUN_ON_CPU_HOST_PTR(d));
-    }
+    tlb_queue_flush_others(src_cpu, r);
+    tlb_queue_flush(src_cpu, r, true);
 }
 
 void tlb_flush_page_all_cpus_synced(CPUState *src, target_ulong addr)
@@ -749,6 +859,8 @@ static void tlb_flush_range_locked(CPUArchState *env, int midx,
         return;
     }
 
+    tlb_flush_large_pages_locked(env, midx, addr, len, mask);
+
     for (target_ulong i = 0; i < len; i += TARGET_PAGE_SIZE) {
         target_ulong page = addr + i;
         CPUTLBEntry *entry = tlb_entry(env, midx, page);
@@ -760,15 +872,8 @@ static void tlb_flush_range_locked(CPUArchState *env, int midx,
     }
 }
 
-typedef struct {
-    target_ulong addr;
-    target_ulong len;
-    uint16_t idxmap;
-    uint16_t bits;
-} TLBFlushRangeData;
-
 static void tlb_flush_range_by_mmuidx_async_0(CPUState *cpu,
-                                              TLBFlushRangeData d)
+                                              CPUTLBFlushRange d)
 {
     CPUArchState *env = cpu->env_ptr;
     int mmu_idx;
@@ -806,19 +911,62 @@ static void tlb_flush_range_by_mmuidx_async_0(CPUState *cpu,
     }
 }
 
-static void tlb_flush_range_by_mmuidx_async_1(CPUState *cpu,
-                                              run_on_cpu_data data)
+/* Run the flushes queued for @cpu by other cpus. */
+static void tlb_flush_pending_work(CPUState *cpu, run_on_cpu_data data)
+{
+    CPUArchState *env = cpu->env_ptr;
+    CPUTLBCommon *c = &env_tlb(env)->c;
+    CPUTLBFlushRange pending[CPU_TLB_PENDING_SIZE];
+    uint16_t full;
+    unsigned i, n;
+
+    qemu_spin_lock(&c->lock);
+    full = c->pending_full;
+    n = c->pending_n;
+    memcpy(pending, c->pending, n * sizeof(pending[0]));
+    c->pending_full = 0;
+    c->pending_n = 0;
+    c->pending_queued = false;
+    if (full || n) {
+        qatomic_set(&c->flush_batch_count, c->flush_batch_count + 1);
+    }
+    qemu_spin_unlock(&c->lock);
+
+    if (full) {
+        tlb_flush_by_mmuidx_async_work(cpu, RUN_ON_CPU_HOST_INT(full));
+    }
+    for (i = 0; i < n; i++) {
+        CPUTLBFlushRange d = pending[i];
+
+        d.idxmap &= ~full;
+        if (d.idxmap == 0) {
+            continue;
+        }
+        if (d.bits >= TARGET_LONG_BITS && d.len == TARGET_PAGE_SIZE) {
+            tlb_flush_page_by_mmuidx_async_0(cpu, d.addr, d.idxmap);
+        } else {
+            tlb_flush_range_by_mmuidx_async_0(cpu, d);
+        }
+    }
+}
+
+static void tlb_flush_pending_safe_work(CPUState *cpu, run_on_cpu_data data)
 {
-    TLBFlushRangeData *d = data.host_ptr;
-    tlb_flush_range_by_mmuidx_async_0(cpu, *d);
-    g_free(d);
+    CPUArchState *env = cpu->env_ptr;
+    CPUTLBCommon *c = &env_tlb(env)->c;
+
+    qemu_spin_lock(&c->lock);
+    c->pending_safe = false;
+    qemu_spin_unlock(&c->lock);
+
+    tlb_flush_pending_work(cpu, data);
 }
 
 void tlb_flush_range_by_mmuidx(CPUState *cpu, target_ulong addr,
                                target_ulong len, uint16_t idxmap,
                                unsigned bits)
 {
-    TLBFlushRangeData d;
+    CPUTLBFlushRange d;
 
     /*
      * If all bits are significant, and len is small,
@@ -843,10 +991,7 @@ void tlb_flush_range_by_mmuidx(CPUState *cpu, target_ulong addr,
     if (qemu_cpu_is_self(cpu)) {
         tlb_flush_range_by_mmuidx_async_0(cpu, d);
     } else {
-        /* Otherwise allocate a structure, freed by the worker.  */
-        TLBFlushRangeData *p = g_memdup(&d, sizeof(d));
-        async_run_on_cpu(cpu, tlb_flush_range_by_mmuidx_async_1,
-                         RUN_ON_CPU_HOST_PTR(p));
+        tlb_queue_flush(cpu, d, false);
     }
 }
 
@@ -860,8 +1005,7 @@ void tlb_flush_range_by_mmuidx_all_cpus(CPUState *src_cpu,
                                         target_ulong addr, target_ulong len,
                                         uint16_t idxmap, unsigned bits)
 {
-    TLBFlushRangeData d;
-    CPUState *dst_cpu;
+    CPUTLBFlushRange d;
 
     /*
      * If all bits are significant, and len is small,
@@ -883,16 +1027,7 @@ void tlb_flush_range_by_mmuidx_all_cpus(CPUState *src_cpu,
     d.idxmap = idxmap;
     d.bits = bits;
 
-    /* Allocate a separate data block for each destination cpu.  */
-    CPU_FOREACH(dst_cpu) {
-        if (dst_cpu != src_cpu) {
-            TLBFlushRangeData *p = g_memdup(&d, sizeof(d));
-            async_run_on_cpu(dst_cpu,
-                             tlb_flush_range_by_mmuidx_async_1,
-                             RUN_ON_CPU_HOST_PTR(p));
-        }
-    }
-
+    tlb_queue_flush_others(src_cpu, d);
     tlb_flush_range_by_mmuidx_async_0(src_cpu, d);
 }
 
@@ -910,8 +1045,7 @@ void tlb_flush_range_by_mmuidx_all_cpus_synced(CPUState *src_cpu,
                                                uint16_t idxmap,
                                                unsigned bits)
 {
-    TLBFlushRangeData d, *p;
-    CPUState *dst_cpu;
+    CPUTLBFlushRange d;
 
     /*
      * If all bits are significant, and len is small,
@@ -933,18 +1067,8 @@ void tlb_flush_range_by_mmuidx_all_cpus_synced(CPUState *src_cpu,
     d.idxmap = idxmap;
     d.bits = bits;
 
-    /* Allocate a separate data block for each destination cpu.  */
-    CPU_FOREACH(dst_cpu) {
-        if (dst_cpu != src_cpu) {
-            p = g_memdup(&d, sizeof(d));
-            async_run_on_cpu(dst_cpu, tlb_flush_range_by_mmuidx_async_1,
-                             RUN_ON_CPU_HOST_PTR(p));
-        }
-    }
-
-    p = g_memdup(&d, sizeof(d));
-    async_safe_run_on_cpu(src_cpu, tlb_flush_range_by_mmuidx_async_1,
-                          RUN_ON_CPU_HOST_PTR(p));
+    tlb_queue_flush_others(src_cpu, d);
+    tlb_queue_flush(src_cpu, d, true);
 }
 
 void tlb_flush_page_bits_by_mmuidx_all_cpus_synced(CPUState *src_cpu,
@@ -1081,13 +1205,14 @@ void tlb_set_dirty(CPUState *cpu, target_ulong vaddr)
     qemu_spin_unlock(&env_tlb(env)->c.lock);
 }
 
-/* Our TLB does not support large pages, so remember the area covered by
-   large pages and trigger a full TLB flush if these are invalidated.  */
-static void tlb_add_large_page(CPUArchState *env, int mmu_idx,
-                               target_ulong vaddr, target_ulong size)
+/*
+ * For large pages that cannot be kept in the large page table, remember
+ * the area they cover and trigger a full TLB flush if it is invalidated.
+ */
+static void tlb_add_large_page_region(CPUArchState *env, int mmu_idx,
+                                      target_ulong vaddr, target_ulong lp_mask)
 {
     target_ulong lp_addr = env_tlb(env)->d[mmu_idx].large_page_addr;
-    target_ulong lp_mask = ~(size - 1);
 
     if (lp_addr == (target_ulong)-1) {
         /* No previous large page.  */
@@ -1105,10 +1230,62 @@ static void tlb_add_large_page(CPUArchState *env, int mmu_idx,
     env_tlb(env)->d[mmu_idx].large_page_mask = lp_mask;
 }
 
+/*
+ * Our TLB only holds TARGET_PAGE_SIZE entries.  Remember the large page
+ * containing @vaddr, so that the rest of it can be entered into the TLB
+ * without calling tlb_fill, and so that a flush of any page within it
+ * drops all of it.
+ */
+static void tlb_add_large_page(CPUArchState *env, int mmu_idx,
+                               target_ulong vaddr, CPUTLBEntryFull *full)
+{
+    CPUTLBDesc *desc = &env_tlb(env)->d[mmu_idx];
+    CPUTLBLargePage *lp = NULL;
+    target_ulong lp_addr, lp_mask;
+    int i;
+
+    lp_mask = -1;
+    if (full->lg_page_size < TARGET_LONG_BITS) {
+        lp_mask <<= full->lg_page_size;
+    } else {
+        lp_mask = 0;
+    }
+    if (lp_mask == 0 || (full->prot & PAGE_WRITE_INV)) {
+        tlb_add_large_page_region(env, mmu_idx, vaddr, lp_mask);
+        return;
+    }
+    lp_addr = vaddr & lp_mask;
+
+    /* Refills of the same page, e.g. for a write, replace the entry. */
+    for (i = 0; i < CPU_LTLB_SIZE; i++) {
+        if (desc->ltable[i].mask == lp_mask &&
+            desc->ltable[i].addr == lp_addr) {
+            lp = &desc->ltable[i];
+            break;
+        }
+    }
+    if (!lp) {
+        lp = &desc->ltable[desc->lindex++ % CPU_LTLB_SIZE];
+        if (lp->mask) {
+            /* The TLB may still hold entries for the evicted page. */
+            tlb_add_large_page_region(env, mmu_idx, lp->addr, lp->mask);
+        }
+    }
+
+    lp->addr = lp_addr;
+    lp->mask = lp_mask;
+    lp->vaddr_page = vaddr & TARGET_PAGE_MASK;
+    lp->full = *full;
+}
+
+static void tlb_set_page_full_1(CPUState *cpu, int mmu_idx,
+                                target_ulong vaddr, CPUTLBEntryFull *full);
+
 /*
  * Add a new TLB entry. At most one entry for a given virtual address
  * is permitted. Only a single TARGET_PAGE_SIZE region is mapped, the
- * supplied size is only used by tlb_flush_page.
+ * supplied size is used by tlb_flush_page and to map further pages
+ * on a TLB miss.
  *
  * Called from TCG-generated code, which is under an RCU read-side
  * critical section.
@@ -1117,6 +1294,66 @@ void tlb_set_page_full(CPUState *cpu, int mmu_idx,
                        target_ulong vaddr, CPUTLBEntryFull *full)
 {
     CPUArchState *env = cpu->env_ptr;
+
+    tlb_count_page_size(env_tlb(env)->c.page_miss_count,
+                        full->lg_page_size);
+    if (full->lg_page_size > TARGET_PAGE_BITS) {
+        tlb_add_large_page(env, mmu_idx, vaddr, full);
+    }
+    tlb_set_page_full_1(cpu, mmu_idx, vaddr, full);
+}
+
+/*
+ * Enter into the TLB the page containing @addr, if it is part of a large
+ * page previously returned by tlb_fill that allows @access_type.
+ * Return false if tlb_fill must be called instead.
+ */
+static bool tlb_fill_large_page(CPUState *cpu, target_ulong addr,
+                                MMUAccessType access_type, int mmu_idx)
+{
+    CPUArchState *env = cpu->env_ptr;
+    CPUTLBDesc *desc = &env_tlb(env)->d[mmu_idx];
+    target_ulong page = addr & TARGET_PAGE_MASK;
+    int prot, i;
+
+    switch (access_type) {
+    case MMU_DATA_LOAD:
+        prot = PAGE_READ;
+        break;
+    case MMU_DATA_STORE:
+        prot = PAGE_WRITE;
+        break;
+    case MMU_INST_FETCH:
+        prot = PAGE_EXEC;
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    for (i = 0; i < CPU_LTLB_SIZE; i++) {
+        CPUTLBLargePage *lp = &desc->ltable[i];
+        CPUTLBEntryFull full;
+
+        if (!lp->mask || (addr & lp->mask) != lp->addr ||
+            !lp->full.lg_page_exact || !(lp->full.prot & prot)) {
+            continue;
+        }
+
+        full = lp->full;
+        full.phys_addr = (full.phys_addr & TARGET_PAGE_MASK)
+                         - (lp->vaddr_page - lp->addr) + (page - lp->addr);
+        tlb_count_page_size(env_tlb(env)->c.page_hit_count,
+                            full.lg_page_size);
+        tlb_set_page_full_1(cpu, mmu_idx, page, &full);
+        return true;
+    }
+    return false;
+}
+
+static void tlb_set_page_full_1(CPUState *cpu, int mmu_idx,
+                                target_ulong vaddr, CPUTLBEntryFull *full)
+{
+    CPUArchState *env = cpu->env_ptr;
     CPUTLB *tlb = env_tlb(env);
     CPUTLBDesc *desc = &tlb->d[mmu_idx];
     MemoryRegionSection *section;
@@ -1136,7 +1373,6 @@ void tlb_set_page_full(CPUState *cpu, int mmu_idx,
         sz = TARGET_PAGE_SIZE;
     } else {
         sz = (hwaddr)1 << full->lg_page_size;
-        tlb_add_large_page(env, mmu_idx, vaddr, sz);
     }
     vaddr_page = vaddr & TARGET_PAGE_MASK;
     paddr_page = full->phys_addr & TARGET_PAGE_MASK;
@@ -1317,6 +1553,10 @@ static void tlb_fill(CPUState *cpu, target_ulong addr, int size,
 {
     bool ok;
 
+    if (tlb_fill_large_page(cpu, addr, access_type, mmu_idx)) {
+        return;
+    }
+
     /*
      * This is not a probe, so only valid return is success; failure
      * should result in exception + longjmp to the cpu loop.
@@ -1552,7 +1792,8 @@ static int probe_access_internal(CPUArchState *env, target_ulong addr,
         if (!victim_tlb_hit(env, mmu_idx, index, elt_ofs, page_addr)) {
             CPUState *cs = env_cpu(env);
 
-            if (!cs->cc->tcg_ops->tlb_fill(cs, addr, fault_size, access_type,
+            if (!tlb_fill_large_page(cs, addr, access_type, mmu_idx) &&
+                !cs->cc->tcg_ops->tlb_fill(cs, addr, fault_size, access_type,
                                            mmu_idx, nonfault, retaddr)) {
                 /* Non-faulting page table read failed.  */
                 *phost = NULL;
@@ -2686,6 +2927,39 @@ void cpu_st16_le_mmu(CPUArchState *env, abi_ptr addr, Int128 val,
     qemu_plugin_vcpu_mem_cb(env_cpu(env), addr, oi, QEMU_PLUGIN_MEM_W);
 }
 
+/*
+ * Look up @len bytes at @addr, within one page, for a bulk access:
+ * raise any fault or watchpoint for the whole range, mark it dirty,
+ * and return its host address, or NULL if it is not RAM.
+ */
+static void *cpu_bulk_lookup(CPUArchState *env, abi_ptr addr, size_t len,
+                             MMUAccessType access_type, int mmu_idx,
+                             uintptr_t ra)
+{
+    CPUTLBEntryFull *full;
+    void *host;
+    int flags;
+
+    flags = probe_access_internal(env, addr, len, access_type, mmu_idx,
+                                  false, &host, &full, ra);
+
+    if (unlikely(flags & TLB_WATCHPOINT)) {
+        int wp_access = (access_type == MMU_DATA_STORE
+                         ? BP_MEM_WRITE : BP_MEM_READ);
+        cpu_check_watchpoint(env_cpu(env), addr, len,
+                             full->attrs, wp_access, ra);
+    }
+    if (unlikely(flags & TLB_NOTDIRTY)) {
+        /* Unlike probe_access, invalidate code in the whole range. */
+        notdirty_write(env_cpu(env), addr, len, full, ra);
+    }
+    return host;
+}
+
+static inline void cpu_bulk_done(void)
+{
+}
+
 #include "ldst_common.c.inc"
 
 /*
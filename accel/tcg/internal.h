@@ -45,6 +45,10 @@ G_NORETURN void cpu_io_recompile(CPUState *cpu, uintptr_t retaddr);
 TranslationBlock *tb_gen_code(CPUState *cpu, target_ulong pc,
                               target_ulong cs_base, uint32_t flags,
                               int cflags);
+TranslationBlock *tb_gen_code_phys(CPUState *cpu, target_ulong pc,
+                                   target_ulong cs_base, uint32_t flags,
+                                   int cflags, tb_page_addr_t phys_pc,
+                                   void *host_pc, TranslationBlock *replace);
 void page_init(void);
 void tb_htable_init(void);
 void tb_reset_jump(TranslationBlock *tb, int n);
@@ -67,4 +71,20 @@ static inline target_ulong log_pc(CPUState *cpu, const TranslationBlock *tb)
 extern int64_t max_delay;
 extern int64_t max_advance;
 
+/*
+ * Number of executions after which a TB is retranslated as a
+ * superblock, or 0 if superblock formation is disabled.
+ */
+extern uint32_t tb_superblock_threshold;
+
+/*
+ * Execution counters of cold TBs, indexed by tcg_tb_index().  They are
+ * kept out of the code buffer so that the generated code never stores
+ * to the pages it is executing from.  NULL if superblocks are disabled.
+ */
+extern uint32_t *tb_exec_counts;
+
+/* Start counting the executions of a new @tb from zero. */
+void tb_exec_count_reset(const TranslationBlock *tb);
+
 #endif /* ACCEL_TCG_INTERNAL_H */
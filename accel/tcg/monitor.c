@@ -10,11 +10,14 @@
 #include "qapi/error.h"
 #include "qapi/type-helpers.h"
 #include "qapi/qapi-commands-machine.h"
+#include "qapi/util.h"
 #include "monitor/monitor.h"
+#include "monitor/hmp.h"
 #include "sysemu/cpus.h"
 #include "sysemu/cpu-timers.h"
 #include "sysemu/tcg.h"
 #include "internal.h"
+#include "tb-stats.h"
 
 
 static void dump_drift_info(GString *buf)
@@ -66,6 +69,56 @@ HumanReadableText *qmp_x_query_opcount(Error **errp)
     return human_readable_text_from_str(buf);
 }
 
+HumanReadableText *qmp_x_query_tb_hot(bool has_count, uint32_t count,
+                                      bool has_sort_by, TbHotSortKey sort_by,
+                                      Error **errp)
+{
+    g_autoptr(GString) buf = g_string_new("");
+
+    if (!tcg_enabled()) {
+        error_setg(errp,
+                   "TB statistics are only available with accel=tcg");
+        return NULL;
+    }
+
+    if (!tb_stats_dump_hot(buf, has_count ? count : 10,
+                           has_sort_by ? sort_by : TB_HOT_SORT_KEY_EXEC,
+                           errp)) {
+        return NULL;
+    }
+
+    return human_readable_text_from_str(buf);
+}
+
+static void hmp_info_tb_hot(Monitor *mon, const QDict *qdict)
+{
+    int64_t count = qdict_get_try_int(qdict, "count", 10);
+    const char *sort = qdict_get_try_str(qdict, "sort");
+    g_autoptr(HumanReadableText) info = NULL;
+    TbHotSortKey sort_by = TB_HOT_SORT_KEY_EXEC;
+    Error *err = NULL;
+
+    if (count < 0) {
+        monitor_printf(mon, "count must not be negative\n");
+        return;
+    }
+    if (sort) {
+        sort_by = qapi_enum_parse(&TbHotSortKey_lookup, sort, -1, &err);
+        if (err) {
+            hmp_handle_error(mon, err);
+            return;
+        }
+    }
+
+    info = qmp_x_query_tb_hot(true, MIN(count, UINT32_MAX), true, sort_by,
+                              &err);
+    if (err) {
+        hmp_handle_error(mon, err);
+        return;
+    }
+    monitor_puts(mon, info->human_readable_text);
+}
+
 #ifdef CONFIG_PROFILER
 
 int64_t dev_time;
@@ -101,6 +154,7 @@ static void hmp_tcg_register(void)
 {
     monitor_register_hmp_info_hrt("jit", qmp_x_query_jit);
     monitor_register_hmp_info_hrt("opcount", qmp_x_query_opcount);
+    monitor_register_hmp("tb-hot", true, hmp_info_tb_hot);
 }
 
 type_init(hmp_tcg_register);
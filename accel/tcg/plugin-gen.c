@@ -75,6 +75,7 @@ enum plugin_gen_cb {
     PLUGIN_GEN_CB_UDATA,
     PLUGIN_GEN_CB_INLINE,
     PLUGIN_GEN_CB_MEM,
+    PLUGIN_GEN_CB_MEM_BUFFER,
     PLUGIN_GEN_ENABLE_MEM_HELPER,
     PLUGIN_GEN_DISABLE_MEM_HELPER,
     PLUGIN_GEN_N_CBS,
@@ -92,6 +93,11 @@ void HELPER(plugin_vcpu_mem_cb)(unsigned int vcpu_index,
                                 void *userdata)
 { }
 
+void HELPER(plugin_vcpu_mem_buffer_flush)(uint32_t cpu_index, void *buf)
+{
+    qemu_plugin_mem_buffer_flush(buf, cpu_index);
+}
+
 static void do_gen_mem_cb(TCGv vaddr, uint32_t info)
 {
     TCGv_i32 cpu_index = tcg_temp_ebb_new_i32();
@@ -128,21 +134,12 @@ static void gen_empty_udata_cb(void)
 }
 
 /*
- * For now we only support addi_i64.
- * When we support more ops, we can generate one empty inline cb for each.
+ * Inline ops and conditional callbacks are generated from scratch at
+ * injection time (see inject_inline_cb), so only the insertion point
+ * is needed.
  */
 static void gen_empty_inline_cb(void)
 {
-    TCGv_i64 val = tcg_temp_ebb_new_i64();
-    TCGv_ptr ptr = tcg_temp_ebb_new_ptr();
-
-    tcg_gen_movi_ptr(ptr, 0);
-    tcg_gen_ld_i64(val, ptr, 0);
-    /* pass an immediate != 0 so that it doesn't get optimized away */
-    tcg_gen_addi_i64(val, val, 0xdeadface);
-    tcg_gen_st_i64(val, ptr, 0);
-    tcg_temp_free_ptr(ptr);
-    tcg_temp_free_i64(val);
 }
 
 static void gen_empty_mem_cb(TCGv addr, uint32_t info)
@@ -150,6 +147,12 @@ static void gen_empty_mem_cb(TCGv addr, uint32_t info)
     do_gen_mem_cb(addr, info);
 }
 
+/* Trace buffer records are generated at injection time, from @addr */
+static void gen_empty_mem_buffer(TCGv addr, uint32_t info)
+{
+    tcg_gen_plugin_mem_cb(addr, info);
+}
+
 /*
  * Share the same function for enable/disable. When enabling, the NULL
  * pointer will be overwritten later.
@@ -226,9 +229,14 @@ void plugin_gen_empty_mem_callback(TCGv addr, uint32_t info)
 {
     union mem_gen_fn fn;
 
+    tcg_ctx->plugin_insn->mem_accesses++;
+
     fn.mem_fn = gen_empty_mem_cb;
     gen_mem_wrapped(PLUGIN_GEN_CB_MEM, &fn, addr, info, true);
 
+    fn.mem_fn = gen_empty_mem_buffer;
+    gen_mem_wrapped(PLUGIN_GEN_CB_MEM_BUFFER, &fn, addr, info, true);
+
     fn.inline_fn = gen_empty_inline_cb;
     gen_mem_wrapped(PLUGIN_GEN_CB_INLINE, &fn, 0, info, false);
 }
@@ -333,19 +341,6 @@ static TCGOp *copy_extu_tl_i64(TCGOp **begin_op, TCGOp *op)
     return op;
 }
 
-static TCGOp *copy_ld_i64(TCGOp **begin_op, TCGOp *op)
-{
-    if (TCG_TARGET_REG_BITS == 32) {
-        /* 2x ld_i32 */
-        op = copy_op(begin_op, op, INDEX_op_ld_i32);
-        op = copy_op(begin_op, op, INDEX_op_ld_i32);
-    } else {
-        /* ld_i64 */
-        op = copy_op(begin_op, op, INDEX_op_ld_i64);
-    }
-    return op;
-}
-
 static TCGOp *copy_st_i64(TCGOp **begin_op, TCGOp *op)
 {
     if (TCG_TARGET_REG_BITS == 32) {
@@ -359,21 +354,6 @@ static TCGOp *copy_st_i64(TCGOp **begin_op, TCGOp *op)
     return op;
 }
 
-static TCGOp *copy_add_i64(TCGOp **begin_op, TCGOp *op, uint64_t v)
-{
-    if (TCG_TARGET_REG_BITS == 32) {
-        /* all 32-bit backends must implement add2_i32 */
-        g_assert(TCG_TARGET_HAS_add2_i32);
-        op = copy_op(begin_op, op, INDEX_op_add2_i32);
-        op->args[4] = tcgv_i32_arg(tcg_constant_i32(v));
-        op->args[5] = tcgv_i32_arg(tcg_constant_i32(v >> 32));
-    } else {
-        op = copy_op(begin_op, op, INDEX_op_add_i64);
-        op->args[2] = tcgv_i64_arg(tcg_constant_i64(v));
-    }
-    return op;
-}
-
 static TCGOp *copy_st_ptr(TCGOp **begin_op, TCGOp *op)
 {
     if (UINTPTR_MAX == UINT32_MAX) {
@@ -437,25 +417,6 @@ static TCGOp *append_udata_cb(const struct qemu_plugin_dyn_cb *cb,
     return op;
 }
 
-static TCGOp *append_inline_cb(const struct qemu_plugin_dyn_cb *cb,
-                               TCGOp *begin_op, TCGOp *op,
-                               int *unused)
-{
-    /* const_ptr */
-    op = copy_const_ptr(&begin_op, op, cb->userp);
-
-    /* ld_i64 */
-    op = copy_ld_i64(&begin_op, op);
-
-    /* add_i64 */
-    op = copy_add_i64(&begin_op, op, cb->inline_insn.imm);
-
-    /* st_i64 */
-    op = copy_st_i64(&begin_op, op);
-
-    return op;
-}
-
 static TCGOp *append_mem_cb(const struct qemu_plugin_dyn_cb *cb,
                             TCGOp *begin_op, TCGOp *op, int *cb_idx)
 {
@@ -541,10 +502,335 @@ inject_udata_cb(const GArray *cbs, TCGOp *begin_op)
     inject_cb_type(cbs, begin_op, append_udata_cb, op_ok);
 }
 
-static void
-inject_inline_cb(const GArray *cbs, TCGOp *begin_op, op_ok_fn ok)
+/*
+ * Load the address that @entry refers to for the vCPU running the code;
+ * @ptr is the address to use for entries that are not in a scoreboard.
+ */
+static TCGv_ptr gen_plugin_u64_ptr(qemu_plugin_u64 entry, void *ptr)
+{
+    TCGv_ptr addr = tcg_temp_ebb_new_ptr();
+    TCGv_i32 cpu_index;
+    GArray *data;
+
+    if (!entry.score) {
+        tcg_gen_movi_ptr(addr, (intptr_t)ptr);
+        return addr;
+    }
+
+    data = entry.score->data;
+    cpu_index = tcg_temp_ebb_new_i32();
+    tcg_gen_ld_i32(cpu_index, cpu_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    tcg_gen_muli_i32(cpu_index, cpu_index, g_array_get_element_size(data));
+    tcg_gen_ext_i32_ptr(addr, cpu_index);
+    tcg_temp_free_i32(cpu_index);
+    tcg_gen_addi_ptr(addr, addr, (intptr_t)data->data + entry.offset);
+    return addr;
+}
+
+static void gen_inline_op(const struct qemu_plugin_dyn_cb *cb)
+{
+    TCGv_ptr ptr = gen_plugin_u64_ptr(cb->inline_insn.entry, cb->userp);
+    TCGv_i64 val;
+
+    switch (cb->inline_insn.op) {
+    case QEMU_PLUGIN_INLINE_ADD_U64:
+        val = tcg_temp_ebb_new_i64();
+        tcg_gen_ld_i64(val, ptr, 0);
+        tcg_gen_addi_i64(val, val, cb->inline_insn.imm);
+        tcg_gen_st_i64(val, ptr, 0);
+        tcg_temp_free_i64(val);
+        break;
+    case QEMU_PLUGIN_INLINE_STORE_U64:
+        tcg_gen_st_i64(tcg_constant_i64(cb->inline_insn.imm), ptr, 0);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+    tcg_temp_free_ptr(ptr);
+}
+
+static TCGCond plugin_cond_to_tcgcond(enum qemu_plugin_cond cond)
+{
+    switch (cond) {
+    case QEMU_PLUGIN_COND_EQ:
+        return TCG_COND_EQ;
+    case QEMU_PLUGIN_COND_NE:
+        return TCG_COND_NE;
+    case QEMU_PLUGIN_COND_LT:
+        return TCG_COND_LTU;
+    case QEMU_PLUGIN_COND_LE:
+        return TCG_COND_LEU;
+    case QEMU_PLUGIN_COND_GT:
+        return TCG_COND_GTU;
+    case QEMU_PLUGIN_COND_GE:
+        return TCG_COND_GEU;
+    default:
+        /* ALWAYS and NEVER conditions are handled at registration time */
+        g_assert_not_reached();
+    }
+}
+
+/*
+ * As in append_udata_cb, call the empty helper and then point the call
+ * op at the plugin's callback.
+ */
+static void gen_cond_cb(const struct qemu_plugin_dyn_cb *cb)
+{
+    TCGLabel *after_cb = gen_new_label();
+    TCGv_ptr ptr = gen_plugin_u64_ptr(cb->cond.entry, NULL);
+    TCGv_i64 val = tcg_temp_ebb_new_i64();
+    TCGv_i32 cpu_index;
+    TCGOp *op;
+
+    tcg_gen_ld_i64(val, ptr, 0);
+    tcg_temp_free_ptr(ptr);
+    tcg_gen_brcondi_i64(tcg_invert_cond(plugin_cond_to_tcgcond(cb->cond.cond)),
+                        val, cb->cond.imm, after_cb);
+    tcg_temp_free_i64(val);
+
+    cpu_index = tcg_temp_ebb_new_i32();
+    tcg_gen_ld_i32(cpu_index, cpu_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    gen_helper_plugin_vcpu_udata_cb(cpu_index, tcg_constant_ptr(cb->userp));
+    tcg_temp_free_i32(cpu_index);
+
+    op = tcg_last_op();
+    tcg_debug_assert(op->opc == INDEX_op_call);
+    op->args[TCGOP_CALLO(op) + TCGOP_CALLI(op)] = (uintptr_t)cb->f.vcpu_udata;
+
+    gen_set_label(after_cb);
+}
+
+static void inject_inline_cb(const GArray *cbs, const GArray *cond_cbs,
+                             TCGOp *begin_op, op_ok_fn ok)
+{
+    TCGOp *end_op;
+    int i;
+
+    if ((!cbs || cbs->len == 0) && (!cond_cbs || cond_cbs->len == 0)) {
+        rm_ops(begin_op);
+        return;
+    }
+
+    end_op = find_op(begin_op, INDEX_op_plugin_cb_end);
+    tcg_debug_assert(end_op);
+
+    /* in front of the range that is removed below */
+    tcg_ctx->emit_before_op = begin_op;
+    for (i = 0; cbs && i < cbs->len; i++) {
+        struct qemu_plugin_dyn_cb *cb =
+            &g_array_index(cbs, struct qemu_plugin_dyn_cb, i);
+
+        if (ok(begin_op, cb)) {
+            gen_inline_op(cb);
+        }
+    }
+    /* after the inline ops, so that the condition sees their result */
+    for (i = 0; cond_cbs && i < cond_cbs->len; i++) {
+        gen_cond_cb(&g_array_index(cond_cbs, struct qemu_plugin_dyn_cb, i));
+    }
+    tcg_ctx->emit_before_op = NULL;
+
+    rm_ops_range(begin_op, end_op);
+}
+
+/* Return how many elements of @cbs record to @buf */
+static size_t buffer_cbs(const GArray *cbs,
+                         const struct qemu_plugin_mem_buffer *buf)
+{
+    size_t n = 0;
+    int i;
+
+    for (i = 0; cbs && i < cbs->len; i++) {
+        const struct qemu_plugin_dyn_cb *cb =
+            &g_array_index(cbs, struct qemu_plugin_dyn_cb, i);
+
+        if (cb->buffer.buf == buf) {
+            n++;
+        }
+    }
+    return n;
+}
+
+/*
+ * Return the maximum number of records that @insn appends to @buf: its
+ * executions, each of its memory accesses, and one for an access from a
+ * helper, after which plugin_mem_buffer_append() keeps the reserved room.
+ * Each memory access of the translated code is executed at most once.
+ */
+static size_t insn_buffer_records(const struct qemu_plugin_insn *insn,
+                                  const struct qemu_plugin_mem_buffer *buf)
 {
-    inject_cb_type(cbs, begin_op, append_inline_cb, ok);
+    size_t n_mem = buffer_cbs(insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_BUFFER], buf);
+    size_t n = buffer_cbs(insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_BUFFER], buf);
+
+    n += insn->mem_accesses * n_mem;
+    if (insn->mem_helper && n_mem) {
+        n++;
+    }
+    return n;
+}
+
+static void gen_buffer_flush(struct qemu_plugin_mem_buffer *buf)
+{
+    TCGv_i32 cpu_index = tcg_temp_ebb_new_i32();
+
+    tcg_gen_ld_i32(cpu_index, cpu_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    gen_helper_plugin_vcpu_mem_buffer_flush(cpu_index, tcg_constant_ptr(buf));
+    tcg_temp_free_i32(cpu_index);
+}
+
+/*
+ * Flush the vCPU's trace buffer unless it has room for all the records
+ * of @insn. This is the only branch of the buffered tracing, and it must
+ * be at the start of the instruction: after a guest memory access, the
+ * EBB temps of the instruction may still be live.
+ */
+static void gen_buffer_reserve(const struct qemu_plugin_insn *insn,
+                               struct qemu_plugin_mem_buffer *buf)
+{
+    qemu_plugin_u64 entry = { .score = buf->score };
+    size_t reserve = MIN(insn_buffer_records(insn, buf), buf->n_records);
+    TCGLabel *has_room = gen_new_label();
+    TCGv_ptr base = gen_plugin_u64_ptr(entry, NULL);
+    TCGv_i64 n = tcg_temp_ebb_new_i64();
+
+    if (insn->mem_helper) {
+        tcg_gen_st_i64(tcg_constant_i64(reserve), base,
+                       offsetof(struct qemu_plugin_mem_buffer_vcpu, reserved));
+    }
+    tcg_gen_ld_i64(n, base, offsetof(struct qemu_plugin_mem_buffer_vcpu, n));
+    tcg_temp_free_ptr(base);
+    tcg_gen_brcondi_i64(TCG_COND_LEU, n, buf->n_records - reserve, has_room);
+    tcg_temp_free_i64(n);
+    gen_buffer_flush(buf);
+    gen_set_label(has_room);
+}
+
+/* Return the buffer of the @i-th buffered callback of @insn, or NULL */
+static struct qemu_plugin_mem_buffer *
+insn_buffer(const struct qemu_plugin_insn *insn, unsigned int i)
+{
+    const GArray *insn_cbs = insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_BUFFER];
+    const GArray *mem_cbs = insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_BUFFER];
+
+    if (i < insn_cbs->len) {
+        return g_array_index(insn_cbs, struct qemu_plugin_dyn_cb, i).buffer.buf;
+    }
+    i -= insn_cbs->len;
+    if (i < mem_cbs->len) {
+        return g_array_index(mem_cbs, struct qemu_plugin_dyn_cb, i).buffer.buf;
+    }
+    return NULL;
+}
+
+/* Must be called with tcg_ctx->emit_before_op set */
+static void gen_buffer_reserves(const struct qemu_plugin_insn *insn)
+{
+    struct qemu_plugin_mem_buffer *buf;
+    unsigned int i, j;
+
+    for (i = 0; (buf = insn_buffer(insn, i)); i++) {
+        /* once for each buffer */
+        for (j = 0; j < i && insn_buffer(insn, j) != buf; j++) {
+            continue;
+        }
+        if (j == i) {
+            gen_buffer_reserve(insn, buf);
+        }
+    }
+}
+
+/*
+ * Append a record for an access to @vaddr (with @info 0 for an instruction
+ * execution) to the vCPU's trace buffer. gen_buffer_reserve() made room
+ * for it, unless the records of the instruction do not fit in the buffer;
+ * then each of them is flushed on its own.
+ */
+static void gen_buffer_record(const struct qemu_plugin_insn *insn,
+                              const struct qemu_plugin_dyn_cb *cb,
+                              TCGv_i64 vaddr, uint32_t info)
+{
+    struct qemu_plugin_mem_buffer *buf = cb->buffer.buf;
+    qemu_plugin_u64 entry = { .score = buf->score };
+    TCGv_ptr base = gen_plugin_u64_ptr(entry, NULL);
+    TCGv_ptr rec = tcg_temp_ebb_new_ptr();
+    TCGv_i64 n = tcg_temp_ebb_new_i64();
+    TCGv_i64 off = tcg_temp_ebb_new_i64();
+
+    tcg_gen_ld_i64(n, base, offsetof(struct qemu_plugin_mem_buffer_vcpu, n));
+    tcg_gen_muli_i64(off, n, sizeof(struct qemu_plugin_mem_record));
+    tcg_gen_trunc_i64_ptr(rec, off);
+    tcg_temp_free_i64(off);
+    tcg_gen_add_ptr(rec, rec, base);
+
+#define REC_OFS(field) (offsetof(struct qemu_plugin_mem_buffer_vcpu, \
+                                 records) + \
+                        offsetof(struct qemu_plugin_mem_record, field))
+    tcg_gen_st_i64(vaddr, rec, REC_OFS(vaddr));
+    tcg_gen_st_i64(tcg_constant_i64(cb->buffer.insn_vaddr), rec,
+                   REC_OFS(insn_vaddr));
+    tcg_gen_st_ptr(tcg_constant_ptr(cb->userp), rec, REC_OFS(userdata));
+    tcg_gen_st_i32(tcg_constant_i32(info), rec, REC_OFS(info));
+#undef REC_OFS
+    tcg_temp_free_ptr(rec);
+
+    tcg_gen_addi_i64(n, n, 1);
+    tcg_gen_st_i64(n, base, offsetof(struct qemu_plugin_mem_buffer_vcpu, n));
+    tcg_temp_free_i64(n);
+    tcg_temp_free_ptr(base);
+
+    if (insn_buffer_records(insn, buf) > buf->n_records) {
+        gen_buffer_flush(buf);
+    }
+}
+
+/* Must be called with tcg_ctx->emit_before_op set */
+static void gen_buffer_records(const struct qemu_plugin_insn *insn,
+                               const GArray *cbs, TCGOp *begin_op,
+                               TCGv_i64 vaddr, uint32_t info, op_ok_fn ok)
+{
+    int i;
+
+    for (i = 0; cbs && i < cbs->len; i++) {
+        struct qemu_plugin_dyn_cb *cb =
+            &g_array_index(cbs, struct qemu_plugin_dyn_cb, i);
+
+        if (ok(begin_op, cb)) {
+            gen_buffer_record(insn, cb, vaddr, info);
+        }
+    }
+}
+
+static void inject_mem_buffer_cb(const struct qemu_plugin_insn *insn,
+                                 TCGOp *begin_op)
+{
+    const GArray *cbs = insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_BUFFER];
+    TCGOp *mem_op = QTAILQ_NEXT(begin_op, link);
+    TCGTemp *addr = arg_temp(mem_op->args[0]);
+    TCGv_i64 vaddr;
+
+    tcg_debug_assert(mem_op->opc == INDEX_op_plugin_mem_cb);
+    if (!cbs || cbs->len == 0) {
+        rm_ops(begin_op);
+        return;
+    }
+
+    /* no labels here, we are in the middle of the instruction */
+    tcg_ctx->emit_before_op = begin_op;
+    vaddr = tcg_temp_ebb_new_i64();
+    if (TARGET_LONG_BITS == 32) {
+        tcg_gen_extu_i32_i64(vaddr, temp_tcgv_i32(addr));
+    } else {
+        tcg_gen_mov_i64(vaddr, temp_tcgv_i64(addr));
+    }
+    gen_buffer_records(insn, cbs, begin_op, vaddr, mem_op->args[1], op_rw);
+    tcg_temp_free_i64(vaddr);
+    tcg_ctx->emit_before_op = NULL;
+
+    rm_ops(begin_op);
 }
 
 static void
@@ -588,12 +874,13 @@ static void inject_mem_enable_helper(struct qemu_plugin_tb *ptb,
                                      struct qemu_plugin_insn *plugin_insn,
                                      TCGOp *begin_op)
 {
-    GArray *cbs[2];
+    GArray *cbs[3];
     GArray *arr;
     size_t n_cbs, i;
 
     cbs[0] = plugin_insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_REGULAR];
     cbs[1] = plugin_insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_INLINE];
+    cbs[2] = plugin_insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_BUFFER];
 
     n_cbs = 0;
     for (i = 0; i < ARRAY_SIZE(cbs); i++) {
@@ -656,7 +943,8 @@ static void plugin_gen_tb_udata(const struct qemu_plugin_tb *ptb,
 static void plugin_gen_tb_inline(const struct qemu_plugin_tb *ptb,
                                  TCGOp *begin_op)
 {
-    inject_inline_cb(ptb->cbs[PLUGIN_CB_INLINE], begin_op, op_ok);
+    inject_inline_cb(ptb->cbs[PLUGIN_CB_INLINE], ptb->cbs[PLUGIN_CB_COND],
+                     begin_op, op_ok);
 }
 
 static void plugin_gen_insn_udata(const struct qemu_plugin_tb *ptb,
@@ -671,7 +959,16 @@ static void plugin_gen_insn_inline(const struct qemu_plugin_tb *ptb,
                                    TCGOp *begin_op, int insn_idx)
 {
     struct qemu_plugin_insn *insn = g_ptr_array_index(ptb->insns, insn_idx);
+
+    /* the execution is recorded before the accesses of the instruction */
+    tcg_ctx->emit_before_op = begin_op;
+    gen_buffer_reserves(insn);
+    gen_buffer_records(insn, insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_BUFFER],
+                       begin_op, tcg_constant_i64(insn->vaddr), 0, op_ok);
+    tcg_ctx->emit_before_op = NULL;
+
     inject_inline_cb(insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_INLINE],
+                     insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_COND],
                      begin_op, op_ok);
 }
 
@@ -689,7 +986,14 @@ static void plugin_gen_mem_inline(const struct qemu_plugin_tb *ptb,
     struct qemu_plugin_insn *insn = g_ptr_array_index(ptb->insns, insn_idx);
 
     cbs = insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_INLINE];
-    inject_inline_cb(cbs, begin_op, op_rw);
+    inject_inline_cb(cbs, NULL, begin_op, op_rw);
+}
+
+static void plugin_gen_mem_buffer(const struct qemu_plugin_tb *ptb,
+                                  TCGOp *begin_op, int insn_idx)
+{
+    struct qemu_plugin_insn *insn = g_ptr_array_index(ptb->insns, insn_idx);
+    inject_mem_buffer_cb(insn, begin_op);
 }
 
 static void plugin_gen_enable_mem_helper(struct qemu_plugin_tb *ptb,
@@ -744,6 +1048,9 @@ static void pr_ops(void)
             case PLUGIN_GEN_CB_MEM:
                 type = "mem";
                 break;
+            case PLUGIN_GEN_CB_MEM_BUFFER:
+                type = "mem buffer";
+                break;
             case PLUGIN_GEN_ENABLE_MEM_HELPER:
                 type = "enable mem helper";
                 break;
@@ -824,6 +1131,9 @@ static void plugin_gen_inject(struct qemu_plugin_tb *plugin_tb)
                 case PLUGIN_GEN_CB_INLINE:
                     plugin_gen_mem_inline(plugin_tb, op, insn_idx);
                     break;
+                case PLUGIN_GEN_CB_MEM_BUFFER:
+                    plugin_gen_mem_buffer(plugin_tb, op, insn_idx);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
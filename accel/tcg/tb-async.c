@@ -0,0 +1,254 @@
+/*
+ * Background translation of superblocks.
+ *
+ * When a TB becomes hot, the vCPU that noticed hands the retranslation to
+ * a pool of translator threads and goes on running the existing TB, which
+ * stays valid until the superblock replaces it.  Each translator thread
+ * has its own TCGContext and code region, exactly like a vCPU thread in
+ * MTTCG mode, and publishes its TBs through the same tb_link_page() path.
+ *
+ * Translator threads cannot use the softmmu TLB of the vCPU they work
+ * for, so the vCPU resolves the code page before queueing the request,
+ * and a translation that needs another page is abandoned (see
+ * translator_access()).  Likewise the vCPU state keeps changing under
+ * the worker, so only targets that set TCGCPUOps.translate_async, whose
+ * translation depends on nothing but the TB flags and fixed state, are
+ * handled here.  Cold TBs are still translated synchronously: the vCPU
+ * has nothing else to run.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/queue.h"
+#include "qemu/rcu.h"
+#include "qemu/thread.h"
+#include "qemu/timer.h"
+#include "exec/exec-all.h"
+#include "hw/core/tcg-cpu-ops.h"
+#include "tcg/tcg.h"
+#include "tb-context.h"
+#include "internal.h"
+#include "tb-async.h"
+
+/* Beyond this many pending requests, the vCPU translates by itself. */
+#define TB_ASYNC_QUEUE_MAX  256
+
+typedef struct TBAsyncRequest {
+    CPUState *cpu;
+    TranslationBlock *tb;
+    target_ulong pc;
+    target_ulong cs_base;
+    uint32_t flags;
+    uint32_t cflags;
+    tb_page_addr_t phys_pc;
+    void *host_pc;
+    unsigned tb_flush_count;
+    int64_t queued_ns;
+    QSIMPLEQ_ENTRY(TBAsyncRequest) entry;
+} TBAsyncRequest;
+
+typedef struct TBAsyncWorker {
+    QemuThread thread;
+    /* Held while translating; tb_flush takes all of them. */
+    QemuMutex lock;
+} TBAsyncWorker;
+
+static struct {
+    TBAsyncWorker *workers;
+    unsigned n_workers;
+
+    QemuMutex lock;
+    QemuCond cond;
+    QSIMPLEQ_HEAD(, TBAsyncRequest) queue;
+    unsigned depth;
+
+    /* Statistics, updated under @lock. */
+    unsigned max_depth;
+    uint64_t queued;
+    uint64_t overflows;
+    uint64_t done;
+    uint64_t stale;
+    int64_t wait_ns;
+    int64_t translate_ns;
+} tb_async;
+
+static __thread bool tb_async_worker;
+
+bool tb_async_in_worker(void)
+{
+    return tb_async_worker;
+}
+
+bool tb_async_request(CPUState *cpu, TranslationBlock *tb, target_ulong pc,
+                      target_ulong cs_base, uint32_t flags)
+{
+    TBAsyncRequest *req;
+    tb_page_addr_t phys_pc;
+    void *host_pc;
+
+    /* The vCPU keeps changing its state while the worker translates. */
+    if (!tb_async.n_workers || !cpu->cc->tcg_ops->translate_async) {
+        return false;
+    }
+
+    /* Superblocks that span two pages are left to the vCPU. */
+    phys_pc = get_page_addr_code_hostp(cpu->env_ptr, pc, &host_pc);
+    if (phys_pc == -1 || phys_pc != tb_page_addr0(tb) ||
+        tb_page_addr1(tb) != -1) {
+        return false;
+    }
+
+    req = g_new(TBAsyncRequest, 1);
+    req->cpu = cpu;
+    req->tb = tb;
+    req->pc = pc;
+    req->cs_base = cs_base;
+    req->flags = flags;
+    req->cflags = tb_cflags(tb) | CF_HOT;
+    req->phys_pc = phys_pc;
+    req->host_pc = host_pc;
+    req->tb_flush_count = qatomic_read(&tb_ctx.tb_flush_count);
+    req->queued_ns = get_clock();
+
+    qemu_mutex_lock(&tb_async.lock);
+    if (tb_async.depth == TB_ASYNC_QUEUE_MAX) {
+        tb_async.overflows++;
+        qemu_mutex_unlock(&tb_async.lock);
+        g_free(req);
+        return false;
+    }
+    QSIMPLEQ_INSERT_TAIL(&tb_async.queue, req, entry);
+    tb_async.depth++;
+    tb_async.max_depth = MAX(tb_async.max_depth, tb_async.depth);
+    tb_async.queued++;
+    qemu_cond_signal(&tb_async.cond);
+    qemu_mutex_unlock(&tb_async.lock);
+    return true;
+}
+
+/* Called with the worker lock held, so that tb_flush cannot intervene. */
+static bool tb_async_translate(TBAsyncRequest *req)
+{
+    TranslationBlock *tb;
+
+    /* A flush since the request was queued has freed req->tb. */
+    if (qatomic_read(&tb_ctx.tb_flush_count) != req->tb_flush_count ||
+        (qatomic_read(&req->tb->cflags) & CF_INVALID)) {
+        return false;
+    }
+
+    qemu_thread_jit_write();
+    tb = tb_gen_code_phys(req->cpu, req->pc, req->cs_base, req->flags,
+                          req->cflags, req->phys_pc, req->host_pc, req->tb);
+    qemu_thread_jit_execute();
+    return tb != NULL;
+}
+
+static void *tb_async_thread(void *opaque)
+{
+    TBAsyncWorker *w = opaque;
+
+    rcu_register_thread();
+    tcg_register_thread();
+    tb_async_worker = true;
+
+    qemu_mutex_lock(&tb_async.lock);
+    while (true) {
+        TBAsyncRequest *req;
+        int64_t start, end;
+        bool ok;
+
+        while (QSIMPLEQ_EMPTY(&tb_async.queue)) {
+            qemu_cond_wait(&tb_async.cond, &tb_async.lock);
+        }
+        req = QSIMPLEQ_FIRST(&tb_async.queue);
+        QSIMPLEQ_REMOVE_HEAD(&tb_async.queue, entry);
+        tb_async.depth--;
+        qemu_mutex_unlock(&tb_async.lock);
+
+        start = get_clock();
+        qemu_mutex_lock(&w->lock);
+        WITH_RCU_READ_LOCK_GUARD() {
+            ok = tb_async_translate(req);
+        }
+        qemu_mutex_unlock(&w->lock);
+        end = get_clock();
+
+        qemu_mutex_lock(&tb_async.lock);
+        if (ok) {
+            tb_async.done++;
+            tb_async.wait_ns += start - req->queued_ns;
+            tb_async.translate_ns += end - start;
+            qatomic_inc(&tb_ctx.tb_hot_count);
+        } else {
+            tb_async.stale++;
+        }
+        g_free(req);
+    }
+
+    return NULL;
+}
+
+void tb_async_init(unsigned n)
+{
+    unsigned i;
+
+    qemu_mutex_init(&tb_async.lock);
+    qemu_cond_init(&tb_async.cond);
+    QSIMPLEQ_INIT(&tb_async.queue);
+
+    tb_async.workers = g_new0(TBAsyncWorker, n);
+    for (i = 0; i < n; i++) {
+        TBAsyncWorker *w = &tb_async.workers[i];
+        g_autofree char *name = g_strdup_printf("TCG translate %u", i);
+
+        qemu_mutex_init(&w->lock);
+        qemu_thread_create(&w->thread, name, tb_async_thread, w,
+                           QEMU_THREAD_JOINABLE);
+    }
+    tb_async.n_workers = n;
+}
+
+void tb_async_lock(void)
+{
+    unsigned i;
+
+    for (i = 0; i < tb_async.n_workers; i++) {
+        qemu_mutex_lock(&tb_async.workers[i].lock);
+    }
+}
+
+void tb_async_unlock(void)
+{
+    unsigned i;
+
+    for (i = 0; i < tb_async.n_workers; i++) {
+        qemu_mutex_unlock(&tb_async.workers[i].lock);
+    }
+}
+
+void tb_async_dump_info(GString *buf)
+{
+    if (!tb_async.n_workers) {
+        return;
+    }
+
+    qemu_mutex_lock(&tb_async.lock);
+    g_string_append_printf(buf, "async translate threads %u\n",
+                           tb_async.n_workers);
+    g_string_append_printf(buf, "async queue depth   %u (max %u)\n",
+                           tb_async.depth, tb_async.max_depth);
+    g_string_append_printf(buf, "async requests      %" PRIu64
+                           " (%" PRIu64 " done, %" PRIu64 " dropped, %"
+                           PRIu64 " overflowed)\n",
+                           tb_async.queued, tb_async.done, tb_async.stale,
+                           tb_async.overflows);
+    g_string_append_printf(buf, "async avg wait      %" PRId64 " ns\n",
+                           tb_async.done ?
+                           tb_async.wait_ns / tb_async.done : 0);
+    g_string_append_printf(buf, "async avg translate %" PRId64 " ns\n",
+                           tb_async.done ?
+                           tb_async.translate_ns / tb_async.done : 0);
+    qemu_mutex_unlock(&tb_async.lock);
+}
@@ -0,0 +1,54 @@
+/*
+ * Background translation of superblocks.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef ACCEL_TCG_TB_ASYNC_H
+#define ACCEL_TCG_TB_ASYNC_H
+
+#if defined(CONFIG_TCG) && defined(CONFIG_SOFTMMU)
+/* Start @n translator threads.  Called once, after tcg_prologue_init(). */
+void tb_async_init(unsigned n);
+
+/*
+ * Queue the retranslation of the hot @tb, which @cpu has just left with
+ * TB_EXIT_HOT in the state described by @pc, @cs_base and @flags.
+ * Returns false if the request was not queued and the caller should do
+ * the retranslation itself.
+ */
+bool tb_async_request(CPUState *cpu, TranslationBlock *tb, target_ulong pc,
+                      target_ulong cs_base, uint32_t flags);
+
+/* True if the current thread is a translator thread. */
+bool tb_async_in_worker(void);
+
+/* Keep the translator threads away from the code buffer during tb_flush. */
+void tb_async_lock(void);
+void tb_async_unlock(void);
+
+/* Add statistics about the translator threads to @buf. */
+void tb_async_dump_info(GString *buf);
+#else
+static inline bool tb_async_request(CPUState *cpu, TranslationBlock *tb,
+                                    target_ulong pc, target_ulong cs_base,
+                                    uint32_t flags)
+{
+    return false;
+}
+
+static inline bool tb_async_in_worker(void)
+{
+    return false;
+}
+
+static inline void tb_async_lock(void)
+{
+}
+
+static inline void tb_async_unlock(void)
+{
+}
+#endif
+
+#endif
@@ -0,0 +1,490 @@
+/*
+ * Persistent translation cache for user-mode emulation.
+ *
+ * Host code generated by TCG is full of absolute addresses: helpers,
+ * globals, the prologue, the TranslationBlock itself and the targets of
+ * chained jumps.  Rather than relocating it, the cache is only reused when
+ * the new process is laid out exactly like the one that wrote it: same
+ * QEMU binary at the same address, same code buffer, same guest_base,
+ * same first vCPU and byte-identical prologue.  In practice this means
+ * running the same command line with address space randomization
+ * disabled, which is the common case for build farms and test suites
+ * that start the same binaries over and over.  Heap addresses such as
+ * the vCPU and the TB execution counters are baked into the code too,
+ * so the cache is not even looked at while randomization is enabled.
+ *
+ * The file holds the used part of the code buffer verbatim, a copy of the
+ * guest bytes each TB was translated from and the lookup key of each TB.
+ * At startup the code is copied back to its old place; a TB is adopted
+ * lazily, the first time tb_gen_code() is asked for it, and only if the
+ * guest bytes still match.  Everything else is regenerated as usual.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#ifdef CONFIG_LINUX
+#include <sys/personality.h>
+#endif
+#include "qemu/cacheflush.h"
+#include "qemu/error-report.h"
+#include "qemu/plugin-event.h"
+#include "exec/exec-all.h"
+#include "exec/cpu_ldst.h"
+#include "exec/translate-all.h"
+#include "tcg/tcg.h"
+#include "trace.h"
+#include "tb-hash.h"
+#include "tb-context.h"
+#include "internal.h"
+#include "tb-cache.h"
+
+#define TB_CACHE_MAGIC      "QEMUTBC\0"
+#define TB_CACHE_VERSION    1
+
+typedef struct TBCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t pad;
+
+    /* The QEMU binary and where it was loaded. */
+    uint64_t exe_dev;
+    uint64_t exe_ino;
+    uint64_t exe_size;
+    int64_t exe_mtime;
+    uint64_t text_anchor;
+    uint64_t data_anchor;
+    uint64_t cpu_anchor;
+    uint64_t exec_counts_anchor;
+
+    /* The code buffer and the guest address space. */
+    uint64_t code_gen_buffer;
+    uint64_t code_gen_buffer_size;
+    uint64_t splitwx_diff;
+    uint64_t guest_base;
+
+    /* Options that are baked into the generated code. */
+    uint32_t tcg_cflags;
+    uint32_t superblock_threshold;
+    char cpu_model[128];
+
+    /* Sizes of the sections that follow the header. */
+    uint32_t prologue_size;
+    uint32_t nb_entries;
+    uint32_t bytes_size;
+    uint64_t code_size;
+} TBCacheHeader;
+
+/*
+ * One cached TB.  Followed in the file by the prologue, the entries, the
+ * concatenated guest bytes and finally the code.
+ */
+typedef struct TBCacheEntry {
+    uint64_t pc;
+    uint64_t cs_base;
+    uint32_t flags;
+    uint32_t cflags;
+    uint32_t trace_vcpu_dstate;
+    uint32_t size;
+    uint64_t tb_offset;     /* TranslationBlock, from code_gen_buffer */
+    uint64_t bytes_offset;  /* guest bytes, within the bytes section */
+} TBCacheEntry;
+
+static struct {
+    char *path;
+    pid_t pid;
+    /* Key properties of the first vCPU, which may exit before we save. */
+    uintptr_t cpu_anchor;
+    uint32_t tcg_cflags;
+    const char *cpu_model;
+    TBCacheEntry *entries;
+    uint8_t *bytes;
+    /* Entries not yet adopted or rejected; keys are the values. */
+    GHashTable *index;
+} tb_cache;
+
+void tb_cache_enable(const char *path)
+{
+#ifdef CONFIG_TCG_INTERPRETER
+    warn_report("The translation cache is not supported with TCI");
+#else
+    g_free(tb_cache.path);
+    tb_cache.path = g_strdup(path);
+#endif
+}
+
+static guint tb_cache_entry_hash(gconstpointer key)
+{
+    const TBCacheEntry *e = key;
+
+    return tb_hash_func(e->pc, e->pc, e->flags, e->cflags,
+                        e->trace_vcpu_dstate);
+}
+
+static gboolean tb_cache_entry_equal(gconstpointer a, gconstpointer b)
+{
+    const TBCacheEntry *ea = a, *eb = b;
+
+    return ea->pc == eb->pc &&
+           ea->cs_base == eb->cs_base &&
+           ea->flags == eb->flags &&
+           ea->cflags == eb->cflags &&
+           ea->trace_vcpu_dstate == eb->trace_vcpu_dstate;
+}
+
+static const void *tb_cache_prologue(void)
+{
+    return tcg_splitwx_to_rw((const void *)tcg_qemu_tb_exec);
+}
+
+/* True if mappings are placed at the same addresses in every run. */
+static bool tb_cache_layout_fixed(void)
+{
+#ifdef CONFIG_LINUX
+    g_autofree char *val = NULL;
+
+    if (personality(0xffffffff) & ADDR_NO_RANDOMIZE) {
+        return true;
+    }
+    return g_file_get_contents("/proc/sys/kernel/randomize_va_space",
+                               &val, NULL, NULL) && atoi(val) == 0;
+#else
+    return false;
+#endif
+}
+
+static bool tb_cache_header_init(TBCacheHeader *h)
+{
+    struct stat st;
+
+    if (stat("/proc/self/exe", &st) < 0) {
+        return false;
+    }
+
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, TB_CACHE_MAGIC, sizeof(h->magic));
+    h->version = TB_CACHE_VERSION;
+    h->exe_dev = st.st_dev;
+    h->exe_ino = st.st_ino;
+    h->exe_size = st.st_size;
+    h->exe_mtime = st.st_mtime;
+    h->text_anchor = (uintptr_t)tb_gen_code;
+    h->data_anchor = (uintptr_t)&tb_ctx;
+    h->cpu_anchor = tb_cache.cpu_anchor;
+    h->exec_counts_anchor = (uintptr_t)tb_exec_counts;
+    h->code_gen_buffer = (uintptr_t)tcg_ctx->code_gen_buffer;
+    h->code_gen_buffer_size = tcg_ctx->code_gen_buffer_size;
+    h->splitwx_diff = tcg_splitwx_diff;
+    h->guest_base = guest_base;
+    h->tcg_cflags = tb_cache.tcg_cflags;
+    h->superblock_threshold = tb_superblock_threshold;
+    pstrcpy(h->cpu_model, sizeof(h->cpu_model), tb_cache.cpu_model);
+    h->prologue_size = tcg_ctx->code_gen_buffer - tb_cache_prologue();
+    return true;
+}
+
+static bool tb_cache_header_matches(const TBCacheHeader *cur,
+                                    const TBCacheHeader *old)
+{
+    /* Everything up to the section sizes must be identical. */
+    return !memcmp(cur, old, offsetof(TBCacheHeader, nb_entries)) &&
+           old->nb_entries != 0 && old->bytes_size != 0 &&
+           old->code_size <= tcg_ctx->code_gen_highwater -
+                             tcg_ctx->code_gen_buffer;
+}
+
+static bool tb_cache_entry_valid(const TBCacheHeader *h,
+                                 const TBCacheEntry *e)
+{
+    return e->size != 0 &&
+           e->size <= 2 * TARGET_PAGE_SIZE &&
+           e->size <= h->bytes_size &&
+           e->bytes_offset <= h->bytes_size - e->size &&
+           h->code_size >= sizeof(TranslationBlock) &&
+           e->tb_offset <= h->code_size - sizeof(TranslationBlock) &&
+           QEMU_IS_ALIGNED(e->tb_offset, __alignof__(TranslationBlock));
+}
+
+void tb_cache_load(CPUState *cpu, const char *cpu_model)
+{
+    g_autofree uint8_t *prologue = NULL;
+    TBCacheHeader cur, old;
+    struct stat st;
+    void *rw;
+    FILE *f;
+    uint32_t i;
+
+    if (!tb_cache.path) {
+        return;
+    }
+    if (!tb_cache_layout_fixed()) {
+        warn_report("The translation cache needs address space "
+                    "randomization to be disabled, e.g. with setarch -R; "
+                    "ignoring %s", tb_cache.path);
+        g_clear_pointer(&tb_cache.path, g_free);
+        return;
+    }
+    assert(tcg_ctx->code_gen_ptr == tcg_ctx->code_gen_buffer);
+
+    tb_cache.pid = getpid();
+    tb_cache.cpu_anchor = (uintptr_t)cpu;
+    tb_cache.tcg_cflags = cpu->tcg_cflags;
+    tb_cache.cpu_model = cpu_model;
+    if (!tb_cache_header_init(&cur)) {
+        return;
+    }
+
+    f = fopen(tb_cache.path, "rb");
+    if (f == NULL) {
+        /* Nothing cached yet.  */
+        return;
+    }
+
+    /* The file is copied straight into the code buffer and executed. */
+    if (fstat(fileno(f), &st) < 0 || !S_ISREG(st.st_mode) ||
+        st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+        warn_report("Translation cache %s must be a regular file owned by "
+                    "the current user and not writable by others, "
+                    "ignoring it", tb_cache.path);
+        goto out;
+    }
+
+    if (fread(&old, sizeof(old), 1, f) != 1 ||
+        !tb_cache_header_matches(&cur, &old)) {
+        trace_tb_cache_mismatch(tb_cache.path);
+        goto out;
+    }
+
+    prologue = g_malloc(old.prologue_size);
+    if (fread(prologue, old.prologue_size, 1, f) != 1 ||
+        memcmp(prologue, tb_cache_prologue(), old.prologue_size)) {
+        trace_tb_cache_mismatch(tb_cache.path);
+        goto out;
+    }
+
+    tb_cache.entries = g_new(TBCacheEntry, old.nb_entries);
+    tb_cache.bytes = g_malloc(old.bytes_size);
+    if (fread(tb_cache.entries, sizeof(TBCacheEntry),
+              old.nb_entries, f) != old.nb_entries ||
+        fread(tb_cache.bytes, old.bytes_size, 1, f) != 1 ||
+        fread(tcg_ctx->code_gen_buffer, old.code_size, 1, f) != 1) {
+        warn_report("Could not read translation cache %s, ignoring it",
+                    tb_cache.path);
+        goto out;
+    }
+
+    rw = tcg_ctx->code_gen_buffer;
+    flush_idcache_range((uintptr_t)tcg_splitwx_to_rx(rw), (uintptr_t)rw,
+                        old.code_size);
+    tcg_ctx->code_gen_ptr = tcg_ctx->code_gen_buffer + old.code_size;
+
+    tb_cache.index = g_hash_table_new(tb_cache_entry_hash,
+                                      tb_cache_entry_equal);
+    for (i = 0; i < old.nb_entries; i++) {
+        TBCacheEntry *e = &tb_cache.entries[i];
+
+        if (tb_cache_entry_valid(&old, e)) {
+            g_hash_table_add(tb_cache.index, e);
+        }
+    }
+    trace_tb_cache_load(tb_cache.path, g_hash_table_size(tb_cache.index),
+                        old.code_size);
+    fclose(f);
+    return;
+
+ out:
+    g_clear_pointer(&tb_cache.entries, g_free);
+    g_clear_pointer(&tb_cache.bytes, g_free);
+    fclose(f);
+}
+
+static bool tb_cache_plugins_active(CPUState *cpu)
+{
+    /* Instrumented code refers to per-process plugin state. */
+    return test_bit(QEMU_PLUGIN_EV_VCPU_TB_TRANS, cpu->plugin_mask);
+}
+
+TranslationBlock *tb_cache_lookup(CPUState *cpu, target_ulong pc,
+                                  target_ulong cs_base, uint32_t flags,
+                                  uint32_t cflags)
+{
+    TBCacheEntry key = {
+        .pc = pc,
+        .cs_base = cs_base,
+        .flags = flags,
+        .cflags = cflags,
+        .trace_vcpu_dstate = *cpu->trace_dstate,
+    };
+    TranslationBlock *tb, *existing_tb;
+    TBCacheEntry *e;
+
+    assert_memory_lock();
+
+    if (!tb_cache.index || tb_cache_plugins_active(cpu)) {
+        return NULL;
+    }
+    e = g_hash_table_lookup(tb_cache.index, &key);
+    if (!e) {
+        return NULL;
+    }
+    /* Whatever happens below, the entry is used up. */
+    g_hash_table_remove(tb_cache.index, e);
+
+    tb = tcg_ctx->code_gen_buffer + e->tb_offset;
+    if (tb->size != e->size || tb->cs_base != cs_base ||
+        (!(cflags & CF_PCREL) && tb->pc != pc) ||
+        tb->flags != flags || tb->cflags != cflags ||
+        page_check_range(pc, e->size, PAGE_EXEC) != 0 ||
+        memcmp(g2h_untagged(pc), tb_cache.bytes + e->bytes_offset, e->size)) {
+        trace_tb_cache_reject(pc);
+        return NULL;
+    }
+
+    /* Bring the TB back into the state tb_gen_code() leaves it in. */
+    tb->trace_vcpu_dstate = key.trace_vcpu_dstate;
+    tb_exec_count_reset(tb);
+    tb_set_page_addr0(tb, pc);
+    tb_set_page_addr1(tb, -1);
+    page_protect(pc);
+    if ((pc ^ (pc + e->size - 1)) & TARGET_PAGE_MASK) {
+        tb_set_page_addr1(tb, TARGET_PAGE_ALIGN(pc));
+        page_protect(TARGET_PAGE_ALIGN(pc));
+    }
+
+    qemu_spin_init(&tb->jmp_lock);
+    tb->jmp_list_head = (uintptr_t)NULL;
+    tb->jmp_list_next[0] = (uintptr_t)NULL;
+    tb->jmp_list_next[1] = (uintptr_t)NULL;
+    tb->jmp_dest[0] = (uintptr_t)NULL;
+    tb->jmp_dest[1] = (uintptr_t)NULL;
+
+    /* The saved code may still be chained to TBs of the old process. */
+    if (tb->jmp_reset_offset[0] != TB_JMP_OFFSET_INVALID) {
+        tb_reset_jump(tb, 0);
+    }
+    if (tb->jmp_reset_offset[1] != TB_JMP_OFFSET_INVALID) {
+        tb_reset_jump(tb, 1);
+    }
+
+    tcg_tb_insert(tb);
+    existing_tb = tb_link_page(tb, tb_page_addr0(tb), tb_page_addr1(tb));
+    if (unlikely(existing_tb != tb)) {
+        tcg_tb_remove(tb);
+        return existing_tb;
+    }
+    trace_tb_cache_adopt(tb, pc);
+    return tb;
+}
+
+void tb_cache_flush(void)
+{
+    /* The code buffer is about to be reused from the start. */
+    g_clear_pointer(&tb_cache.index, g_hash_table_destroy);
+}
+
+typedef struct TBCacheSaveState {
+    GArray *entries;
+    GByteArray *bytes;
+} TBCacheSaveState;
+
+static void tb_cache_save_entry(TBCacheSaveState *s, const TBCacheEntry *e,
+                                const void *bytes)
+{
+    TBCacheEntry n = *e;
+
+    n.bytes_offset = s->bytes->len;
+    g_array_append_val(s->entries, n);
+    g_byte_array_append(s->bytes, bytes, e->size);
+}
+
+static gboolean tb_cache_save_tb(gpointer key, gpointer value, gpointer data)
+{
+    TBCacheSaveState *s = data;
+    TranslationBlock *tb = value;
+    /* In user-mode, the "physical" page address is the virtual pc. */
+    tb_page_addr_t pc = tb_page_addr0(tb);
+    TBCacheEntry e = {
+        .pc = pc,
+        .cs_base = tb->cs_base,
+        .flags = tb->flags,
+        .cflags = tb->cflags,
+        .trace_vcpu_dstate = tb->trace_vcpu_dstate,
+        .size = tb->size,
+        .tb_offset = (void *)tb - tcg_ctx->code_gen_buffer,
+    };
+
+    if (!(tb_cflags(tb) & CF_INVALID) &&
+        page_check_range(pc, tb->size, PAGE_EXEC) == 0) {
+        tb_cache_save_entry(s, &e, g2h_untagged(pc));
+    }
+    return false;
+}
+
+static bool tb_cache_write(int fd, TBCacheHeader *h, TBCacheSaveState *s)
+{
+    h->nb_entries = s->entries->len;
+    h->bytes_size = s->bytes->len;
+    h->code_size = tcg_ctx->code_gen_ptr - tcg_ctx->code_gen_buffer;
+
+    return qemu_write_full(fd, h, sizeof(*h)) == sizeof(*h) &&
+           qemu_write_full(fd, tb_cache_prologue(), h->prologue_size) ==
+               h->prologue_size &&
+           qemu_write_full(fd, s->entries->data,
+                           s->entries->len * sizeof(TBCacheEntry)) ==
+               s->entries->len * sizeof(TBCacheEntry) &&
+           qemu_write_full(fd, s->bytes->data, s->bytes->len) ==
+               s->bytes->len &&
+           qemu_write_full(fd, tcg_ctx->code_gen_buffer, h->code_size) ==
+               h->code_size;
+}
+
+void tb_cache_save(CPUState *cpu)
+{
+    g_autofree char *tmp = NULL;
+    TBCacheSaveState s;
+    TBCacheHeader h;
+    bool ok;
+    int fd;
+
+    /* Forked children leave the cache to their parent. */
+    if (!tb_cache.path || tb_cache.pid != getpid() ||
+        tb_cache_plugins_active(cpu) || !tb_cache_header_init(&h)) {
+        return;
+    }
+
+    tmp = g_strdup_printf("%s.%d", tb_cache.path, getpid());
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        warn_report("Could not open %s: %s, translation cache not saved",
+                    tmp, strerror(errno));
+        return;
+    }
+
+    s.entries = g_array_new(false, false, sizeof(TBCacheEntry));
+    s.bytes = g_byte_array_new();
+
+    mmap_lock();
+    tcg_tb_foreach(tb_cache_save_tb, &s);
+    if (tb_cache.index) {
+        GHashTableIter iter;
+        TBCacheEntry *e;
+
+        /* Carry over what this run did not get around to using. */
+        g_hash_table_iter_init(&iter, tb_cache.index);
+        while (g_hash_table_iter_next(&iter, (gpointer *)&e, NULL)) {
+            tb_cache_save_entry(&s, e, tb_cache.bytes + e->bytes_offset);
+        }
+    }
+    ok = tb_cache_write(fd, &h, &s);
+    mmap_unlock();
+
+    close(fd);
+    if (ok && rename(tmp, tb_cache.path) == 0) {
+        trace_tb_cache_save(tb_cache.path, s.entries->len, h.code_size);
+    } else {
+        warn_report("Could not write translation cache %s", tb_cache.path);
+        unlink(tmp);
+    }
+    g_array_free(s.entries, true);
+    g_byte_array_free(s.bytes, true);
+}
@@ -0,0 +1,50 @@
+/*
+ * Persistent translation cache for user-mode emulation.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef ACCEL_TCG_TB_CACHE_H
+#define ACCEL_TCG_TB_CACHE_H
+
+#if defined(CONFIG_TCG) && defined(CONFIG_USER_ONLY)
+/* Load translations from, and save them back to, @path. */
+void tb_cache_enable(const char *path);
+
+/*
+ * Map the cached translations into the freshly initialized code buffer.
+ * Must be called after tcg_prologue_init() and before any translation.
+ * @cpu_model is part of the cache key.
+ */
+void tb_cache_load(CPUState *cpu, const char *cpu_model);
+
+/*
+ * Return a cached TB matching the lookup key if the guest code it was
+ * translated from is unchanged, linked in as if it had just been
+ * translated.  Otherwise return NULL.  Called with mmap_lock held.
+ */
+TranslationBlock *tb_cache_lookup(CPUState *cpu, target_ulong pc,
+                                  target_ulong cs_base, uint32_t flags,
+                                  uint32_t cflags);
+
+/* Forget cached translations that were not used; their code is gone. */
+void tb_cache_flush(void);
+
+/* Write the translations of this process back to the cache file. */
+void tb_cache_save(CPUState *cpu);
+#else
+static inline void tb_cache_flush(void)
+{
+}
+
+static inline TranslationBlock *tb_cache_lookup(CPUState *cpu,
+                                                target_ulong pc,
+                                                target_ulong cs_base,
+                                                uint32_t flags,
+                                                uint32_t cflags)
+{
+    return NULL;
+}
+#endif
+
+#endif
@@ -35,6 +35,11 @@ struct TBContext {
     /* statistics */
     unsigned tb_flush_count;
     unsigned tb_phys_invalidate_count;
+    unsigned smc_write_count;
+    unsigned smc_write_skipped;
+    unsigned smc_invalidate_count;
+    unsigned tb_hot_count;
+    unsigned superblock_count;
 };
 
 extern TBContext tb_ctx;
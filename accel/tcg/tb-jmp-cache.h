@@ -9,20 +9,46 @@
 #ifndef ACCEL_TCG_TB_JMP_CACHE_H
 #define ACCEL_TCG_TB_JMP_CACHE_H
 
+/*
+ * The first level starts with 1 << TB_JMP_CACHE_BITS entries and doubles,
+ * up to 1 << TB_JMP_CACHE_MAX_BITS, while its miss rate stays high.
+ */
 #define TB_JMP_CACHE_BITS 12
 #define TB_JMP_CACHE_SIZE (1 << TB_JMP_CACHE_BITS)
+#define TB_JMP_CACHE_MAX_BITS 16
+
+/*
+ * The second level holds the entries evicted from the first one, in
+ * TB_VICTIM_CACHE_WAYS-way sets indexed like the first level.
+ */
+#define TB_VICTIM_CACHE_BITS 8
+#define TB_VICTIM_CACHE_SETS (1 << TB_VICTIM_CACHE_BITS)
+#define TB_VICTIM_CACHE_WAYS 4
+
+typedef struct CPUJumpCacheEntry {
+    TranslationBlock *tb;
+    target_ulong pc;
+} CPUJumpCacheEntry;
 
 /*
  * Accessed in parallel; all accesses to 'tb' must be atomic.
  * For CF_PCREL, accesses to 'pc' must be protected by a
  * load_acquire/store_release to 'tb'.
+ *
+ * The cache is replaced as a whole when it grows, so other threads
+ * must read cpu->tb_jmp_cache with qatomic_rcu_read within an RCU
+ * critical section.
  */
 struct CPUJumpCache {
     struct rcu_head rcu;
-    struct {
-        TranslationBlock *tb;
-        target_ulong pc;
-    } array[TB_JMP_CACHE_SIZE];
+    /* Way 0 of each set is the most recently used. */
+    CPUJumpCacheEntry victim[TB_VICTIM_CACHE_SETS][TB_VICTIM_CACHE_WAYS];
+    /* Only used by the owning vCPU, to decide when to grow. */
+    unsigned lookups;
+    unsigned misses;
+    /* log2 of the number of entries in @array. */
+    unsigned bits;
+    CPUJumpCacheEntry array[];
 };
 
 #endif /* ACCEL_TCG_TB_JMP_CACHE_H */
@@ -18,7 +18,9 @@
  */
 
 #include "qemu/osdep.h"
+#include "qemu/bitmap.h"
 #include "qemu/interval-tree.h"
+#include "qemu/rcu.h"
 #include "exec/cputlb.h"
 #include "exec/log.h"
 #include "exec/exec-all.h"
@@ -29,6 +31,9 @@
 #include "tb-hash.h"
 #include "tb-context.h"
 #include "internal.h"
+#include "tb-cache.h"
+#include "tb-async.h"
+#include "tb-stats.h"
 
 
 /* List iterators for lists of tagged pointers in TranslationBlock. */
@@ -48,7 +53,8 @@ static bool tb_cmp(const void *ap, const void *bp)
     return ((tb_cflags(a) & CF_PCREL || a->pc == b->pc) &&
             a->cs_base == b->cs_base &&
             a->flags == b->flags &&
-            (tb_cflags(a) & ~CF_INVALID) == (tb_cflags(b) & ~CF_INVALID) &&
+            (tb_lookup_cflags(a) & ~CF_INVALID) ==
+            (tb_lookup_cflags(b) & ~CF_INVALID) &&
             a->trace_vcpu_dstate == b->trace_vcpu_dstate &&
             tb_page_addr0(a) == tb_page_addr0(b) &&
             tb_page_addr1(a) == tb_page_addr1(b));
@@ -191,8 +197,18 @@ struct PageDesc {
     QemuSpin lock;
     /* list of TBs intersecting this ram page */
     uintptr_t first_tb;
+    /*
+     * Once the page has seen SMC_BITMAP_USE_THRESHOLD writes, the bytes
+     * covered by its TBs, so that writes to the rest of the page do not
+     * have to walk the TB list.  Dropped whenever the list changes, and
+     * rebuilt on the next write.
+     */
+    unsigned long *code_bitmap;
+    unsigned int code_write_count;
 };
 
+#define SMC_BITMAP_USE_THRESHOLD 10
+
 void page_table_config_init(void)
 {
     uint32_t v_l1_bits;
@@ -566,6 +582,36 @@ static void page_collection_unlock(struct page_collection *set)
     g_free(set);
 }
 
+/* Called with @p->lock held. */
+static void page_invalidate_code_bitmap(PageDesc *p)
+{
+    g_free(p->code_bitmap);
+    p->code_bitmap = NULL;
+}
+
+/* Called with @p->lock held. */
+static void page_build_code_bitmap(PageDesc *p)
+{
+    TranslationBlock *tb;
+    PageForEachNext n;
+
+    p->code_bitmap = bitmap_new(TARGET_PAGE_SIZE);
+
+    PAGE_FOR_EACH_TB(unused, unused, p, tb, n) {
+        tb_page_addr_t tb_start, tb_end;
+
+        /* As in tb_invalidate_phys_page_range__locked. */
+        if (n == 0) {
+            tb_start = tb_page_addr0(tb) & ~TARGET_PAGE_MASK;
+            tb_end = MIN(tb_start + tb->size, TARGET_PAGE_SIZE);
+        } else {
+            tb_start = 0;
+            tb_end = (tb_page_addr0(tb) + tb->size) & ~TARGET_PAGE_MASK;
+        }
+        bitmap_set(p->code_bitmap, tb_start, tb_end - tb_start);
+    }
+}
+
 /* Set to NULL all the 'first_tb' fields in all PageDescs. */
 static void tb_remove_all_1(int level, void **lp)
 {
@@ -580,6 +626,8 @@ static void tb_remove_all_1(int level, void **lp)
         for (i = 0; i < V_L2_SIZE; ++i) {
             page_lock(&pd[i]);
             pd[i].first_tb = (uintptr_t)NULL;
+            page_invalidate_code_bitmap(&pd[i]);
+            pd[i].code_write_count = 0;
             page_unlock(&pd[i]);
         }
     } else {
@@ -610,6 +658,7 @@ static inline void tb_page_add(PageDesc *p, TranslationBlock *tb,
     bool page_already_protected;
 
     assert_page_locked(p);
+    page_invalidate_code_bitmap(p);
 
     tb->page_next[n] = p->first_tb;
     page_already_protected = p->first_tb != 0;
@@ -640,6 +689,7 @@ static inline void tb_page_remove(PageDesc *pd, TranslationBlock *tb)
     PageForEachNext n1;
 
     assert_page_locked(pd);
+    page_invalidate_code_bitmap(pd);
     pprev = &pd->first_tb;
     PAGE_FOR_EACH_TB(unused, unused, pd, tb1, n1) {
         if (tb1 == tb) {
@@ -730,6 +780,7 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
     bool did_flush = false;
 
     mmap_lock();
+    tb_async_lock();
     /* If it is already been done on request of another CPU, just retry. */
     if (tb_ctx.tb_flush_count != tb_flush_count.host_int) {
         goto done;
@@ -742,12 +793,15 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
 
     qht_reset_size(&tb_ctx.htable, CODE_GEN_HTABLE_SIZE);
     tb_remove_all();
+    tb_cache_flush();
+    tb_stats_flush();
 
     tcg_region_reset_all();
     /* XXX: flush processor icache at this point if cache flush is expensive */
     qatomic_mb_set(&tb_ctx.tb_flush_count, tb_ctx.tb_flush_count + 1);
 
 done:
+    tb_async_unlock();
     mmap_unlock();
     if (did_flush) {
         qemu_plugin_flush_cb();
@@ -854,14 +908,22 @@ static void tb_jmp_cache_inval_tb(TranslationBlock *tb)
             tcg_flush_jmp_cache(cpu);
         }
     } else {
-        uint32_t h = tb_jmp_cache_hash_func(tb->pc);
+        uint32_t v = tb_jmp_cache_hash_func(tb->pc, TB_VICTIM_CACHE_BITS);
 
+        RCU_READ_LOCK_GUARD();
         CPU_FOREACH(cpu) {
-            CPUJumpCache *jc = cpu->tb_jmp_cache;
+            CPUJumpCache *jc = qatomic_rcu_read(&cpu->tb_jmp_cache);
+            uint32_t h = tb_jmp_cache_hash_func(tb->pc, jc->bits);
+            int way;
 
             if (qatomic_read(&jc->array[h].tb) == tb) {
                 qatomic_set(&jc->array[h].tb, NULL);
             }
+            for (way = 0; way < TB_VICTIM_CACHE_WAYS; way++) {
+                if (qatomic_read(&jc->victim[v][way].tb) == tb) {
+                    qatomic_set(&jc->victim[v][way].tb, NULL);
+                }
+            }
         }
     }
 }
@@ -887,7 +949,7 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
     /* remove the TB from the hash list */
     phys_pc = tb_page_addr0(tb);
     h = tb_hash_func(phys_pc, (orig_cflags & CF_PCREL ? 0 : tb->pc),
-                     tb->flags, orig_cflags, tb->trace_vcpu_dstate);
+                     tb->flags, orig_cflags & ~CF_HOT, tb->trace_vcpu_dstate);
     if (!qht_remove(&tb_ctx.htable, tb, h)) {
         return;
     }
@@ -968,7 +1030,7 @@ TranslationBlock *tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
 
     /* add in the hash table */
     h = tb_hash_func(phys_pc, (tb->cflags & CF_PCREL ? 0 : tb->pc),
-                     tb->flags, tb->cflags, tb->trace_vcpu_dstate);
+                     tb->flags, tb_lookup_cflags(tb), tb->trace_vcpu_dstate);
     qht_insert(&tb_ctx.htable, tb, h, &existing_tb);
 
     /* remove TB from the page(s) if we couldn't insert it */
@@ -1076,12 +1138,13 @@ bool tb_invalidate_phys_page_unwind(tb_page_addr_t addr, uintptr_t pc)
 /*
  * @p must be non-NULL.
  * Call with all @pages locked.
+ * @is_cpu_write is true for guest writes, which are counted as SMC.
  */
 static void
 tb_invalidate_phys_page_range__locked(struct page_collection *pages,
                                       PageDesc *p, tb_page_addr_t start,
                                       tb_page_addr_t end,
-                                      uintptr_t retaddr)
+                                      uintptr_t retaddr, bool is_cpu_write)
 {
     TranslationBlock *tb;
     tb_page_addr_t tb_start, tb_end;
@@ -1123,6 +1186,10 @@ tb_invalidate_phys_page_range__locked(struct page_collection *pages,
             }
 #endif /* TARGET_HAS_PRECISE_SMC */
             tb_phys_invalidate__locked(tb);
+            if (is_cpu_write) {
+                qatomic_set(&tb_ctx.smc_invalidate_count,
+                            tb_ctx.smc_invalidate_count + 1);
+            }
         }
     }
 
@@ -1160,7 +1227,7 @@ void tb_invalidate_phys_page(tb_page_addr_t addr)
     start = addr & TARGET_PAGE_MASK;
     end = start + TARGET_PAGE_SIZE;
     pages = page_collection_lock(start, end);
-    tb_invalidate_phys_page_range__locked(pages, p, start, end, 0);
+    tb_invalidate_phys_page_range__locked(pages, p, start, end, 0, false);
     page_collection_unlock(pages);
 }
 
@@ -1187,7 +1254,8 @@ void tb_invalidate_phys_range(tb_page_addr_t start, tb_page_addr_t end)
             continue;
         }
         assert_page_locked(pd);
-        tb_invalidate_phys_page_range__locked(pages, pd, start, bound, 0);
+        tb_invalidate_phys_page_range__locked(pages, pd, start, bound, 0,
+                                              false);
     }
     page_collection_unlock(pages);
 }
@@ -1207,12 +1275,28 @@ static void tb_invalidate_phys_page_fast__locked(struct page_collection *pages,
     }
 
     assert_page_locked(p);
-    tb_invalidate_phys_page_range__locked(pages, p, start, start + len, ra);
+    qatomic_set(&tb_ctx.smc_write_count, tb_ctx.smc_write_count + 1);
+
+    if (!p->code_bitmap &&
+        ++p->code_write_count >= SMC_BITMAP_USE_THRESHOLD) {
+        page_build_code_bitmap(p);
+    }
+    if (p->code_bitmap) {
+        unsigned int nr = start & ~TARGET_PAGE_MASK;
+
+        if (find_next_bit(p->code_bitmap, nr + len, nr) >= nr + len) {
+            qatomic_set(&tb_ctx.smc_write_skipped,
+                        tb_ctx.smc_write_skipped + 1);
+            return;
+        }
+    }
+    tb_invalidate_phys_page_range__locked(pages, p, start, start + len,
+                                          ra, true);
 }
 
 /*
- * len must be <= 8 and start must be a multiple of len.
- * Called via softmmu_template.h when code areas are written to with
+ * [ram_addr, ram_addr + size) must be within one page.
+ * Called via notdirty_write when code areas are written to with
  * iothread mutex not held.
  */
 void tb_invalidate_phys_range_fast(ram_addr_t ram_addr,
@@ -0,0 +1,203 @@
+/*
+ * Per translation block statistics.
+ *
+ * Each TB translated while statistics are enabled points to a record
+ * shared by all translations of the same guest code in the same cpu
+ * state, so that the record survives retranslation and tb_flush.  The
+ * generated code counts executions inline, without leaving the TB, in
+ * a counter private to the vCPU; everything else is updated at
+ * translation time.  Records of code that stopped running are freed at
+ * the next tb_flush, so that memory use follows the guest working set.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qapi/error.h"
+#include "qemu/thread.h"
+#include "exec/exec-all.h"
+#include "tb-hash.h"
+#include "tb-stats.h"
+
+static struct {
+    bool enabled;
+    unsigned max_cpus;
+    QemuMutex lock;
+    GHashTable *records;
+} tb_stats;
+
+static guint tb_stats_hash(gconstpointer p)
+{
+    const TBStatistics *s = p;
+
+    return tb_hash_func(s->phys_pc, s->pc, s->flags, 0, 0);
+}
+
+static gboolean tb_stats_equal(gconstpointer a, gconstpointer b)
+{
+    const TBStatistics *sa = a;
+    const TBStatistics *sb = b;
+
+    return sa->phys_pc == sb->phys_pc && sa->pc == sb->pc &&
+           sa->cs_base == sb->cs_base && sa->flags == sb->flags;
+}
+
+void tb_stats_init(unsigned max_cpus)
+{
+    qemu_mutex_init(&tb_stats.lock);
+    tb_stats.records = g_hash_table_new_full(tb_stats_hash, tb_stats_equal,
+                                             g_free, NULL);
+    tb_stats.max_cpus = max_cpus;
+    tb_stats.enabled = true;
+}
+
+static uint64_t tb_stats_execs(const TBStatistics *s)
+{
+    uint64_t execs = 0;
+    unsigned i;
+
+    for (i = 0; i < tb_stats.max_cpus; i++) {
+        execs += qatomic_read_u64(&s->exec_count[i]);
+    }
+    return execs;
+}
+
+TBStatistics *tb_stats_get(tb_page_addr_t phys_pc, target_ulong pc,
+                           target_ulong cs_base, uint32_t flags)
+{
+    TBStatistics key = {
+        .phys_pc = phys_pc,
+        .pc = pc,
+        .cs_base = cs_base,
+        .flags = flags,
+    };
+    TBStatistics *s;
+
+    /* Temporary TBs for code outside RAM are not worth tracking. */
+    if (!tb_stats.enabled || phys_pc == -1) {
+        return NULL;
+    }
+
+    qemu_mutex_lock(&tb_stats.lock);
+    s = g_hash_table_lookup(tb_stats.records, &key);
+    if (!s) {
+        s = g_malloc0(sizeof(*s) + tb_stats.max_cpus * sizeof(uint64_t));
+        *s = key;
+        g_hash_table_add(tb_stats.records, s);
+    }
+    qemu_mutex_unlock(&tb_stats.lock);
+    return s;
+}
+
+void tb_stats_record(TranslationBlock *tb, int64_t ns,
+                     unsigned spills, unsigned reloads)
+{
+    TBStatistics *s = tb->tb_stats;
+
+    qemu_mutex_lock(&tb_stats.lock);
+    s->translations++;
+    s->translate_ns += ns;
+    s->guest_insns = tb->icount;
+    s->guest_bytes = tb->size;
+    s->host_bytes = tb->tc.size;
+    s->spills = spills;
+    s->reloads = reloads;
+    qemu_mutex_unlock(&tb_stats.lock);
+}
+
+static gboolean tb_stats_idle(gpointer key, gpointer value, gpointer data)
+{
+    TBStatistics *s = key;
+    uint64_t execs = tb_stats_execs(s);
+    bool idle = execs == s->execs_at_flush;
+
+    s->execs_at_flush = execs;
+    return idle;
+}
+
+void tb_stats_flush(void)
+{
+    if (!tb_stats.enabled) {
+        return;
+    }
+
+    qemu_mutex_lock(&tb_stats.lock);
+    g_hash_table_foreach_remove(tb_stats.records, tb_stats_idle, NULL);
+    qemu_mutex_unlock(&tb_stats.lock);
+}
+
+static uint64_t tb_stats_sort_value(const TBStatistics *s, TbHotSortKey key)
+{
+    switch (key) {
+    case TB_HOT_SORT_KEY_EXEC:
+        return tb_stats_execs(s);
+    case TB_HOT_SORT_KEY_INSNS:
+        /* Guest instructions executed, rather than translated. */
+        return tb_stats_execs(s) * s->guest_insns;
+    case TB_HOT_SORT_KEY_TRANSLATE_TIME:
+        return s->translate_ns;
+    case TB_HOT_SORT_KEY_TRANSLATIONS:
+        return s->translations;
+    case TB_HOT_SORT_KEY_SPILLS:
+        return tb_stats_execs(s) * (s->spills + s->reloads);
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static gint tb_stats_compare(gconstpointer a, gconstpointer b, gpointer opaque)
+{
+    TbHotSortKey key = GPOINTER_TO_INT(opaque);
+    uint64_t va = tb_stats_sort_value(*(TBStatistics * const *)a, key);
+    uint64_t vb = tb_stats_sort_value(*(TBStatistics * const *)b, key);
+
+    return va < vb ? 1 : va > vb ? -1 : 0;
+}
+
+bool tb_stats_dump_hot(GString *buf, unsigned count, TbHotSortKey key,
+                       Error **errp)
+{
+    g_autoptr(GPtrArray) all = NULL;
+    GHashTableIter iter;
+    gpointer p;
+    unsigned i;
+
+    if (!tb_stats.enabled) {
+        error_setg(errp, "TB statistics are not enabled; "
+                   "use -accel tcg,tb-stats=on");
+        return false;
+    }
+
+    qemu_mutex_lock(&tb_stats.lock);
+
+    all = g_ptr_array_sized_new(g_hash_table_size(tb_stats.records));
+    g_hash_table_iter_init(&iter, tb_stats.records);
+    while (g_hash_table_iter_next(&iter, &p, NULL)) {
+        g_ptr_array_add(all, p);
+    }
+    g_ptr_array_sort_with_data(all, tb_stats_compare, GINT_TO_POINTER(key));
+
+    g_string_append_printf(buf, "%u of %u TBs\n",
+                           MIN(count, all->len), all->len);
+    g_string_append_printf(buf, "%-18s %-18s %-8s %12s %5s %5s %5s %6s "
+                           "%9s %7s %7s\n",
+                           "pc", "phys_pc", "flags", "execs", "insns",
+                           "bytes", "host", "xlats", "xlat_ns", "spills",
+                           "reloads");
+    for (i = 0; i < count && i < all->len; i++) {
+        const TBStatistics *s = g_ptr_array_index(all, i);
+
+        g_string_append_printf(buf, "0x%016" PRIx64 " 0x%016" PRIx64
+                               " %08x %12" PRIu64 " %5u %5u %5u %6" PRIu64
+                               " %9" PRId64 " %7u %7u\n",
+                               (uint64_t)s->pc, (uint64_t)s->phys_pc,
+                               s->flags, tb_stats_execs(s),
+                               s->guest_insns, s->guest_bytes, s->host_bytes,
+                               s->translations,
+                               s->translate_ns / MAX(s->translations, 1),
+                               s->spills, s->reloads);
+    }
+
+    qemu_mutex_unlock(&tb_stats.lock);
+    return true;
+}
@@ -0,0 +1,89 @@
+/*
+ * Per translation block statistics.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef ACCEL_TCG_TB_STATS_H
+#define ACCEL_TCG_TB_STATS_H
+
+/*
+ * Statistics for the guest code at one address, in one cpu state.
+ * They are kept across retranslations and tb_flush, and describe the
+ * most recent translation.
+ */
+struct TBStatistics {
+    tb_page_addr_t phys_pc;
+    target_ulong pc;
+    target_ulong cs_base;
+    uint32_t flags;
+
+    /* Updated under the tb_stats lock. */
+    uint64_t execs_at_flush;
+    uint64_t translations;
+    int64_t translate_ns;
+    unsigned guest_insns;
+    unsigned guest_bytes;
+    unsigned host_bytes;
+    unsigned spills;
+    unsigned reloads;
+
+    /*
+     * Incremented by the generated code on each entry into the TB, with
+     * one counter per vCPU index so that vCPUs do not race.
+     */
+    uint64_t exec_count[];
+};
+
+#if defined(CONFIG_TCG) && defined(CONFIG_SOFTMMU)
+#include "qapi/qapi-types-machine.h"
+
+/*
+ * Start collecting statistics for the TBs translated from now on, for
+ * vCPUs with an index below @max_cpus.
+ */
+void tb_stats_init(unsigned max_cpus);
+
+/*
+ * Return the statistics record for a TB about to be translated with
+ * the given lookup key, or NULL if statistics are not being collected.
+ */
+TBStatistics *tb_stats_get(tb_page_addr_t phys_pc, target_ulong pc,
+                           target_ulong cs_base, uint32_t flags);
+
+/* Account a translation of @tb that took @ns nanoseconds. */
+void tb_stats_record(TranslationBlock *tb, int64_t ns,
+                     unsigned spills, unsigned reloads);
+
+/*
+ * Called by tb_flush, when no TB refers to the records any longer.
+ * Free the records of guest code that did not run since the last call.
+ */
+void tb_stats_flush(void);
+
+/*
+ * Add to @buf the @count records with the highest value of @key,
+ * or an error to @errp if statistics are not being collected.
+ */
+bool tb_stats_dump_hot(GString *buf, unsigned count, TbHotSortKey key,
+                       Error **errp);
+#else
+static inline TBStatistics *tb_stats_get(tb_page_addr_t phys_pc,
+                                         target_ulong pc,
+                                         target_ulong cs_base,
+                                         uint32_t flags)
+{
+    return NULL;
+}
+
+static inline void tb_stats_record(TranslationBlock *tb, int64_t ns,
+                                   unsigned spills, unsigned reloads)
+{
+}
+
+static inline void tb_stats_flush(void)
+{
+}
+#endif
+
+#endif
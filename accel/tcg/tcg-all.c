@@ -37,6 +37,8 @@
 #include "hw/boards.h"
 #endif
 #include "internal.h"
+#include "tb-async.h"
+#include "tb-stats.h"
 
 struct TCGState {
     AccelState parent_obj;
@@ -44,6 +46,11 @@ struct TCGState {
     bool mttcg_enabled;
     int splitwx_enabled;
     unsigned long tb_size;
+    uint32_t superblock_threshold;
+    uint32_t translate_threads;
+    uint32_t global_regs;
+    bool cse_enabled;
+    bool tb_stats_enabled;
 };
 typedef struct TCGState TCGState;
 
@@ -99,6 +106,7 @@ static void tcg_accel_instance_init(Object *obj)
     TCGState *s = TCG_STATE(obj);
 
     s->mttcg_enabled = default_mttcg_enabled();
+    s->cse_enabled = true;
 
     /* If debugging enabled, default "auto on", otherwise off. */
 #if defined(CONFIG_DEBUG_TCG) && !defined(CONFIG_USER_ONLY)
@@ -121,10 +129,27 @@ static int tcg_init_machine(MachineState *ms)
 
     tcg_allowed = true;
     mttcg_enabled = s->mttcg_enabled;
+    tb_superblock_threshold = s->superblock_threshold;
+
+    /*
+     * Translator threads get their own TCG contexts and code regions,
+     * which are only available with one of each per vCPU thread.
+     */
+    if (s->translate_threads && (!mttcg_enabled || !tb_superblock_threshold)) {
+        warn_report("translate-threads requires thread=multi and "
+                    "superblock-threshold, ignoring it");
+        s->translate_threads = 0;
+    }
 
     page_init();
     tb_htable_init();
-    tcg_init(s->tb_size * MiB, s->splitwx_enabled, max_cpus);
+    tcg_init(s->tb_size * MiB, s->splitwx_enabled,
+             max_cpus + s->translate_threads);
+    tcg_global_regs = s->global_regs;
+    if (tb_superblock_threshold) {
+        tb_exec_counts = g_new0(uint32_t, tcg_tb_index_max());
+    }
+    tcg_cse_enabled = s->cse_enabled;
 
 #if defined(CONFIG_SOFTMMU)
     /*
@@ -132,6 +157,13 @@ static int tcg_init_machine(MachineState *ms)
      * initialize the prologue now.
      */
     tcg_prologue_init(tcg_ctx);
+
+    if (s->translate_threads) {
+        tb_async_init(s->translate_threads);
+    }
+    if (s->tb_stats_enabled) {
+        tb_stats_init(max_cpus);
+    }
 #endif
 
     return 0;
@@ -196,6 +228,89 @@ static void tcg_set_tb_size(Object *obj, Visitor *v,
     s->tb_size = value;
 }
 
+static void tcg_get_superblock_threshold(Object *obj, Visitor *v,
+                                         const char *name, void *opaque,
+                                         Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->superblock_threshold;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_superblock_threshold(Object *obj, Visitor *v,
+                                         const char *name, void *opaque,
+                                         Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+
+    s->superblock_threshold = value;
+}
+
+static void tcg_get_translate_threads(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->translate_threads;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_translate_threads(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+
+    if (value > 64) {
+        error_setg(errp, "at most 64 translate threads are supported");
+        return;
+    }
+
+    s->translate_threads = value;
+}
+
+static void tcg_get_global_regs(Object *obj, Visitor *v,
+                                const char *name, void *opaque,
+                                Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->global_regs;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_global_regs(Object *obj, Visitor *v,
+                                const char *name, void *opaque,
+                                Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+
+    if (value > TCG_MAX_GLOBAL_REGS) {
+        error_setg(errp, "at most %d global registers are supported",
+                   TCG_MAX_GLOBAL_REGS);
+        return;
+    }
+
+    s->global_regs = value;
+}
+
 static bool tcg_get_splitwx(Object *obj, Error **errp)
 {
     TCGState *s = TCG_STATE(obj);
@@ -208,6 +323,30 @@ static void tcg_set_splitwx(Object *obj, bool value, Error **errp)
     s->splitwx_enabled = value;
 }
 
+static bool tcg_get_cse(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    return s->cse_enabled;
+}
+
+static void tcg_set_cse(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    s->cse_enabled = value;
+}
+
+static bool tcg_get_tb_stats(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    return s->tb_stats_enabled;
+}
+
+static void tcg_set_tb_stats(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    s->tb_stats_enabled = value;
+}
+
 static int tcg_gdbstub_supported_sstep_flags(void)
 {
     /*
@@ -245,6 +384,38 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
         tcg_get_splitwx, tcg_set_splitwx);
     object_class_property_set_description(oc, "split-wx",
         "Map jit pages into separate RW and RX regions");
+
+    object_class_property_add(oc, "superblock-threshold", "int",
+        tcg_get_superblock_threshold, tcg_set_superblock_threshold,
+        NULL, NULL);
+    object_class_property_set_description(oc, "superblock-threshold",
+        "Executions after which a TB is retranslated as a superblock "
+        "(0 = off)");
+
+    object_class_property_add(oc, "translate-threads", "int",
+        tcg_get_translate_threads, tcg_set_translate_threads,
+        NULL, NULL);
+    object_class_property_set_description(oc, "translate-threads",
+        "Number of threads that translate superblocks in the background "
+        "(0 = off)");
+
+    object_class_property_add(oc, "global-regs", "int",
+        tcg_get_global_regs, tcg_set_global_regs,
+        NULL, NULL);
+    object_class_property_set_description(oc, "global-regs",
+        "Number of guest registers kept in host registers across branches "
+        "within a TB (0 = off)");
+
+    object_class_property_add_bool(oc, "cse",
+        tcg_get_cse, tcg_set_cse);
+    object_class_property_set_description(oc, "cse",
+        "Reuse common subexpressions and remove redundant stores "
+        "to the CPU state in TCG ops");
+
+    object_class_property_add_bool(oc, "tb-stats",
+        tcg_get_tb_stats, tcg_set_tb_stats);
+    object_class_property_set_description(oc, "tb-stats",
+        "Collect execution statistics for each translation block");
 }
 
 static const TypeInfo tcg_accel_type = {
@@ -52,6 +52,7 @@
 #include "qemu/qemu-print.h"
 #include "qemu/main-loop.h"
 #include "qemu/cacheinfo.h"
+#include "qemu/rcu.h"
 #include "qemu/timer.h"
 #include "exec/log.h"
 #include "sysemu/cpus.h"
@@ -64,6 +65,9 @@
 #include "tb-context.h"
 #include "internal.h"
 #include "perf.h"
+#include "tb-cache.h"
+#include "tb-async.h"
+#include "tb-stats.h"
 
 /* Make sure all possible CPU event bits fit in tb->trace_vcpu_dstate */
 QEMU_BUILD_BUG_ON(CPU_TRACE_DSTATE_MAX_EVENTS >
@@ -297,31 +301,31 @@ static int setjmp_gen_code(CPUArchState *env, TranslationBlock *tb,
     return tcg_gen_code(tcg_ctx, tb, pc);
 }
 
-/* Called with mmap_lock held for user mode emulation.  */
-TranslationBlock *tb_gen_code(CPUState *cpu,
-                              target_ulong pc, target_ulong cs_base,
-                              uint32_t flags, int cflags)
+/*
+ * Translate the code at @pc, whose page has already been resolved to
+ * @phys_pc and @host_pc by the caller.  If @replace is not NULL, it is
+ * invalidated right before the new TB is published, so that the new TB
+ * takes its place in the lookup structures.
+ *
+ * Returns NULL if the code buffer is full and must be flushed, if the
+ * translation needs a second page that only the vCPU thread can resolve
+ * (see tb_async_in_worker()), or if @replace was invalidated meanwhile.
+ *
+ * Called with mmap_lock held for user mode emulation.
+ */
+TranslationBlock *tb_gen_code_phys(CPUState *cpu, target_ulong pc,
+                                   target_ulong cs_base, uint32_t flags,
+                                   int cflags, tb_page_addr_t phys_pc,
+                                   void *host_pc, TranslationBlock *replace)
 {
     CPUArchState *env = cpu->env_ptr;
     TranslationBlock *tb, *existing_tb;
-    tb_page_addr_t phys_pc;
     tcg_insn_unit *gen_code_buf;
     int gen_code_size, search_size, max_insns;
 #ifdef CONFIG_PROFILER
     TCGProfile *prof = &tcg_ctx->prof;
 #endif
-    int64_t ti;
-    void *host_pc;
-
-    assert_memory_lock();
-    qemu_thread_jit_write();
-
-    phys_pc = get_page_addr_code_hostp(env, pc, &host_pc);
-
-    if (phys_pc == -1) {
-        /* Generate a one-shot TB with 1 insn in it */
-        cflags = (cflags & ~CF_COUNT_MASK) | CF_LAST_IO | 1;
-    }
+    int64_t ti, stats_start = 0;
 
     max_insns = cflags & CF_COUNT_MASK;
     if (max_insns == 0) {
@@ -332,12 +336,7 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
  buffer_overflow:
     tb = tcg_tb_alloc(tcg_ctx);
     if (unlikely(!tb)) {
-        /* flush must be done */
-        tb_flush(cpu);
-        mmap_unlock();
-        /* Make the execution loop process the flush as soon as possible.  */
-        cpu->exception_index = EXCP_INTERRUPT;
-        cpu_loop_exit(cpu);
+        return NULL;
     }
 
     gen_code_buf = tcg_ctx->code_gen_ptr;
@@ -348,7 +347,11 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     tb->cs_base = cs_base;
     tb->flags = flags;
     tb->cflags = cflags;
-    tb->trace_vcpu_dstate = *cpu->trace_dstate;
+    /* A TB that is replaced was looked up with the right trace state. */
+    tb->trace_vcpu_dstate = replace ? replace->trace_vcpu_dstate
+                                    : *cpu->trace_dstate;
+    tb_exec_count_reset(tb);
+    tb->tb_stats = tb_stats_get(phys_pc, pc, cs_base, flags);
     tb_set_page_addr0(tb, phys_pc);
     tb_set_page_addr1(tb, -1);
     tcg_ctx->gen_tb = tb;
@@ -362,6 +365,9 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
 
     trace_translate_block(tb, pc, tb->tc.ptr);
 
+    if (tb->tb_stats) {
+        stats_start = get_clock();
+    }
     gen_code_size = setjmp_gen_code(env, tb, pc, host_pc, &max_insns, &ti);
     if (unlikely(gen_code_size < 0)) {
         switch (gen_code_size) {
@@ -398,6 +404,11 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
                           max_insns);
             goto tb_overflow;
 
+        case -3:
+            /* Translation abandoned; give back the TB.  */
+            qatomic_set(&tcg_ctx->code_gen_ptr, (void *)tb);
+            return NULL;
+
         default:
             g_assert_not_reached();
         }
@@ -408,6 +419,11 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     }
     tb->tc.size = gen_code_size;
 
+    if (tb->tb_stats) {
+        tb_stats_record(tb, get_clock() - stats_start,
+                        tcg_ctx->nb_spills, tcg_ctx->nb_reloads);
+    }
+
     /*
      * For CF_PCREL, attribute all executions of the generated code
      * to its first mapping.
@@ -443,6 +459,8 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
 
             /* Dump header and the first instruction */
             fprintf(logfile, "OUT: [size=%d]\n", gen_code_size);
+            fprintf(logfile, "  -- %u spills, %u reloads\n",
+                    tcg_ctx->nb_spills, tcg_ctx->nb_reloads);
             fprintf(logfile,
                     "  -- guest addr 0x" TARGET_FMT_lx " + tb prologue\n",
                     tcg_ctx->gen_insn_data[insn][0]);
@@ -525,6 +543,18 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
         return tb;
     }
 
+    if (replace) {
+        /*
+         * The guest code may have been modified since @replace was
+         * picked, in which case our copy is just as stale.
+         */
+        if (qatomic_read(&replace->cflags) & CF_INVALID) {
+            qatomic_set(&tcg_ctx->code_gen_ptr, (void *)tb);
+            return NULL;
+        }
+        tb_phys_invalidate(replace, -1);
+    }
+
     /*
      * Insert TB into the corresponding region tree before publishing it
      * through QHT. Otherwise rewinding happened in the TB might fail to
@@ -549,6 +579,44 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     return tb;
 }
 
+/* Called with mmap_lock held for user mode emulation.  */
+TranslationBlock *tb_gen_code(CPUState *cpu,
+                              target_ulong pc, target_ulong cs_base,
+                              uint32_t flags, int cflags)
+{
+    CPUArchState *env = cpu->env_ptr;
+    TranslationBlock *tb;
+    tb_page_addr_t phys_pc;
+    void *host_pc;
+
+    assert_memory_lock();
+    qemu_thread_jit_write();
+
+    phys_pc = get_page_addr_code_hostp(env, pc, &host_pc);
+
+    if (phys_pc == -1) {
+        /* Generate a one-shot TB with 1 insn in it */
+        cflags = (cflags & ~CF_COUNT_MASK) | CF_LAST_IO | 1;
+    } else {
+        tb = tb_cache_lookup(cpu, pc, cs_base, flags, cflags);
+        if (tb) {
+            return tb;
+        }
+    }
+
+    tb = tb_gen_code_phys(cpu, pc, cs_base, flags, cflags,
+                          phys_pc, host_pc, NULL);
+    if (unlikely(!tb)) {
+        /* flush must be done */
+        tb_flush(cpu);
+        mmap_unlock();
+        /* Make the execution loop process the flush as soon as possible.  */
+        cpu->exception_index = EXCP_INTERRUPT;
+        cpu_loop_exit(cpu);
+    }
+    return tb;
+}
+
 /* user-mode: call with mmap_lock held */
 void tb_check_watchpoint(CPUState *cpu, uintptr_t retaddr)
 {
@@ -708,6 +776,7 @@ void dump_exec_info(GString *buf)
     struct tb_tree_stats tst = {};
     struct qht_stats hst;
     size_t nb_tbs, flush_full, flush_part, flush_elide;
+    size_t flush_queued, flush_merged, flush_upgraded, flush_batches;
 
     tcg_tb_foreach(tb_tree_stats_iter, &tst);
     nb_tbs = tst.nb_tbs;
@@ -748,11 +817,39 @@ void dump_exec_info(GString *buf)
                            qatomic_read(&tb_ctx.tb_flush_count));
     g_string_append_printf(buf, "TB invalidate count %u\n",
                            qatomic_read(&tb_ctx.tb_phys_invalidate_count));
+    g_string_append_printf(buf, "SMC writes          %u (%u outside code, "
+                           "%u TBs invalidated)\n",
+                           qatomic_read(&tb_ctx.smc_write_count),
+                           qatomic_read(&tb_ctx.smc_write_skipped),
+                           qatomic_read(&tb_ctx.smc_invalidate_count));
+    if (tb_superblock_threshold) {
+        uint64_t side_exits = 0;
+        CPUState *cpu;
+
+        CPU_FOREACH(cpu) {
+            side_exits += qatomic_read_u64(&cpu->superblock_side_exits);
+        }
+        g_string_append_printf(buf, "TB hot count        %u\n",
+                               qatomic_read(&tb_ctx.tb_hot_count));
+        g_string_append_printf(buf, "superblock count    %u\n",
+                               qatomic_read(&tb_ctx.superblock_count));
+        g_string_append_printf(buf, "superblock side exits %" PRIu64 "\n",
+                               side_exits);
+    }
+    tb_async_dump_info(buf);
 
     tlb_flush_counts(&flush_full, &flush_part, &flush_elide);
     g_string_append_printf(buf, "TLB full flushes    %zu\n", flush_full);
     g_string_append_printf(buf, "TLB partial flushes %zu\n", flush_part);
     g_string_append_printf(buf, "TLB elided flushes  %zu\n", flush_elide);
+    tlb_flush_batch_counts(&flush_queued, &flush_merged, &flush_upgraded,
+                           &flush_batches);
+    g_string_append_printf(buf, "TLB queued flushes  %zu (%zu merged, "
+                           "%zu upgraded to full)\n",
+                           flush_queued, flush_merged, flush_upgraded);
+    g_string_append_printf(buf, "TLB flush batches   %zu\n", flush_batches);
+    tlb_dump_page_size_info(buf);
+    tcg_dump_regalloc_info(buf);
     tcg_dump_info(buf);
 }
 
@@ -773,16 +870,24 @@ void cpu_interrupt(CPUState *cpu, int mask)
  */
 void tcg_flush_jmp_cache(CPUState *cpu)
 {
-    CPUJumpCache *jc = cpu->tb_jmp_cache;
+    CPUJumpCache *jc;
+
+    RCU_READ_LOCK_GUARD();
+    jc = qatomic_rcu_read(&cpu->tb_jmp_cache);
 
     /* During early initialization, the cache may not yet be allocated. */
     if (unlikely(jc == NULL)) {
         return;
     }
 
-    for (int i = 0; i < TB_JMP_CACHE_SIZE; i++) {
+    for (int i = 0; i < 1u << jc->bits; i++) {
         qatomic_set(&jc->array[i].tb, NULL);
     }
+    for (int i = 0; i < TB_VICTIM_CACHE_SETS; i++) {
+        for (int way = 0; way < TB_VICTIM_CACHE_WAYS; way++) {
+            qatomic_set(&jc->victim[i][way].tb, NULL);
+        }
+    }
 }
 
 /* This is a wrapper for common code that can not use CONFIG_SOFTMMU */
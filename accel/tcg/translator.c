@@ -17,6 +17,16 @@
 #include "exec/translator.h"
 #include "exec/plugin-gen.h"
 #include "exec/replay-core.h"
+#include "tb-context.h"
+#include "internal.h"
+#include "tb-async.h"
+#include "tb-stats.h"
+
+/* Maximum number of branches a superblock may be extended across. */
+#define TB_TRACE_MAX_BRANCHES 8
+
+uint32_t tb_superblock_threshold;
+uint32_t *tb_exec_counts;
 
 bool translator_use_goto_tb(DisasContextBase *db, target_ulong dest)
 {
@@ -29,11 +39,90 @@ bool translator_use_goto_tb(DisasContextBase *db, target_ulong dest)
     return ((db->pc_first ^ dest) & TARGET_PAGE_MASK) == 0;
 }
 
+bool translator_extend_trace(DisasContextBase *db, target_ulong dest)
+{
+    /*
+     * Only ever extend forward, so that [pc_first, pc_next) remains
+     * a hull of all the guest code used by the superblock.
+     */
+    if (db->trace_budget == 0 ||
+        db->num_insns >= db->max_insns ||
+        dest < db->pc_next ||
+        !is_same_page(db, dest)) {
+        return false;
+    }
+    db->trace_budget--;
+    return true;
+}
+
+void tb_exec_count_reset(const TranslationBlock *tb)
+{
+    if (tb_exec_counts) {
+        qatomic_set(&tb_exec_counts[tcg_tb_index(tb)], 0);
+    }
+}
+
+void translator_gen_side_exit(DisasContextBase *db)
+{
+    TCGv_i64 count = tcg_temp_new_i64();
+    int ofs = offsetof(ArchCPU, parent_obj.superblock_side_exits) -
+              offsetof(ArchCPU, env);
+
+    tcg_debug_assert(tb_cflags(db->tb) & CF_HOT);
+
+    /* Per vCPU, so that a plain increment does not lose updates. */
+    tcg_gen_ld_i64(count, cpu_env, ofs);
+    tcg_gen_addi_i64(count, count, 1);
+    tcg_gen_st_i64(count, cpu_env, ofs);
+}
+
+/*
+ * Count the executions of a TB for its statistics record, in the
+ * counter of the running vCPU so that a plain increment is enough.
+ */
+static void gen_tb_stats_exec_count(TBStatistics *s)
+{
+    TCGv_i32 index = tcg_temp_new_i32();
+    TCGv_ptr ptr = tcg_temp_new_ptr();
+    TCGv_i64 count = tcg_temp_new_i64();
+
+    tcg_gen_ld_i32(index, cpu_env,
+                   offsetof(ArchCPU, parent_obj.cpu_index) -
+                   offsetof(ArchCPU, env));
+    tcg_gen_shli_i32(index, index, 3);
+    tcg_gen_ext_i32_ptr(ptr, index);
+    tcg_gen_addi_ptr(ptr, ptr, (intptr_t)s->exec_count);
+
+    tcg_gen_ld_i64(count, ptr, 0);
+    tcg_gen_addi_i64(count, count, 1);
+    tcg_gen_st_i64(count, ptr, 0);
+}
+
+/*
+ * Count the executions of a cold TB.  Once it becomes hot, leave it
+ * before any guest state has been modified, so that the main loop can
+ * replace it with a superblock.
+ */
+static TCGLabel *gen_tb_exec_count(TranslationBlock *tb)
+{
+    TCGv_ptr ptr = tcg_constant_ptr(&tb_exec_counts[tcg_tb_index(tb)]);
+    TCGv_i32 count = tcg_temp_new_i32();
+    TCGLabel *hot = gen_new_label();
+
+    tcg_gen_ld_i32(count, ptr, 0);
+    tcg_gen_addi_i32(count, count, 1);
+    tcg_gen_st_i32(count, ptr, 0);
+    tcg_gen_brcondi_i32(TCG_COND_EQ, count, tb_superblock_threshold, hot);
+    return hot;
+}
+
 void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
                      target_ulong pc, void *host_pc,
                      const TranslatorOps *ops, DisasContextBase *db)
 {
     uint32_t cflags = tb_cflags(tb);
+    TCGLabel *hot_label = NULL;
+    int trace_budget = 0;
     bool plugin_enabled;
 
     /* Initialize DisasContext */
@@ -44,6 +133,7 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
     db->num_insns = 0;
     db->max_insns = *max_insns;
     db->singlestep_enabled = cflags & CF_SINGLE_STEP;
+    db->trace_budget = 0;
     db->host_addr[0] = host_pc;
     db->host_addr[1] = NULL;
 
@@ -56,11 +146,27 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
 
     /* Start translating.  */
     gen_tb_start(db->tb);
+    if (tb->tb_stats) {
+        gen_tb_stats_exec_count(tb->tb_stats);
+    }
+    if (tb_superblock_threshold &&
+        !(cflags & (CF_HOT | CF_USE_ICOUNT | CF_NO_GOTO_TB | CF_COUNT_MASK))) {
+        hot_label = gen_tb_exec_count(tb);
+    }
     ops->tb_start(db, cpu);
     tcg_debug_assert(db->is_jmp == DISAS_NEXT);  /* no early exit */
 
     plugin_enabled = plugin_gen_tb_start(cpu, db, cflags & CF_MEMI_ONLY);
 
+    /*
+     * Side exits would skip instruction counting and per-TB plugin
+     * callbacks, so only extend superblocks when neither is in use.
+     */
+    if ((cflags & CF_HOT) && !(cflags & CF_USE_ICOUNT) && !plugin_enabled) {
+        trace_budget = TB_TRACE_MAX_BRANCHES;
+        db->trace_budget = trace_budget;
+    }
+
     while (true) {
         *max_insns = ++db->num_insns;
         ops->insn_start(db, cpu);
@@ -114,6 +220,14 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
     ops->tb_stop(db, cpu);
     gen_tb_end(db->tb, db->num_insns);
 
+    if (hot_label) {
+        gen_set_label(hot_label);
+        tcg_gen_exit_tb(tb, TB_EXIT_HOT);
+    }
+    if (db->trace_budget < trace_budget) {
+        qatomic_inc(&tb_ctx.superblock_count);
+    }
+
     if (plugin_enabled) {
         plugin_gen_tb_end(cpu);
     }
@@ -155,6 +269,11 @@ static void *translator_access(CPUArchState *env, DisasContextBase *db,
         host = db->host_addr[0];
         base = db->pc_first;
     } else {
+        /* Other pages can only be looked up from the vCPU thread. */
+        if (tb_async_in_worker()) {
+            siglongjmp(tcg_ctx->jmp_trans, -3);
+        }
+
         host = db->host_addr[1];
         base = TARGET_PAGE_ALIGN(db->pc_first);
         if (host == NULL) {
@@ -187,6 +306,34 @@ static void *translator_access(CPUArchState *env, DisasContextBase *db,
     return host + (pc - base);
 }
 
+static void *translator_peek_access(CPUArchState *env, DisasContextBase *db,
+                                    target_ulong pc, size_t len)
+{
+    if (pc >= db->pc_first && is_same_page(db, pc + len - 1)) {
+        return translator_access(env, db, pc, len);
+    }
+    if (tb_async_in_worker()) {
+        siglongjmp(tcg_ctx->jmp_trans, -3);
+    }
+    return NULL;
+}
+
+uint16_t translator_peek_lduw(CPUArchState *env, DisasContextBase *db,
+                              abi_ptr pc)
+{
+    void *p = translator_peek_access(env, db, pc, sizeof(uint16_t));
+
+    return p ? lduw_p(p) : cpu_lduw_code(env, pc);
+}
+
+uint32_t translator_peek_ldl(CPUArchState *env, DisasContextBase *db,
+                             abi_ptr pc)
+{
+    void *p = translator_peek_access(env, db, pc, sizeof(uint32_t));
+
+    return p ? ldl_p(p) : cpu_ldl_code(env, pc);
+}
+
 uint8_t translator_ldub(CPUArchState *env, DisasContextBase *db, abi_ptr pc)
 {
     uint8_t ret;
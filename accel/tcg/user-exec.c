@@ -227,6 +227,85 @@ int page_get_flags(target_ulong address)
     return p ? p->flags : 0;
 }
 
+int page_get_flags_range(target_ulong start, target_ulong last)
+{
+    PageFlagsNode *p;
+    int flags = 0;
+
+    assert(last >= start);
+    assert_memory_lock();
+
+    for (p = pageflags_find(start, last); p;
+         p = pageflags_next(p, start, last)) {
+        flags |= p->flags;
+    }
+    return flags;
+}
+
+bool page_check_range_flags(target_ulong start, target_ulong last, int flags)
+{
+    target_ulong addr = start;
+    PageFlagsNode *p;
+
+    assert(last >= start);
+    assert_memory_lock();
+
+    /* The nodes are visited in address order, look for gaps. */
+    for (p = pageflags_find(start, last); p;
+         p = pageflags_next(p, start, last)) {
+        if (p->itree.start > addr || (p->flags & flags) != flags) {
+            return false;
+        }
+        if (p->itree.last >= last) {
+            return true;
+        }
+        addr = p->itree.last + 1;
+    }
+    return false;
+}
+
+bool page_check_range_empty(target_ulong start, target_ulong last)
+{
+    assert(last >= start);
+    assert_memory_lock();
+    return pageflags_find(start, last) == NULL;
+}
+
+target_ulong page_find_range_empty(target_ulong min, target_ulong max,
+                                   target_ulong len, target_ulong align)
+{
+    target_ulong len_m1 = len - 1;
+
+    assert(min <= max);
+    assert(max <= GUEST_ADDR_MAX);
+    assert(len != 0);
+    assert(is_power_of_2(align));
+    assert_memory_lock();
+
+    /*
+     * Try the highest candidate below max, and if something is mapped
+     * there, continue below the lowest mapping it overlaps: any range
+     * ending above that mapping would overlap it too.
+     */
+    while (len_m1 <= max - min) {
+        target_ulong start = (max - len_m1) & -align;
+        PageFlagsNode *p;
+
+        if (start < min) {
+            break;
+        }
+        p = pageflags_find(start, start + len_m1);
+        if (!p) {
+            return start;
+        }
+        if (p->itree.start <= min) {
+            break;
+        }
+        max = p->itree.start - 1;
+    }
+    return -1;
+}
+
 /* A subroutine of page_set_flags: insert a new node for [start,last]. */
 static void pageflags_create(target_ulong start, target_ulong last, int flags)
 {
@@ -634,6 +713,7 @@ void page_protect(tb_page_addr_t address)
         pageflags_set_clear(start, last, 0, PAGE_WRITE);
         mprotect(g2h_untagged(start), qemu_host_page_size,
                  prot & (PAGE_READ | PAGE_EXEC) ? PROT_READ : PROT_NONE);
+        mmap_note_host_prot(start, last);
     }
 }
 
@@ -716,6 +796,7 @@ int page_unprotect(target_ulong address, uintptr_t pc)
             prot = (prot & ~PAGE_EXEC) | PAGE_READ;
         }
         mprotect((void *)g2h_untagged(start), len, prot & PAGE_BITS);
+        mmap_note_host_prot(start, start + len - 1);
     }
     mmap_unlock();
 
@@ -1222,6 +1303,26 @@ uint64_t cpu_ldq_code(CPUArchState *env, abi_ptr ptr)
     return ret;
 }
 
+/*
+ * Check @len bytes at @addr, within one page, for a bulk access and
+ * return their host address.  As for the other accessors, writes to
+ * pages containing code are caught by the SIGSEGV handler, which must
+ * be able to unwind to @ra until cpu_bulk_done.
+ */
+static void *cpu_bulk_lookup(CPUArchState *env, abi_ptr addr, size_t len,
+                             MMUAccessType access_type, int mmu_idx,
+                             uintptr_t ra)
+{
+    probe_access_internal(env, addr, len, access_type, false, ra);
+    set_helper_retaddr(ra);
+    return g2h(env_cpu(env), addr);
+}
+
+static inline void cpu_bulk_done(void)
+{
+    clear_helper_retaddr();
+}
+
 #include "ldst_common.c.inc"
 
 /*
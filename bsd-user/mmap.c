@@ -42,6 +42,11 @@ bool have_mmap_lock(void)
     return mmap_lock_count > 0 ? true : false;
 }
 
+/* Memory syscalls hold the mmap_lock throughout, so there is nothing to do. */
+void mmap_note_host_prot(target_ulong start, target_ulong last)
+{
+}
+
 /* Grab lock to make sure things are in a consistent state after fork().  */
 void mmap_fork_start(void)
 {
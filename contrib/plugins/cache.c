@@ -25,6 +25,14 @@ static GRand *rng;
 static int limit;
 static bool sys;
 
+/*
+ * In buffered mode the accesses are simulated in batches from a trace
+ * buffer, instead of one callback per access. The records only carry
+ * virtual addresses, so this is the default for user mode only.
+ */
+#define BUFFER_RECORDS 4096
+static struct qemu_plugin_mem_buffer *trace_buf;
+
 enum EvictionPolicy {
     LRU,
     FIFO,
@@ -385,13 +393,26 @@ static bool access_cache(Cache *cache, uint64_t addr)
     return false;
 }
 
+/* Account an access to @addr, and to @misses if it misses in @cache. */
+static bool cache_access_count(Cache *cache, uint64_t addr, uint64_t *misses)
+{
+    bool hit = access_cache(cache, addr);
+
+    if (!hit) {
+        __atomic_fetch_add(misses, 1, __ATOMIC_SEQ_CST);
+        cache->misses++;
+    }
+    cache->accesses++;
+    return hit;
+}
+
 static void vcpu_mem_access(unsigned int vcpu_index, qemu_plugin_meminfo_t info,
                             uint64_t vaddr, void *userdata)
 {
     uint64_t effective_addr;
     struct qemu_plugin_hwaddr *hwaddr;
     int cache_idx;
-    InsnData *insn;
+    InsnData *insn = userdata;
     bool hit_in_l1;
 
     hwaddr = qemu_plugin_get_hwaddr(info, vaddr);
@@ -403,13 +424,8 @@ static void vcpu_mem_access(unsigned int vcpu_index, qemu_plugin_meminfo_t info,
     cache_idx = vcpu_index % cores;
 
     g_mutex_lock(&l1_dcache_locks[cache_idx]);
-    hit_in_l1 = access_cache(l1_dcaches[cache_idx], effective_addr);
-    if (!hit_in_l1) {
-        insn = userdata;
-        __atomic_fetch_add(&insn->l1_dmisses, 1, __ATOMIC_SEQ_CST);
-        l1_dcaches[cache_idx]->misses++;
-    }
-    l1_dcaches[cache_idx]->accesses++;
+    hit_in_l1 = cache_access_count(l1_dcaches[cache_idx], effective_addr,
+                                   &insn->l1_dmisses);
     g_mutex_unlock(&l1_dcache_locks[cache_idx]);
 
     if (hit_in_l1 || !use_l2) {
@@ -418,33 +434,21 @@ static void vcpu_mem_access(unsigned int vcpu_index, qemu_plugin_meminfo_t info,
     }
 
     g_mutex_lock(&l2_ucache_locks[cache_idx]);
-    if (!access_cache(l2_ucaches[cache_idx], effective_addr)) {
-        insn = userdata;
-        __atomic_fetch_add(&insn->l2_misses, 1, __ATOMIC_SEQ_CST);
-        l2_ucaches[cache_idx]->misses++;
-    }
-    l2_ucaches[cache_idx]->accesses++;
+    cache_access_count(l2_ucaches[cache_idx], effective_addr,
+                       &insn->l2_misses);
     g_mutex_unlock(&l2_ucache_locks[cache_idx]);
 }
 
 static void vcpu_insn_exec(unsigned int vcpu_index, void *userdata)
 {
-    uint64_t insn_addr;
-    InsnData *insn;
+    InsnData *insn = userdata;
     int cache_idx;
     bool hit_in_l1;
 
-    insn_addr = ((InsnData *) userdata)->addr;
-
     cache_idx = vcpu_index % cores;
     g_mutex_lock(&l1_icache_locks[cache_idx]);
-    hit_in_l1 = access_cache(l1_icaches[cache_idx], insn_addr);
-    if (!hit_in_l1) {
-        insn = userdata;
-        __atomic_fetch_add(&insn->l1_imisses, 1, __ATOMIC_SEQ_CST);
-        l1_icaches[cache_idx]->misses++;
-    }
-    l1_icaches[cache_idx]->accesses++;
+    hit_in_l1 = cache_access_count(l1_icaches[cache_idx], insn->addr,
+                                   &insn->l1_imisses);
     g_mutex_unlock(&l1_icache_locks[cache_idx]);
 
     if (hit_in_l1 || !use_l2) {
@@ -453,15 +457,51 @@ static void vcpu_insn_exec(unsigned int vcpu_index, void *userdata)
     }
 
     g_mutex_lock(&l2_ucache_locks[cache_idx]);
-    if (!access_cache(l2_ucaches[cache_idx], insn_addr)) {
-        insn = userdata;
-        __atomic_fetch_add(&insn->l2_misses, 1, __ATOMIC_SEQ_CST);
-        l2_ucaches[cache_idx]->misses++;
-    }
-    l2_ucaches[cache_idx]->accesses++;
+    cache_access_count(l2_ucaches[cache_idx], insn->addr, &insn->l2_misses);
     g_mutex_unlock(&l2_ucache_locks[cache_idx]);
 }
 
+/*
+ * Simulate a batch of fetches and data accesses in program order, taking
+ * the locks of the core once for the whole batch.
+ */
+static void vcpu_trace_buf_full(unsigned int vcpu_index,
+                                const struct qemu_plugin_mem_record *records,
+                                size_t n, void *userdata)
+{
+    int cache_idx = vcpu_index % cores;
+    size_t i;
+
+    g_mutex_lock(&l1_dcache_locks[cache_idx]);
+    g_mutex_lock(&l1_icache_locks[cache_idx]);
+    if (use_l2) {
+        g_mutex_lock(&l2_ucache_locks[cache_idx]);
+    }
+
+    for (i = 0; i < n; i++) {
+        InsnData *insn = records[i].userdata;
+        uint64_t addr = records[i].vaddr;
+        bool hit_in_l1;
+
+        if (records[i].info == 0) {
+            hit_in_l1 = cache_access_count(l1_icaches[cache_idx], addr,
+                                           &insn->l1_imisses);
+        } else {
+            hit_in_l1 = cache_access_count(l1_dcaches[cache_idx], addr,
+                                           &insn->l1_dmisses);
+        }
+        if (!hit_in_l1 && use_l2) {
+            cache_access_count(l2_ucaches[cache_idx], addr, &insn->l2_misses);
+        }
+    }
+
+    if (use_l2) {
+        g_mutex_unlock(&l2_ucache_locks[cache_idx]);
+    }
+    g_mutex_unlock(&l1_icache_locks[cache_idx]);
+    g_mutex_unlock(&l1_dcache_locks[cache_idx]);
+}
+
 static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
 {
     size_t n_insns;
@@ -496,6 +536,13 @@ static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
         }
         g_mutex_unlock(&hashtable_lock);
 
+        if (trace_buf) {
+            qemu_plugin_register_vcpu_mem_buffered(insn, trace_buf, rw, data);
+            qemu_plugin_register_vcpu_insn_exec_buffered(insn, trace_buf,
+                                                         data);
+            continue;
+        }
+
         qemu_plugin_register_vcpu_mem_cb(insn, vcpu_mem_access,
                                          QEMU_PLUGIN_CB_NO_REGS,
                                          rw, data);
@@ -750,9 +797,11 @@ int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
     int l1_iassoc, l1_iblksize, l1_icachesize;
     int l1_dassoc, l1_dblksize, l1_dcachesize;
     int l2_assoc, l2_blksize, l2_cachesize;
+    bool buffered;
 
     limit = 32;
     sys = info->system_emulation;
+    buffered = !sys;
 
     l1_dassoc = 8;
     l1_dblksize = 64;
@@ -804,6 +853,11 @@ int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
                 fprintf(stderr, "boolean argument parsing failed: %s\n", opt);
                 return -1;
             }
+        } else if (g_strcmp0(tokens[0], "buffered") == 0) {
+            if (!qemu_plugin_bool_parse(tokens[0], tokens[1], &buffered)) {
+                fprintf(stderr, "boolean argument parsing failed: %s\n", opt);
+                return -1;
+            }
         } else if (g_strcmp0(tokens[0], "evict") == 0) {
             if (g_strcmp0(tokens[1], "rand") == 0) {
                 policy = RAND;
@@ -851,6 +905,11 @@ int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
     l1_icache_locks = g_new0(GMutex, cores);
     l2_ucache_locks = use_l2 ? g_new0(GMutex, cores) : NULL;
 
+    if (buffered) {
+        trace_buf = qemu_plugin_register_vcpu_mem_buffer_cb(
+            id, vcpu_trace_buf_full, BUFFER_RECORDS, NULL);
+    }
+
     qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
     qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
 
@@ -138,6 +138,8 @@ this code that are retained.
 
 GEN_INPUT_FLUSH__NOCHECK(float32_input_flush__nocheck, float32)
 GEN_INPUT_FLUSH__NOCHECK(float64_input_flush__nocheck, float64)
+GEN_INPUT_FLUSH__NOCHECK(float16_input_flush__nocheck, float16)
+GEN_INPUT_FLUSH__NOCHECK(bfloat16_input_flush__nocheck, bfloat16)
 #undef GEN_INPUT_FLUSH__NOCHECK
 
 #define GEN_INPUT_FLUSH1(name, soft_t)                  \
@@ -151,6 +153,8 @@ GEN_INPUT_FLUSH__NOCHECK(float64_input_flush__nocheck, float64)
 
 GEN_INPUT_FLUSH1(float32_input_flush1, float32)
 GEN_INPUT_FLUSH1(float64_input_flush1, float64)
+GEN_INPUT_FLUSH1(float16_input_flush1, float16)
+GEN_INPUT_FLUSH1(bfloat16_input_flush1, bfloat16)
 #undef GEN_INPUT_FLUSH1
 
 #define GEN_INPUT_FLUSH2(name, soft_t)                                  \
@@ -165,6 +169,8 @@ GEN_INPUT_FLUSH1(float64_input_flush1, float64)
 
 GEN_INPUT_FLUSH2(float32_input_flush2, float32)
 GEN_INPUT_FLUSH2(float64_input_flush2, float64)
+GEN_INPUT_FLUSH2(float16_input_flush2, float16)
+GEN_INPUT_FLUSH2(bfloat16_input_flush2, bfloat16)
 #undef GEN_INPUT_FLUSH2
 
 #define GEN_INPUT_FLUSH3(name, soft_t)                                  \
@@ -180,6 +186,8 @@ GEN_INPUT_FLUSH2(float64_input_flush2, float64)
 
 GEN_INPUT_FLUSH3(float32_input_flush3, float32)
 GEN_INPUT_FLUSH3(float64_input_flush3, float64)
+GEN_INPUT_FLUSH3(float16_input_flush3, float16)
+GEN_INPUT_FLUSH3(bfloat16_input_flush3, bfloat16)
 #undef GEN_INPUT_FLUSH3
 
 /*
@@ -401,6 +409,175 @@ float64_gen2(float64 xa, float64 xb, float_status *s,
     return soft(ua.s, ub.s, s);
 }
 
+/*
+ * float16 and bfloat16 have no host type.  Their hardfloat path widens
+ * zero or normal inputs exactly to double, and rounds the double result
+ * to the narrow format with integer arithmetic.  Double has more than
+ * twice the precision of either format plus two bits, so an add, sub,
+ * mul, div or sqrt rounded first to double and then to the narrow format
+ * is still correctly rounded.  A fused multiply-add can only be wrong if
+ * its double result is exactly halfway between two narrow values; those,
+ * and results that are not zero or normal in the narrow format, are left
+ * to the soft path.
+ */
+
+static inline double hard_from_narrow(uint16_t a, int frac_bits, int bias)
+{
+    union_float64 u;
+    uint64_t mag = a & 0x7fff;
+
+    if (mag) {
+        mag = (mag << (52 - frac_bits)) + ((uint64_t)(1023 - bias) << 52);
+    }
+    u.s = make_float64(((uint64_t)(a & 0x8000) << 48) | mag);
+    return u.h;
+}
+
+static inline bool hard_to_narrow(double h, uint16_t *r, int frac_bits,
+                                  int bias, bool check_tie)
+{
+    union_float64 u = { .h = h };
+    uint64_t mag = float64_val(u.s) & INT64_MAX;
+    uint16_t sign = (float64_val(u.s) >> 48) & 0x8000;
+    int shift = 52 - frac_bits;
+    uint64_t half = 1ull << (shift - 1);
+
+    if (mag == 0) {
+        *r = sign;
+        return true;
+    }
+    /* Tiny results may underflow. */
+    if (mag < (uint64_t)(1024 - bias) << 52) {
+        return false;
+    }
+    if (check_tie && (mag & (2 * half - 1)) == half) {
+        return false;
+    }
+    mag += half - 1 + ((mag >> shift) & 1);
+    mag = (mag >> shift) - ((uint64_t)(1023 - bias) << frac_bits);
+    /* Overflow, which also catches infinities and NaNs. */
+    if (mag >= (uint64_t)(2 * bias + 1) << frac_bits) {
+        return false;
+    }
+    *r = sign | mag;
+    return true;
+}
+
+static inline double f16_to_hard(float16 a)
+{
+    return hard_from_narrow(float16_val(a), 10, 15);
+}
+
+static inline bool hard_to_f16(double h, float16 *r, bool check_tie)
+{
+    uint16_t v;
+
+    if (unlikely(!hard_to_narrow(h, &v, 10, 15, check_tie))) {
+        return false;
+    }
+    *r = make_float16(v);
+    return true;
+}
+
+static inline double bf16_to_hard(bfloat16 a)
+{
+    return hard_from_narrow(a, 7, 127);
+}
+
+static inline bool hard_to_bf16(double h, bfloat16 *r, bool check_tie)
+{
+    return hard_to_narrow(h, r, 7, 127, check_tie);
+}
+
+typedef float16 (*soft_f16_op2_fn)(float16 a, float16 b, float_status *s);
+typedef bfloat16 (*soft_bf16_op2_fn)(bfloat16 a, bfloat16 b,
+                                     float_status *s);
+typedef bool (*f16_check_fn)(float16 a, float16 b);
+typedef bool (*bf16_check_fn)(bfloat16 a, bfloat16 b);
+
+static inline bool f16_is_zon2(float16 a, float16 b)
+{
+    return float16_is_zero_or_normal(a) && float16_is_zero_or_normal(b);
+}
+
+static inline bool bf16_is_zon2(bfloat16 a, bfloat16 b)
+{
+    return bfloat16_is_zero_or_normal(a) && bfloat16_is_zero_or_normal(b);
+}
+
+static inline float16
+float16_gen2(float16 a, float16 b, float_status *s,
+             hard_f64_op2_fn hard, soft_f16_op2_fn soft, f16_check_fn pre)
+{
+    float16 r;
+
+    if (unlikely(!can_use_fpu(s))) {
+        goto soft;
+    }
+
+    float16_input_flush2(&a, &b, s);
+    if (unlikely(!pre(a, b))) {
+        goto soft;
+    }
+
+    if (likely(hard_to_f16(hard(f16_to_hard(a), f16_to_hard(b)), &r, false))) {
+        return r;
+    }
+
+ soft:
+    return soft(a, b, s);
+}
+
+static inline bfloat16
+bfloat16_gen2(bfloat16 a, bfloat16 b, float_status *s,
+              hard_f64_op2_fn hard, soft_bf16_op2_fn soft, bf16_check_fn pre)
+{
+    bfloat16 r;
+
+    if (unlikely(!can_use_fpu(s))) {
+        goto soft;
+    }
+
+    bfloat16_input_flush2(&a, &b, s);
+    if (unlikely(!pre(a, b))) {
+        goto soft;
+    }
+
+    if (likely(hard_to_bf16(hard(bf16_to_hard(a), bf16_to_hard(b)),
+                            &r, false))) {
+        return r;
+    }
+
+ soft:
+    return soft(a, b, s);
+}
+
+/*
+ * Float to integer conversions round to nearest even with rint(), which
+ * like the operations above relies on the host rounding mode being left
+ * at its default, and towards zero with trunc().  Other rounding modes,
+ * scaling, and values that round outside [@min, @lim) take the soft path,
+ * which raises invalid as needed.
+ */
+static inline bool can_use_fpu_to_int(const float_status *s,
+                                      FloatRoundMode rmode, int scale)
+{
+    if (QEMU_NO_HARDFLOAT) {
+        return false;
+    }
+    return likely(s->float_exception_flags & float_flag_inexact &&
+                  scale == 0 &&
+                  (rmode == float_round_nearest_even ||
+                   rmode == float_round_to_zero));
+}
+
+static inline bool hard_to_int(double d, FloatRoundMode rmode,
+                               double min, double lim, double *r)
+{
+    *r = rmode == float_round_to_zero ? trunc(d) : rint(d);
+    return likely(*r >= min && *r < lim);
+}
+
 /*
  * Classify a floating point number. Everything above float_class_qnan
  * is a NaN so cls >= float_class_qnan is any NaN.
@@ -1845,8 +2022,8 @@ static floatx80 floatx80_round_pack_canonical(FloatParts128 *p,
  * Addition and subtraction
  */
 
-static float16 QEMU_FLATTEN
-float16_addsub(float16 a, float16 b, float_status *status, bool subtract)
+static float16 QEMU_SOFTFLOAT_ATTR
+soft_f16_addsub(float16 a, float16 b, float_status *status, bool subtract)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -1857,14 +2034,14 @@ float16_addsub(float16 a, float16 b, float_status *status, bool subtract)
     return float16_round_pack_canonical(pr, status);
 }
 
-float16 float16_add(float16 a, float16 b, float_status *status)
+static float16 soft_f16_add(float16 a, float16 b, float_status *status)
 {
-    return float16_addsub(a, b, status, false);
+    return soft_f16_addsub(a, b, status, false);
 }
 
-float16 float16_sub(float16 a, float16 b, float_status *status)
+static float16 soft_f16_sub(float16 a, float16 b, float_status *status)
 {
-    return float16_addsub(a, b, status, true);
+    return soft_f16_addsub(a, b, status, true);
 }
 
 static float32 QEMU_SOFTFLOAT_ATTR
@@ -1986,6 +2163,18 @@ float64_sub(float64 a, float64 b, float_status *s)
     return float64_addsub(a, b, s, hard_f64_sub, soft_f64_sub);
 }
 
+float16 QEMU_FLATTEN
+float16_add(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f64_add, soft_f16_add, f16_is_zon2);
+}
+
+float16 QEMU_FLATTEN
+float16_sub(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f64_sub, soft_f16_sub, f16_is_zon2);
+}
+
 static float64 float64r32_addsub(float64 a, float64 b, float_status *status,
                                  bool subtract)
 {
@@ -2008,8 +2197,8 @@ float64 float64r32_sub(float64 a, float64 b, float_status *status)
     return float64r32_addsub(a, b, status, true);
 }
 
-static bfloat16 QEMU_FLATTEN
-bfloat16_addsub(bfloat16 a, bfloat16 b, float_status *status, bool subtract)
+static bfloat16 QEMU_SOFTFLOAT_ATTR
+soft_bf16_addsub(bfloat16 a, bfloat16 b, float_status *status, bool subtract)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2020,14 +2209,26 @@ bfloat16_addsub(bfloat16 a, bfloat16 b, float_status *status, bool subtract)
     return bfloat16_round_pack_canonical(pr, status);
 }
 
-bfloat16 bfloat16_add(bfloat16 a, bfloat16 b, float_status *status)
+static bfloat16 soft_bf16_add(bfloat16 a, bfloat16 b, float_status *status)
+{
+    return soft_bf16_addsub(a, b, status, false);
+}
+
+static bfloat16 soft_bf16_sub(bfloat16 a, bfloat16 b, float_status *status)
 {
-    return bfloat16_addsub(a, b, status, false);
+    return soft_bf16_addsub(a, b, status, true);
 }
 
-bfloat16 bfloat16_sub(bfloat16 a, bfloat16 b, float_status *status)
+bfloat16 QEMU_FLATTEN
+bfloat16_add(bfloat16 a, bfloat16 b, float_status *s)
 {
-    return bfloat16_addsub(a, b, status, true);
+    return bfloat16_gen2(a, b, s, hard_f64_add, soft_bf16_add, bf16_is_zon2);
+}
+
+bfloat16 QEMU_FLATTEN
+bfloat16_sub(bfloat16 a, bfloat16 b, float_status *s)
+{
+    return bfloat16_gen2(a, b, s, hard_f64_sub, soft_bf16_sub, bf16_is_zon2);
 }
 
 static float128 QEMU_FLATTEN
@@ -2080,7 +2281,8 @@ floatx80 floatx80_sub(floatx80 a, floatx80 b, float_status *status)
  * Multiplication
  */
 
-float16 QEMU_FLATTEN float16_mul(float16 a, float16 b, float_status *status)
+static float16 QEMU_SOFTFLOAT_ATTR
+soft_f16_mul(float16 a, float16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2139,6 +2341,12 @@ float64_mul(float64 a, float64 b, float_status *s)
                         f64_is_zon2, f64_addsubmul_post);
 }
 
+float16 QEMU_FLATTEN
+float16_mul(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f64_mul, soft_f16_mul, f16_is_zon2);
+}
+
 float64 float64r32_mul(float64 a, float64 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
@@ -2150,8 +2358,8 @@ float64 float64r32_mul(float64 a, float64 b, float_status *status)
     return float64r32_round_pack_canonical(pr, status);
 }
 
-bfloat16 QEMU_FLATTEN
-bfloat16_mul(bfloat16 a, bfloat16 b, float_status *status)
+static bfloat16 QEMU_SOFTFLOAT_ATTR
+soft_bf16_mul(bfloat16 a, bfloat16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2162,6 +2370,12 @@ bfloat16_mul(bfloat16 a, bfloat16 b, float_status *status)
     return bfloat16_round_pack_canonical(pr, status);
 }
 
+bfloat16 QEMU_FLATTEN
+bfloat16_mul(bfloat16 a, bfloat16 b, float_status *s)
+{
+    return bfloat16_gen2(a, b, s, hard_f64_mul, soft_bf16_mul, bf16_is_zon2);
+}
+
 float128 QEMU_FLATTEN
 float128_mul(float128 a, float128 b, float_status *status)
 {
@@ -2192,8 +2406,9 @@ floatx80_mul(floatx80 a, floatx80 b, float_status *status)
  * Fused multiply-add
  */
 
-float16 QEMU_FLATTEN float16_muladd(float16 a, float16 b, float16 c,
-                                    int flags, float_status *status)
+static float16 QEMU_SOFTFLOAT_ATTR
+soft_f16_muladd(float16 a, float16 b, float16 c, int flags,
+                float_status *status)
 {
     FloatParts64 pa, pb, pc, *pr;
 
@@ -2205,6 +2420,53 @@ float16 QEMU_FLATTEN float16_muladd(float16 a, float16 b, float16 c,
     return float16_round_pack_canonical(pr, status);
 }
 
+/*
+ * The product of two float16 or bfloat16 values is exact in double,
+ * so a plain multiply and add rounds only once, and the host need not
+ * have a fused multiply-add.
+ */
+static inline double hard_narrow_muladd(double a, double b, double c,
+                                        int flags)
+{
+    if (flags & float_muladd_negate_product) {
+        a = -a;
+    }
+    if (flags & float_muladd_negate_c) {
+        c = -c;
+    }
+    return a * b + c;
+}
+
+float16 QEMU_FLATTEN float16_muladd(float16 a, float16 b, float16 c,
+                                    int flags, float_status *s)
+{
+    float16 r;
+
+    if (unlikely(!can_use_fpu(s))) {
+        goto soft;
+    }
+    if (unlikely(flags & float_muladd_halve_result)) {
+        goto soft;
+    }
+
+    float16_input_flush3(&a, &b, &c, s);
+    if (unlikely(!f16_is_zon2(a, b) || !float16_is_zero_or_normal(c))) {
+        goto soft;
+    }
+
+    if (likely(hard_to_f16(hard_narrow_muladd(f16_to_hard(a), f16_to_hard(b),
+                                              f16_to_hard(c), flags),
+                           &r, true))) {
+        if (flags & float_muladd_negate_result) {
+            return float16_chs(r);
+        }
+        return r;
+    }
+
+ soft:
+    return soft_f16_muladd(a, b, c, flags, s);
+}
+
 static float32 QEMU_SOFTFLOAT_ATTR
 soft_f32_muladd(float32 a, float32 b, float32 c, int flags,
                 float_status *status)
@@ -2390,8 +2652,9 @@ float64 float64r32_muladd(float64 a, float64 b, float64 c,
     return float64r32_round_pack_canonical(pr, status);
 }
 
-bfloat16 QEMU_FLATTEN bfloat16_muladd(bfloat16 a, bfloat16 b, bfloat16 c,
-                                      int flags, float_status *status)
+static bfloat16 QEMU_SOFTFLOAT_ATTR
+soft_bf16_muladd(bfloat16 a, bfloat16 b, bfloat16 c, int flags,
+                 float_status *status)
 {
     FloatParts64 pa, pb, pc, *pr;
 
@@ -2403,6 +2666,37 @@ bfloat16 QEMU_FLATTEN bfloat16_muladd(bfloat16 a, bfloat16 b, bfloat16 c,
     return bfloat16_round_pack_canonical(pr, status);
 }
 
+bfloat16 QEMU_FLATTEN bfloat16_muladd(bfloat16 a, bfloat16 b, bfloat16 c,
+                                      int flags, float_status *s)
+{
+    bfloat16 r;
+
+    if (unlikely(!can_use_fpu(s))) {
+        goto soft;
+    }
+    if (unlikely(flags & float_muladd_halve_result)) {
+        goto soft;
+    }
+
+    bfloat16_input_flush3(&a, &b, &c, s);
+    if (unlikely(!bf16_is_zon2(a, b) || !bfloat16_is_zero_or_normal(c))) {
+        goto soft;
+    }
+
+    if (likely(hard_to_bf16(hard_narrow_muladd(bf16_to_hard(a),
+                                               bf16_to_hard(b),
+                                               bf16_to_hard(c), flags),
+                            &r, true))) {
+        if (flags & float_muladd_negate_result) {
+            return bfloat16_chs(r);
+        }
+        return r;
+    }
+
+ soft:
+    return soft_bf16_muladd(a, b, c, flags, s);
+}
+
 float128 QEMU_FLATTEN float128_muladd(float128 a, float128 b, float128 c,
                                       int flags, float_status *status)
 {
@@ -2420,7 +2714,8 @@ float128 QEMU_FLATTEN float128_muladd(float128 a, float128 b, float128 c,
  * Division
  */
 
-float16 float16_div(float16 a, float16 b, float_status *status)
+static float16 QEMU_SOFTFLOAT_ATTR
+soft_f16_div(float16 a, float16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2513,6 +2808,22 @@ float64_div(float64 a, float64 b, float_status *s)
                         f64_div_pre, f64_div_post);
 }
 
+static bool f16_div_pre(float16 a, float16 b)
+{
+    return float16_is_zero_or_normal(a) && float16_is_normal(b);
+}
+
+static bool bf16_div_pre(bfloat16 a, bfloat16 b)
+{
+    return bfloat16_is_zero_or_normal(a) && bfloat16_is_normal(b);
+}
+
+float16 QEMU_FLATTEN
+float16_div(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f64_div, soft_f16_div, f16_div_pre);
+}
+
 float64 float64r32_div(float64 a, float64 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
@@ -2524,8 +2835,8 @@ float64 float64r32_div(float64 a, float64 b, float_status *status)
     return float64r32_round_pack_canonical(pr, status);
 }
 
-bfloat16 QEMU_FLATTEN
-bfloat16_div(bfloat16 a, bfloat16 b, float_status *status)
+static bfloat16 QEMU_SOFTFLOAT_ATTR
+soft_bf16_div(bfloat16 a, bfloat16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2536,6 +2847,12 @@ bfloat16_div(bfloat16 a, bfloat16 b, float_status *status)
     return bfloat16_round_pack_canonical(pr, status);
 }
 
+bfloat16 QEMU_FLATTEN
+bfloat16_div(bfloat16 a, bfloat16 b, float_status *s)
+{
+    return bfloat16_gen2(a, b, s, hard_f64_div, soft_bf16_div, bf16_div_pre);
+}
+
 float128 QEMU_FLATTEN
 float128_div(float128 a, float128 b, float_status *status)
 {
@@ -2805,7 +3122,8 @@ float16 float64_to_float16(float64 a, bool ieee, float_status *s)
     return float16a_round_pack_canonical(&p, s, fmt);
 }
 
-float32 float64_to_float32(float64 a, float_status *s)
+static float32 QEMU_SOFTFLOAT_ATTR
+soft_float64_to_float32(float64 a, float_status *s)
 {
     FloatParts64 p;
 
@@ -2814,6 +3132,33 @@ float32 float64_to_float32(float64 a, float_status *s)
     return float32_round_pack_canonical(&p, s);
 }
 
+float32 float64_to_float32(float64 a, float_status *s)
+{
+    union_float64 ua;
+    union_float32 ur;
+
+    ua.s = a;
+    if (unlikely(!can_use_fpu(s))) {
+        goto soft;
+    }
+
+    float64_input_flush1(&ua.s, s);
+    if (unlikely(!float64_is_zero_or_normal(ua.s))) {
+        goto soft;
+    }
+
+    ur.h = ua.h;
+    if (unlikely(f32_is_inf(ur))) {
+        float_raise(float_flag_overflow, s);
+    } else if (unlikely(fabsf(ur.h) <= FLT_MIN) && !float64_is_zero(ua.s)) {
+        goto soft;
+    }
+    return ur.s;
+
+ soft:
+    return soft_float64_to_float32(ua.s, s);
+}
+
 float32 bfloat16_to_float32(bfloat16 a, float_status *s)
 {
     FloatParts64 p;
@@ -2972,18 +3317,38 @@ float16 float16_round_to_int(float16 a, float_status *s)
 
 float32 float32_round_to_int(float32 a, float_status *s)
 {
+    union_float32 ua, ur;
     FloatParts64 p;
 
-    float32_unpack_canonical(&p, a, s);
+    ua.s = a;
+    if (likely(can_use_fpu(s))) {
+        float32_input_flush1(&ua.s, s);
+        if (likely(float32_is_zero_or_normal(ua.s))) {
+            ur.h = rintf(ua.h);
+            return ur.s;
+        }
+    }
+
+    float32_unpack_canonical(&p, ua.s, s);
     parts_round_to_int(&p, s->float_rounding_mode, 0, s, &float32_params);
     return float32_round_pack_canonical(&p, s);
 }
 
 float64 float64_round_to_int(float64 a, float_status *s)
 {
+    union_float64 ua, ur;
     FloatParts64 p;
 
-    float64_unpack_canonical(&p, a, s);
+    ua.s = a;
+    if (likely(can_use_fpu(s))) {
+        float64_input_flush1(&ua.s, s);
+        if (likely(float64_is_zero_or_normal(ua.s))) {
+            ur.h = rint(ua.h);
+            return ur.s;
+        }
+    }
+
+    float64_unpack_canonical(&p, ua.s, s);
     parts_round_to_int(&p, s->float_rounding_mode, 0, s, &float64_params);
     return float64_round_pack_canonical(&p, s);
 }
@@ -3071,18 +3436,38 @@ int16_t float32_to_int16_scalbn(float32 a, FloatRoundMode rmode, int scale,
 int32_t float32_to_int32_scalbn(float32 a, FloatRoundMode rmode, int scale,
                                 float_status *s)
 {
+    union_float32 ua;
     FloatParts64 p;
+    double r;
 
-    float32_unpack_canonical(&p, a, s);
+    ua.s = a;
+    if (can_use_fpu_to_int(s, rmode, scale)) {
+        float32_input_flush1(&ua.s, s);
+        if (hard_to_int(ua.h, rmode, -0x1p31, 0x1p31, &r)) {
+            return r;
+        }
+    }
+
+    float32_unpack_canonical(&p, ua.s, s);
     return parts_float_to_sint(&p, rmode, scale, INT32_MIN, INT32_MAX, s);
 }
 
 int64_t float32_to_int64_scalbn(float32 a, FloatRoundMode rmode, int scale,
                                 float_status *s)
 {
+    union_float32 ua;
     FloatParts64 p;
+    double r;
 
-    float32_unpack_canonical(&p, a, s);
+    ua.s = a;
+    if (can_use_fpu_to_int(s, rmode, scale)) {
+        float32_input_flush1(&ua.s, s);
+        if (hard_to_int(ua.h, rmode, -0x1p63, 0x1p63, &r)) {
+            return r;
+        }
+    }
+
+    float32_unpack_canonical(&p, ua.s, s);
     return parts_float_to_sint(&p, rmode, scale, INT64_MIN, INT64_MAX, s);
 }
 
@@ -3098,18 +3483,38 @@ int16_t float64_to_int16_scalbn(float64 a, FloatRoundMode rmode, int scale,
 int32_t float64_to_int32_scalbn(float64 a, FloatRoundMode rmode, int scale,
                                 float_status *s)
 {
+    union_float64 ua;
     FloatParts64 p;
+    double r;
 
-    float64_unpack_canonical(&p, a, s);
+    ua.s = a;
+    if (can_use_fpu_to_int(s, rmode, scale)) {
+        float64_input_flush1(&ua.s, s);
+        if (hard_to_int(ua.h, rmode, -0x1p31, 0x1p31, &r)) {
+            return r;
+        }
+    }
+
+    float64_unpack_canonical(&p, ua.s, s);
     return parts_float_to_sint(&p, rmode, scale, INT32_MIN, INT32_MAX, s);
 }
 
 int64_t float64_to_int64_scalbn(float64 a, FloatRoundMode rmode, int scale,
                                 float_status *s)
 {
+    union_float64 ua;
     FloatParts64 p;
+    double r;
 
-    float64_unpack_canonical(&p, a, s);
+    ua.s = a;
+    if (can_use_fpu_to_int(s, rmode, scale)) {
+        float64_input_flush1(&ua.s, s);
+        if (hard_to_int(ua.h, rmode, -0x1p63, 0x1p63, &r)) {
+            return r;
+        }
+    }
+
+    float64_unpack_canonical(&p, ua.s, s);
     return parts_float_to_sint(&p, rmode, scale, INT64_MIN, INT64_MAX, s);
 }
 
@@ -3461,18 +3866,38 @@ uint16_t float32_to_uint16_scalbn(float32 a, FloatRoundMode rmode, int scale,
 uint32_t float32_to_uint32_scalbn(float32 a, FloatRoundMode rmode, int scale,
                                   float_status *s)
 {
+    union_float32 ua;
     FloatParts64 p;
+    double r;
 
-    float32_unpack_canonical(&p, a, s);
+    ua.s = a;
+    if (can_use_fpu_to_int(s, rmode, scale)) {
+        float32_input_flush1(&ua.s, s);
+        if (hard_to_int(ua.h, rmode, 0, 0x1p32, &r)) {
+            return r;
+        }
+    }
+
+    float32_unpack_canonical(&p, ua.s, s);
     return parts_float_to_uint(&p, rmode, scale, UINT32_MAX, s);
 }
 
 uint64_t float32_to_uint64_scalbn(float32 a, FloatRoundMode rmode, int scale,
                                   float_status *s)
 {
+    union_float32 ua;
     FloatParts64 p;
+    double r;
 
-    float32_unpack_canonical(&p, a, s);
+    ua.s = a;
+    if (can_use_fpu_to_int(s, rmode, scale)) {
+        float32_input_flush1(&ua.s, s);
+        if (hard_to_int(ua.h, rmode, 0, 0x1p64, &r)) {
+            return r;
+        }
+    }
+
+    float32_unpack_canonical(&p, ua.s, s);
     return parts_float_to_uint(&p, rmode, scale, UINT64_MAX, s);
 }
 
@@ -3488,18 +3913,38 @@ uint16_t float64_to_uint16_scalbn(float64 a, FloatRoundMode rmode, int scale,
 uint32_t float64_to_uint32_scalbn(float64 a, FloatRoundMode rmode, int scale,
                                   float_status *s)
 {
+    union_float64 ua;
     FloatParts64 p;
+    double r;
 
-    float64_unpack_canonical(&p, a, s);
+    ua.s = a;
+    if (can_use_fpu_to_int(s, rmode, scale)) {
+        float64_input_flush1(&ua.s, s);
+        if (hard_to_int(ua.h, rmode, 0, 0x1p32, &r)) {
+            return r;
+        }
+    }
+
+    float64_unpack_canonical(&p, ua.s, s);
     return parts_float_to_uint(&p, rmode, scale, UINT32_MAX, s);
 }
 
 uint64_t float64_to_uint64_scalbn(float64 a, FloatRoundMode rmode, int scale,
                                   float_status *s)
 {
+    union_float64 ua;
     FloatParts64 p;
+    double r;
 
-    float64_unpack_canonical(&p, a, s);
+    ua.s = a;
+    if (can_use_fpu_to_int(s, rmode, scale)) {
+        float64_input_flush1(&ua.s, s);
+        if (hard_to_int(ua.h, rmode, 0, 0x1p64, &r)) {
+            return r;
+        }
+    }
+
+    float64_unpack_canonical(&p, ua.s, s);
     return parts_float_to_uint(&p, rmode, scale, UINT64_MAX, s);
 }
 
@@ -4490,7 +4935,8 @@ floatx80 floatx80_scalbn(floatx80 a, int n, float_status *status)
  * Square Root
  */
 
-float16 QEMU_FLATTEN float16_sqrt(float16 a, float_status *status)
+static float16 QEMU_SOFTFLOAT_ATTR
+soft_f16_sqrt(float16 a, float_status *status)
 {
     FloatParts64 p;
 
@@ -4499,6 +4945,26 @@ float16 QEMU_FLATTEN float16_sqrt(float16 a, float_status *status)
     return float16_round_pack_canonical(&p, status);
 }
 
+float16 QEMU_FLATTEN float16_sqrt(float16 a, float_status *s)
+{
+    float16 r;
+
+    if (unlikely(!can_use_fpu(s))) {
+        goto soft;
+    }
+
+    float16_input_flush1(&a, s);
+    if (unlikely(!float16_is_zero_or_normal(a) || float16_is_neg(a))) {
+        goto soft;
+    }
+    if (likely(hard_to_f16(sqrt(f16_to_hard(a)), &r, false))) {
+        return r;
+    }
+
+ soft:
+    return soft_f16_sqrt(a, s);
+}
+
 static float32 QEMU_SOFTFLOAT_ATTR
 soft_f32_sqrt(float32 a, float_status *status)
 {
@@ -4582,7 +5048,8 @@ float64 float64r32_sqrt(float64 a, float_status *status)
     return float64r32_round_pack_canonical(&p, status);
 }
 
-bfloat16 QEMU_FLATTEN bfloat16_sqrt(bfloat16 a, float_status *status)
+static bfloat16 QEMU_SOFTFLOAT_ATTR
+soft_bf16_sqrt(bfloat16 a, float_status *status)
 {
     FloatParts64 p;
 
@@ -4591,6 +5058,26 @@ bfloat16 QEMU_FLATTEN bfloat16_sqrt(bfloat16 a, float_status *status)
     return bfloat16_round_pack_canonical(&p, status);
 }
 
+bfloat16 QEMU_FLATTEN bfloat16_sqrt(bfloat16 a, float_status *s)
+{
+    bfloat16 r;
+
+    if (unlikely(!can_use_fpu(s))) {
+        goto soft;
+    }
+
+    bfloat16_input_flush1(&a, s);
+    if (unlikely(!bfloat16_is_zero_or_normal(a) || bfloat16_is_neg(a))) {
+        goto soft;
+    }
+    if (likely(hard_to_bf16(sqrt(bf16_to_hard(a)), &r, false))) {
+        return r;
+    }
+
+ soft:
+    return soft_bf16_sqrt(a, s);
+}
+
 float128 QEMU_FLATTEN float128_sqrt(float128 a, float_status *status)
 {
     FloatParts128 p;
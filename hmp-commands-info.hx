@@ -283,6 +283,24 @@ SRST
     Show dynamic compiler opcode counters
 ERST
 
+#if defined(CONFIG_TCG)
+    {
+        .name       = "tb-hot",
+        .args_type  = "count:i?,sort:s?",
+        .params     = "[count [exec|insns|translate-time|translations|spills]]",
+        .help       = "show the translation blocks with the highest "
+                      "statistics (default: 10, sorted by exec)",
+    },
+#endif
+
+SRST
+  ``info tb-hot`` [*count* [*sort*]]
+    Show the *count* translation blocks (default: 10) with the highest
+    value of the *sort* statistic: ``exec`` (the default), ``insns``,
+    ``translate-time``, ``translations`` or ``spills``. Statistics are
+    only collected with ``-accel tcg,tb-stats=on``.
+ERST
+
     {
         .name       = "sync-profile",
         .args_type  = "mean:-m,no_coalesce:-n,max:i?",
@@ -280,6 +280,33 @@ void page_set_flags(target_ulong start, target_ulong end, int flags);
 void page_reset_target_data(target_ulong start, target_ulong end);
 int page_check_range(target_ulong start, target_ulong len, int flags);
 
+/*
+ * The following walk the mappings overlapping [start, last] rather than
+ * each page, and must be called with the mmap_lock held.
+ */
+
+/* Return the union of the flags of the pages in [start, last]. */
+int page_get_flags_range(target_ulong start, target_ulong last);
+
+/* Return true if all the pages in [start, last] are mapped with @flags. */
+bool page_check_range_flags(target_ulong start, target_ulong last, int flags);
+
+/* Return true if no page in [start, last] is mapped. */
+bool page_check_range_empty(target_ulong start, target_ulong last);
+
+/*
+ * page_find_range_empty
+ * @min: first byte of the search range
+ * @max: last byte of the search range
+ * @len: size of the hole required
+ * @align: alignment of the hole required (power of 2)
+ *
+ * Return the highest address of an unmapped hole of @len bytes within
+ * [@min, @max], or -1 if there is none.
+ */
+target_ulong page_find_range_empty(target_ulong min, target_ulong max,
+                                   target_ulong len, target_ulong align);
+
 /**
  * page_get_target_data(address)
  * @address: guest virtual address
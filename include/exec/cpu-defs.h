@@ -65,6 +65,15 @@
 /* use a fully associative victim tlb of 8 entries */
 #define CPU_VTLB_SIZE 8
 
+/* remember the last 8 large pages filled, per mmu mode */
+#define CPU_LTLB_SIZE 8
+
+/* statistics are kept per log2 of the page size */
+#define CPU_TLB_PAGE_SIZES TARGET_LONG_BITS
+
+/* queue up to 16 flushes from other cpus before flushing everything */
+#define CPU_TLB_PENDING_SIZE 16
+
 #if HOST_LONG_BITS == 32 && TARGET_LONG_BITS == 32
 #define CPU_TLB_ENTRY_BITS 4
 #else
@@ -154,6 +163,14 @@ typedef struct CPUTLBEntryFull {
     /* @lg_page_size contains the log2 of the page size. */
     uint8_t lg_page_size;
 
+    /*
+     * @lg_page_exact is true if the translation holds for the whole
+     * page given by @lg_page_size, so that the other TARGET_PAGE_SIZE
+     * pages within it can be mapped without calling tlb_fill.  It is
+     * false if @lg_page_size was rounded up for the sake of flushing.
+     */
+    bool lg_page_exact;
+
     /*
      * Allow target-specific additions to this structure.
      * This may be used to cache items from the guest cpu
@@ -166,19 +183,39 @@ typedef struct CPUTLBEntryFull {
 #endif  /* !CONFIG_USER_ONLY */
 
 #if !defined(CONFIG_USER_ONLY) && defined(CONFIG_TCG)
+/*
+ * A page larger than TARGET_PAGE_SIZE, as returned by tlb_fill.  The
+ * tlb itself only holds TARGET_PAGE_SIZE entries; this records how to
+ * create them for the rest of the large page without another tlb_fill,
+ * and which of them to drop when any part of the large page is flushed.
+ * The page is matched if (vaddr & mask) == addr; an unused entry has
+ * a mask of 0.
+ */
+typedef struct CPUTLBLargePage {
+    target_ulong addr;
+    target_ulong mask;
+    /* The page within the large page that @full was filled for. */
+    target_ulong vaddr_page;
+    CPUTLBEntryFull full;
+} CPUTLBLargePage;
+
 /*
  * Data elements that are per MMU mode, minus the bits accessed by
  * the TCG fast path.
  */
 typedef struct CPUTLBDesc {
     /*
-     * Describe a region covering all of the large pages allocated
-     * into the tlb.  When any page within this region is flushed,
-     * we must flush the entire tlb.  The region is matched if
+     * Describe a region covering the large pages that did not fit in
+     * ltable.  When any page within this region is flushed, we must
+     * flush the entire tlb.  The region is matched if
      * (addr & large_page_mask) == large_page_addr.
      */
     target_ulong large_page_addr;
     target_ulong large_page_mask;
+    /* The next index to use in the large page table.  */
+    size_t lindex;
+    /* The large pages currently mapped by the tlb.  */
+    CPUTLBLargePage ltable[CPU_LTLB_SIZE];
     /* host time (in ns) at the beginning of the time window */
     int64_t window_begin_ns;
     /* maximum number of entries observed in the window */
@@ -203,6 +240,18 @@ typedef struct CPUTLBDescFast {
     CPUTLBEntry *table;
 } CPUTLBDescFast QEMU_ALIGNED(2 * sizeof(void *));
 
+/*
+ * A flush of @len bytes at @addr, comparing only the low @bits of the
+ * address, from the tlbs indicated by @idxmap.  A @bits value less than
+ * TARGET_PAGE_BITS flushes these tlbs entirely.
+ */
+typedef struct CPUTLBFlushRange {
+    target_ulong addr;
+    target_ulong len;
+    uint16_t idxmap;
+    uint16_t bits;
+} CPUTLBFlushRange;
+
 /*
  * Data elements that are shared between all MMU modes.
  */
@@ -215,6 +264,19 @@ typedef struct CPUTLBCommon {
      * Protected by tlb_c.lock.
      */
     uint16_t dirty;
+    /*
+     * Flushes requested by other cpus, and not run yet.  They are run
+     * together the next time this cpu processes its queued work, and
+     * overlapping requests are merged.  Once more than
+     * CPU_TLB_PENDING_SIZE ranges are pending, the mmu_idx involved are
+     * added to pending_full and flushed entirely instead.
+     * Protected by tlb_c.lock.
+     */
+    uint16_t pending_full;
+    bool pending_queued;
+    bool pending_safe;
+    unsigned pending_n;
+    CPUTLBFlushRange pending[CPU_TLB_PENDING_SIZE];
     /*
      * Statistics.  These are not lock protected, but are read and
      * written atomically.  This allows the monitor to print a snapshot
@@ -223,6 +285,23 @@ typedef struct CPUTLBCommon {
     size_t full_flush_count;
     size_t part_flush_count;
     size_t elide_flush_count;
+    /*
+     * Flushes queued by other cpus, those merged into a pending one,
+     * those turned into a flush of the whole mmu_idx, and the batches
+     * in which they ran.  Updated under tlb_c.lock.
+     */
+    size_t queued_flush_count;
+    size_t merged_flush_count;
+    size_t upgraded_flush_count;
+    size_t flush_batch_count;
+    /*
+     * Indexed by the log2 of the page size: tlb misses resolved by
+     * tlb_fill, tlb misses resolved from the large page table, and
+     * large pages dropped by a partial flush.
+     */
+    size_t page_miss_count[CPU_TLB_PAGE_SIZES];
+    size_t page_hit_count[CPU_TLB_PAGE_SIZES];
+    size_t page_flush_count[CPU_TLB_PAGE_SIZES];
 } CPUTLBCommon;
 
 /*
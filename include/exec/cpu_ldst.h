@@ -206,6 +206,24 @@ void cpu_stl_le_mmuidx_ra(CPUArchState *env, abi_ptr ptr, uint32_t val,
 void cpu_stq_le_mmuidx_ra(CPUArchState *env, abi_ptr ptr, uint64_t val,
                           int mmu_idx, uintptr_t ra);
 
+/*
+ * Bulk operations on guest memory.  Each page is looked up once, raising
+ * any fault or watchpoint for the part of the range it contains before
+ * that part is accessed, and RAM is then accessed through its host address.
+ * A fault may thus leave the pages before the faulting one modified.
+ * cpu_memmove_mmuidx_ra copies forward one page at a time, so the ranges
+ * must not overlap unless @dst is below @src.
+ *
+ * Return the number of bytes done.  This stops short of @len at the
+ * first page that is not RAM, such as MMIO or ROM, and is 0 when plugins
+ * ask for memory callbacks; the caller must do the rest with accesses of
+ * the guest's own size.
+ */
+size_t cpu_memset_mmuidx_ra(CPUArchState *env, abi_ptr addr, uint8_t val,
+                            size_t len, int mmu_idx, uintptr_t ra);
+size_t cpu_memmove_mmuidx_ra(CPUArchState *env, abi_ptr dst, abi_ptr src,
+                             size_t len, int mmu_idx, uintptr_t ra);
+
 uint8_t cpu_ldb_mmu(CPUArchState *env, abi_ptr ptr, MemOpIdx oi, uintptr_t ra);
 uint16_t cpu_ldw_be_mmu(CPUArchState *env, abi_ptr ptr,
                         MemOpIdx oi, uintptr_t ra);
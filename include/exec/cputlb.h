@@ -27,5 +27,8 @@
 void tlb_protect_code(ram_addr_t ram_addr);
 void tlb_unprotect_code(ram_addr_t ram_addr);
 void tlb_flush_counts(size_t *full, size_t *part, size_t *elide);
+void tlb_flush_batch_counts(size_t *queued, size_t *merged, size_t *upgraded,
+                            size_t *batches);
+void tlb_dump_page_size_info(GString *buf);
 #endif
 #endif
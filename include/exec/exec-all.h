@@ -282,8 +282,9 @@ void tlb_flush_range_by_mmuidx_all_cpus_synced(CPUState *cpu,
  * address and attributes for the translation.
  *
  * At most one entry for a given virtual address is permitted. Only a
- * single TARGET_PAGE_SIZE region is mapped; @full->lg_page_size is only
- * used by tlb_flush_page.
+ * single TARGET_PAGE_SIZE region is mapped; @full->lg_page_size is
+ * used by tlb_flush_page and, if @full->lg_page_exact, to map the rest
+ * of the page on later TLB misses without calling tlb_fill.
  */
 void tlb_set_page_full(CPUState *cpu, int mmu_idx, target_ulong vaddr,
                        CPUTLBEntryFull *full);
@@ -545,6 +546,7 @@ struct TranslationBlock {
 #define CF_PARALLEL      0x00080000 /* Generate code for a parallel context */
 #define CF_NOIRQ         0x00100000 /* Generate an uninterruptible TB */
 #define CF_PCREL         0x00200000 /* Opcodes in TB are PC-relative */
+#define CF_HOT           0x00400000 /* Superblock retranslated from hot TB */
 #define CF_CLUSTER_MASK  0xff000000 /* Top 8 bits are cluster ID */
 #define CF_CLUSTER_SHIFT 24
 
@@ -561,6 +563,9 @@ struct TranslationBlock {
 
     struct tb_tc tc;
 
+    /* Execution statistics, if enabled with -accel tcg,tb-stats=on. */
+    TBStatistics *tb_stats;
+
     /*
      * Track tb_page_addr_t intervals that intersect this TB.
      * For user-only, the virtual addresses are always contiguous,
@@ -619,6 +624,16 @@ static inline uint32_t tb_cflags(const TranslationBlock *tb)
     return qatomic_read(&tb->cflags);
 }
 
+/*
+ * The cflags that take part in TB lookup and hashing.  CF_HOT only records
+ * how a TB was translated: a superblock replaces the TB it was formed from
+ * and must be found by the same lookups.
+ */
+static inline uint32_t tb_lookup_cflags(const TranslationBlock *tb)
+{
+    return tb_cflags(tb) & ~CF_HOT;
+}
+
 static inline tb_page_addr_t tb_page_addr0(const TranslationBlock *tb)
 {
 #ifdef CONFIG_USER_ONLY
@@ -753,6 +768,17 @@ void TSA_NO_TSA mmap_lock(void);
 void TSA_NO_TSA mmap_unlock(void);
 bool have_mmap_lock(void);
 
+/**
+ * mmap_note_host_prot:
+ * @start: first guest address
+ * @last: last guest address
+ *
+ * Called with the mmap_lock held when the host protection of the pages
+ * in [@start, @last] was changed for self-modifying code detection,
+ * so that a memory syscall in progress on them does not undo it.
+ */
+void mmap_note_host_prot(target_ulong start, target_ulong last);
+
 /**
  * adjust_signal_pc:
  * @pc: raw pc from the host signal ucontext_t.
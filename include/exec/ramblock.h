@@ -74,6 +74,16 @@ struct RAMBlock {
      * could not have been valid on the source.
      */
     ram_addr_t postcopy_length;
+
+    /*
+     * With the mapped-ram migration capability, bitmap of the pages
+     * whose contents are in the migration file, and the file offsets
+     * of that bitmap and of the region where the pages are written.
+     * The multifd channels update file_bmap concurrently.
+     */
+    unsigned long *file_bmap;
+    off_t bitmap_offset;
+    uint64_t pages_offset;
 };
 #endif
 #endif
@@ -77,6 +77,8 @@ typedef enum DisasJumpType {
  * @num_insns: Number of translated instructions (including current).
  * @max_insns: Maximum number of instructions to be translated in this TB.
  * @singlestep_enabled: "Hardware" single stepping enabled.
+ * @trace_budget: Number of further branches this superblock may be
+ *                extended across; zero unless the TB has CF_HOT.
  *
  * Architecture-agnostic disassembly context.
  */
@@ -88,6 +90,7 @@ typedef struct DisasContextBase {
     int num_insns;
     int max_insns;
     bool singlestep_enabled;
+    int trace_budget;
     void *host_addr[2];
 } DisasContextBase;
 
@@ -160,6 +163,34 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
  */
 bool translator_use_goto_tb(DisasContextBase *db, target_ulong dest);
 
+/**
+ * translator_extend_trace
+ * @db: Disassembly context
+ * @dest: guest pc at which translation would continue
+ *
+ * Return true if the current TB is a superblock that may be extended
+ * past the branch being translated, continuing with the instruction at
+ * @dest instead of ending the TB.  This is the case for CF_HOT TBs, as
+ * long as @dest is forward of the current instruction on the first page
+ * and the instruction budget is not exhausted.
+ *
+ * For an unconditional direct branch, @dest is the branch target.
+ * For a conditional branch, @dest is the fall-through address and the
+ * taken path must leave the TB through a side exit; see
+ * translator_gen_side_exit.
+ */
+bool translator_extend_trace(DisasContextBase *db, target_ulong dest);
+
+/**
+ * translator_gen_side_exit
+ * @db: Disassembly context
+ *
+ * Emit code accounting for a side exit taken out of a superblock.
+ * The caller then leaves the TB via tcg_gen_lookup_and_goto_ptr, since
+ * both goto_tb slots are reserved for the end of the trace.
+ */
+void translator_gen_side_exit(DisasContextBase *db);
+
 /*
  * Translator Load Functions
  *
@@ -209,6 +240,21 @@ translator_ldq_swap(CPUArchState *env, DisasContextBase *db,
     return ret;
 }
 
+/*
+ * translator_peek_lduw, translator_peek_ldl - look at nearby code
+ *
+ * Load code that is not part of the instruction being translated, e.g.
+ * to find the length of the next one.  Unlike translator_ld*, the bytes
+ * are not reported to plugins.  Within the first page of the TB they are
+ * read through the host page that translation started from; elsewhere
+ * they are loaded through the softmmu TLB, or translation is abandoned
+ * on translator threads, which cannot use it.
+ */
+uint16_t translator_peek_lduw(CPUArchState *env, DisasContextBase *db,
+                              abi_ptr pc);
+uint32_t translator_peek_ldl(CPUArchState *env, DisasContextBase *db,
+                             abi_ptr pc);
+
 /**
  * translator_fake_ldb - fake instruction load
  * @insn8: byte of instruction
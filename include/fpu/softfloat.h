@@ -286,6 +286,16 @@ static inline bool float16_is_normal(float16 a)
     return (((float16_val(a) >> 10) + 1) & 0x1f) >= 2;
 }
 
+static inline bool float16_is_denormal(float16 a)
+{
+    return float16_is_zero_or_denormal(a) && !float16_is_zero(a);
+}
+
+static inline bool float16_is_zero_or_normal(float16 a)
+{
+    return float16_is_normal(a) || float16_is_zero(a);
+}
+
 static inline float16 float16_abs(float16 a)
 {
     /* Note that abs does *not* handle NaN specially, nor does
@@ -468,6 +478,16 @@ static inline bool bfloat16_is_normal(bfloat16 a)
     return (((a >> 7) + 1) & 0xff) >= 2;
 }
 
+static inline bool bfloat16_is_denormal(bfloat16 a)
+{
+    return bfloat16_is_zero_or_denormal(a) && !bfloat16_is_zero(a);
+}
+
+static inline bool bfloat16_is_zero_or_normal(bfloat16 a)
+{
+    return bfloat16_is_normal(a) || bfloat16_is_zero(a);
+}
+
 static inline bfloat16 bfloat16_abs(bfloat16 a)
 {
     /* Note that abs does *not* handle NaN specially, nor does
@@ -292,6 +292,8 @@ struct qemu_work_item;
  * @can_do_io: Nonzero if memory-mapped IO is safe. Deterministic execution
  * requires that IO only be performed on the last instruction of a TB
  * so that interrupts take effect immediately.
+ * @superblock_side_exits: Number of side exits out of superblocks taken
+ *   by this CPU, counted by the generated code.
  * @cpu_ases: Pointer to array of CPUAddressSpaces (which define the
  *            AddressSpaces this CPU has)
  * @num_ases: number of CPUAddressSpaces in @cpu_ases
@@ -422,6 +424,7 @@ struct CPUState {
     uint32_t halted;
     uint32_t can_do_io;
     int32_t exception_index;
+    uint64_t superblock_side_exits;
 
     /* shared by kvm, hax and hvf */
     bool vcpu_dirty;
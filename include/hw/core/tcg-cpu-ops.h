@@ -48,6 +48,14 @@ struct TCGCPUOps {
     void (*cpu_exec_exit)(CPUState *cpu);
     /** @debug_excp_handler: Callback for handling debug exceptions */
     void (*debug_excp_handler)(CPUState *cpu);
+    /**
+     * @translate_async: True if translation depends only on the pc,
+     * cs_base and flags of the TB and on CPU state that does not change
+     * without a tb_flush, and reads guest code only with translator_ld*
+     * and translator_peek_*.  Translator threads may then retranslate
+     * hot TBs while the vCPU keeps running.
+     */
+    bool translate_async;
 
 #ifdef NEED_CPU_H
 #if defined(CONFIG_USER_ONLY) && defined(TARGET_I386)
@@ -74,9 +74,43 @@ enum plugin_dyn_cb_type {
 enum plugin_dyn_cb_subtype {
     PLUGIN_CB_REGULAR,
     PLUGIN_CB_INLINE,
+    PLUGIN_CB_COND,
+    PLUGIN_CB_BUFFER,
     PLUGIN_N_CB_SUBTYPES,
 };
 
+/*
+ * One element per vCPU, indexed by cpu_index. @data is reallocated (with
+ * all TBs flushed) when a vCPU whose index does not fit is created.
+ */
+struct qemu_plugin_scoreboard {
+    GArray *data;
+    QLIST_ENTRY(qemu_plugin_scoreboard) entry;
+};
+
+/*
+ * A trace buffer keeps the pending records of each vCPU in a scoreboard
+ * whose elements are struct qemu_plugin_mem_buffer_vcpu. At the start of
+ * each instruction, the generated code calls qemu_plugin_mem_buffer_flush()
+ * unless there is room for all the records of the instruction; the records
+ * themselves are appended without any check. @reserved is the room the
+ * current instruction needs, for the accesses appended from helpers.
+ */
+struct qemu_plugin_mem_buffer_vcpu {
+    uint64_t n;
+    uint64_t reserved;
+    struct qemu_plugin_mem_record records[];
+};
+
+struct qemu_plugin_mem_buffer {
+    struct qemu_plugin_ctx *ctx;
+    struct qemu_plugin_scoreboard *score;
+    size_t n_records;
+    qemu_plugin_vcpu_mem_buffer_cb_t cb;
+    void *userdata;
+    QLIST_ENTRY(qemu_plugin_mem_buffer) entry;
+};
+
 /*
  * A dynamic callback has an insertion point that is determined at run-time.
  * Usually the insertion point is somewhere in the code cache; think for
@@ -90,10 +124,26 @@ struct qemu_plugin_dyn_cb {
     enum qemu_plugin_mem_rw rw;
     /* fields specific to each dyn_cb type go here */
     union {
+        /*
+         * @entry.score is NULL for ops on the single location at @userp,
+         * registered with the non-per-vcpu API.
+         */
         struct {
+            qemu_plugin_u64 entry;
             enum qemu_plugin_op op;
             uint64_t imm;
         } inline_insn;
+        /* @f.vcpu_udata is called with @userp if @entry @cond @imm */
+        struct {
+            qemu_plugin_u64 entry;
+            enum qemu_plugin_cond cond;
+            uint64_t imm;
+        } cond;
+        /* the records are stored with @userp as their user data */
+        struct {
+            struct qemu_plugin_mem_buffer *buf;
+            uint64_t insn_vaddr;
+        } buffer;
     };
 };
 
@@ -108,6 +158,9 @@ struct qemu_plugin_insn {
     /* if set, the instruction calls helpers that might access guest memory */
     bool mem_helper;
 
+    /* number of guest memory accesses made by the translated code */
+    unsigned int mem_accesses;
+
     bool mem_only;
 };
 
@@ -174,6 +227,7 @@ struct qemu_plugin_insn *qemu_plugin_tb_insn_get(struct qemu_plugin_tb *tb,
     g_byte_array_set_size(insn->data, 0);
     insn->calls_helpers = false;
     insn->mem_helper = false;
+    insn->mem_accesses = 0;
     insn->vaddr = pc;
 
     for (i = 0; i < PLUGIN_N_CB_TYPES; i++) {
@@ -203,6 +257,9 @@ void qemu_plugin_flush_cb(void);
 
 void qemu_plugin_atexit_cb(void);
 
+void qemu_plugin_mem_buffer_flush(struct qemu_plugin_mem_buffer *buf,
+                                  unsigned int cpu_index);
+
 void qemu_plugin_add_dyn_cb_arr(GArray *arr);
 
 static inline void qemu_plugin_disable_mem_helpers(CPUState *cpu)
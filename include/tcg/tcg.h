@@ -269,6 +269,7 @@ typedef struct TCGPool {
 
 #define TCG_MAX_TEMPS 512
 #define TCG_MAX_INSNS 512
+#define TCG_MAX_GLOBAL_REGS 8
 
 /* when the size of the arguments of a called function is smaller than
    this value, they are statically allocated in the TB stack frame */
@@ -466,6 +467,9 @@ typedef struct TCGTemp {
     unsigned int mem_allocated:1;
     unsigned int temp_allocated:1;
     unsigned int temp_subindex:1;
+    /* Kept in @carry_reg across the labels of the current TB.  */
+    unsigned int carried:1;
+    TCGReg carry_reg:8;
 
     int64_t val;
     struct TCGTemp *mem_base;
@@ -603,6 +607,18 @@ struct TCGContext {
 
     TCGLabel *exitreq_label;
 
+    /* Globals kept in host registers across labels, see tcg_global_regs. */
+    int nb_carry;
+    TCGRegSet carry_regs;
+    TCGTemp *carry_temps[TCG_MAX_GLOBAL_REGS];
+
+    /* Register allocator statistics for the current TB, and totals. */
+    unsigned nb_spills;
+    unsigned nb_reloads;
+    size_t regalloc_tb_count;
+    size_t regalloc_spill_count;
+    size_t regalloc_reload_count;
+
 #ifdef CONFIG_PLUGIN
     /*
      * We keep one plugin_tb struct per TCGContext. Note that on every TB
@@ -615,6 +631,9 @@ struct TCGContext {
 
     /* descriptor of the instruction being translated */
     struct qemu_plugin_insn *plugin_insn;
+
+    /* if set, new ops are inserted before this one instead of appended */
+    TCGOp *emit_before_op;
 #endif
 
     GHashTable *const_table[TCG_TYPE_COUNT];
@@ -643,6 +662,8 @@ static inline bool temp_readonly(TCGTemp *ts)
 extern __thread TCGContext *tcg_ctx;
 extern const void *tcg_code_gen_epilogue;
 extern uintptr_t tcg_splitwx_diff;
+extern unsigned int tcg_global_regs;
+extern bool tcg_cse_enabled;
 extern TCGv_env cpu_env;
 
 bool in_code_gen_buffer(const void *p);
@@ -794,6 +815,11 @@ static inline void tcg_set_insn_start_param(TCGOp *op, int arg, target_ulong v)
 /* The last op that was emitted.  */
 static inline TCGOp *tcg_last_op(void)
 {
+#ifdef CONFIG_PLUGIN
+    if (tcg_ctx->emit_before_op) {
+        return QTAILQ_PREV(tcg_ctx->emit_before_op, link);
+    }
+#endif
     return QTAILQ_LAST(&tcg_ctx->ops);
 }
 
@@ -828,6 +854,15 @@ TranslationBlock *tcg_tb_lookup(uintptr_t tc_ptr);
 void tcg_tb_foreach(GTraverseFunc func, gpointer user_data);
 size_t tcg_nb_tbs(void);
 
+/*
+ * Return a number unique to @tb among the TBs that are in the code
+ * buffer at the same time, and below tcg_tb_index_max().  It is derived
+ * from the address of @tb, so it can index arrays of per-TB data that
+ * are kept outside the code buffer.
+ */
+size_t tcg_tb_index(const TranslationBlock *tb);
+size_t tcg_tb_index_max(void);
+
 /* user-mode: Called with mmap_lock held.  */
 static inline void *tcg_malloc(int size)
 {
@@ -913,6 +948,7 @@ static inline TCGv_ptr tcg_temp_new_ptr(void)
 int64_t tcg_cpu_exec_time(void);
 void tcg_dump_info(GString *buf);
 void tcg_dump_op_count(GString *buf);
+void tcg_dump_regalloc_info(GString *buf);
 
 #define TCG_CT_CONST  1 /* any constant of register size */
 
@@ -995,6 +1031,8 @@ TCGOp *tcg_op_insert_after(TCGContext *s, TCGOp *op,
 void tcg_remove_ops_after(TCGOp *op);
 
 void tcg_optimize(TCGContext *s);
+int tcg_optimize_cse(TCGContext *s);
+int tcg_optimize_stores(TCGContext *s);
 
 /*
  * Locate or create a read-only temporary that is a constant.
@@ -1129,11 +1167,10 @@ static inline size_t tcg_current_code_size(TCGContext *s)
  *        TB index (0 or 1). That is, we left the TB via (the equivalent
  *        of) "goto_tb <index>". The main loop uses this to determine
  *        how to link the TB just executed to the next.
- *  2:    we are using instruction counting code generation, and we
- *        did not start executing this TB because the instruction counter
- *        would hit zero midway through it. In this case the pointer
- *        returned is the TB we were about to execute, and the caller must
- *        arrange to execute the remaining count of instructions.
+ *  2:    the execution counter of this TB reached the superblock
+ *        threshold, and we did not start executing it. The pointer
+ *        returned is the TB we were about to execute, and the caller
+ *        should retranslate it as a superblock.
  *  3:    we stopped because the CPU's exit_request flag was set
  *        (usually meaning that there is an interrupt that needs to be
  *        handled). The pointer returned is the TB we were about to execute
@@ -1156,6 +1193,7 @@ static inline size_t tcg_current_code_size(TCGContext *s)
 #define TB_EXIT_IDX0      0
 #define TB_EXIT_IDX1      1
 #define TB_EXIT_IDXMAX    1
+#define TB_EXIT_HOT       2
 #define TB_EXIT_REQUESTED 3
 
 #ifdef CONFIG_TCG_INTERPRETER
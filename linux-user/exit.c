@@ -18,6 +18,7 @@
  */
 #include "qemu/osdep.h"
 #include "accel/tcg/perf.h"
+#include "accel/tcg/tb-cache.h"
 #include "gdbstub/syscalls.h"
 #include "qemu.h"
 #include "user-internals.h"
@@ -39,6 +40,7 @@ void preexit_cleanup(CPUArchState *env, int code)
         __gcov_dump();
 #endif
         gdb_exit(code);
+        tb_cache_save(env_cpu(env));
         qemu_plugin_user_exit();
         perf_exit();
 }
@@ -308,6 +308,34 @@ TargetFdTrans **target_fd_trans;
 QemuMutex target_fd_trans_lock;
 unsigned int target_fd_max;
 
+typedef struct TargetFdTransOld {
+    struct rcu_head rcu;
+    TargetFdTrans **table;
+} TargetFdTransOld;
+
+static void fd_trans_free_old(TargetFdTransOld *old)
+{
+    g_free(old->table);
+    g_free(old);
+}
+
+/* Make room for @fd in the table, with target_fd_trans_lock held. */
+void fd_trans_grow_unsafe(int fd)
+{
+    unsigned int newmax = ((fd >> 6) + 1) << 6; /* by slice of 64 entries */
+    TargetFdTrans **table = g_new0(TargetFdTrans *, newmax);
+
+    if (target_fd_trans) {
+        TargetFdTransOld *old = g_new(TargetFdTransOld, 1);
+
+        memcpy(table, target_fd_trans, target_fd_max * sizeof(*table));
+        old->table = target_fd_trans;
+        call_rcu(old, fd_trans_free_old, rcu);
+    }
+    qatomic_rcu_set(&target_fd_trans, table);
+    qatomic_store_release(&target_fd_max, newmax);
+}
+
 static void tswap_nlmsghdr(struct nlmsghdr *nlh)
 {
     nlh->nlmsg_len = tswap32(nlh->nlmsg_len);
@@ -17,6 +17,7 @@
 #define FD_TRANS_H
 
 #include "qemu/lockable.h"
+#include "qemu/rcu.h"
 
 typedef abi_long (*TargetFdDataFunc)(void *, size_t);
 typedef abi_long (*TargetFdAddrFunc)(void *, abi_ulong, socklen_t);
@@ -36,59 +37,55 @@ static inline void fd_trans_init(void)
     qemu_mutex_init(&target_fd_trans_lock);
 }
 
-static inline TargetFdDataFunc fd_trans_target_to_host_data(int fd)
+/*
+ * Lookups do not take target_fd_trans_lock, since they happen for each
+ * read and write.  The table is replaced when it grows, and the old one
+ * is freed after an RCU grace period.  target_fd_max is updated after
+ * the table, so a table of at least that size is always seen.
+ */
+static inline TargetFdTrans *fd_trans_get(int fd)
 {
-    if (fd < 0) {
+    TargetFdTrans **table;
+
+    if (fd < 0 || fd >= qatomic_load_acquire(&target_fd_max)) {
         return NULL;
     }
 
-    QEMU_LOCK_GUARD(&target_fd_trans_lock);
-    if (fd < target_fd_max && target_fd_trans[fd]) {
-        return target_fd_trans[fd]->target_to_host_data;
-    }
-    return NULL;
+    RCU_READ_LOCK_GUARD();
+    table = qatomic_rcu_read(&target_fd_trans);
+    return qatomic_read(&table[fd]);
+}
+
+static inline TargetFdDataFunc fd_trans_target_to_host_data(int fd)
+{
+    TargetFdTrans *trans = fd_trans_get(fd);
+
+    return trans ? trans->target_to_host_data : NULL;
 }
 
 static inline TargetFdDataFunc fd_trans_host_to_target_data(int fd)
 {
-    if (fd < 0) {
-        return NULL;
-    }
+    TargetFdTrans *trans = fd_trans_get(fd);
 
-    QEMU_LOCK_GUARD(&target_fd_trans_lock);
-    if (fd < target_fd_max && target_fd_trans[fd]) {
-        return target_fd_trans[fd]->host_to_target_data;
-    }
-    return NULL;
+    return trans ? trans->host_to_target_data : NULL;
 }
 
 static inline TargetFdAddrFunc fd_trans_target_to_host_addr(int fd)
 {
-    if (fd < 0) {
-        return NULL;
-    }
+    TargetFdTrans *trans = fd_trans_get(fd);
 
-    QEMU_LOCK_GUARD(&target_fd_trans_lock);
-    if (fd < target_fd_max && target_fd_trans[fd]) {
-        return target_fd_trans[fd]->target_to_host_addr;
-    }
-    return NULL;
+    return trans ? trans->target_to_host_addr : NULL;
 }
 
+void fd_trans_grow_unsafe(int fd);
+
 static inline void internal_fd_trans_register_unsafe(int fd,
                                                      TargetFdTrans *trans)
 {
-    unsigned int oldmax;
-
     if (fd >= target_fd_max) {
-        oldmax = target_fd_max;
-        target_fd_max = ((fd >> 6) + 1) << 6; /* by slice of 64 entries */
-        target_fd_trans = g_renew(TargetFdTrans *,
-                                  target_fd_trans, target_fd_max);
-        memset((void *)(target_fd_trans + oldmax), 0,
-               (target_fd_max - oldmax) * sizeof(TargetFdTrans *));
+        fd_trans_grow_unsafe(fd);
     }
-    target_fd_trans[fd] = trans;
+    qatomic_set(&target_fd_trans[fd], trans);
 }
 
 static inline void fd_trans_register(int fd, TargetFdTrans *trans)
@@ -100,7 +97,7 @@ static inline void fd_trans_register(int fd, TargetFdTrans *trans)
 static inline void internal_fd_trans_unregister_unsafe(int fd)
 {
     if (fd >= 0 && fd < target_fd_max) {
-        target_fd_trans[fd] = NULL;
+        qatomic_set(&target_fd_trans[fd], NULL);
     }
 }
 
@@ -46,6 +46,120 @@ bool have_mmap_lock(void)
     return mmap_lock_count > 0 ? true : false;
 }
 
+/*
+ * munmap and mprotect do not hold the mmap_lock across the host syscalls.
+ * Instead they mark the host pages they change as busy with
+ * mmap_range_lock(), and take the mmap_lock only to read and to update
+ * the page flags.  Thus memory syscalls on disjoint ranges, and
+ * translation, proceed in parallel with them.  Operations that keep the
+ * mmap_lock throughout use mmap_range_wait() for the busy ranges that
+ * they overlap.
+ *
+ * page_protect() and page_unprotect() can still change the protection
+ * of a busy host page under the mmap_lock.  They report it through
+ * mmap_note_host_prot(), and mmap_range_unlock() then applies the
+ * protection from the final page flags again.
+ */
+typedef struct MmapRange {
+    abi_ulong start;
+    abi_ulong last;
+    /* Host pages whose protection was changed by someone else. */
+    abi_ulong reprot_start;
+    abi_ulong reprot_last;
+    QLIST_ENTRY(MmapRange) next;
+} MmapRange;
+
+static QLIST_HEAD(, MmapRange) mmap_ranges =
+    QLIST_HEAD_INITIALIZER(mmap_ranges);
+static pthread_cond_t mmap_range_cond = PTHREAD_COND_INITIALIZER;
+
+static MmapRange *mmap_range_find(abi_ulong start, abi_ulong last)
+{
+    MmapRange *r;
+
+    QLIST_FOREACH(r, &mmap_ranges, next) {
+        if (r->start <= last && start <= r->last) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Wait until no other thread is changing [start, last].
+ * Must be called with the mmap_lock held; return true if it was dropped.
+ */
+static bool mmap_range_wait(abi_ulong start, abi_ulong last)
+{
+    bool waited = false;
+
+    assert(have_mmap_lock());
+    while (mmap_range_find(start, last)) {
+        pthread_cond_wait(&mmap_range_cond, &mmap_mutex);
+        waited = true;
+    }
+    return waited;
+}
+
+/* Mark the host pages in [start, last] as busy. */
+static void mmap_range_lock(MmapRange *r, abi_ulong start, abi_ulong last)
+{
+    r->start = start;
+    r->last = last;
+    r->reprot_start = -1;
+    r->reprot_last = 0;
+
+    mmap_lock();
+    mmap_range_wait(start, last);
+    QLIST_INSERT_HEAD(&mmap_ranges, r, next);
+    mmap_unlock();
+}
+
+/* Release a range taken by mmap_range_lock(), with the mmap_lock held. */
+static void mmap_range_unlock(MmapRange *r)
+{
+    assert(have_mmap_lock());
+    QLIST_REMOVE(r, next);
+
+    if (r->reprot_start <= r->reprot_last) {
+        abi_ulong n = (r->reprot_last - r->reprot_start) / qemu_host_page_size;
+        abi_ulong addr = r->reprot_start;
+
+        do {
+            int prot = page_get_flags_range(addr,
+                                            addr + qemu_host_page_size - 1);
+
+            if (prot & PAGE_EXEC) {
+                prot = (prot & ~PAGE_EXEC) | PAGE_READ;
+            }
+            /* Unmapped pages stay unmapped, or reserved with PROT_NONE. */
+            if (prot || reserved_va) {
+                mprotect(g2h_untagged(addr), qemu_host_page_size,
+                         prot & PAGE_BITS);
+            }
+            addr += qemu_host_page_size;
+        } while (n--);
+    }
+
+    pthread_cond_broadcast(&mmap_range_cond);
+}
+
+void mmap_note_host_prot(target_ulong start, target_ulong last)
+{
+    MmapRange *r;
+
+    assert(have_mmap_lock());
+    start &= qemu_host_page_mask;
+    last |= ~qemu_host_page_mask;
+
+    QLIST_FOREACH(r, &mmap_ranges, next) {
+        if (r->start <= last && start <= r->last) {
+            r->reprot_start = MIN(r->reprot_start, MAX(start, r->start));
+            r->reprot_last = MAX(r->reprot_last, MIN(last, r->last));
+        }
+    }
+}
+
 /* Grab lock to make sure things are in a consistent state after fork().  */
 void mmap_fork_start(void)
 {
@@ -56,10 +170,14 @@ void mmap_fork_start(void)
 
 void mmap_fork_end(int child)
 {
-    if (child)
+    if (child) {
         pthread_mutex_init(&mmap_mutex, NULL);
-    else
+        /* The threads that had busy ranges do not exist in the child. */
+        QLIST_INIT(&mmap_ranges);
+        pthread_cond_init(&mmap_range_cond, NULL);
+    } else {
         pthread_mutex_unlock(&mmap_mutex);
+    }
 }
 
 /*
@@ -116,8 +234,9 @@ static int validate_prot_to_pageflags(int *host_prot, int prot)
 /* NOTE: all the constants are the HOST ones, but addresses are target. */
 int target_mprotect(abi_ulong start, abi_ulong len, int target_prot)
 {
-    abi_ulong end, host_start, host_end, addr;
-    int prot1, ret, page_flags, host_prot;
+    abi_ulong end, host_start, host_end;
+    int prot1, prot_head, prot_tail, ret, page_flags, host_prot;
+    MmapRange range;
 
     trace_target_mprotect(start, len, target_prot);
 
@@ -137,19 +256,22 @@ int target_mprotect(abi_ulong start, abi_ulong len, int target_prot)
         return 0;
     }
 
-    mmap_lock();
     host_start = start & qemu_host_page_mask;
     host_end = HOST_PAGE_ALIGN(end);
+    mmap_range_lock(&range, host_start, host_end - 1);
+
+    /* Protection of the other target pages in the first and last host page. */
+    mmap_lock();
+    prot_head = start > host_start ?
+                page_get_flags_range(host_start, start - 1) : 0;
+    prot_tail = end < host_end ? page_get_flags_range(end, host_end - 1) : 0;
+    mmap_unlock();
+
     if (start > host_start) {
         /* handle host page containing start */
-        prot1 = host_prot;
-        for (addr = host_start; addr < start; addr += TARGET_PAGE_SIZE) {
-            prot1 |= page_get_flags(addr);
-        }
+        prot1 = host_prot | prot_head;
         if (host_end == host_start + qemu_host_page_size) {
-            for (addr = end; addr < host_end; addr += TARGET_PAGE_SIZE) {
-                prot1 |= page_get_flags(addr);
-            }
+            prot1 |= prot_tail;
             end = host_end;
         }
         ret = mprotect(g2h_untagged(host_start), qemu_host_page_size,
@@ -160,10 +282,7 @@ int target_mprotect(abi_ulong start, abi_ulong len, int target_prot)
         host_start += qemu_host_page_size;
     }
     if (end < host_end) {
-        prot1 = host_prot;
-        for (addr = end; addr < host_end; addr += TARGET_PAGE_SIZE) {
-            prot1 |= page_get_flags(addr);
-        }
+        prot1 = host_prot | prot_tail;
         ret = mprotect(g2h_untagged(host_end - qemu_host_page_size),
                        qemu_host_page_size, prot1 & PAGE_BITS);
         if (ret != 0) {
@@ -180,11 +299,14 @@ int target_mprotect(abi_ulong start, abi_ulong len, int target_prot)
             goto error;
         }
     }
-
-    page_set_flags(start, start + len, page_flags);
     ret = 0;
 
 error:
+    mmap_lock();
+    if (ret == 0) {
+        page_set_flags(start, start + len, page_flags);
+    }
+    mmap_range_unlock(&range);
     mmap_unlock();
     return ret;
 }
@@ -194,7 +316,7 @@ static int mmap_frag(abi_ulong real_start,
                      abi_ulong start, abi_ulong end,
                      int prot, int flags, int fd, abi_ulong offset)
 {
-    abi_ulong real_end, addr;
+    abi_ulong real_end;
     void *host_start;
     int prot1, prot_new;
 
@@ -203,9 +325,11 @@ static int mmap_frag(abi_ulong real_start,
 
     /* get the protection of the target pages outside the mapping */
     prot1 = 0;
-    for(addr = real_start; addr < real_end; addr++) {
-        if (addr < start || addr >= end)
-            prot1 |= page_get_flags(addr);
+    if (start > real_start) {
+        prot1 |= page_get_flags_range(real_start, start - 1);
+    }
+    if (end < real_end) {
+        prot1 |= page_get_flags_range(end, real_end - 1);
     }
 
     if (prot1 == 0) {
@@ -265,14 +389,15 @@ abi_ulong mmap_next_start = TASK_UNMAPPED_BASE;
 
 unsigned long last_brk;
 
-/* Subroutine of mmap_find_vma, used when we have pre-allocated a chunk
-   of guest address space.  */
+/*
+ * Subroutine of mmap_find_vma, used when we have pre-allocated a chunk
+ * of guest address space: look for the highest free range ending at
+ * or below start + size, and then from the top of the address space.
+ */
 static abi_ulong mmap_find_vma_reserved(abi_ulong start, abi_ulong size,
                                         abi_ulong align)
 {
-    abi_ulong addr, end_addr, incr = qemu_host_page_size;
-    int prot;
-    bool looped = false;
+    abi_ulong addr = -1;
 
     if (size > reserved_va) {
         return (abi_ulong)-1;
@@ -280,48 +405,21 @@ static abi_ulong mmap_find_vma_reserved(abi_ulong start, abi_ulong size,
 
     /* Note that start and size have already been aligned by mmap_find_vma. */
 
-    end_addr = start + size;
-    if (start > reserved_va - size) {
-        /* Start at the top of the address space.  */
-        end_addr = ((reserved_va - size) & -align) + size;
-        looped = true;
+    /* Address 0 is never returned. */
+    if (start <= reserved_va - size && start + size - 1 >= align) {
+        addr = page_find_range_empty(align, start + size - 1, size, align);
     }
-
-    /* Search downward from END_ADDR, checking to see if a page is in use.  */
-    addr = end_addr;
-    while (1) {
-        addr -= incr;
-        if (addr > end_addr) {
-            if (looped) {
-                /* Failure.  The entire address space has been searched.  */
-                return (abi_ulong)-1;
-            }
-            /* Re-start at the top of the address space.  */
-            addr = end_addr = ((reserved_va - size) & -align) + size;
-            looped = true;
-        } else {
-            prot = page_get_flags(addr);
-            if (prot) {
-                /* Page in use.  Restart below this page.  */
-                addr = end_addr = ((addr - size) & -align) + size;
-            } else if (addr && addr + size == end_addr) {
-                /* Success!  All pages between ADDR and END_ADDR are free.  */
-                if (start == mmap_next_start) {
-                    mmap_next_start = addr;
-                }
-                return addr;
-            }
-        }
+    if (addr == (abi_ulong)-1 && reserved_va - 1 >= align) {
+        addr = page_find_range_empty(align, reserved_va - 1, size, align);
     }
+    if (addr != (abi_ulong)-1 && start == mmap_next_start) {
+        mmap_next_start = addr;
+    }
+    return addr;
 }
 
-/*
- * Find and reserve a free memory area of size 'size'. The search
- * starts at 'start'.
- * It must be called with mmap_lock() held.
- * Return -1 if error.
- */
-abi_ulong mmap_find_vma(abi_ulong start, abi_ulong size, abi_ulong align)
+static abi_ulong do_mmap_find_vma(abi_ulong start, abi_ulong size,
+                                  abi_ulong align)
 {
     void *ptr, *prev;
     abi_ulong addr;
@@ -428,6 +526,45 @@ abi_ulong mmap_find_vma(abi_ulong start, abi_ulong size, abi_ulong align)
     }
 }
 
+/*
+ * Find and reserve a free memory area of size 'size'. The search
+ * starts at 'start'.
+ * It must be called with mmap_lock() held.
+ * Return -1 if error.
+ */
+abi_ulong mmap_find_vma(abi_ulong start, abi_ulong size, abi_ulong align)
+{
+    while (true) {
+        abi_ulong addr = do_mmap_find_vma(start, size, align);
+        abi_ulong last, page;
+
+        if (addr == (abi_ulong)-1) {
+            return addr;
+        }
+
+        /*
+         * A concurrent munmap may have freed the area on the host before
+         * clearing the page flags.  Once it is done, the area is ours if
+         * nobody mapped it while we waited.
+         */
+        last = addr + HOST_PAGE_ALIGN(size) - 1;
+        if (!mmap_range_wait(addr, last) ||
+            page_check_range_empty(addr, last)) {
+            return addr;
+        }
+
+        /* Give back the parts of the host reservation that are still ours. */
+        if (!reserved_va) {
+            for (page = addr; page < last; page += qemu_host_page_size) {
+                if (page_check_range_empty(page,
+                                           page + qemu_host_page_size - 1)) {
+                    munmap(g2h_untagged(page), qemu_host_page_size);
+                }
+            }
+        }
+    }
+}
+
 /* NOTE: all the constants are the HOST ones */
 abi_long target_mmap(abi_ulong start, abi_ulong len, int target_prot,
                      int flags, int fd, abi_ulong offset)
@@ -565,6 +702,7 @@ abi_long target_mmap(abi_ulong start, abi_ulong len, int target_prot,
             errno = ENOMEM;
             goto fail;
         }
+        mmap_range_wait(real_start, real_end - 1);
 
         /* worst case: we cannot map the file because the offset is not
            aligned, so we read it */
@@ -672,7 +810,6 @@ static void mmap_reserve(abi_ulong start, abi_ulong size)
 {
     abi_ulong real_start;
     abi_ulong real_end;
-    abi_ulong addr;
     abi_ulong end;
     int prot;
 
@@ -681,13 +818,10 @@ static void mmap_reserve(abi_ulong start, abi_ulong size)
     end = start + size;
     if (start > real_start) {
         /* handle host page containing start */
-        prot = 0;
-        for (addr = real_start; addr < start; addr += TARGET_PAGE_SIZE) {
-            prot |= page_get_flags(addr);
-        }
+        prot = page_get_flags_range(real_start, start - 1);
         if (real_end == real_start + qemu_host_page_size) {
-            for (addr = end; addr < real_end; addr += TARGET_PAGE_SIZE) {
-                prot |= page_get_flags(addr);
+            if (end < real_end) {
+                prot |= page_get_flags_range(end, real_end - 1);
             }
             end = real_end;
         }
@@ -695,10 +829,7 @@ static void mmap_reserve(abi_ulong start, abi_ulong size)
             real_start += qemu_host_page_size;
     }
     if (end < real_end) {
-        prot = 0;
-        for (addr = end; addr < real_end; addr += TARGET_PAGE_SIZE) {
-            prot |= page_get_flags(addr);
-        }
+        prot = page_get_flags_range(end, real_end - 1);
         if (prot != 0)
             real_end -= qemu_host_page_size;
     }
@@ -711,8 +842,9 @@ static void mmap_reserve(abi_ulong start, abi_ulong size)
 
 int target_munmap(abi_ulong start, abi_ulong len)
 {
-    abi_ulong end, real_start, real_end, addr;
+    abi_ulong end, real_start, real_end;
     int prot, ret;
+    MmapRange range;
 
     trace_target_munmap(start, len);
 
@@ -723,20 +855,18 @@ int target_munmap(abi_ulong start, abi_ulong len)
         return -TARGET_EINVAL;
     }
 
-    mmap_lock();
     end = start + len;
     real_start = start & qemu_host_page_mask;
     real_end = HOST_PAGE_ALIGN(end);
+    mmap_range_lock(&range, real_start, real_end - 1);
 
+    mmap_lock();
     if (start > real_start) {
         /* handle host page containing start */
-        prot = 0;
-        for(addr = real_start; addr < start; addr += TARGET_PAGE_SIZE) {
-            prot |= page_get_flags(addr);
-        }
+        prot = page_get_flags_range(real_start, start - 1);
         if (real_end == real_start + qemu_host_page_size) {
-            for(addr = end; addr < real_end; addr += TARGET_PAGE_SIZE) {
-                prot |= page_get_flags(addr);
+            if (end < real_end) {
+                prot |= page_get_flags_range(end, real_end - 1);
             }
             end = real_end;
         }
@@ -744,13 +874,11 @@ int target_munmap(abi_ulong start, abi_ulong len)
             real_start += qemu_host_page_size;
     }
     if (end < real_end) {
-        prot = 0;
-        for(addr = end; addr < real_end; addr += TARGET_PAGE_SIZE) {
-            prot |= page_get_flags(addr);
-        }
+        prot = page_get_flags_range(end, real_end - 1);
         if (prot != 0)
             real_end -= qemu_host_page_size;
     }
+    mmap_unlock();
 
     ret = 0;
     /* unmap what we can */
@@ -762,9 +890,11 @@ int target_munmap(abi_ulong start, abi_ulong len)
         }
     }
 
+    mmap_lock();
     if (ret == 0) {
         page_set_flags(start, start + len, 0);
     }
+    mmap_range_unlock(&range);
     mmap_unlock();
     return ret;
 }
@@ -773,6 +903,7 @@ abi_long target_mremap(abi_ulong old_addr, abi_ulong old_size,
                        abi_ulong new_size, unsigned long flags,
                        abi_ulong new_addr)
 {
+    abi_ulong old_last, new_last;
     int prot;
     void *host_addr;
 
@@ -784,8 +915,16 @@ abi_long target_mremap(abi_ulong old_addr, abi_ulong old_size,
         errno = ENOMEM;
         return -1;
     }
+    old_last = HOST_PAGE_ALIGN(old_addr + MAX(old_size, new_size)) - 1;
+    new_last = HOST_PAGE_ALIGN(new_addr + new_size) - 1;
 
     mmap_lock();
+    /* Both ranges must be idle at once; waiting for one drops the lock. */
+    while (mmap_range_wait(old_addr & qemu_host_page_mask, old_last) ||
+           ((flags & MREMAP_FIXED) &&
+            mmap_range_wait(new_addr & qemu_host_page_mask, new_last))) {
+        continue;
+    }
 
     if (flags & MREMAP_FIXED) {
         host_addr = mremap(g2h_untagged(old_addr), old_size, new_size,
@@ -815,12 +954,8 @@ abi_long target_mremap(abi_ulong old_addr, abi_ulong old_size,
     } else {
         int prot = 0;
         if (reserved_va && old_size < new_size) {
-            abi_ulong addr;
-            for (addr = old_addr + old_size;
-                 addr < old_addr + new_size;
-                 addr++) {
-                prot |= page_get_flags(addr);
-            }
+            prot = page_get_flags_range(old_addr + old_size,
+                                        old_addr + new_size - 1);
         }
         if (prot == 0) {
             host_addr = mremap(g2h_untagged(old_addr),
@@ -859,19 +994,11 @@ abi_long target_mremap(abi_ulong old_addr, abi_ulong old_size,
 
 static bool can_passthrough_madvise(abi_ulong start, abi_ulong end)
 {
-    ulong addr;
-
     if ((start | end) & ~qemu_host_page_mask) {
         return false;
     }
 
-    for (addr = start; addr < end; addr += TARGET_PAGE_SIZE) {
-        if (!(page_get_flags(addr) & PAGE_PASSTHROUGH)) {
-            return false;
-        }
-    }
-
-    return true;
+    return page_check_range_flags(start, end - 1, PAGE_PASSTHROUGH);
 }
 
 abi_long target_madvise(abi_ulong start, abi_ulong len_in, int advice)
@@ -937,6 +1064,7 @@ abi_long target_madvise(abi_ulong start, abi_ulong len_in, int advice)
      * though.
      */
     mmap_lock();
+    mmap_range_wait(start & qemu_host_page_mask, HOST_PAGE_ALIGN(end) - 1);
     switch (advice) {
     case MADV_WIPEONFORK:
     case MADV_KEEPONFORK:
@@ -8746,6 +8746,73 @@ static int do_getdents64(abi_long dirfd, abi_long arg2, abi_long count)
 _syscall2(int, pivot_root, const char *, new_root, const char *, put_old)
 #endif
 
+#ifndef DEBUG_REMAP
+/*
+ * Syscalls of the form (int fd, void *buf, size_t count[, off_t offset])
+ * where the guest and the host agree on the layout of every argument.
+ * They are dispatched from this table instead of the switch in
+ * do_syscall1, and use the guest buffer in place.
+ */
+#define PASSTHROUGH_WRITES_BUF  (1 << 0)  /* otherwise buf is only read */
+#define PASSTHROUGH_FD_DATA     (1 << 1)  /* fd_trans may translate the data */
+
+typedef struct SyscallPassthrough {
+    bool valid;       /* host_nr may be 0, as __NR_read is on x86_64 */
+    uint16_t host_nr;
+    uint16_t flags;
+} SyscallPassthrough;
+
+#define PASSTHROUGH(nr, fl) { .valid = true, .host_nr = (nr), .flags = (fl) }
+
+static const SyscallPassthrough syscall_passthrough[] = {
+    [TARGET_NR_read] = PASSTHROUGH(__NR_read, PASSTHROUGH_WRITES_BUF |
+                                              PASSTHROUGH_FD_DATA),
+    [TARGET_NR_write] = PASSTHROUGH(__NR_write, PASSTHROUGH_FD_DATA),
+#if defined(TARGET_NR_pread64) && TARGET_ABI_BITS == 64 && HOST_LONG_BITS == 64
+    /* The offset is a single register, without any alignment rules. */
+    [TARGET_NR_pread64] = PASSTHROUGH(__NR_pread64, PASSTHROUGH_WRITES_BUF),
+    [TARGET_NR_pwrite64] = PASSTHROUGH(__NR_pwrite64, 0),
+#endif
+};
+
+#undef PASSTHROUGH
+
+/* Return true if @num was handled, with the result in @ret. */
+static bool do_syscall_passthrough(CPUState *cpu, int num, abi_long arg1,
+                                   abi_long arg2, abi_long arg3,
+                                   abi_long arg4, abi_long *ret)
+{
+    const SyscallPassthrough *pt;
+    void *p = NULL;
+
+    if (num < 0 || num >= ARRAY_SIZE(syscall_passthrough)) {
+        return false;
+    }
+    pt = &syscall_passthrough[num];
+    if (!pt->valid ||
+        ((pt->flags & PASSTHROUGH_FD_DATA) && fd_trans_get(arg1))) {
+        return false;
+    }
+
+    /* A NULL buffer of zero length must succeed. */
+    if (arg2 != 0 || arg3 != 0) {
+        abi_ulong addr = cpu_untagged_addr(cpu, arg2);
+        int type = (pt->flags & PASSTHROUGH_WRITES_BUF
+                    ? VERIFY_WRITE : VERIFY_READ);
+
+        if (!access_ok_untagged(type, addr, arg3)) {
+            *ret = -TARGET_EFAULT;
+            return true;
+        }
+        p = g2h_untagged(addr);
+    }
+
+    *ret = get_errno(safe_syscall(pt->host_nr, (int)arg1, p,
+                                  (size_t)arg3, (off_t)arg4));
+    return true;
+}
+#endif
+
 /* This is an internal helper for do_syscall so that it is easier
  * to have a single return point, so that actions, such as logging
  * of syscall results, can be performed.
@@ -8770,6 +8837,12 @@ static abi_long do_syscall1(CPUArchState *cpu_env, int num, abi_long arg1,
 #endif
     void *p;
 
+#ifndef DEBUG_REMAP
+    if (do_syscall_passthrough(cpu, num, arg1, arg2, arg3, arg4, &ret)) {
+        return ret;
+    }
+#endif
+
     switch(num) {
     case TARGET_NR_exit:
         /* In old applications this may be used to implement _exit(2).
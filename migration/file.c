@@ -0,0 +1,232 @@
+/*
+ * QEMU live migration to and from a file
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/cutils.h"
+#include "qapi/error.h"
+#include "exec/ramblock.h"
+#include "channel.h"
+#include "file.h"
+#include "migration.h"
+#include "io/channel-file.h"
+#include "trace.h"
+
+#define OFFSET_OPTION ",offset="
+
+static struct FileOutgoingArgs {
+    char *fname;
+} outgoing_args;
+
+/* Remove the offset option from @filespec and return it in @offsetp. */
+static int file_parse_offset(char *filespec, uint64_t *offsetp, Error **errp)
+{
+    char *option = strstr(filespec, OFFSET_OPTION);
+    int ret;
+
+    if (option) {
+        *option = 0;
+        option += sizeof(OFFSET_OPTION) - 1;
+        ret = qemu_strtosz(option, NULL, offsetp);
+        if (ret) {
+            error_setg_errno(errp, -ret, "file URI has bad offset %s", option);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void file_start_outgoing_migration(MigrationState *s, const char *filespec,
+                                   Error **errp)
+{
+    g_autofree char *filename = g_strdup(filespec);
+    QIOChannelFile *fioc;
+    QIOChannel *ioc;
+    uint64_t offset = 0;
+    int flags = O_CREAT | O_WRONLY;
+
+    trace_migration_file_outgoing(filename);
+
+    if (file_parse_offset(filename, &offset, errp)) {
+        return;
+    }
+
+    /* Keep whatever the user placed before the migration data */
+    if (!offset) {
+        flags |= O_TRUNC;
+    }
+
+    fioc = qio_channel_file_new_path(filename, flags, 0600, errp);
+    if (!fioc) {
+        return;
+    }
+
+    ioc = QIO_CHANNEL(fioc);
+    if (offset && qio_channel_io_seek(ioc, offset, SEEK_SET, errp) < 0) {
+        object_unref(OBJECT(ioc));
+        return;
+    }
+
+    g_free(outgoing_args.fname);
+    outgoing_args.fname = g_strdup(filename);
+
+    qio_channel_set_name(ioc, "migration-file-outgoing");
+    migration_channel_connect(s, ioc, NULL, NULL);
+    object_unref(OBJECT(ioc));
+}
+
+/*
+ * Open one more channel to the file of the outgoing migration, for a
+ * multifd send thread.  The file was already created by
+ * file_start_outgoing_migration(), so the task completes right away.
+ */
+void file_send_channel_create(QIOTaskFunc f, void *data)
+{
+    QIOChannelFile *ioc;
+    QIOTask *task;
+    Error *err = NULL;
+
+    ioc = qio_channel_file_new_path(outgoing_args.fname, O_WRONLY, 0, &err);
+
+    task = qio_task_new(OBJECT(ioc), f, data, NULL);
+    if (!ioc) {
+        qio_task_set_error(task, err);
+    }
+    qio_task_complete(task);
+}
+
+static gboolean file_accept_incoming_migration(QIOChannel *ioc,
+                                               GIOCondition condition,
+                                               gpointer opaque)
+{
+    migration_channel_process_incoming(ioc);
+    object_unref(OBJECT(ioc));
+    return G_SOURCE_REMOVE;
+}
+
+static void file_add_incoming_watch(QIOChannel *ioc)
+{
+    qio_channel_set_name(ioc, "migration-file-incoming");
+    qio_channel_add_watch_full(ioc, G_IO_IN,
+                               file_accept_incoming_migration,
+                               NULL, NULL,
+                               g_main_context_get_thread_default());
+}
+
+void file_start_incoming_migration(const char *filespec, Error **errp)
+{
+    g_autofree char *filename = g_strdup(filespec);
+    QIOChannelFile *fioc;
+    QIOChannel *ioc;
+    uint64_t offset = 0;
+    int i, channels = 0;
+
+    trace_migration_file_incoming(filename);
+
+    if (file_parse_offset(filename, &offset, errp)) {
+        return;
+    }
+
+    fioc = qio_channel_file_new_path(filename, O_RDONLY, 0, errp);
+    if (!fioc) {
+        return;
+    }
+
+    ioc = QIO_CHANNEL(fioc);
+    if (offset && qio_channel_io_seek(ioc, offset, SEEK_SET, errp) < 0) {
+        object_unref(OBJECT(ioc));
+        return;
+    }
+
+    /*
+     * The multifd channels only use positioned reads, so they can be
+     * opened right away.  The main channel is added first so that
+     * migration_ioc_process_incoming() sees it first.
+     */
+    if (migrate_use_multifd()) {
+        channels = migrate_multifd_channels();
+    }
+
+    file_add_incoming_watch(ioc);
+    for (i = 0; i < channels; i++) {
+        fioc = qio_channel_file_new_path(filename, O_RDONLY, 0, errp);
+        if (!fioc) {
+            return;
+        }
+        file_add_incoming_watch(QIO_CHANNEL(fioc));
+    }
+}
+
+static int file_pwrite_all(QIOChannel *ioc, const uint8_t *buf, size_t len,
+                           off_t pos, Error **errp)
+{
+    while (len) {
+        ssize_t ret = qio_channel_pwrite(ioc, (char *)buf, len, pos, errp);
+
+        if (ret < 0) {
+            return -1;
+        }
+        buf += ret;
+        pos += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+/*
+ * Write the pages described by @iov, which all belong to @block, at
+ * their place in the region of the file reserved for @block.  Pages
+ * that are contiguous in memory are written with a single call.
+ */
+int file_write_ramblock_iov(QIOChannel *ioc, const struct iovec *iov,
+                            int niov, RAMBlock *block, Error **errp)
+{
+    int i = 0;
+
+    while (i < niov) {
+        uint8_t *base = iov[i].iov_base;
+        size_t len = iov[i].iov_len;
+
+        for (i++; i < niov && (uint8_t *)iov[i].iov_base == base + len; i++) {
+            len += iov[i].iov_len;
+        }
+
+        if (file_pwrite_all(ioc, base, len,
+                            block->pages_offset + (base - block->host),
+                            errp)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Read @len bytes of @block, starting at @offset, from the region of
+ * the file reserved for @block.
+ */
+int file_read_ramblock(QIOChannel *ioc, RAMBlock *block, ram_addr_t offset,
+                       size_t len, Error **errp)
+{
+    uint8_t *buf = block->host + offset;
+    off_t pos = block->pages_offset + offset;
+
+    while (len) {
+        ssize_t ret = qio_channel_pread(ioc, (char *)buf, len, pos, errp);
+
+        if (ret < 0) {
+            return -1;
+        }
+        if (ret == 0) {
+            error_setg(errp, "Unexpected end of file reading RAM block %s",
+                       block->idstr);
+            return -1;
+        }
+        buf += ret;
+        pos += ret;
+        len -= ret;
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+/*
+ * QEMU live migration to and from a file
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef QEMU_MIGRATION_FILE_H
+#define QEMU_MIGRATION_FILE_H
+
+#include "exec/cpu-common.h"
+#include "io/task.h"
+
+void file_start_incoming_migration(const char *filespec, Error **errp);
+
+void file_start_outgoing_migration(MigrationState *s, const char *filespec,
+                                   Error **errp);
+
+void file_send_channel_create(QIOTaskFunc f, void *data);
+int file_write_ramblock_iov(QIOChannel *ioc, const struct iovec *iov,
+                            int niov, RAMBlock *block, Error **errp);
+int file_read_ramblock(QIOChannel *ioc, RAMBlock *block, ram_addr_t offset,
+                       size_t len, Error **errp);
+#endif
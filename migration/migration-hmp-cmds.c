@@ -126,6 +126,23 @@ void hmp_info_migrate(Monitor *mon, const QDict *qdict)
         }
     }
 
+    if (info->has_multifd_channels) {
+        MultiFDChannelStatsList *chan;
+
+        for (chan = info->multifd_channels; chan; chan = chan->next) {
+            monitor_printf(mon, "multifd channel %" PRIu64 ": %" PRIu64
+                           " packets, %" PRIu64 " normal pages, %" PRIu64
+                           " zero pages, %" PRIu64 " zero pages/s, %" PRIu64
+                           " ms preparing, %" PRIu64 " ms writing\n",
+                           chan->value->id, chan->value->packets,
+                           chan->value->normal_pages,
+                           chan->value->zero_pages,
+                           chan->value->zero_pages_per_second,
+                           chan->value->prepare_time,
+                           chan->value->write_time);
+        }
+    }
+
     if (info->disk) {
         monitor_printf(mon, "transferred disk: %" PRIu64 " kbytes\n",
                        info->disk->transferred >> 10);
@@ -170,6 +187,23 @@ void hmp_info_migrate(Monitor *mon, const QDict *qdict)
                        info->cpu_throttle_percentage);
     }
 
+    if (info->auto_tune) {
+        monitor_printf(mon, "auto-tune dirty rate: %" PRIu64 " bytes/s\n",
+                       info->auto_tune->dirty_rate);
+        monitor_printf(mon, "auto-tune throughput: %" PRIu64 " bytes/s\n",
+                       info->auto_tune->throughput);
+        monitor_printf(mon, "auto-tune channel usage: %u%% cpu, "
+                       "%u%% write\n",
+                       info->auto_tune->channel_cpu_usage,
+                       info->auto_tune->channel_write_usage);
+        if (info->auto_tune->has_compression_level) {
+            monitor_printf(mon, "auto-tune compression level: %" PRId64 "\n",
+                           info->auto_tune->compression_level);
+        }
+        monitor_printf(mon, "auto-tune postcopy requested: %s\n",
+                       info->auto_tune->postcopy_requested ? "on" : "off");
+    }
+
     if (info->has_postcopy_blocktime) {
         monitor_printf(mon, "postcopy blocktime: %u\n",
                        info->postcopy_blocktime);
@@ -309,6 +343,10 @@ void hmp_info_migrate_parameters(Monitor *mon, const QDict *qdict)
         monitor_printf(mon, "%s: %s\n",
             MigrationParameter_str(MIGRATION_PARAMETER_MULTIFD_COMPRESSION),
             MultiFDCompression_str(params->multifd_compression));
+        assert(params->has_zero_page_detection);
+        monitor_printf(mon, "%s: %s\n",
+            MigrationParameter_str(MIGRATION_PARAMETER_ZERO_PAGE_DETECTION),
+            ZeroPageDetection_str(params->zero_page_detection));
         monitor_printf(mon, "%s: %" PRIu64 " bytes\n",
             MigrationParameter_str(MIGRATION_PARAMETER_XBZRLE_CACHE_SIZE),
             params->xbzrle_cache_size);
@@ -557,6 +595,11 @@ void hmp_migrate_set_parameter(Monitor *mon, const QDict *qdict)
         visit_type_MultiFDCompression(v, param, &p->multifd_compression,
                                       &err);
         break;
+    case MIGRATION_PARAMETER_ZERO_PAGE_DETECTION:
+        p->has_zero_page_detection = true;
+        visit_type_ZeroPageDetection(v, param, &p->zero_page_detection,
+                                     &err);
+        break;
     case MIGRATION_PARAMETER_MULTIFD_ZLIB_LEVEL:
         p->has_multifd_zlib_level = true;
         visit_type_uint8(v, param, &p->multifd_zlib_level, &err);
@@ -565,6 +608,10 @@ void hmp_migrate_set_parameter(Monitor *mon, const QDict *qdict)
         p->has_multifd_zstd_level = true;
         visit_type_uint8(v, param, &p->multifd_zstd_level, &err);
         break;
+    case MIGRATION_PARAMETER_MULTIFD_LZ4_LEVEL:
+        p->has_multifd_lz4_level = true;
+        visit_type_uint8(v, param, &p->multifd_lz4_level, &err);
+        break;
     case MIGRATION_PARAMETER_XBZRLE_CACHE_SIZE:
         p->has_xbzrle_cache_size = true;
         if (!visit_type_size(v, param, &cache_size, &err)) {
@@ -20,6 +20,7 @@
 #include "migration/blocker.h"
 #include "exec.h"
 #include "fd.h"
+#include "file.h"
 #include "socket.h"
 #include "sysemu/runstate.h"
 #include "sysemu/sysemu.h"
@@ -93,6 +94,18 @@
 #define DEFAULT_MIGRATE_CPU_THROTTLE_INCREMENT 10
 #define DEFAULT_MIGRATE_MAX_CPU_THROTTLE 99
 
+/* How often the auto-tune controller runs (ms) */
+#define AUTO_TUNE_PERIOD 1000
+/*
+ * Lower the compression level when the multifd channels spend more than
+ * this percentage of their time compressing, and raise it when they
+ * spend less, while waiting for the link more than this percentage.
+ */
+#define AUTO_TUNE_CPU_HIGH 80
+#define AUTO_TUNE_CPU_LOW 50
+/* Periods that the maximum throttle does not converge before postcopy */
+#define AUTO_TUNE_STALL_PERIODS 3
+
 /* Migration XBZRLE default cache size */
 #define DEFAULT_MIGRATE_XBZRLE_CACHE_SIZE (64 * 1024 * 1024)
 
@@ -104,6 +117,9 @@
 #define DEFAULT_MIGRATE_MULTIFD_ZLIB_LEVEL 1
 /* 0: means nocompress, 1: best speed, ... 20: best compress ratio */
 #define DEFAULT_MIGRATE_MULTIFD_ZSTD_LEVEL 1
+/* 0: means fast lz4, 1: lz4hc best speed, ... 12: best compress ratio */
+#define DEFAULT_MIGRATE_MULTIFD_LZ4_LEVEL 0
+#define DEFAULT_MIGRATE_ZERO_PAGE_DETECTION ZERO_PAGE_DETECTION_MULTIFD
 
 /* Background transfer rate for postcopy, 0 means unlimited, note
  * that page requests can still exceed this limit.
@@ -161,6 +177,7 @@ INITIALIZE_MIGRATE_CAPS_SET(check_caps_background_snapshot,
     MIGRATION_CAPABILITY_MULTIFD,
     MIGRATION_CAPABILITY_PAUSE_BEFORE_SWITCHOVER,
     MIGRATION_CAPABILITY_AUTO_CONVERGE,
+    MIGRATION_CAPABILITY_AUTO_TUNE,
     MIGRATION_CAPABILITY_RELEASE_RAM,
     MIGRATION_CAPABILITY_RDMA_PIN_ALL,
     MIGRATION_CAPABILITY_COMPRESS,
@@ -192,7 +209,8 @@ static bool migration_needs_multiple_sockets(void)
 static bool uri_supports_multi_channels(const char *uri)
 {
     return strstart(uri, "tcp:", NULL) || strstart(uri, "unix:", NULL) ||
-           strstart(uri, "vsock:", NULL);
+           strstart(uri, "vsock:", NULL) ||
+           (migrate_mapped_ram() && strstart(uri, "file:", NULL));
 }
 
 static bool
@@ -204,6 +222,17 @@ migration_channels_and_uri_compatible(const char *uri, Error **errp)
         return false;
     }
 
+    if (migrate_mapped_ram() && !strstart(uri, "file:", NULL)) {
+        error_setg(errp, "Migration with mapped-ram requires a file: URI");
+        return false;
+    }
+
+    if (migrate_mapped_ram() && migrate_use_tls()) {
+        error_setg(errp, "Migration with mapped-ram is not compatible"
+                   " with TLS");
+        return false;
+    }
+
     return true;
 }
 
@@ -526,6 +555,8 @@ static void qemu_start_incoming_migration(const char *uri, Error **errp)
         exec_start_incoming_migration(p, errp);
     } else if (strstart(uri, "fd:", &p)) {
         fd_start_incoming_migration(p, errp);
+    } else if (strstart(uri, "file:", &p)) {
+        file_start_incoming_migration(p, errp);
     } else {
         error_setg(errp, "unknown migration protocol: %s", uri);
     }
@@ -994,6 +1025,10 @@ MigrationParameters *qmp_query_migrate_parameters(Error **errp)
     params->multifd_zlib_level = s->parameters.multifd_zlib_level;
     params->has_multifd_zstd_level = true;
     params->multifd_zstd_level = s->parameters.multifd_zstd_level;
+    params->has_multifd_lz4_level = true;
+    params->multifd_lz4_level = s->parameters.multifd_lz4_level;
+    params->has_zero_page_detection = true;
+    params->zero_page_detection = s->parameters.zero_page_detection;
     params->has_xbzrle_cache_size = true;
     params->xbzrle_cache_size = s->parameters.xbzrle_cache_size;
     params->has_max_postcopy_bandwidth = true;
@@ -1159,6 +1194,9 @@ static void populate_ram_info(MigrationInfo *info, MigrationState *s)
     info->ram->downtime_bytes = ram_counters.downtime_bytes;
     info->ram->postcopy_bytes = stat64_get(&ram_atomic_counters.postcopy_bytes);
 
+    info->multifd_channels = multifd_query_send_channels();
+    info->has_multifd_channels = info->multifd_channels != NULL;
+
     if (migrate_use_xbzrle()) {
         info->xbzrle_cache = g_malloc0(sizeof(*info->xbzrle_cache));
         info->xbzrle_cache->cache_size = migrate_xbzrle_cache_size();
@@ -1186,6 +1224,22 @@ static void populate_ram_info(MigrationInfo *info, MigrationState *s)
         info->cpu_throttle_percentage = cpu_throttle_get_percentage();
     }
 
+    if (migrate_auto_tune()) {
+        MigrationAutoTune *at = &s->auto_tune;
+
+        info->auto_tune = g_malloc0(sizeof(*info->auto_tune));
+        info->auto_tune->dirty_rate = at->dirty_rate;
+        info->auto_tune->throughput = at->throughput;
+        info->auto_tune->channel_cpu_usage = at->channel_cpu_usage;
+        info->auto_tune->channel_write_usage = at->channel_write_usage;
+        if (migrate_use_multifd() && migrate_multifd_compression()) {
+            info->auto_tune->has_compression_level = true;
+            info->auto_tune->compression_level =
+                migrate_multifd_compression_level();
+        }
+        info->auto_tune->postcopy_requested = at->postcopy_requested;
+    }
+
     if (s->state != MIGRATION_STATUS_COMPLETED) {
         info->ram->remaining = ram_bytes_remaining();
         info->ram->dirty_pages_rate = ram_counters.dirty_pages_rate;
@@ -1428,6 +1482,24 @@ static bool migrate_caps_check(bool *cap_list,
         }
     }
 
+    if (cap_list[MIGRATION_CAPABILITY_MAPPED_RAM]) {
+        /*
+         * Every page has a single place in the file, so only the page
+         * contents can be written there.
+         */
+        if (cap_list[MIGRATION_CAPABILITY_XBZRLE] ||
+            cap_list[MIGRATION_CAPABILITY_COMPRESS] ||
+            cap_list[MIGRATION_CAPABILITY_POSTCOPY_RAM] ||
+            cap_list[MIGRATION_CAPABILITY_X_COLO] ||
+            cap_list[MIGRATION_CAPABILITY_BACKGROUND_SNAPSHOT] ||
+            cap_list[MIGRATION_CAPABILITY_ZERO_COPY_SEND] ||
+            migrate_multifd_compression()) {
+            error_setg(errp, "Mapped-ram is only available for "
+                       "non-compressed precopy migration");
+            return false;
+        }
+    }
+
     if (cap_list[MIGRATION_CAPABILITY_MULTIFD]) {
         if (cap_list[MIGRATION_CAPABILITY_COMPRESS]) {
             error_setg(errp, "Multifd is not compatible with compress");
@@ -1435,6 +1507,13 @@ static bool migrate_caps_check(bool *cap_list,
         }
     }
 
+    /* Both would throttle the guest */
+    if (cap_list[MIGRATION_CAPABILITY_AUTO_TUNE] &&
+        cap_list[MIGRATION_CAPABILITY_AUTO_CONVERGE]) {
+        error_setg(errp, "Auto-tune is not compatible with auto-converge");
+        return false;
+    }
+
     return true;
 }
 
@@ -1596,6 +1675,13 @@ static bool migrate_params_check(MigrationParameters *params, Error **errp)
         return false;
     }
 
+    if (params->has_multifd_lz4_level &&
+        (params->multifd_lz4_level > 12)) {
+        error_setg(errp, QERR_INVALID_PARAMETER_VALUE, "multifd_lz4_level",
+                   "a value between 0 and 12");
+        return false;
+    }
+
     if (params->has_xbzrle_cache_size &&
         (params->xbzrle_cache_size < qemu_target_page_size() ||
          !is_power_of_2(params->xbzrle_cache_size))) {
@@ -1660,6 +1746,13 @@ static bool migrate_params_check(MigrationParameters *params, Error **errp)
     }
 #endif
 
+    if (migrate_mapped_ram() &&
+        params->has_multifd_compression && params->multifd_compression) {
+        error_setg(errp, "Mapped-ram is only available for "
+                   "non-compressed precopy migration");
+        return false;
+    }
+
     return true;
 }
 
@@ -1733,6 +1826,12 @@ static void migrate_params_test_apply(MigrateSetParameters *params,
     if (params->has_multifd_compression) {
         dest->multifd_compression = params->multifd_compression;
     }
+    if (params->has_multifd_lz4_level) {
+        dest->multifd_lz4_level = params->multifd_lz4_level;
+    }
+    if (params->has_zero_page_detection) {
+        dest->zero_page_detection = params->zero_page_detection;
+    }
     if (params->has_xbzrle_cache_size) {
         dest->xbzrle_cache_size = params->xbzrle_cache_size;
     }
@@ -1845,6 +1944,12 @@ static void migrate_params_apply(MigrateSetParameters *params, Error **errp)
     if (params->has_multifd_compression) {
         s->parameters.multifd_compression = params->multifd_compression;
     }
+    if (params->has_multifd_lz4_level) {
+        s->parameters.multifd_lz4_level = params->multifd_lz4_level;
+    }
+    if (params->has_zero_page_detection) {
+        s->parameters.zero_page_detection = params->zero_page_detection;
+    }
     if (params->has_xbzrle_cache_size) {
         s->parameters.xbzrle_cache_size = params->xbzrle_cache_size;
         xbzrle_cache_resize(params->xbzrle_cache_size, errp);
@@ -2252,6 +2357,8 @@ void migrate_init(MigrationState *s)
     s->expected_downtime = 0;
     s->setup_time = 0;
     s->start_postcopy = false;
+    memset(&s->auto_tune, 0, sizeof(s->auto_tune));
+    s->auto_tune.compression_level = -1;
     s->postcopy_after_devices = false;
     s->migration_thread_running = false;
     error_free(s->error);
@@ -2523,6 +2630,8 @@ void qmp_migrate(const char *uri, bool has_blk, bool blk,
         exec_start_outgoing_migration(s, p, &local_err);
     } else if (strstart(uri, "fd:", &p)) {
         fd_start_outgoing_migration(s, p, &local_err);
+    } else if (strstart(uri, "file:", &p)) {
+        file_start_outgoing_migration(s, p, &local_err);
     } else {
         if (!(has_resume && resume)) {
             yank_unregister_instance(MIGRATION_YANK_INSTANCE);
@@ -2748,6 +2857,74 @@ int migrate_multifd_zstd_level(void)
     return s->parameters.multifd_zstd_level;
 }
 
+int migrate_multifd_lz4_level(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->parameters.multifd_lz4_level;
+}
+
+/*
+ * The range of levels that auto-tune may pick for the multifd
+ * compression method: from the fastest one to the configured one.
+ */
+static void migrate_multifd_compression_levels(MigrationState *s,
+                                               int *min, int *max)
+{
+    switch (s->parameters.multifd_compression) {
+    case MULTIFD_COMPRESSION_ZLIB:
+        /* level 0 does not compress at all */
+        *min = 1;
+        *max = s->parameters.multifd_zlib_level;
+        break;
+#ifdef CONFIG_ZSTD
+    case MULTIFD_COMPRESSION_ZSTD:
+        /* level 0 is the zstd default level */
+        *min = 1;
+        *max = s->parameters.multifd_zstd_level;
+        break;
+#endif
+#ifdef CONFIG_LZ4
+    case MULTIFD_COMPRESSION_LZ4:
+        *min = 0;
+        *max = s->parameters.multifd_lz4_level;
+        break;
+#endif
+    default:
+        *min = *max = 0;
+        break;
+    }
+    *min = MIN(*min, *max);
+}
+
+/*
+ * The level that the multifd channels compress with: the one configured
+ * for the compression method, or a lower one picked by auto-tune.
+ */
+int migrate_multifd_compression_level(void)
+{
+    MigrationState *s = migrate_get_current();
+    int level = qatomic_read(&s->auto_tune.compression_level);
+    int min, max;
+
+    migrate_multifd_compression_levels(s, &min, &max);
+    if (!migrate_auto_tune() || level < 0) {
+        return max;
+    }
+    return MIN(level, max);
+}
+
+ZeroPageDetection migrate_zero_page_detection(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->parameters.zero_page_detection;
+}
+
 #ifdef CONFIG_LINUX
 bool migrate_use_zero_copy_send(void)
 {
@@ -2840,6 +3017,24 @@ bool migrate_postcopy_preempt(void)
     return s->enabled_capabilities[MIGRATION_CAPABILITY_POSTCOPY_PREEMPT];
 }
 
+bool migrate_mapped_ram(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->enabled_capabilities[MIGRATION_CAPABILITY_MAPPED_RAM];
+}
+
+bool migrate_auto_tune(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->enabled_capabilities[MIGRATION_CAPABILITY_AUTO_TUNE];
+}
+
 /* migration thread support */
 /*
  * Something bad happened to the RP stream, mark an error
@@ -3809,6 +4004,146 @@ static void update_iteration_initial_status(MigrationState *s)
     s->iteration_initial_pages = ram_get_total_transferred_pages();
 }
 
+/*
+ * Lower the compression level when the multifd channels are short of
+ * CPU, and raise it back when they have CPU to spare but wait for the
+ * link, since better compression then sends more pages per second.
+ */
+static void migration_auto_tune_compression(MigrationState *s)
+{
+    MigrationAutoTune *at = &s->auto_tune;
+    int old_level = migrate_multifd_compression_level();
+    int level = old_level;
+    int min, max;
+
+    migrate_multifd_compression_levels(s, &min, &max);
+    if (at->channel_cpu_usage > AUTO_TUNE_CPU_HIGH) {
+        level = MAX(level - 1, min);
+    } else if (at->channel_cpu_usage < AUTO_TUNE_CPU_LOW &&
+               at->channel_write_usage > AUTO_TUNE_CPU_LOW) {
+        level = MIN(level + 1, max);
+    }
+
+    if (level != old_level) {
+        trace_migration_auto_tune_compression(old_level, level);
+    }
+    qatomic_set(&at->compression_level, level);
+}
+
+/*
+ * Throttle the guest so that it dirties memory at no more than half the
+ * throughput, which at least halves the remaining memory at each pass,
+ * and release the throttle when it is not needed anymore.  If even the
+ * maximum throttle does not let precopy converge, switch to postcopy.
+ */
+static void migration_auto_tune_throttle(MigrationState *s)
+{
+    MigrationAutoTune *at = &s->auto_tune;
+    int pct_now = cpu_throttle_active() ? cpu_throttle_get_percentage() : 0;
+    int pct_max = s->parameters.max_cpu_throttle;
+    int pct_step = s->parameters.cpu_throttle_increment;
+    uint64_t target = at->throughput / 2;
+    int pct = pct_now;
+
+    if (!at->throughput) {
+        return;
+    }
+    /* What is left can be sent within the downtime limit */
+    if (ram_counters.remaining <=
+        at->throughput * s->parameters.downtime_limit / 1000) {
+        at->stalled_periods = 0;
+        return;
+    }
+
+    if (at->dirty_rate > target) {
+        /*
+         * The dirty rate scales with the time that the vCPUs run, which
+         * gives the throttle for the target, but approach it by steps
+         * since the measured dirty rate lags behind.
+         */
+        pct = 100 - (100 - pct_now) * target / at->dirty_rate;
+        pct = MIN(pct, pct_now + pct_step);
+    } else if (at->dirty_rate < target / 2) {
+        pct = MAX(pct_now - pct_step, 0);
+    }
+    pct = MIN(pct, pct_max);
+
+    if (pct != pct_now) {
+        trace_migration_auto_tune_throttle(pct_now, pct);
+        if (pct) {
+            cpu_throttle_set(pct);
+        } else {
+            cpu_throttle_stop();
+        }
+    }
+
+    if (pct_now < pct_max || at->dirty_rate < at->throughput) {
+        at->stalled_periods = 0;
+    } else if (++at->stalled_periods >= AUTO_TUNE_STALL_PERIODS &&
+               migrate_postcopy_ram() && !at->postcopy_requested) {
+        trace_migration_auto_tune_postcopy(at->dirty_rate, at->throughput);
+        at->postcopy_requested = true;
+        qatomic_set(&s->start_postcopy, true);
+    }
+}
+
+/*
+ * The auto-tune controller: measure the dirty rate, the throughput and
+ * how busy the multifd channels are, then adjust the compression level
+ * and the guest throttle.
+ */
+static void migration_auto_tune(MigrationState *s, int64_t current_time)
+{
+    MigrationAutoTune *at = &s->auto_tune;
+    uint64_t bytes = migration_total_bytes(s);
+    uint64_t prepare_ns, write_ns;
+    int64_t period = current_time - at->last_time;
+
+    if (!migrate_auto_tune() || s->state != MIGRATION_STATUS_ACTIVE) {
+        return;
+    }
+    if (at->last_time && period < AUTO_TUNE_PERIOD) {
+        return;
+    }
+
+    multifd_send_busy_time(&prepare_ns, &write_ns);
+    if (at->last_time) {
+        at->throughput = (bytes - at->last_bytes) * 1000 / period;
+        /* Updated at every bitmap sync, itself at least 1s apart */
+        at->dirty_rate = ram_counters.dirty_pages_rate *
+                         qemu_target_page_size();
+        if (migrate_use_multifd()) {
+            uint64_t channels_ns = migrate_multifd_channels() *
+                                   period * SCALE_MS;
+
+            at->channel_cpu_usage =
+                MIN((prepare_ns - at->last_prepare_ns) * 100 / channels_ns,
+                    100);
+            at->channel_write_usage =
+                MIN((write_ns - at->last_write_ns) * 100 / channels_ns, 100);
+        }
+        trace_migration_auto_tune(at->dirty_rate, at->throughput,
+                                  at->channel_cpu_usage,
+                                  at->channel_write_usage);
+
+        if (migrate_use_multifd()) {
+            migration_auto_tune_compression(s);
+        }
+        /*
+         * The dirty rate is only known after the first pass, and the
+         * bulk phase of block migration makes little RAM progress.
+         */
+        if (ram_counters.dirty_sync_count > 1 && !blk_mig_bulk_active()) {
+            migration_auto_tune_throttle(s);
+        }
+    }
+
+    at->last_time = current_time;
+    at->last_bytes = bytes;
+    at->last_prepare_ns = prepare_ns;
+    at->last_write_ns = write_ns;
+}
+
 static void migration_update_counters(MigrationState *s,
                                       int64_t current_time)
 {
@@ -3834,6 +4169,8 @@ static void migration_update_counters(MigrationState *s,
     s->pages_per_second = (double) transferred_pages /
                              (((double) time_spent / 1000.0));
 
+    multifd_update_counters(time_spent);
+
     /*
      * if we haven't sent anything, we don't want to
      * recalculate. 10000 is a small enough number for our purposes
@@ -3844,6 +4181,8 @@ static void migration_update_counters(MigrationState *s,
 
     qemu_file_reset_rate_limit(s->to_dst_file);
 
+    migration_auto_tune(s, current_time);
+
     update_iteration_initial_status(s);
 
     trace_migrate_transferred(transferred, time_spent,
@@ -3899,7 +4238,7 @@ static MigIterateState migration_iteration_run(MigrationState *s)
 
 static void migration_iteration_finish(MigrationState *s)
 {
-    /* If we enabled cpu throttling for auto-converge, turn it off. */
+    /* Turn off the cpu throttling of auto-converge or auto-tune, if any. */
     cpu_throttle_stop();
 
     qemu_mutex_lock_iothread();
@@ -4487,6 +4826,12 @@ static Property migration_properties[] = {
     DEFINE_PROP_UINT8("multifd-zstd-level", MigrationState,
                       parameters.multifd_zstd_level,
                       DEFAULT_MIGRATE_MULTIFD_ZSTD_LEVEL),
+    DEFINE_PROP_UINT8("multifd-lz4-level", MigrationState,
+                      parameters.multifd_lz4_level,
+                      DEFAULT_MIGRATE_MULTIFD_LZ4_LEVEL),
+    DEFINE_PROP_ZERO_PAGE_DETECTION("zero-page-detection", MigrationState,
+                      parameters.zero_page_detection,
+                      DEFAULT_MIGRATE_ZERO_PAGE_DETECTION),
     DEFINE_PROP_SIZE("xbzrle-cache-size", MigrationState,
                       parameters.xbzrle_cache_size,
                       DEFAULT_MIGRATE_XBZRLE_CACHE_SIZE),
@@ -4533,6 +4878,8 @@ static Property migration_properties[] = {
     DEFINE_PROP_MIG_CAP("x-zero-copy-send",
             MIGRATION_CAPABILITY_ZERO_COPY_SEND),
 #endif
+    DEFINE_PROP_MIG_CAP("x-mapped-ram", MIGRATION_CAPABILITY_MAPPED_RAM),
+    DEFINE_PROP_MIG_CAP("x-auto-tune", MIGRATION_CAPABILITY_AUTO_TUNE),
 
     DEFINE_PROP_END_OF_LIST(),
 };
@@ -4593,6 +4940,8 @@ static void migration_instance_init(Object *obj)
     params->has_multifd_compression = true;
     params->has_multifd_zlib_level = true;
     params->has_multifd_zstd_level = true;
+    params->has_multifd_lz4_level = true;
+    params->has_zero_page_detection = true;
     params->has_xbzrle_cache_size = true;
     params->has_max_postcopy_bandwidth = true;
     params->has_max_cpu_throttle = true;
@@ -203,6 +203,27 @@ void migration_incoming_transport_cleanup(MigrationIncomingState *mis);
  */
 void fill_destination_postcopy_migration_info(MigrationInfo *info);
 
+/* State of the auto-tune controller, only used by the migration thread */
+typedef struct MigrationAutoTune {
+    /* Time of the last measurement (ms) */
+    int64_t last_time;
+    /* migration_total_bytes() at the last measurement */
+    uint64_t last_bytes;
+    /* Busy time of the multifd send channels at the last measurement */
+    uint64_t last_prepare_ns;
+    uint64_t last_write_ns;
+    /* Measured during the last period, see MigrationAutoTuneInfo */
+    uint64_t dirty_rate;
+    uint64_t throughput;
+    uint8_t channel_cpu_usage;
+    uint8_t channel_write_usage;
+    /* Compression level for the multifd channels, read by them */
+    int compression_level;
+    /* Periods in a row that the maximum throttle did not converge */
+    int stalled_periods;
+    bool postcopy_requested;
+} MigrationAutoTune;
+
 #define TYPE_MIGRATION "migration"
 
 typedef struct MigrationClass MigrationClass;
@@ -310,6 +331,8 @@ struct MigrationState {
 
     /* Flag set once the migration has been asked to enter postcopy */
     bool start_postcopy;
+    /* The auto-tune controller, when the capability is on */
+    MigrationAutoTune auto_tune;
     /* Flag set after postcopy has sent the device state */
     bool postcopy_after_devices;
 
@@ -424,6 +447,9 @@ int migrate_multifd_channels(void);
 MultiFDCompression migrate_multifd_compression(void);
 int migrate_multifd_zlib_level(void);
 int migrate_multifd_zstd_level(void);
+int migrate_multifd_lz4_level(void);
+int migrate_multifd_compression_level(void);
+ZeroPageDetection migrate_zero_page_detection(void);
 
 #ifdef CONFIG_LINUX
 bool migrate_use_zero_copy_send(void);
@@ -451,6 +477,8 @@ bool migrate_use_events(void);
 bool migrate_postcopy_blocktime(void);
 bool migrate_background_snapshot(void);
 bool migrate_postcopy_preempt(void);
+bool migrate_mapped_ram(void);
+bool migrate_auto_tune(void);
 
 /* Sending on the return path - generic and then for each message type */
 void migrate_send_rp_shut(MigrationIncomingState *mis,
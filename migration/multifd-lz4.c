@@ -0,0 +1,288 @@
+/*
+ * Multifd lz4 compression implementation
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include <lz4.h>
+#include <lz4hc.h>
+#include "qemu/bswap.h"
+#include "qemu/rcu.h"
+#include "exec/ramblock.h"
+#include "exec/target_page.h"
+#include "qapi/error.h"
+#include "migration.h"
+#include "trace.h"
+#include "multifd.h"
+
+/*
+ * Each page is compressed on its own, so that pages can be decompressed
+ * straight into guest memory.  In the packet, every page is preceded by
+ * its compressed size as a big endian 32 bit value.  Pages that do not
+ * shrink are sent as they are, and their size is then the page size.
+ */
+#define LZ4_PAGE_HDR_SIZE sizeof(uint32_t)
+
+struct lz4_data {
+    /* compression state, large enough for both lz4 and lz4hc */
+    void *state;
+    /* compressed buffer */
+    uint8_t *zbuff;
+    /* size of compressed buffer */
+    uint32_t zbuff_len;
+};
+
+static uint32_t lz4_buff_len(void)
+{
+    uint32_t page_count = MULTIFD_PACKET_SIZE / qemu_target_page_size();
+
+    return MULTIFD_PACKET_SIZE + page_count * LZ4_PAGE_HDR_SIZE;
+}
+
+/* Multifd lz4 compression */
+
+/**
+ * lz4_send_setup: setup send side
+ *
+ * Setup each channel with lz4 compression.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static int lz4_send_setup(MultiFDSendParams *p, Error **errp)
+{
+    struct lz4_data *z = g_new0(struct lz4_data, 1);
+
+    p->data = z;
+    /* auto-tune can switch between lz4 and lz4hc at any packet */
+    z->state = g_try_malloc(MAX(LZ4_sizeofState(), LZ4_sizeofStateHC()));
+    if (!z->state) {
+        g_free(z);
+        error_setg(errp, "multifd %u: out of memory for lz4 state", p->id);
+        return -1;
+    }
+
+    z->zbuff_len = lz4_buff_len();
+    z->zbuff = g_try_malloc(z->zbuff_len);
+    if (!z->zbuff) {
+        g_free(z->state);
+        g_free(z);
+        error_setg(errp, "multifd %u: out of memory for zbuff", p->id);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * lz4_send_cleanup: cleanup send side
+ *
+ * Close the channel and return memory.
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static void lz4_send_cleanup(MultiFDSendParams *p, Error **errp)
+{
+    struct lz4_data *z = p->data;
+
+    g_free(z->state);
+    z->state = NULL;
+    g_free(z->zbuff);
+    z->zbuff = NULL;
+    g_free(p->data);
+    p->data = NULL;
+}
+
+/**
+ * lz4_send_prepare: prepare date to be able to send
+ *
+ * Create a compressed buffer with all the pages that we are going to
+ * send.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static int lz4_send_prepare(MultiFDSendParams *p, Error **errp)
+{
+    struct lz4_data *z = p->data;
+    int level = migrate_multifd_compression_level();
+    uint32_t pos = 0;
+    uint32_t i;
+
+    for (i = 0; i < p->normal_num; i++) {
+        const char *page = (char *)p->pages->block->host + p->normal[i];
+        char *dst = (char *)z->zbuff + pos + LZ4_PAGE_HDR_SIZE;
+        int ret;
+
+        if (pos + LZ4_PAGE_HDR_SIZE + p->page_size > z->zbuff_len) {
+            error_setg(errp, "multifd %u: compressed buffer too small",
+                       p->id);
+            return -1;
+        }
+
+        /*
+         * Only accept output that is smaller than a page, so that the
+         * receiver can tell compressed pages from raw ones by their size.
+         */
+        if (level) {
+            ret = LZ4_compress_HC_extStateHC(z->state, page, dst,
+                                             p->page_size, p->page_size - 1,
+                                             level);
+        } else {
+            ret = LZ4_compress_fast_extState(z->state, page, dst,
+                                             p->page_size, p->page_size - 1,
+                                             1);
+        }
+        if (ret <= 0) {
+            memcpy(dst, page, p->page_size);
+            ret = p->page_size;
+        }
+        stl_be_p(z->zbuff + pos, ret);
+        pos += LZ4_PAGE_HDR_SIZE + ret;
+    }
+    p->iov[p->iovs_num].iov_base = z->zbuff;
+    p->iov[p->iovs_num].iov_len = pos;
+    p->iovs_num++;
+    p->next_packet_size = pos;
+    p->flags |= MULTIFD_FLAG_LZ4;
+
+    return 0;
+}
+
+/**
+ * lz4_recv_setup: setup receive side
+ *
+ * Create the compressed buffer.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static int lz4_recv_setup(MultiFDRecvParams *p, Error **errp)
+{
+    struct lz4_data *z = g_new0(struct lz4_data, 1);
+
+    p->data = z;
+    z->zbuff_len = lz4_buff_len();
+    z->zbuff = g_try_malloc(z->zbuff_len);
+    if (!z->zbuff) {
+        g_free(z);
+        error_setg(errp, "multifd %u: out of memory for zbuff", p->id);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * lz4_recv_cleanup: cleanup receive side
+ *
+ * Return the memory of the compressed buffer.
+ *
+ * @p: Params for the channel that we are using
+ */
+static void lz4_recv_cleanup(MultiFDRecvParams *p)
+{
+    struct lz4_data *z = p->data;
+
+    g_free(z->zbuff);
+    z->zbuff = NULL;
+    g_free(p->data);
+    p->data = NULL;
+}
+
+/**
+ * lz4_recv_pages: read the data from the channel into actual pages
+ *
+ * Read the compressed buffer, and uncompress it into the actual
+ * pages.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static int lz4_recv_pages(MultiFDRecvParams *p, Error **errp)
+{
+    uint32_t in_size = p->next_packet_size;
+    uint32_t flags = p->flags & MULTIFD_FLAG_COMPRESSION_MASK;
+    struct lz4_data *z = p->data;
+    uint32_t pos = 0;
+    int ret;
+    int i;
+
+    if (flags != MULTIFD_FLAG_LZ4) {
+        error_setg(errp, "multifd %u: flags received %x flags expected %x",
+                   p->id, flags, MULTIFD_FLAG_LZ4);
+        return -1;
+    }
+    if (in_size > z->zbuff_len) {
+        error_setg(errp, "multifd %u: packet size received %u size max %u",
+                   p->id, in_size, z->zbuff_len);
+        return -1;
+    }
+    ret = qio_channel_read_all(p->c, (void *)z->zbuff, in_size, errp);
+
+    if (ret != 0) {
+        return ret;
+    }
+
+    for (i = 0; i < p->normal_num; i++) {
+        char *page = (char *)p->host + p->normal[i];
+        uint32_t len;
+
+        if (in_size - pos < LZ4_PAGE_HDR_SIZE) {
+            error_setg(errp, "multifd %u: missing header of page %d",
+                       p->id, i);
+            return -1;
+        }
+        len = ldl_be_p(z->zbuff + pos);
+        pos += LZ4_PAGE_HDR_SIZE;
+        if (len > p->page_size || len > in_size - pos) {
+            error_setg(errp, "multifd %u: page %d has invalid size %u",
+                       p->id, i, len);
+            return -1;
+        }
+
+        if (len == p->page_size) {
+            memcpy(page, z->zbuff + pos, len);
+        } else {
+            ret = LZ4_decompress_safe((char *)z->zbuff + pos, page, len,
+                                      p->page_size);
+            if (ret != p->page_size) {
+                error_setg(errp, "multifd %u: page %d decompressed to %d "
+                           "bytes, expected %u", p->id, i, ret, p->page_size);
+                return -1;
+            }
+        }
+        pos += len;
+    }
+    if (pos != in_size) {
+        error_setg(errp, "multifd %u: packet size received %u size used %u",
+                   p->id, in_size, pos);
+        return -1;
+    }
+    return 0;
+}
+
+static MultiFDMethods multifd_lz4_ops = {
+    .send_setup = lz4_send_setup,
+    .send_cleanup = lz4_send_cleanup,
+    .send_prepare = lz4_send_prepare,
+    .recv_setup = lz4_recv_setup,
+    .recv_cleanup = lz4_recv_cleanup,
+    .recv_pages = lz4_recv_pages
+};
+
+static void multifd_lz4_register(void)
+{
+    multifd_register_ops(MULTIFD_COMPRESSION_LZ4, &multifd_lz4_ops);
+}
+
+migration_init(multifd_lz4_register);
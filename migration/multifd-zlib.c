@@ -29,6 +29,8 @@ struct zlib_data {
     uint32_t zbuff_len;
     /* uncompressed buffer of size qemu_target_page_size() */
     uint8_t *buf;
+    /* compression level of the stream */
+    int level;
 };
 
 /* Multifd zlib compression */
@@ -52,7 +54,8 @@ static int zlib_send_setup(MultiFDSendParams *p, Error **errp)
     zs->zalloc = Z_NULL;
     zs->zfree = Z_NULL;
     zs->opaque = Z_NULL;
-    if (deflateInit(zs, migrate_multifd_zlib_level()) != Z_OK) {
+    z->level = migrate_multifd_compression_level();
+    if (deflateInit(zs, z->level) != Z_OK) {
         err_msg = "deflate init failed";
         goto err_free_z;
     }
@@ -118,9 +121,22 @@ static int zlib_send_prepare(MultiFDSendParams *p, Error **errp)
     struct zlib_data *z = p->data;
     z_stream *zs = &z->zs;
     uint32_t out_size = 0;
+    int level = migrate_multifd_compression_level();
     int ret;
     uint32_t i;
 
+    /*
+     * auto-tune may have changed the level.  The previous packet ended
+     * with a flush, so deflateParams() has no pending data to compress.
+     */
+    if (level != z->level) {
+        if (deflateParams(zs, level, Z_DEFAULT_STRATEGY) != Z_OK) {
+            error_setg(errp, "multifd %u: deflateParams failed", p->id);
+            return -1;
+        }
+        z->level = level;
+    }
+
     for (i = 0; i < p->normal_num; i++) {
         uint32_t available = z->zbuff_len - out_size;
         int flush = Z_NO_FLUSH;
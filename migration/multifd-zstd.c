@@ -32,6 +32,8 @@ struct zstd_data {
     uint8_t *zbuff;
     /* size of compressed buffer */
     uint32_t zbuff_len;
+    /* compression level of the stream */
+    int level;
 };
 
 /* Multifd zstd compression */
@@ -59,7 +61,8 @@ static int zstd_send_setup(MultiFDSendParams *p, Error **errp)
         return -1;
     }
 
-    res = ZSTD_initCStream(z->zcs, migrate_multifd_zstd_level());
+    z->level = migrate_multifd_compression_level();
+    res = ZSTD_initCStream(z->zcs, z->level);
     if (ZSTD_isError(res)) {
         ZSTD_freeCStream(z->zcs);
         g_free(z);
@@ -67,8 +70,12 @@ static int zstd_send_setup(MultiFDSendParams *p, Error **errp)
                    p->id, ZSTD_getErrorName(res));
         return -1;
     }
-    /* This is the maxium size of the compressed buffer */
-    z->zbuff_len = ZSTD_compressBound(MULTIFD_PACKET_SIZE);
+    /*
+     * This is the maxium size of the compressed buffer, plus room for
+     * the end of the previous frame when the level changes.
+     */
+    z->zbuff_len = ZSTD_compressBound(MULTIFD_PACKET_SIZE) +
+                   ZSTD_compressBound(0);
     z->zbuff = g_try_malloc(z->zbuff_len);
     if (!z->zbuff) {
         ZSTD_freeCStream(z->zcs);
@@ -113,6 +120,7 @@ static void zstd_send_cleanup(MultiFDSendParams *p, Error **errp)
 static int zstd_send_prepare(MultiFDSendParams *p, Error **errp)
 {
     struct zstd_data *z = p->data;
+    int level = migrate_multifd_compression_level();
     int ret;
     uint32_t i;
 
@@ -120,6 +128,39 @@ static int zstd_send_prepare(MultiFDSendParams *p, Error **errp)
     z->out.size = z->zbuff_len;
     z->out.pos = 0;
 
+    /*
+     * auto-tune may have changed the level.  zstd only applies a new
+     * level at the start of a frame, and the packets are otherwise all
+     * part of one frame, so end it first.  The receiver decompresses the
+     * frames one after the other.
+     */
+    if (level != z->level) {
+        size_t res;
+
+        z->in.src = NULL;
+        z->in.size = 0;
+        z->in.pos = 0;
+        do {
+            res = ZSTD_compressStream2(z->zcs, &z->out, &z->in, ZSTD_e_end);
+        } while (res > 0 && !ZSTD_isError(res) &&
+                 z->out.size - z->out.pos > 0);
+        if (res > 0 && !ZSTD_isError(res)) {
+            error_setg(errp, "multifd %u: compressStream buffer too small",
+                       p->id);
+            return -1;
+        }
+        if (!ZSTD_isError(res)) {
+            res = ZSTD_CCtx_setParameter(z->zcs, ZSTD_c_compressionLevel,
+                                         level);
+        }
+        if (ZSTD_isError(res)) {
+            error_setg(errp, "multifd %u: setting level %d failed with %s",
+                       p->id, level, ZSTD_getErrorName(res));
+            return -1;
+        }
+        z->level = level;
+    }
+
     for (i = 0; i < p->normal_num; i++) {
         ZSTD_EndDirective flush = ZSTD_e_continue;
 
@@ -270,15 +311,18 @@ static int zstd_recv_pages(MultiFDRecvParams *p, Error **errp)
          * Welcome to decompressStream semantics
          *
          * We need to loop while:
-         * - return is > 0
+         * - there is no error
          * - there is input available
          * - we haven't put out a full page
+         *
+         * A return of 0 only means that a frame ended; the sender starts
+         * a new one when it changes the compression level.
          */
         do {
             ret = ZSTD_decompressStream(z->zds, &z->out, &z->in);
-        } while (ret > 0 && (z->in.size - z->in.pos > 0)
-                         && (z->out.pos < p->page_size));
-        if (ret > 0 && (z->out.pos < p->page_size)) {
+        } while (!ZSTD_isError(ret) && (z->in.size - z->in.pos > 0)
+                                    && (z->out.pos < p->page_size));
+        if (!ZSTD_isError(ret) && (z->out.pos < p->page_size)) {
             error_setg(errp, "multifd %u: decompressStream buffer too small",
                        p->id);
             return -1;
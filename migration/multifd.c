@@ -12,6 +12,7 @@
 
 #include "qemu/osdep.h"
 #include "qemu/rcu.h"
+#include "qemu/timer.h"
 #include "exec/target_page.h"
 #include "sysemu/sysemu.h"
 #include "exec/ramblock.h"
@@ -20,6 +21,7 @@
 #include "ram.h"
 #include "migration.h"
 #include "socket.h"
+#include "file.h"
 #include "tls.h"
 #include "qemu-file.h"
 #include "trace.h"
@@ -130,6 +132,9 @@ static void nocomp_recv_cleanup(MultiFDRecvParams *p)
  * nocomp_recv_pages: read the data from the channel into actual pages
  *
  * For no compression we just need to read things into the correct place.
+ * Pages that are contiguous in guest memory are read with a single
+ * iovec, and when another packet follows, its header is read by the
+ * same call.
  *
  * Returns 0 for success or -1 for error
  *
@@ -139,6 +144,8 @@ static void nocomp_recv_cleanup(MultiFDRecvParams *p)
 static int nocomp_recv_pages(MultiFDRecvParams *p, Error **errp)
 {
     uint32_t flags = p->flags & MULTIFD_FLAG_COMPRESSION_MASK;
+    uint32_t iovs_num = 0;
+    int ret;
 
     if (flags != MULTIFD_FLAG_NOCOMP) {
         error_setg(errp, "multifd %u: flags received %x flags expected %x",
@@ -146,10 +153,28 @@ static int nocomp_recv_pages(MultiFDRecvParams *p, Error **errp)
         return -1;
     }
     for (int i = 0; i < p->normal_num; i++) {
-        p->iov[i].iov_base = p->host + p->normal[i];
-        p->iov[i].iov_len = p->page_size;
+        uint8_t *host = p->host + p->normal[i];
+
+        if (iovs_num && (uint8_t *)p->iov[iovs_num - 1].iov_base +
+                        p->iov[iovs_num - 1].iov_len == host) {
+            p->iov[iovs_num - 1].iov_len += p->page_size;
+        } else {
+            p->iov[iovs_num].iov_base = host;
+            p->iov[iovs_num].iov_len = p->page_size;
+            iovs_num++;
+        }
+    }
+    if (p->can_read_ahead) {
+        p->iov[iovs_num].iov_base = p->packet;
+        p->iov[iovs_num].iov_len = p->packet_len;
+        iovs_num++;
+    }
+
+    ret = qio_channel_readv_all(p->c, p->iov, iovs_num, errp);
+    if (ret == 0) {
+        p->packet_read_ahead = p->can_read_ahead;
     }
-    return qio_channel_readv_all(p->c, p->iov, p->normal_num, errp);
+    return ret;
 }
 
 static MultiFDMethods multifd_nocomp_ops = {
@@ -262,6 +287,7 @@ static void multifd_send_fill_packet(MultiFDSendParams *p)
     packet->flags = cpu_to_be32(p->flags);
     packet->pages_alloc = cpu_to_be32(p->pages->allocated);
     packet->normal_pages = cpu_to_be32(p->normal_num);
+    packet->zero_pages = cpu_to_be32(p->zero_num);
     packet->next_packet_size = cpu_to_be32(p->next_packet_size);
     packet->packet_num = cpu_to_be64(p->packet_num);
 
@@ -275,6 +301,12 @@ static void multifd_send_fill_packet(MultiFDSendParams *p)
 
         packet->offset[i] = cpu_to_be64(temp);
     }
+
+    for (i = 0; i < p->zero_num; i++) {
+        uint64_t temp = p->zero[i];
+
+        packet->offset[p->normal_num + i] = cpu_to_be64(temp);
+    }
 }
 
 static int multifd_recv_unfill_packet(MultiFDRecvParams *p, Error **errp)
@@ -321,10 +353,18 @@ static int multifd_recv_unfill_packet(MultiFDRecvParams *p, Error **errp)
         return -1;
     }
 
+    p->zero_num = be32_to_cpu(packet->zero_pages);
+    if (p->zero_num > packet->pages_alloc - p->normal_num) {
+        error_setg(errp, "multifd: received packet "
+                   "with %u zero pages and expected maximum zero pages are %u",
+                   p->zero_num, packet->pages_alloc - p->normal_num);
+        return -1;
+    }
+
     p->next_packet_size = be32_to_cpu(packet->next_packet_size);
     p->packet_num = be64_to_cpu(packet->packet_num);
 
-    if (p->normal_num == 0) {
+    if (p->normal_num == 0 && p->zero_num == 0) {
         return 0;
     }
 
@@ -350,6 +390,18 @@ static int multifd_recv_unfill_packet(MultiFDRecvParams *p, Error **errp)
         p->normal[i] = offset;
     }
 
+    for (i = 0; i < p->zero_num; i++) {
+        uint64_t offset = be64_to_cpu(packet->offset[p->normal_num + i]);
+
+        if (offset > (block->used_length - p->page_size)) {
+            error_setg(errp, "multifd: offset too long %" PRIu64
+                       " (max " RAM_ADDR_FMT ")",
+                       offset, block->used_length);
+            return -1;
+        }
+        p->zero[i] = offset;
+    }
+
     return 0;
 }
 
@@ -369,6 +421,10 @@ struct {
     int exiting;
     /* multifd ops */
     MultiFDMethods *ops;
+    /* bytes of the zero pages found by the channels */
+    Stat64 zero_bytes;
+    /* part of zero_bytes already taken off the rate limit */
+    uint64_t zero_bytes_credited;
 } *multifd_send_state;
 
 /*
@@ -395,7 +451,7 @@ static int multifd_send_pages(QEMUFile *f)
     static int next_channel;
     MultiFDSendParams *p = NULL; /* make happy gcc */
     MultiFDPages_t *pages = multifd_send_state->pages;
-    uint64_t transferred;
+    uint64_t transferred, credit;
 
     if (qatomic_read(&multifd_send_state->exiting)) {
         return -1;
@@ -431,6 +487,14 @@ static int multifd_send_pages(QEMUFile *f)
     multifd_send_state->pages = p->pages;
     p->pages = pages;
     transferred = ((uint64_t) pages->num) * p->page_size + p->packet_len;
+    /*
+     * The zero pages that the channels found were accounted as full
+     * pages when they were queued, but only their offsets were sent.
+     */
+    credit = MIN(stat64_get(&multifd_send_state->zero_bytes) -
+                 multifd_send_state->zero_bytes_credited, transferred);
+    multifd_send_state->zero_bytes_credited += credit;
+    transferred -= credit;
     qemu_file_acct_rate_limit(f, transferred);
     ram_counters.multifd_bytes += transferred;
     stat64_add(&ram_atomic_counters.transferred, transferred);
@@ -471,6 +535,84 @@ int multifd_queue_page(QEMUFile *f, RAMBlock *block, ram_addr_t offset)
     return 1;
 }
 
+/*
+ * Called by the migration thread after each iteration, with the time
+ * in milliseconds that it took.
+ */
+void multifd_update_counters(uint64_t time_spent)
+{
+    int i;
+
+    if (!multifd_send_state || !time_spent) {
+        return;
+    }
+    for (i = 0; i < migrate_multifd_channels(); i++) {
+        MultiFDSendParams *p = &multifd_send_state->params[i];
+        uint64_t zero_pages;
+
+        WITH_QEMU_LOCK_GUARD(&p->mutex) {
+            zero_pages = p->total_zero_pages - p->iteration_zero_pages;
+            p->iteration_zero_pages = p->total_zero_pages;
+            p->zero_pages_per_second = zero_pages * 1000 / time_spent;
+        }
+        trace_multifd_send_zero_pages_rate(p->id, zero_pages, time_spent);
+    }
+}
+
+MultiFDChannelStatsList *multifd_query_send_channels(void)
+{
+    MultiFDChannelStatsList *head = NULL;
+    int i;
+
+    if (!multifd_send_state) {
+        return NULL;
+    }
+    for (i = migrate_multifd_channels() - 1; i >= 0; i--) {
+        MultiFDSendParams *p = &multifd_send_state->params[i];
+        MultiFDChannelStats *stats = g_new0(MultiFDChannelStats, 1);
+
+        stats->id = p->id;
+        WITH_QEMU_LOCK_GUARD(&p->mutex) {
+            stats->packets = p->num_packets;
+            stats->normal_pages = p->total_normal_pages;
+            stats->zero_pages = p->total_zero_pages;
+            stats->zero_pages_per_second = p->zero_pages_per_second;
+            stats->prepare_time = p->total_prepare_ns / SCALE_MS;
+            stats->write_time = p->total_write_ns / SCALE_MS;
+        }
+        QAPI_LIST_PREPEND(head, stats);
+    }
+    return head;
+}
+
+/**
+ * multifd_send_busy_time: time the send channels spent working
+ *
+ * Sum, over all the send channels, the time spent preparing packets
+ * and writing them, since the channels were created.
+ *
+ * @prepare_ns: where to store the time spent preparing, in ns
+ * @write_ns: where to store the time spent writing, in ns
+ */
+void multifd_send_busy_time(uint64_t *prepare_ns, uint64_t *write_ns)
+{
+    int i;
+
+    *prepare_ns = 0;
+    *write_ns = 0;
+    if (!multifd_send_state) {
+        return;
+    }
+    for (i = 0; i < migrate_multifd_channels(); i++) {
+        MultiFDSendParams *p = &multifd_send_state->params[i];
+
+        WITH_QEMU_LOCK_GUARD(&p->mutex) {
+            *prepare_ns += p->total_prepare_ns;
+            *write_ns += p->total_write_ns;
+        }
+    }
+}
+
 static void multifd_send_terminate_threads(Error *err)
 {
     int i;
@@ -550,6 +692,8 @@ void multifd_save_cleanup(void)
         p->iov = NULL;
         g_free(p->normal);
         p->normal = NULL;
+        g_free(p->zero);
+        p->zero = NULL;
         multifd_send_state->ops->send_cleanup(p, &local_err);
         if (local_err) {
             migrate_set_error(migrate_get_current(), local_err);
@@ -654,18 +798,24 @@ static void *multifd_send_thread(void *opaque)
     Error *local_err = NULL;
     int ret = 0;
     bool use_zero_copy_send = migrate_use_zero_copy_send();
+    bool use_zero_page_detection =
+        migrate_zero_page_detection() == ZERO_PAGE_DETECTION_MULTIFD;
+    /* with mapped-ram, there are no packets, only the pages */
+    bool use_mapped_ram = migrate_mapped_ram();
 
     thread = MigrationThreadAdd(p->name, qemu_get_thread_id());
 
     trace_multifd_send_thread_start(p->id);
     rcu_register_thread();
 
-    if (multifd_send_initial_packet(p, &local_err) < 0) {
-        ret = -1;
-        goto out;
+    if (!use_mapped_ram) {
+        if (multifd_send_initial_packet(p, &local_err) < 0) {
+            ret = -1;
+            goto out;
+        }
+        /* initial packet */
+        p->num_packets = 1;
     }
-    /* initial packet */
-    p->num_packets = 1;
 
     while (true) {
         qemu_sem_wait(&p->sem);
@@ -677,18 +827,31 @@ static void *multifd_send_thread(void *opaque)
 
         if (p->pending_job) {
             uint64_t packet_num = p->packet_num;
+            RAMBlock *block = p->pages->block;
+            int64_t start_time = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+            int64_t write_time;
             uint32_t flags;
             p->normal_num = 0;
+            p->zero_num = 0;
 
-            if (use_zero_copy_send) {
+            if (use_zero_copy_send || use_mapped_ram) {
                 p->iovs_num = 0;
             } else {
                 p->iovs_num = 1;
             }
 
             for (int i = 0; i < p->pages->num; i++) {
-                p->normal[p->normal_num] = p->pages->offset[i];
-                p->normal_num++;
+                ram_addr_t offset = p->pages->offset[i];
+
+                if (use_zero_page_detection &&
+                    buffer_is_zero(p->pages->block->host + offset,
+                                   p->page_size)) {
+                    p->zero[p->zero_num] = offset;
+                    p->zero_num++;
+                } else {
+                    p->normal[p->normal_num] = offset;
+                    p->normal_num++;
+                }
             }
 
             if (p->normal_num) {
@@ -698,39 +861,69 @@ static void *multifd_send_thread(void *opaque)
                     break;
                 }
             }
-            multifd_send_fill_packet(p);
+            if (!use_mapped_ram) {
+                multifd_send_fill_packet(p);
+            }
             flags = p->flags;
             p->flags = 0;
             p->num_packets++;
             p->total_normal_pages += p->normal_num;
+            p->total_zero_pages += p->zero_num;
             p->pages->num = 0;
             p->pages->block = NULL;
+            write_time = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+            p->total_prepare_ns += write_time - start_time;
             qemu_mutex_unlock(&p->mutex);
 
-            trace_multifd_send(p->id, packet_num, p->normal_num, flags,
-                               p->next_packet_size);
+            stat64_add(&ram_atomic_counters.normal, p->normal_num);
+            stat64_add(&ram_atomic_counters.duplicate, p->zero_num);
+            stat64_add(&multifd_send_state->zero_bytes,
+                       (uint64_t)p->zero_num * p->page_size);
 
-            if (use_zero_copy_send) {
-                /* Send header first, without zerocopy */
-                ret = qio_channel_write_all(p->c, (void *)p->packet,
-                                            p->packet_len, &local_err);
+            trace_multifd_send(p->id, packet_num, p->normal_num, p->zero_num,
+                               flags, p->next_packet_size);
+
+            if (use_mapped_ram) {
+                /* Write each page at its place in the file */
+                ret = file_write_ramblock_iov(p->c, p->iov, p->iovs_num,
+                                              block, &local_err);
                 if (ret != 0) {
                     break;
                 }
+                for (int i = 0; i < p->normal_num; i++) {
+                    set_bit_atomic(p->normal[i] / p->page_size,
+                                   block->file_bmap);
+                }
+                for (int i = 0; i < p->zero_num; i++) {
+                    clear_bit_atomic(p->zero[i] / p->page_size,
+                                     block->file_bmap);
+                }
             } else {
-                /* Send header using the same writev call */
-                p->iov[0].iov_len = p->packet_len;
-                p->iov[0].iov_base = p->packet;
-            }
+                if (use_zero_copy_send) {
+                    /* Send header first, without zerocopy */
+                    ret = qio_channel_write_all(p->c, (void *)p->packet,
+                                                p->packet_len, &local_err);
+                    if (ret != 0) {
+                        break;
+                    }
+                } else {
+                    /* Send header using the same writev call */
+                    p->iov[0].iov_len = p->packet_len;
+                    p->iov[0].iov_base = p->packet;
+                }
 
-            ret = qio_channel_writev_full_all(p->c, p->iov, p->iovs_num, NULL,
-                                              0, p->write_flags, &local_err);
-            if (ret != 0) {
-                break;
+                ret = qio_channel_writev_full_all(p->c, p->iov, p->iovs_num,
+                                                  NULL, 0, p->write_flags,
+                                                  &local_err);
+                if (ret != 0) {
+                    break;
+                }
             }
 
             qemu_mutex_lock(&p->mutex);
             p->pending_job--;
+            p->total_write_ns += qemu_clock_get_ns(QEMU_CLOCK_REALTIME) -
+                                 write_time;
             qemu_mutex_unlock(&p->mutex);
 
             if (flags & MULTIFD_FLAG_SYNC) {
@@ -768,7 +961,8 @@ out:
 
     rcu_unregister_thread();
     MigrationThreadDel(thread);
-    trace_multifd_send_thread_end(p->id, p->num_packets, p->total_normal_pages);
+    trace_multifd_send_thread_end(p->id, p->num_packets, p->total_normal_pages,
+                                  p->total_zero_pages);
 
     return NULL;
 }
@@ -933,15 +1127,18 @@ int multifd_save_setup(Error **errp)
         p->pending_job = 0;
         p->id = i;
         p->pages = multifd_pages_init(page_count);
-        p->packet_len = sizeof(MultiFDPacket_t)
-                      + sizeof(uint64_t) * page_count;
-        p->packet = g_malloc0(p->packet_len);
-        p->packet->magic = cpu_to_be32(MULTIFD_MAGIC);
-        p->packet->version = cpu_to_be32(MULTIFD_VERSION);
+        if (!migrate_mapped_ram()) {
+            p->packet_len = sizeof(MultiFDPacket_t)
+                          + sizeof(uint64_t) * page_count;
+            p->packet = g_malloc0(p->packet_len);
+            p->packet->magic = cpu_to_be32(MULTIFD_MAGIC);
+            p->packet->version = cpu_to_be32(MULTIFD_VERSION);
+        }
         p->name = g_strdup_printf("multifdsend_%d", i);
         /* We need one extra place for the packet header */
         p->iov = g_new0(struct iovec, page_count + 1);
         p->normal = g_new0(ram_addr_t, page_count);
+        p->zero = g_new0(ram_addr_t, page_count);
         p->page_size = qemu_target_page_size();
         p->page_count = page_count;
 
@@ -951,7 +1148,11 @@ int multifd_save_setup(Error **errp)
             p->write_flags = 0;
         }
 
-        socket_send_channel_create(multifd_new_send_channel_async, p);
+        if (migrate_mapped_ram()) {
+            file_send_channel_create(multifd_new_send_channel_async, p);
+        } else {
+            socket_send_channel_create(multifd_new_send_channel_async, p);
+        }
     }
 
     for (i = 0; i < thread_count; i++) {
@@ -974,6 +1175,8 @@ struct {
     int count;
     /* syncs main thread and channels */
     QemuSemaphore sem_sync;
+    /* with mapped-ram, the number of channels without a range to read */
+    QemuSemaphore channels_ready;
     /* global number of generated multifd packets */
     uint64_t packet_num;
     /* multifd ops */
@@ -1010,6 +1213,8 @@ static void multifd_recv_terminate_threads(Error *err)
         if (p->c) {
             qio_channel_shutdown(p->c, QIO_CHANNEL_SHUTDOWN_BOTH, NULL);
         }
+        /* with mapped-ram, the channel threads wait for work there */
+        qemu_sem_post(&p->sem);
         qemu_mutex_unlock(&p->mutex);
     }
 }
@@ -1049,6 +1254,7 @@ void multifd_load_cleanup(void)
         object_unref(OBJECT(p->c));
         p->c = NULL;
         qemu_mutex_destroy(&p->mutex);
+        qemu_sem_destroy(&p->sem);
         qemu_sem_destroy(&p->sem_sync);
         g_free(p->name);
         p->name = NULL;
@@ -1059,9 +1265,12 @@ void multifd_load_cleanup(void)
         p->iov = NULL;
         g_free(p->normal);
         p->normal = NULL;
+        g_free(p->zero);
+        p->zero = NULL;
         multifd_recv_state->ops->recv_cleanup(p);
     }
     qemu_sem_destroy(&multifd_recv_state->sem_sync);
+    qemu_sem_destroy(&multifd_recv_state->channels_ready);
     g_free(multifd_recv_state->params);
     multifd_recv_state->params = NULL;
     g_free(multifd_recv_state);
@@ -1072,7 +1281,8 @@ void multifd_recv_sync_main(void)
 {
     int i;
 
-    if (!migrate_use_multifd()) {
+    /* with mapped-ram, the channels only read what they are given */
+    if (!migrate_use_multifd() || migrate_mapped_ram()) {
         return;
     }
     for (i = 0; i < migrate_multifd_channels(); i++) {
@@ -1095,11 +1305,139 @@ void multifd_recv_sync_main(void)
     trace_multifd_recv_sync_main(multifd_recv_state->packet_num);
 }
 
+/*
+ * With mapped-ram, have a channel read @len bytes of @block at @offset
+ * from the file.  Returns -1 if the channels failed.
+ */
+static int multifd_recv_queue_range(RAMBlock *block, ram_addr_t offset,
+                                    size_t len)
+{
+    static int next_channel;
+    MultiFDRecvParams *p;
+    int i;
+
+    qemu_sem_wait(&multifd_recv_state->channels_ready);
+    next_channel %= migrate_multifd_channels();
+    for (i = next_channel;; i = (i + 1) % migrate_multifd_channels()) {
+        p = &multifd_recv_state->params[i];
+
+        qemu_mutex_lock(&p->mutex);
+        if (p->quit) {
+            qemu_mutex_unlock(&p->mutex);
+            return -1;
+        }
+        if (!p->pending_job) {
+            p->pending_job = true;
+            next_channel = (i + 1) % migrate_multifd_channels();
+            break;
+        }
+        qemu_mutex_unlock(&p->mutex);
+    }
+    p->block = block;
+    p->offset = offset;
+    p->len = len;
+    qemu_mutex_unlock(&p->mutex);
+    qemu_sem_post(&p->sem);
+
+    return 0;
+}
+
+/*
+ * With mapped-ram, spread the reading of @len bytes of @block at
+ * @offset between the channels.  Returns -1 if the channels failed.
+ */
+int multifd_recv_queue_ramblock(RAMBlock *block, ram_addr_t offset,
+                                size_t len)
+{
+    while (len) {
+        size_t chunk = MIN(len, MULTIFD_PACKET_SIZE);
+
+        if (multifd_recv_queue_range(block, offset, chunk) < 0) {
+            return -1;
+        }
+        offset += chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+/*
+ * With mapped-ram, wait until the channels have read everything that
+ * was queued.  Returns -1 if the channels failed.
+ */
+int multifd_recv_wait_ramblock(void)
+{
+    int thread_count = migrate_multifd_channels();
+    int i, ret = 0;
+
+    for (i = 0; i < thread_count; i++) {
+        qemu_sem_wait(&multifd_recv_state->channels_ready);
+    }
+    for (i = 0; i < thread_count; i++) {
+        MultiFDRecvParams *p = &multifd_recv_state->params[i];
+
+        WITH_QEMU_LOCK_GUARD(&p->mutex) {
+            if (p->quit) {
+                ret = -1;
+            }
+        }
+        qemu_sem_post(&multifd_recv_state->channels_ready);
+    }
+    return ret;
+}
+
+/*
+ * With mapped-ram, wait for a range to read and read it from its place
+ * in the file.
+ */
+static int multifd_recv_mapped_ram(MultiFDRecvParams *p, Error **errp)
+{
+    RAMBlock *block;
+    ram_addr_t offset;
+    size_t len;
+
+    qemu_sem_wait(&p->sem);
+
+    qemu_mutex_lock(&p->mutex);
+    if (!p->pending_job) {
+        /* woken up to quit */
+        qemu_mutex_unlock(&p->mutex);
+        return 0;
+    }
+    block = p->block;
+    offset = p->offset;
+    len = p->len;
+    qemu_mutex_unlock(&p->mutex);
+
+    trace_multifd_recv_mapped_ram(p->id, block->idstr, offset, len);
+    if (file_read_ramblock(p->c, block, offset, len, errp) < 0) {
+        return -1;
+    }
+    p->num_packets++;
+    p->total_normal_pages += len / p->page_size;
+
+    qemu_mutex_lock(&p->mutex);
+    p->pending_job = false;
+    qemu_mutex_unlock(&p->mutex);
+    qemu_sem_post(&multifd_recv_state->channels_ready);
+
+    return 0;
+}
+
+/* Clear the pages that the source found to be zero */
+static void multifd_recv_zero_pages(MultiFDRecvParams *p)
+{
+    for (int i = 0; i < p->zero_num; i++) {
+        ram_handle_compressed(p->host + p->zero[i], 0, p->page_size);
+    }
+}
+
 static void *multifd_recv_thread(void *opaque)
 {
     MultiFDRecvParams *p = opaque;
     Error *local_err = NULL;
-    int ret;
+    bool use_mapped_ram = migrate_mapped_ram();
+    int ret = 0;
 
     trace_multifd_recv_thread_start(p->id);
     rcu_register_thread();
@@ -1111,11 +1449,22 @@ static void *multifd_recv_thread(void *opaque)
             break;
         }
 
-        ret = qio_channel_read_all_eof(p->c, (void *)p->packet,
-                                       p->packet_len, &local_err);
-        if (ret == 0 || ret == -1) {   /* 0: EOF  -1: Error */
-            break;
+        if (use_mapped_ram) {
+            ret = multifd_recv_mapped_ram(p, &local_err);
+            if (ret != 0) {
+                break;
+            }
+            continue;
+        }
+
+        if (!p->packet_read_ahead) {
+            ret = qio_channel_read_all_eof(p->c, (void *)p->packet,
+                                           p->packet_len, &local_err);
+            if (ret == 0 || ret == -1) {   /* 0: EOF  -1: Error */
+                break;
+            }
         }
+        p->packet_read_ahead = false;
 
         qemu_mutex_lock(&p->mutex);
         ret = multifd_recv_unfill_packet(p, &local_err);
@@ -1127,10 +1476,18 @@ static void *multifd_recv_thread(void *opaque)
         flags = p->flags;
         /* recv methods don't know how to handle the SYNC flag */
         p->flags &= ~MULTIFD_FLAG_SYNC;
-        trace_multifd_recv(p->id, p->packet_num, p->normal_num, flags,
-                           p->next_packet_size);
+        /*
+         * After a packet with the SYNC flag, this thread must wait for
+         * the main thread before reading on, and such a packet is also
+         * the last one of the channel.  Any other packet is followed by
+         * another one.
+         */
+        p->can_read_ahead = !(flags & MULTIFD_FLAG_SYNC);
+        trace_multifd_recv(p->id, p->packet_num, p->normal_num, p->zero_num,
+                           flags, p->next_packet_size);
         p->num_packets++;
         p->total_normal_pages += p->normal_num;
+        p->total_zero_pages += p->zero_num;
         qemu_mutex_unlock(&p->mutex);
 
         if (p->normal_num) {
@@ -1140,6 +1497,8 @@ static void *multifd_recv_thread(void *opaque)
             }
         }
 
+        multifd_recv_zero_pages(p);
+
         if (flags & MULTIFD_FLAG_SYNC) {
             qemu_sem_post(&multifd_recv_state->sem_sync);
             qemu_sem_wait(&p->sem_sync);
@@ -1150,12 +1509,29 @@ static void *multifd_recv_thread(void *opaque)
         multifd_recv_terminate_threads(local_err);
         error_free(local_err);
     }
+    if (use_mapped_ram) {
+        bool pending;
+
+        /*
+         * A range may have been queued and not read, because reading it
+         * failed or because quit was set first.  Either way, don't leave
+         * the main thread waiting for this channel.
+         */
+        qemu_mutex_lock(&p->mutex);
+        pending = p->pending_job;
+        p->pending_job = false;
+        qemu_mutex_unlock(&p->mutex);
+        if (pending) {
+            qemu_sem_post(&multifd_recv_state->channels_ready);
+        }
+    }
     qemu_mutex_lock(&p->mutex);
     p->running = false;
     qemu_mutex_unlock(&p->mutex);
 
     rcu_unregister_thread();
-    trace_multifd_recv_thread_end(p->id, p->num_packets, p->total_normal_pages);
+    trace_multifd_recv_thread_end(p->id, p->num_packets, p->total_normal_pages,
+                                  p->total_zero_pages);
 
     return NULL;
 }
@@ -1179,21 +1555,28 @@ int multifd_load_setup(Error **errp)
     multifd_recv_state->params = g_new0(MultiFDRecvParams, thread_count);
     qatomic_set(&multifd_recv_state->count, 0);
     qemu_sem_init(&multifd_recv_state->sem_sync, 0);
+    qemu_sem_init(&multifd_recv_state->channels_ready, thread_count);
     multifd_recv_state->ops = multifd_ops[migrate_multifd_compression()];
 
     for (i = 0; i < thread_count; i++) {
         MultiFDRecvParams *p = &multifd_recv_state->params[i];
 
         qemu_mutex_init(&p->mutex);
+        qemu_sem_init(&p->sem, 0);
         qemu_sem_init(&p->sem_sync, 0);
         p->quit = false;
+        p->pending_job = false;
         p->id = i;
-        p->packet_len = sizeof(MultiFDPacket_t)
-                      + sizeof(uint64_t) * page_count;
-        p->packet = g_malloc0(p->packet_len);
+        if (!migrate_mapped_ram()) {
+            p->packet_len = sizeof(MultiFDPacket_t)
+                          + sizeof(uint64_t) * page_count;
+            p->packet = g_malloc0(p->packet_len);
+        }
         p->name = g_strdup_printf("multifdrecv_%d", i);
-        p->iov = g_new0(struct iovec, page_count);
+        /* one more for the header of the next packet */
+        p->iov = g_new0(struct iovec, page_count + 1);
         p->normal = g_new0(ram_addr_t, page_count);
+        p->zero = g_new0(ram_addr_t, page_count);
         p->page_count = page_count;
         p->page_size = qemu_target_page_size();
     }
@@ -1238,7 +1621,12 @@ void multifd_recv_new_channel(QIOChannel *ioc, Error **errp)
     Error *local_err = NULL;
     int id;
 
-    id = multifd_recv_initial_packet(ioc, &local_err);
+    if (migrate_mapped_ram()) {
+        /* the file channels are opened in order, without a packet */
+        id = qatomic_read(&multifd_recv_state->count);
+    } else {
+        id = multifd_recv_initial_packet(ioc, &local_err);
+    }
     if (id < 0) {
         multifd_recv_terminate_threads(local_err);
         error_propagate_prepend(errp, local_err,
@@ -1260,7 +1648,7 @@ void multifd_recv_new_channel(QIOChannel *ioc, Error **errp)
     p->c = ioc;
     object_ref(OBJECT(ioc));
     /* initial packet */
-    p->num_packets = 1;
+    p->num_packets = migrate_mapped_ram() ? 0 : 1;
 
     p->running = true;
     qemu_thread_create(&p->thread, p->name, multifd_recv_thread, p,
@@ -21,8 +21,14 @@ void multifd_load_shutdown(void);
 bool multifd_recv_all_channels_created(void);
 void multifd_recv_new_channel(QIOChannel *ioc, Error **errp);
 void multifd_recv_sync_main(void);
+int multifd_recv_queue_ramblock(RAMBlock *block, ram_addr_t offset,
+                                size_t len);
+int multifd_recv_wait_ramblock(void);
 int multifd_send_sync_main(QEMUFile *f);
 int multifd_queue_page(QEMUFile *f, RAMBlock *block, ram_addr_t offset);
+void multifd_update_counters(uint64_t time_spent);
+MultiFDChannelStatsList *multifd_query_send_channels(void);
+void multifd_send_busy_time(uint64_t *prepare_ns, uint64_t *write_ns);
 
 /* Multifd Compression flags */
 #define MULTIFD_FLAG_SYNC (1 << 0)
@@ -33,6 +39,7 @@ int multifd_queue_page(QEMUFile *f, RAMBlock *block, ram_addr_t offset);
 #define MULTIFD_FLAG_NOCOMP (0 << 1)
 #define MULTIFD_FLAG_ZLIB (1 << 1)
 #define MULTIFD_FLAG_ZSTD (2 << 1)
+#define MULTIFD_FLAG_LZ4 (3 << 1)
 
 /* This value needs to be a multiple of qemu_target_page_size() */
 #define MULTIFD_PACKET_SIZE (512 * 1024)
@@ -48,7 +55,10 @@ typedef struct {
     /* size of the next packet that contains pages */
     uint32_t next_packet_size;
     uint64_t packet_num;
-    uint64_t unused[4];    /* Reserved for future use */
+    /* zero pages, their offsets follow the ones of the normal pages */
+    uint32_t zero_pages;
+    uint32_t unused32[1];    /* Reserved for future use */
+    uint64_t unused64[3];    /* Reserved for future use */
     char ramblock[256];
     uint64_t offset[];
 } __attribute__((packed)) MultiFDPacket_t;
@@ -118,10 +128,24 @@ typedef struct {
     MultiFDPacket_t *packet;
     /* size of the next packet that contains pages */
     uint32_t next_packet_size;
+    /*
+     * query-migrate reads the counters below, so they are only
+     * written with the mutex held.
+     */
     /* packets sent through this channel */
     uint64_t num_packets;
     /* non zero pages sent through this channel */
     uint64_t total_normal_pages;
+    /* zero pages sent through this channel */
+    uint64_t total_zero_pages;
+    /* total_zero_pages at the start of the current iteration */
+    uint64_t iteration_zero_pages;
+    /* zero pages found per second during the last iteration */
+    uint64_t zero_pages_per_second;
+    /* nanoseconds spent preparing packets */
+    uint64_t total_prepare_ns;
+    /* nanoseconds spent writing packets */
+    uint64_t total_write_ns;
     /* buffers to send */
     struct iovec *iov;
     /* number of iovs used */
@@ -130,6 +154,10 @@ typedef struct {
     ram_addr_t *normal;
     /* num of non zero pages */
     uint32_t normal_num;
+    /* Pages that are zero */
+    ram_addr_t *zero;
+    /* num of zero pages */
+    uint32_t zero_num;
     /* used for compression methods */
     void *data;
 }  MultiFDSendParams;
@@ -153,6 +181,8 @@ typedef struct {
     /* number of pages in a full packet */
     uint32_t page_count;
 
+    /* sem where to wait for more work, with mapped-ram */
+    QemuSemaphore sem;
     /* syncs main thread and channels */
     QemuSemaphore sem_sync;
 
@@ -166,11 +196,24 @@ typedef struct {
     uint32_t flags;
     /* global number of generated multifd packets */
     uint64_t packet_num;
+    /* with mapped-ram, the thread has a range of a block to read */
+    bool pending_job;
+    /* the block, offset and length of that range */
+    RAMBlock *block;
+    ram_addr_t offset;
+    size_t len;
 
     /* thread local variables. No locking required */
 
     /* pointer to the packet */
     MultiFDPacket_t *packet;
+    /*
+     * Another packet follows the current one, so recv_pages can read
+     * its header together with the pages
+     */
+    bool can_read_ahead;
+    /* the header of the next packet was already read into 'packet' */
+    bool packet_read_ahead;
     /* size of the next packet that contains pages */
     uint32_t next_packet_size;
     /* packets sent through this channel */
@@ -179,12 +222,18 @@ typedef struct {
     uint8_t *host;
     /* non zero pages recv through this channel */
     uint64_t total_normal_pages;
+    /* zero pages recv through this channel */
+    uint64_t total_zero_pages;
     /* buffers to recv */
     struct iovec *iov;
     /* Pages that are not zero */
     ram_addr_t *normal;
     /* num of non zero pages */
     uint32_t normal_num;
+    /* Pages that are zero */
+    ram_addr_t *zero;
+    /* num of zero pages */
+    uint32_t zero_num;
     /* used for de-compression methods */
     void *data;
 } MultiFDRecvParams;
@@ -974,3 +974,114 @@ int qemu_file_get_to_fd(QEMUFile *f, int fd, size_t size)
 
     return 0;
 }
+
+/*
+ * Return the position in the underlying channel that the next read or
+ * write of the file corresponds to, or -1 on error.
+ */
+off_t qemu_get_offset(QEMUFile *f)
+{
+    Error *local_error = NULL;
+    off_t ret;
+
+    qemu_fflush(f);
+    ret = qio_channel_io_seek(f->ioc, 0, SEEK_CUR, &local_error);
+    if (ret < 0) {
+        qemu_file_set_error_obj(f, -EIO, local_error);
+        return -1;
+    }
+    if (!qemu_file_is_writable(f)) {
+        /* the data already buffered comes before the next read */
+        ret -= f->buf_size - f->buf_index;
+    }
+    return ret;
+}
+
+/*
+ * Move the file to @pos in the underlying channel, flushing or
+ * dropping whatever is buffered.
+ */
+void qemu_set_offset(QEMUFile *f, off_t pos)
+{
+    Error *local_error = NULL;
+
+    if (f->last_error) {
+        return;
+    }
+
+    qemu_fflush(f);
+    if (!qemu_file_is_writable(f)) {
+        f->buf_index = 0;
+        f->buf_size = 0;
+    }
+    if (qio_channel_io_seek(f->ioc, pos, SEEK_SET, &local_error) < 0) {
+        qemu_file_set_error_obj(f, -EIO, local_error);
+    }
+}
+
+/*
+ * Write @buf at @pos in the underlying channel, bypassing the buffer
+ * and without moving the file.  The channel must be seekable.
+ */
+void qemu_put_buffer_at(QEMUFile *f, const uint8_t *buf, size_t size,
+                        off_t pos)
+{
+    Error *local_error = NULL;
+    size_t done = 0;
+
+    if (f->last_error) {
+        return;
+    }
+
+    while (done < size) {
+        ssize_t ret = qio_channel_pwrite(f->ioc, (char *)buf + done,
+                                         size - done, pos + done,
+                                         &local_error);
+        if (ret < 0) {
+            if (!local_error) {
+                error_setg(&local_error, "Unable to write to file");
+            }
+            qemu_file_set_error_obj(f, -EIO, local_error);
+            return;
+        }
+        done += ret;
+    }
+
+    f->rate_limit_used += size;
+    f->total_transferred += size;
+}
+
+/*
+ * Read @size bytes at @pos in the underlying channel into @buf,
+ * bypassing the buffer and without moving the file.  The channel
+ * must be seekable.
+ *
+ * Returns the number of bytes read, which is less than @size only on
+ * error or at the end of the channel.
+ */
+size_t qemu_get_buffer_at(QEMUFile *f, uint8_t *buf, size_t size, off_t pos)
+{
+    Error *local_error = NULL;
+    size_t done = 0;
+
+    if (f->last_error) {
+        return 0;
+    }
+
+    while (done < size) {
+        ssize_t ret = qio_channel_pread(f->ioc, (char *)buf + done,
+                                        size - done, pos + done,
+                                        &local_error);
+        if (ret <= 0) {
+            if (!local_error) {
+                error_setg(&local_error, "Unexpected end of file");
+            }
+            qemu_file_set_error_obj(f, -EIO, local_error);
+            break;
+        }
+        done += ret;
+    }
+
+    f->total_transferred += done;
+    return done;
+}
@@ -87,6 +87,16 @@
 #define RAM_SAVE_FLAG_COMPRESS_PAGE    0x100
 /* We can't use any flag that is bigger than 0x200 */
 
+/*
+ * With mapped-ram, the stream has a header for each RAM block, that
+ * points to the bitmap of the pages present in the file and to the
+ * region of the file where the pages are written at their offset in
+ * the block.
+ */
+#define MAPPED_RAM_HDR_VERSION 1
+/* The regions of the pages are aligned for direct I/O and mmap */
+#define MAPPED_RAM_FILE_OFFSET_ALIGNMENT 0x100000
+
 int (*xbzrle_encode_buffer_func)(uint8_t *, uint8_t *, int,
      uint8_t *, int) = xbzrle_encode_buffer;
 #if defined(CONFIG_AVX512BW_OPT)
@@ -1309,6 +1319,10 @@ static int save_zero_page_to_file(PageSearchStatus *pss,
     QEMUFile *file = pss->pss_channel;
     int len = 0;
 
+    if (migrate_zero_page_detection() == ZERO_PAGE_DETECTION_NONE) {
+        return 0;
+    }
+
     if (buffer_is_zero(p, TARGET_PAGE_SIZE)) {
         len += save_page_header(pss, block, offset | RAM_SAVE_FLAG_ZERO);
         qemu_put_byte(file, 0);
@@ -1330,7 +1344,20 @@ static int save_zero_page_to_file(PageSearchStatus *pss,
 static int save_zero_page(PageSearchStatus *pss, RAMBlock *block,
                           ram_addr_t offset)
 {
-    int len = save_zero_page_to_file(pss, block, offset);
+    int len;
+
+    if (migrate_mapped_ram()) {
+        if (migrate_zero_page_detection() == ZERO_PAGE_DETECTION_NONE ||
+            !buffer_is_zero(block->host + offset, TARGET_PAGE_SIZE)) {
+            return -1;
+        }
+        /* zero pages are left out of the file */
+        clear_bit_atomic(offset >> TARGET_PAGE_BITS, block->file_bmap);
+        stat64_add(&ram_atomic_counters.duplicate, 1);
+        return 1;
+    }
+
+    len = save_zero_page_to_file(pss, block, offset);
 
     if (len) {
         stat64_add(&ram_atomic_counters.duplicate, 1);
@@ -1394,6 +1421,15 @@ static int save_normal_page(PageSearchStatus *pss, RAMBlock *block,
 {
     QEMUFile *file = pss->pss_channel;
 
+    if (migrate_mapped_ram()) {
+        qemu_put_buffer_at(file, buf, TARGET_PAGE_SIZE,
+                           block->pages_offset + offset);
+        set_bit_atomic(offset >> TARGET_PAGE_BITS, block->file_bmap);
+        ram_transferred_add(TARGET_PAGE_SIZE);
+        stat64_add(&ram_atomic_counters.normal, 1);
+        return 1;
+    }
+
     ram_transferred_add(save_page_header(pss, block,
                                          offset | RAM_SAVE_FLAG_PAGE));
     if (async) {
@@ -1457,10 +1493,10 @@ static int ram_save_page(RAMState *rs, PageSearchStatus *pss)
 static int ram_save_multifd_page(QEMUFile *file, RAMBlock *block,
                                  ram_addr_t offset)
 {
+    /* the multifd channels account for the page when they send it */
     if (multifd_queue_page(file, block, offset) < 0) {
         return -1;
     }
-    stat64_add(&ram_atomic_counters.normal, 1);
 
     return 1;
 }
@@ -2345,6 +2381,13 @@ static int ram_save_target_page_legacy(RAMState *rs, PageSearchStatus *pss)
 {
     RAMBlock *block = pss->block;
     ram_addr_t offset = ((ram_addr_t)pss->page) << TARGET_PAGE_BITS;
+    /*
+     * Do not use multifd in postcopy as one whole host page should be
+     * placed.  Meanwhile postcopy requires atomic update of pages, so even
+     * if host page size == guest page size the dest guest during run may
+     * still see partially copied pages which is data corruption.
+     */
+    bool use_multifd = migrate_use_multifd() && !migration_in_postcopy();
     int res;
 
     if (control_save_page(pss, block, offset, &res)) {
@@ -2355,6 +2398,15 @@ static int ram_save_target_page_legacy(RAMState *rs, PageSearchStatus *pss)
         return 1;
     }
 
+    /*
+     * The multifd channels can look for zero pages themselves, so that
+     * the migration thread does not have to read every page.
+     */
+    if (use_multifd &&
+        migrate_zero_page_detection() == ZERO_PAGE_DETECTION_MULTIFD) {
+        return ram_save_multifd_page(pss->pss_channel, block, offset);
+    }
+
     res = save_zero_page(pss, block, offset);
     if (res > 0) {
         /* Must let xbzrle know, otherwise a previous (now 0'd) cached
@@ -2368,13 +2420,7 @@ static int ram_save_target_page_legacy(RAMState *rs, PageSearchStatus *pss)
         return res;
     }
 
-    /*
-     * Do not use multifd in postcopy as one whole host page should be
-     * placed.  Meanwhile postcopy requires atomic update of pages, so even
-     * if host page size == guest page size the dest guest during run may
-     * still see partially copied pages which is data corruption.
-     */
-    if (migrate_use_multifd() && !migration_in_postcopy()) {
+    if (use_multifd) {
         return ram_save_multifd_page(pss->pss_channel, block, offset);
     }
 
@@ -2731,6 +2777,8 @@ static void ram_save_cleanup(void *opaque)
         block->clear_bmap = NULL;
         g_free(block->bmap);
         block->bmap = NULL;
+        g_free(block->file_bmap);
+        block->file_bmap = NULL;
     }
 
     xbzrle_cleanup();
@@ -3238,6 +3286,55 @@ void qemu_guest_free_page_hint(void *addr, size_t len)
     }
 }
 
+/* Size in the file of the mapped-ram bitmap of a block */
+static uint64_t mapped_ram_bitmap_size(unsigned long num_pages)
+{
+    return DIV_ROUND_UP(num_pages, 64) * sizeof(uint64_t);
+}
+
+/*
+ * Write the mapped-ram header of @block, and reserve the space for its
+ * bitmap and its pages right after it in the file.
+ */
+static void mapped_ram_setup_ramblock(QEMUFile *f, RAMBlock *block)
+{
+    unsigned long num_pages = block->used_length >> TARGET_PAGE_BITS;
+    uint64_t bitmap_size = mapped_ram_bitmap_size(num_pages);
+
+    block->file_bmap = bitmap_new(num_pages);
+
+    qemu_put_be32(f, MAPPED_RAM_HDR_VERSION);
+    qemu_put_be64(f, TARGET_PAGE_SIZE);
+    /* the bitmap comes right after the two offsets */
+    block->bitmap_offset = qemu_get_offset(f) + 2 * sizeof(uint64_t);
+    block->pages_offset = ROUND_UP(block->bitmap_offset + bitmap_size,
+                                   MAPPED_RAM_FILE_OFFSET_ALIGNMENT);
+    qemu_put_be64(f, block->bitmap_offset);
+    qemu_put_be64(f, block->pages_offset);
+
+    /* the rest of the stream goes after the pages */
+    qemu_set_offset(f, block->pages_offset + block->used_length);
+}
+
+/* Write the mapped-ram bitmaps, once all the pages are in the file */
+static void mapped_ram_save_bitmaps(QEMUFile *f)
+{
+    RAMBlock *block;
+
+    RCU_READ_LOCK_GUARD();
+
+    RAMBLOCK_FOREACH_MIGRATABLE(block) {
+        unsigned long num_pages = block->used_length >> TARGET_PAGE_BITS;
+        uint64_t bitmap_size = mapped_ram_bitmap_size(num_pages);
+        g_autofree unsigned long *le_bitmap =
+            bitmap_new(bitmap_size * BITS_PER_BYTE);
+
+        bitmap_to_le(le_bitmap, block->file_bmap, num_pages);
+        qemu_put_buffer_at(f, (uint8_t *)le_bitmap, bitmap_size,
+                           block->bitmap_offset);
+    }
+}
+
 /*
  * Each of ram_save_setup, ram_save_iterate and ram_save_complete has
  * long-running RCU critical section.  When rcu-reclaims in the code
@@ -3287,6 +3384,9 @@ static int ram_save_setup(QEMUFile *f, void *opaque)
             if (migrate_ignore_shared()) {
                 qemu_put_be64(f, block->mr->addr);
             }
+            if (migrate_mapped_ram()) {
+                mapped_ram_setup_ramblock(f, block);
+            }
         }
     }
 
@@ -3483,6 +3583,10 @@ static int ram_save_complete(QEMUFile *f, void *opaque)
         return ret;
     }
 
+    if (migrate_mapped_ram()) {
+        mapped_ram_save_bitmaps(f);
+    }
+
     qemu_put_be64(f, RAM_SAVE_FLAG_EOS);
     qemu_fflush(f);
 
@@ -4255,6 +4359,79 @@ void colo_flush_ram_cache(void)
     trace_colo_flush_ram_cache_end();
 }
 
+/*
+ * Read the mapped-ram header of @block and load the pages that its
+ * bitmap marks as present in the file.  With multifd, the channels
+ * read the pages in parallel.
+ */
+static int mapped_ram_load_ramblock(QEMUFile *f, RAMBlock *block,
+                                    ram_addr_t length)
+{
+    unsigned long num_pages = length >> TARGET_PAGE_BITS;
+    uint64_t bitmap_size = mapped_ram_bitmap_size(num_pages);
+    g_autofree unsigned long *le_bitmap = NULL;
+    g_autofree unsigned long *bitmap = NULL;
+    unsigned long set, clear;
+    uint32_t version;
+    uint64_t page_size;
+
+    version = qemu_get_be32(f);
+    page_size = qemu_get_be64(f);
+    block->bitmap_offset = qemu_get_be64(f);
+    block->pages_offset = qemu_get_be64(f);
+
+    if (version != MAPPED_RAM_HDR_VERSION) {
+        error_report("Unsupported mapped-ram version %" PRIu32
+                     " for block %s", version, block->idstr);
+        return -EINVAL;
+    }
+    if (page_size != TARGET_PAGE_SIZE) {
+        error_report("Mismatched mapped-ram page size %" PRIu64
+                     " for block %s", page_size, block->idstr);
+        return -EINVAL;
+    }
+
+    le_bitmap = bitmap_new(bitmap_size * BITS_PER_BYTE);
+    bitmap = bitmap_new(num_pages);
+    if (qemu_get_buffer_at(f, (uint8_t *)le_bitmap, bitmap_size,
+                           block->bitmap_offset) != bitmap_size) {
+        error_report("Failed to read the mapped-ram bitmap of block %s",
+                     block->idstr);
+        return -EIO;
+    }
+    bitmap_from_le(bitmap, le_bitmap, num_pages);
+
+    for (set = find_first_bit(bitmap, num_pages); set < num_pages;
+         set = find_next_bit(bitmap, num_pages, clear + 1)) {
+        ram_addr_t offset = (ram_addr_t)set << TARGET_PAGE_BITS;
+        size_t size;
+
+        clear = find_next_zero_bit(bitmap, num_pages, set + 1);
+        size = (clear - set) << TARGET_PAGE_BITS;
+
+        if (migrate_use_multifd()) {
+            if (multifd_recv_queue_ramblock(block, offset, size) < 0) {
+                return -EIO;
+            }
+        } else if (qemu_get_buffer_at(f, block->host + offset, size,
+                                      block->pages_offset + offset) != size) {
+            error_report("Failed to read the pages of block %s",
+                         block->idstr);
+            return -EIO;
+        }
+        ramblock_recv_bitmap_set_range(block, block->host + offset,
+                                       clear - set);
+    }
+
+    if (migrate_use_multifd() && multifd_recv_wait_ramblock() < 0) {
+        return -EIO;
+    }
+
+    /* the rest of the stream comes after the pages */
+    qemu_set_offset(f, block->pages_offset + length);
+    return qemu_file_get_error(f);
+}
+
 /**
  * ram_load_precopy: load pages in precopy case
  *
@@ -4396,6 +4573,9 @@ static int ram_load_precopy(QEMUFile *f)
                             ret = -EINVAL;
                         }
                     }
+                    if (!ret && migrate_mapped_ram()) {
+                        ret = mapped_ram_load_ramblock(f, block, length);
+                    }
                     ram_control_load_hook(f, RAM_CONTROL_BLOCK_REG,
                                           block->idstr);
                 } else {
@@ -211,15 +211,116 @@ plugin_register_cb_udata(qemu_plugin_id_t id, enum qemu_plugin_event ev,
     do_plugin_register_cb(id, ev, func, udata);
 }
 
+static struct qemu_plugin_mem_buffer_vcpu *
+plugin_mem_buffer_vcpu(struct qemu_plugin_mem_buffer *buf,
+                       unsigned int cpu_index)
+{
+    GArray *data = buf->score->data;
+
+    return (struct qemu_plugin_mem_buffer_vcpu *)
+        (data->data + cpu_index * g_array_get_element_size(data));
+}
+
+/*
+ * Disable CFI checks.
+ * The callback function has been loaded from an external library so we do not
+ * have type information
+ */
+QEMU_DISABLE_CFI
+void qemu_plugin_mem_buffer_flush(struct qemu_plugin_mem_buffer *buf,
+                                  unsigned int cpu_index)
+{
+    struct qemu_plugin_mem_buffer_vcpu *vbuf =
+        plugin_mem_buffer_vcpu(buf, cpu_index);
+
+    if (vbuf->n) {
+        buf->cb(cpu_index, vbuf->records, vbuf->n, buf->userdata);
+        vbuf->n = 0;
+    }
+}
+
+static void plugin_mem_buffers_flush(unsigned int cpu_index)
+{
+    struct qemu_plugin_mem_buffer *buf, *next;
+
+    /* iterate safely; plugins might uninstall themselves at any time */
+    QLIST_FOREACH_SAFE_RCU(buf, &plugin.mem_buffers, entry, next) {
+        qemu_plugin_mem_buffer_flush(buf, cpu_index);
+    }
+}
+
+/* for the accesses from helpers, see qemu_plugin_vcpu_mem_cb() */
+static void plugin_mem_buffer_append(const struct qemu_plugin_dyn_cb *cb,
+                                     unsigned int cpu_index, uint64_t vaddr,
+                                     qemu_plugin_meminfo_t info)
+{
+    struct qemu_plugin_mem_buffer *buf = cb->buffer.buf;
+    struct qemu_plugin_mem_buffer_vcpu *vbuf =
+        plugin_mem_buffer_vcpu(buf, cpu_index);
+    struct qemu_plugin_mem_record *rec = &vbuf->records[vbuf->n++];
+
+    rec->vaddr = vaddr;
+    rec->insn_vaddr = cb->buffer.insn_vaddr;
+    rec->userdata = cb->userp;
+    rec->info = info;
+    /* keep the room reserved for the rest of the instruction */
+    if (vbuf->n + vbuf->reserved > buf->n_records) {
+        qemu_plugin_mem_buffer_flush(buf, cpu_index);
+    }
+}
+
+static void plugin_grow_scoreboards__locked(CPUState *cpu)
+{
+    size_t scoreboard_size = plugin.scoreboard_alloc_size;
+    struct qemu_plugin_scoreboard *score;
+
+    if (cpu->cpu_index < scoreboard_size) {
+        return;
+    }
+    while (cpu->cpu_index >= scoreboard_size) {
+        scoreboard_size *= 2;
+    }
+    if (QLIST_EMPTY(&plugin.scoreboards)) {
+        /* just update size for future scoreboards */
+        plugin.scoreboard_alloc_size = scoreboard_size;
+        return;
+    }
+
+    /*
+     * The generated code has the address of the scoreboards embedded,
+     * so no vCPU may run while they are moved, and the TBs must be gone
+     * before any runs again. Locking order: start_exclusive() before
+     * plugin.lock, as in qemu_plugin_user_exit().
+     *
+     * This is only reached from the thread creating a vCPU in user mode;
+     * in system mode all the entries are reserved when loading plugins.
+     */
+    qemu_rec_mutex_unlock(&plugin.lock);
+    start_exclusive();
+    qemu_rec_mutex_lock(&plugin.lock);
+    /* another vCPU might have been created in the meantime */
+    if (scoreboard_size > plugin.scoreboard_alloc_size) {
+        QLIST_FOREACH(score, &plugin.scoreboards, entry) {
+            g_array_set_size(score->data, scoreboard_size);
+        }
+        plugin.scoreboard_alloc_size = scoreboard_size;
+        tb_flush(current_cpu);
+    }
+    end_exclusive();
+}
+
 void qemu_plugin_vcpu_init_hook(CPUState *cpu)
 {
     bool success;
 
     qemu_rec_mutex_lock(&plugin.lock);
+    qatomic_set(&plugin.num_vcpus,
+                MAX(plugin.num_vcpus, cpu->cpu_index + 1));
     plugin_cpu_update__locked(&cpu->cpu_index, NULL, NULL);
     success = g_hash_table_insert(plugin.cpu_ht, &cpu->cpu_index,
                                   &cpu->cpu_index);
     g_assert(success);
+    plugin_grow_scoreboards__locked(cpu);
     qemu_rec_mutex_unlock(&plugin.lock);
 
     plugin_vcpu_cb__simple(cpu, QEMU_PLUGIN_EV_VCPU_INIT);
@@ -229,6 +330,7 @@ void qemu_plugin_vcpu_exit_hook(CPUState *cpu)
 {
     bool success;
 
+    plugin_mem_buffers_flush(cpu->cpu_index);
     plugin_vcpu_cb__simple(cpu, QEMU_PLUGIN_EV_VCPU_EXIT);
 
     qemu_rec_mutex_lock(&plugin.lock);
@@ -265,6 +367,11 @@ void qemu_plugin_vcpu_for_each(qemu_plugin_id_t id,
     qemu_rec_mutex_unlock(&plugin.lock);
 }
 
+int qemu_plugin_num_vcpus(void)
+{
+    return qatomic_read(&plugin.num_vcpus);
+}
+
 /* Allocate and return a callback record */
 static struct qemu_plugin_dyn_cb *plugin_get_dyn_cb(GArray **arr)
 {
@@ -291,6 +398,25 @@ void plugin_register_inline_op(GArray **arr,
     dyn_cb->userp = ptr;
     dyn_cb->type = PLUGIN_CB_INLINE;
     dyn_cb->rw = rw;
+    dyn_cb->inline_insn.entry.score = NULL;
+    dyn_cb->inline_insn.entry.offset = 0;
+    dyn_cb->inline_insn.op = op;
+    dyn_cb->inline_insn.imm = imm;
+}
+
+void plugin_register_inline_op_on_entry(GArray **arr,
+                                        enum qemu_plugin_mem_rw rw,
+                                        enum qemu_plugin_op op,
+                                        qemu_plugin_u64 entry,
+                                        uint64_t imm)
+{
+    struct qemu_plugin_dyn_cb *dyn_cb;
+
+    dyn_cb = plugin_get_dyn_cb(arr);
+    dyn_cb->userp = NULL;
+    dyn_cb->type = PLUGIN_CB_INLINE;
+    dyn_cb->rw = rw;
+    dyn_cb->inline_insn.entry = entry;
     dyn_cb->inline_insn.op = op;
     dyn_cb->inline_insn.imm = imm;
 }
@@ -308,6 +434,40 @@ void plugin_register_dyn_cb__udata(GArray **arr,
     dyn_cb->type = PLUGIN_CB_REGULAR;
 }
 
+void plugin_register_dyn_cond_cb__udata(GArray **arr,
+                                        qemu_plugin_vcpu_udata_cb_t cb,
+                                        enum qemu_plugin_cb_flags flags,
+                                        enum qemu_plugin_cond cond,
+                                        qemu_plugin_u64 entry,
+                                        uint64_t imm,
+                                        void *udata)
+{
+    struct qemu_plugin_dyn_cb *dyn_cb = plugin_get_dyn_cb(arr);
+
+    dyn_cb->userp = udata;
+    /* Note flags are discarded as unused. */
+    dyn_cb->f.vcpu_udata = cb;
+    dyn_cb->type = PLUGIN_CB_COND;
+    dyn_cb->cond.cond = cond;
+    dyn_cb->cond.entry = entry;
+    dyn_cb->cond.imm = imm;
+}
+
+void plugin_register_buffer_cb(GArray **arr,
+                               struct qemu_plugin_mem_buffer *buf,
+                               enum qemu_plugin_mem_rw rw,
+                               uint64_t insn_vaddr,
+                               void *userdata)
+{
+    struct qemu_plugin_dyn_cb *dyn_cb = plugin_get_dyn_cb(arr);
+
+    dyn_cb->userp = userdata;
+    dyn_cb->type = PLUGIN_CB_BUFFER;
+    dyn_cb->rw = rw;
+    dyn_cb->buffer.buf = buf;
+    dyn_cb->buffer.insn_vaddr = insn_vaddr;
+}
+
 void plugin_register_vcpu_mem_cb(GArray **arr,
                                  void *cb,
                                  enum qemu_plugin_cb_flags flags,
@@ -358,6 +518,9 @@ qemu_plugin_vcpu_syscall(CPUState *cpu, int64_t num, uint64_t a1, uint64_t a2,
     struct qemu_plugin_cb *cb, *next;
     enum qemu_plugin_event ev = QEMU_PLUGIN_EV_VCPU_SYSCALL;
 
+    /* the accesses before the syscall are seen before its effects */
+    plugin_mem_buffers_flush(cpu->cpu_index);
+
     if (!test_bit(ev, cpu->plugin_mask)) {
         return;
     }
@@ -393,6 +556,7 @@ void qemu_plugin_vcpu_syscall_ret(CPUState *cpu, int64_t num, int64_t ret)
 
 void qemu_plugin_vcpu_idle_cb(CPUState *cpu)
 {
+    plugin_mem_buffers_flush(cpu->cpu_index);
     plugin_vcpu_cb__simple(cpu, QEMU_PLUGIN_EV_VCPU_IDLE);
 }
 
@@ -433,14 +597,25 @@ void qemu_plugin_flush_cb(void)
     plugin_cb__simple(QEMU_PLUGIN_EV_FLUSH);
 }
 
-void exec_inline_op(struct qemu_plugin_dyn_cb *cb)
+void exec_inline_op(struct qemu_plugin_dyn_cb *cb, int cpu_index)
 {
+    qemu_plugin_u64 entry = cb->inline_insn.entry;
     uint64_t *val = cb->userp;
 
+    if (entry.score) {
+        GArray *data = entry.score->data;
+
+        val = (uint64_t *)(data->data + entry.offset +
+                           cpu_index * g_array_get_element_size(data));
+    }
+
     switch (cb->inline_insn.op) {
     case QEMU_PLUGIN_INLINE_ADD_U64:
         *val += cb->inline_insn.imm;
         break;
+    case QEMU_PLUGIN_INLINE_STORE_U64:
+        *val = cb->inline_insn.imm;
+        break;
     default:
         g_assert_not_reached();
     }
@@ -468,7 +643,11 @@ void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
                            vaddr, cb->userp);
             break;
         case PLUGIN_CB_INLINE:
-            exec_inline_op(cb);
+            exec_inline_op(cb, cpu->cpu_index);
+            break;
+        case PLUGIN_CB_BUFFER:
+            plugin_mem_buffer_append(cb, cpu->cpu_index, vaddr,
+                                     make_plugin_meminfo(oi, rw));
             break;
         default:
             g_assert_not_reached();
@@ -478,6 +657,11 @@ void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
 
 void qemu_plugin_atexit_cb(void)
 {
+    int i;
+
+    for (i = 0; i < qemu_plugin_num_vcpus(); i++) {
+        plugin_mem_buffers_flush(i);
+    }
     plugin_cb__udata(QEMU_PLUGIN_EV_ATEXIT);
 }
 
@@ -553,6 +737,86 @@ void qemu_plugin_user_postfork(bool is_child)
     }
 }
 
+struct qemu_plugin_scoreboard *plugin_scoreboard_new(size_t element_size)
+{
+    struct qemu_plugin_scoreboard *score =
+        g_malloc0(sizeof(struct qemu_plugin_scoreboard));
+
+    score->data = g_array_new(false, true, element_size);
+
+    qemu_rec_mutex_lock(&plugin.lock);
+    g_array_set_size(score->data, plugin.scoreboard_alloc_size);
+    QLIST_INSERT_HEAD(&plugin.scoreboards, score, entry);
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    return score;
+}
+
+void plugin_scoreboard_free(struct qemu_plugin_scoreboard *score)
+{
+    qemu_rec_mutex_lock(&plugin.lock);
+    QLIST_REMOVE(score, entry);
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    g_array_free(score->data, true);
+    g_free(score);
+}
+
+/* Called before any code is translated, so there is nothing to flush. */
+void plugin_scoreboard_reserve(int n_vcpus)
+{
+    struct qemu_plugin_scoreboard *score;
+
+    qemu_rec_mutex_lock(&plugin.lock);
+    while (plugin.scoreboard_alloc_size < n_vcpus) {
+        plugin.scoreboard_alloc_size *= 2;
+    }
+    QLIST_FOREACH(score, &plugin.scoreboards, entry) {
+        g_array_set_size(score->data, plugin.scoreboard_alloc_size);
+    }
+    qemu_rec_mutex_unlock(&plugin.lock);
+}
+
+struct qemu_plugin_mem_buffer *
+plugin_mem_buffer_new(qemu_plugin_id_t id,
+                      qemu_plugin_vcpu_mem_buffer_cb_t cb,
+                      size_t n_records, void *userdata)
+{
+    struct qemu_plugin_mem_buffer *buf = g_new0(struct qemu_plugin_mem_buffer,
+                                                1);
+
+    buf->score = plugin_scoreboard_new(
+        sizeof(struct qemu_plugin_mem_buffer_vcpu) +
+        n_records * sizeof(struct qemu_plugin_mem_record));
+    buf->n_records = n_records;
+    buf->cb = cb;
+    buf->userdata = userdata;
+
+    qemu_rec_mutex_lock(&plugin.lock);
+    buf->ctx = plugin_id_to_ctx_locked(id);
+    QLIST_INSERT_HEAD_RCU(&plugin.mem_buffers, buf, entry);
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    return buf;
+}
+
+/*
+ * As for the callbacks, there is no need to wait for an RCU grace period:
+ * this is called with all vCPUs asleep, see plugin_reset_destroy__locked().
+ */
+void plugin_mem_buffers_free__locked(struct qemu_plugin_ctx *ctx)
+{
+    struct qemu_plugin_mem_buffer *buf, *next;
+
+    QLIST_FOREACH_SAFE(buf, &plugin.mem_buffers, entry, next) {
+        if (buf->ctx == ctx) {
+            QLIST_REMOVE_RCU(buf, entry);
+            plugin_scoreboard_free(buf->score);
+            g_free(buf);
+        }
+    }
+}
+
 static bool plugin_dyn_cb_arr_cmp(const void *ap, const void *bp)
 {
     return ap == bp;
@@ -569,6 +833,9 @@ static void __attribute__((__constructor__)) plugin_init(void)
     plugin.id_ht = g_hash_table_new(g_int64_hash, g_int64_equal);
     plugin.cpu_ht = g_hash_table_new(g_int_hash, g_int_equal);
     QTAILQ_INIT(&plugin.ctxs);
+    QLIST_INIT(&plugin.scoreboards);
+    QLIST_INIT(&plugin.mem_buffers);
+    plugin.scoreboard_alloc_size = 16; /* avoid frequent reallocation */
     qht_init(&plugin.dyn_cb_arr_ht, plugin_dyn_cb_arr_cmp, 16,
              QHT_MODE_AUTO_RESIZE);
     atexit(qemu_plugin_atexit_cb);
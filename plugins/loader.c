@@ -300,6 +300,7 @@ int qemu_plugin_load_list(QemuPluginList *head, Error **errp)
     info->system_emulation = true;
     info->system.smp_vcpus = ms->smp.cpus;
     info->system.max_vcpus = ms->smp.max_cpus;
+    plugin_scoreboard_reserve(ms->smp.max_cpus);
 #else
     info->system_emulation = false;
 #endif
@@ -356,6 +357,7 @@ static void plugin_reset_destroy__locked(struct qemu_plugin_reset_data *data)
         abort();
     }
 
+    plugin_mem_buffers_free__locked(ctx);
     success = g_hash_table_remove(plugin.id_ht, &ctx->id);
     g_assert(success);
     QTAILQ_REMOVE(&plugin.ctxs, ctx, entry);
@@ -44,6 +44,13 @@ struct qemu_plugin_state {
      * the code cache is flushed.
      */
     struct qht dyn_cb_arr_ht;
+    /* number of vcpus initialized so far, see qemu_plugin_num_vcpus() */
+    int num_vcpus;
+    /* all scoreboards, and the number of entries allocated in each */
+    QLIST_HEAD(, qemu_plugin_scoreboard) scoreboards;
+    size_t scoreboard_alloc_size;
+    /* all trace buffers; written under @lock, traversed with RCU */
+    QLIST_HEAD(, qemu_plugin_mem_buffer) mem_buffers;
 };
 
 
@@ -69,6 +76,12 @@ void plugin_register_inline_op(GArray **arr,
                                enum qemu_plugin_op op, void *ptr,
                                uint64_t imm);
 
+void plugin_register_inline_op_on_entry(GArray **arr,
+                                        enum qemu_plugin_mem_rw rw,
+                                        enum qemu_plugin_op op,
+                                        qemu_plugin_u64 entry,
+                                        uint64_t imm);
+
 void plugin_reset_uninstall(qemu_plugin_id_t id,
                             qemu_plugin_simple_cb_t cb,
                             bool reset);
@@ -89,12 +102,41 @@ plugin_register_dyn_cb__udata(GArray **arr,
                               enum qemu_plugin_cb_flags flags, void *udata);
 
 
+void plugin_register_dyn_cond_cb__udata(GArray **arr,
+                                        qemu_plugin_vcpu_udata_cb_t cb,
+                                        enum qemu_plugin_cb_flags flags,
+                                        enum qemu_plugin_cond cond,
+                                        qemu_plugin_u64 entry,
+                                        uint64_t imm,
+                                        void *udata);
+
 void plugin_register_vcpu_mem_cb(GArray **arr,
                                  void *cb,
                                  enum qemu_plugin_cb_flags flags,
                                  enum qemu_plugin_mem_rw rw,
                                  void *udata);
 
-void exec_inline_op(struct qemu_plugin_dyn_cb *cb);
+void exec_inline_op(struct qemu_plugin_dyn_cb *cb, int cpu_index);
+
+struct qemu_plugin_scoreboard *plugin_scoreboard_new(size_t element_size);
+
+void plugin_scoreboard_free(struct qemu_plugin_scoreboard *score);
+
+/* Allocate scoreboard entries for at least @n_vcpus vCPUs upfront. */
+void plugin_scoreboard_reserve(int n_vcpus);
+
+struct qemu_plugin_mem_buffer *
+plugin_mem_buffer_new(qemu_plugin_id_t id,
+                      qemu_plugin_vcpu_mem_buffer_cb_t cb,
+                      size_t n_records, void *userdata);
+
+/* Free the trace buffers of @ctx, dropping any pending records. */
+void plugin_mem_buffers_free__locked(struct qemu_plugin_ctx *ctx);
+
+void plugin_register_buffer_cb(GArray **arr,
+                               struct qemu_plugin_mem_buffer *buf,
+                               enum qemu_plugin_mem_rw rw,
+                               uint64_t insn_vaddr,
+                               void *userdata);
 
 #endif /* PLUGIN_H */
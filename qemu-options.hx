@@ -179,14 +179,19 @@ ERST
 DEF("accel", HAS_ARG, QEMU_OPTION_accel,
     "-accel [accel=]accelerator[,prop[=value][,...]]\n"
     "                select accelerator (kvm, xen, hax, hvf, nvmm, whpx or tcg; use 'help' for a list)\n"
+    "                cse=on|off (TCG common subexpression and redundant store elimination, default=on)\n"
+    "                global-regs=n (keep up to n TCG globals in host registers across branches)\n"
     "                igd-passthru=on|off (enable Xen integrated Intel graphics passthrough, default=off)\n"
     "                kernel-irqchip=on|off|split controls accelerated irqchip support (default=on)\n"
     "                kvm-shadow-mem=size of KVM shadow MMU in bytes\n"
     "                split-wx=on|off (enable TCG split w^x mapping)\n"
+    "                superblock-threshold=n (retranslate TBs executed n times as superblocks)\n"
     "                tb-size=n (TCG translation block cache size)\n"
+    "                tb-stats=on|off (collect per-TB execution statistics, default=off)\n"
     "                dirty-ring-size=n (KVM dirty ring GFN count, default 0)\n"
     "                notify-vmexit=run|internal-error|disable,notify-window=n (enable notify VM exit and set notify window, x86 only)\n"
-    "                thread=single|multi (enable multi-threaded TCG)\n", QEMU_ARCH_ALL)
+    "                thread=single|multi (enable multi-threaded TCG)\n"
+    "                translate-threads=n (translate superblocks in n background threads)\n", QEMU_ARCH_ALL)
 SRST
 ``-accel name[,prop=value[,...]]``
     This is used to enable an accelerator. Depending on the target
@@ -195,6 +200,20 @@ SRST
     specified, the next one is used if the previous one fails to
     initialize.
 
+    ``cse=on|off``
+        Controls the TCG optimizer passes that reuse values already
+        computed or loaded earlier in a basic block and remove stores to
+        the CPU state that are overwritten before anything reads them.
+        The number of ops left by each pass is shown by ``-d op_opt``.
+        The default is on.
+
+    ``global-regs=n``
+        Lets the TCG register allocator keep up to n guest registers in
+        host registers across the branches within a translation block,
+        rather than storing them at each branch and reloading them after
+        each label. Helper calls that do not access guest registers keep
+        them too. The default is 0, which disables this.
+
     ``igd-passthru=on|off``
         When Xen is in use, this option controls whether Intel
         integrated graphics devices can be passed through to the guest
@@ -216,9 +235,25 @@ SRST
         such a case this will default on. On other operating systems, this
         will default off, but one may enable this for testing or debugging.
 
+    ``superblock-threshold=n``
+        Enables tiered translation. Once a TCG translation block has been
+        executed n times, it is retranslated as a superblock that extends
+        across branches, on targets that support it. The default is 0,
+        which disables superblock formation.
+
     ``tb-size=n``
         Controls the size (in MiB) of the TCG translation block cache.
 
+    ``tb-stats=on|off``
+        Collects statistics for each TCG translation block: how many
+        times it was executed and retranslated, its size in guest
+        instructions and host code, and the register spills it contains.
+        Executions are counted by the generated code. The most executed
+        blocks are listed by the ``info tb-hot`` monitor command. The
+        statistics of code that did not run between two flushes of the
+        translation cache are discarded. The default is off. Not
+        available with user-mode emulation.
+
     ``thread=single|multi``
         Controls number of TCG threads. When the TCG is multi-threaded
         there will be one thread per vCPU therefore taking advantage of
@@ -227,6 +262,14 @@ SRST
         incompatible TCG features have been enabled (e.g.
         icount/replay).
 
+    ``translate-threads=n``
+        Hands the retranslation of hot translation blocks as superblocks
+        (see ``superblock-threshold``) to a pool of n background threads,
+        so that vCPUs keep running the existing code in the meantime.
+        Requires ``thread=multi``, and is currently only implemented for
+        RISC-V guests. The default is 0, which translates superblocks on
+        the vCPU thread.
+
     ``dirty-ring-size=n``
         When the KVM accelerator is used, it controls the size of the per-vCPU
         dirty page ring buffer (number of entries for each vCPU). It should
@@ -4535,6 +4578,9 @@ DEF("incoming", HAS_ARG, QEMU_OPTION_incoming, \
     "-incoming exec:cmdline\n" \
     "                accept incoming migration on given file descriptor\n" \
     "                or from given external command\n" \
+    "-incoming file:filename[,offset=offset]\n" \
+    "                accept incoming migration from a given file\n" \
+    "                starting at offset (default: 0)\n" \
     "-incoming defer\n" \
     "                wait for the URI to be specified via migrate_incoming\n",
     QEMU_ARCH_ALL)
@@ -4554,6 +4600,10 @@ SRST
     Accept incoming migration as an output from specified external
     command.
 
+``-incoming file:filename[,offset=offset]``
+    Accept incoming migration from a given file starting at offset.
+    offset allows the common size suffixes, or a 0x prefix, but not both.
+
 ``-incoming defer``
     Wait for the URI to be specified via migrate\_incoming. The monitor
     can be used to change settings (such as migration parameters) prior
@@ -828,6 +828,79 @@ TRANS_FEAT(UQSUB_zzz, aa64_sve, gen_gvec_fn_arg_zzz, tcg_gen_gvec_ussub, a)
  *** SVE Integer Arithmetic - Binary Predicated Group
  */
 
+/*
+ * Branch to @label unless all elements of size @esz are active in @pg.
+ *
+ * A loop over a vector typically runs with an all-true governing
+ * predicate until its last iteration, so the common predicated
+ * operations test for that at runtime and then use the host vector
+ * expansion of the unpredicated operation, calling the out-of-line
+ * helper only for a partial predicate.
+ */
+static void gen_brcond_pred_partial(DisasContext *s, int pg, int esz,
+                                    TCGLabel *label)
+{
+    unsigned psz = pred_full_reg_size(s);
+    TCGv_i64 t = tcg_temp_new_i64();
+    unsigned i;
+
+    for (i = 0; i < psz; i += 8) {
+        uint64_t mask = pred_esz_masks[esz];
+
+        if (psz - i < 8) {
+            mask &= MAKE_64BIT_MASK(0, (psz - i) * 8);
+        }
+        tcg_gen_ld_i64(t, cpu_env, pred_full_reg_offset(s, pg) + i);
+        tcg_gen_andi_i64(t, t, mask);
+        tcg_gen_brcondi_i64(TCG_COND_NE, t, mask, label);
+    }
+}
+
+/*
+ * Invoke a vector expander on 3 Zregs if all elements are active in
+ * the predicate, and an out-of-line helper otherwise.
+ */
+static bool gen_gvec_fn_zzzp(DisasContext *s, GVecGen3Fn *gvec_fn,
+                             gen_helper_gvec_4 *fn, int esz,
+                             int rd, int rn, int rm, int pg)
+{
+    if (fn == NULL) {
+        return false;
+    }
+    if (sve_access_check(s)) {
+        unsigned vsz = vec_full_reg_size(s);
+        TCGLabel *partial = gen_new_label();
+        TCGLabel *done = gen_new_label();
+
+        gen_brcond_pred_partial(s, pg, esz, partial);
+        gvec_fn(esz, vec_full_reg_offset(s, rd), vec_full_reg_offset(s, rn),
+                vec_full_reg_offset(s, rm), vsz, vsz);
+        tcg_gen_br(done);
+
+        gen_set_label(partial);
+        tcg_gen_gvec_4_ool(vec_full_reg_offset(s, rd),
+                           vec_full_reg_offset(s, rn),
+                           vec_full_reg_offset(s, rm),
+                           pred_full_reg_offset(s, pg),
+                           vsz, vsz, 0, fn);
+        gen_set_label(done);
+    }
+    return true;
+}
+
+static bool gen_gvec_fn_arg_zpzz(DisasContext *s, GVecGen3Fn *gvec_fn,
+                                 gen_helper_gvec_4 *fn, arg_rprr_esz *a)
+{
+    return gen_gvec_fn_zzzp(s, gvec_fn, fn, a->esz,
+                            a->rd, a->rn, a->rm, a->pg);
+}
+
+static void gen_sel_all_z(unsigned vece, uint32_t rd_ofs, uint32_t rn_ofs,
+                          uint32_t rm_ofs, uint32_t oprsz, uint32_t maxsz)
+{
+    tcg_gen_gvec_mov(vece, rd_ofs, rn_ofs, oprsz, maxsz);
+}
+
 /* Select active elememnts from Zn and inactive elements from Zm,
  * storing the result in Zd.
  */
@@ -837,7 +910,7 @@ static bool do_sel_z(DisasContext *s, int rd, int rn, int rm, int pg, int esz)
         gen_helper_sve_sel_zpzz_b, gen_helper_sve_sel_zpzz_h,
         gen_helper_sve_sel_zpzz_s, gen_helper_sve_sel_zpzz_d
     };
-    return gen_gvec_ool_zzzp(s, fns[esz], rd, rn, rm, pg, 0);
+    return gen_gvec_fn_zzzp(s, gen_sel_all_z, fns[esz], esz, rd, rn, rm, pg);
 }
 
 #define DO_ZPZZ(NAME, FEAT, name) \
@@ -848,22 +921,31 @@ static bool do_sel_z(DisasContext *s, int rd, int rn, int rm, int pg, int esz)
     TRANS_FEAT(NAME, FEAT, gen_gvec_ool_arg_zpzz,                         \
                name##_zpzz_fns[a->esz], a, 0)
 
-DO_ZPZZ(AND_zpzz, aa64_sve, sve_and)
-DO_ZPZZ(EOR_zpzz, aa64_sve, sve_eor)
-DO_ZPZZ(ORR_zpzz, aa64_sve, sve_orr)
-DO_ZPZZ(BIC_zpzz, aa64_sve, sve_bic)
+/* As DO_ZPZZ, with @gvec_fn implementing the unpredicated operation. */
+#define DO_ZPZZ_GVEC(NAME, FEAT, name, gvec_fn) \
+    static gen_helper_gvec_4 * const name##_zpzz_fns[4] = {               \
+        gen_helper_##name##_zpzz_b, gen_helper_##name##_zpzz_h,           \
+        gen_helper_##name##_zpzz_s, gen_helper_##name##_zpzz_d,           \
+    };                                                                    \
+    TRANS_FEAT(NAME, FEAT, gen_gvec_fn_arg_zpzz, gvec_fn,                 \
+               name##_zpzz_fns[a->esz], a)
+
+DO_ZPZZ_GVEC(AND_zpzz, aa64_sve, sve_and, tcg_gen_gvec_and)
+DO_ZPZZ_GVEC(EOR_zpzz, aa64_sve, sve_eor, tcg_gen_gvec_xor)
+DO_ZPZZ_GVEC(ORR_zpzz, aa64_sve, sve_orr, tcg_gen_gvec_or)
+DO_ZPZZ_GVEC(BIC_zpzz, aa64_sve, sve_bic, tcg_gen_gvec_andc)
 
-DO_ZPZZ(ADD_zpzz, aa64_sve, sve_add)
-DO_ZPZZ(SUB_zpzz, aa64_sve, sve_sub)
+DO_ZPZZ_GVEC(ADD_zpzz, aa64_sve, sve_add, tcg_gen_gvec_add)
+DO_ZPZZ_GVEC(SUB_zpzz, aa64_sve, sve_sub, tcg_gen_gvec_sub)
 
-DO_ZPZZ(SMAX_zpzz, aa64_sve, sve_smax)
-DO_ZPZZ(UMAX_zpzz, aa64_sve, sve_umax)
-DO_ZPZZ(SMIN_zpzz, aa64_sve, sve_smin)
-DO_ZPZZ(UMIN_zpzz, aa64_sve, sve_umin)
-DO_ZPZZ(SABD_zpzz, aa64_sve, sve_sabd)
-DO_ZPZZ(UABD_zpzz, aa64_sve, sve_uabd)
+DO_ZPZZ_GVEC(SMAX_zpzz, aa64_sve, sve_smax, tcg_gen_gvec_smax)
+DO_ZPZZ_GVEC(UMAX_zpzz, aa64_sve, sve_umax, tcg_gen_gvec_umax)
+DO_ZPZZ_GVEC(SMIN_zpzz, aa64_sve, sve_smin, tcg_gen_gvec_smin)
+DO_ZPZZ_GVEC(UMIN_zpzz, aa64_sve, sve_umin, tcg_gen_gvec_umin)
+DO_ZPZZ_GVEC(SABD_zpzz, aa64_sve, sve_sabd, gen_gvec_sabd)
+DO_ZPZZ_GVEC(UABD_zpzz, aa64_sve, sve_uabd, gen_gvec_uabd)
 
-DO_ZPZZ(MUL_zpzz, aa64_sve, sve_mul)
+DO_ZPZZ_GVEC(MUL_zpzz, aa64_sve, sve_mul, tcg_gen_gvec_mul)
 DO_ZPZZ(SMULH_zpzz, aa64_sve, sve_smulh)
 DO_ZPZZ(UMULH_zpzz, aa64_sve, sve_umulh)
 
@@ -887,6 +969,36 @@ TRANS_FEAT(SEL_zpzz, aa64_sve, do_sel_z, a->rd, a->rn, a->rm, a->pg, a->esz)
  *** SVE Integer Arithmetic - Unary Predicated Group
  */
 
+/*
+ * Invoke a vector expander on 2 Zregs if all elements are active in
+ * the predicate, and an out-of-line helper otherwise.
+ */
+static bool gen_gvec_fn_arg_zpz(DisasContext *s, GVecGen2Fn *gvec_fn,
+                                gen_helper_gvec_3 *fn, arg_rpr_esz *a)
+{
+    if (fn == NULL) {
+        return false;
+    }
+    if (sve_access_check(s)) {
+        unsigned vsz = vec_full_reg_size(s);
+        TCGLabel *partial = gen_new_label();
+        TCGLabel *done = gen_new_label();
+
+        gen_brcond_pred_partial(s, a->pg, a->esz, partial);
+        gvec_fn(a->esz, vec_full_reg_offset(s, a->rd),
+                vec_full_reg_offset(s, a->rn), vsz, vsz);
+        tcg_gen_br(done);
+
+        gen_set_label(partial);
+        tcg_gen_gvec_3_ool(vec_full_reg_offset(s, a->rd),
+                           vec_full_reg_offset(s, a->rn),
+                           pred_full_reg_offset(s, a->pg),
+                           vsz, vsz, 0, fn);
+        gen_set_label(done);
+    }
+    return true;
+}
+
 #define DO_ZPZ(NAME, FEAT, name) \
     static gen_helper_gvec_3 * const name##_fns[4] = {              \
         gen_helper_##name##_b, gen_helper_##name##_h,               \
@@ -894,13 +1006,21 @@ TRANS_FEAT(SEL_zpzz, aa64_sve, do_sel_z, a->rd, a->rn, a->rm, a->pg, a->esz)
     };                                                              \
     TRANS_FEAT(NAME, FEAT, gen_gvec_ool_arg_zpz, name##_fns[a->esz], a, 0)
 
+#define DO_ZPZ_GVEC(NAME, FEAT, name, gvec_fn) \
+    static gen_helper_gvec_3 * const name##_fns[4] = {              \
+        gen_helper_##name##_b, gen_helper_##name##_h,               \
+        gen_helper_##name##_s, gen_helper_##name##_d,               \
+    };                                                              \
+    TRANS_FEAT(NAME, FEAT, gen_gvec_fn_arg_zpz, gvec_fn,            \
+               name##_fns[a->esz], a)
+
 DO_ZPZ(CLS, aa64_sve, sve_cls)
 DO_ZPZ(CLZ, aa64_sve, sve_clz)
 DO_ZPZ(CNT_zpz, aa64_sve, sve_cnt_zpz)
 DO_ZPZ(CNOT, aa64_sve, sve_cnot)
-DO_ZPZ(NOT_zpz, aa64_sve, sve_not_zpz)
-DO_ZPZ(ABS, aa64_sve, sve_abs)
-DO_ZPZ(NEG, aa64_sve, sve_neg)
+DO_ZPZ_GVEC(NOT_zpz, aa64_sve, sve_not_zpz, tcg_gen_gvec_not)
+DO_ZPZ_GVEC(ABS, aa64_sve, sve_abs, tcg_gen_gvec_abs)
+DO_ZPZ_GVEC(NEG, aa64_sve, sve_neg, tcg_gen_gvec_neg)
 DO_ZPZ(RBIT, aa64_sve, sve_rbit)
 
 static gen_helper_gvec_3 * const fabs_fns[4] = {
@@ -1174,17 +1294,37 @@ DO_ZZW(LSL_zzw, lsl)
  *** SVE Integer Multiply-Add Group
  */
 
+/*
+ * For the accumulating forms, where Zd is also the addend, @gvec_fn
+ * implements the operation when all elements are active.
+ */
 static bool do_zpzzz_ool(DisasContext *s, arg_rprrr_esz *a,
-                         gen_helper_gvec_5 *fn)
+                         GVecGen3Fn *gvec_fn, gen_helper_gvec_5 *fn)
 {
     if (sve_access_check(s)) {
         unsigned vsz = vec_full_reg_size(s);
+        TCGLabel *partial = NULL;
+        TCGLabel *done = NULL;
+
+        if (a->rd == a->ra) {
+            partial = gen_new_label();
+            done = gen_new_label();
+            gen_brcond_pred_partial(s, a->pg, a->esz, partial);
+            gvec_fn(a->esz, vec_full_reg_offset(s, a->rd),
+                    vec_full_reg_offset(s, a->rn),
+                    vec_full_reg_offset(s, a->rm), vsz, vsz);
+            tcg_gen_br(done);
+            gen_set_label(partial);
+        }
         tcg_gen_gvec_5_ool(vec_full_reg_offset(s, a->rd),
                            vec_full_reg_offset(s, a->ra),
                            vec_full_reg_offset(s, a->rn),
                            vec_full_reg_offset(s, a->rm),
                            pred_full_reg_offset(s, a->pg),
                            vsz, vsz, 0, fn);
+        if (done) {
+            gen_set_label(done);
+        }
     }
     return true;
 }
@@ -1193,13 +1333,13 @@ static gen_helper_gvec_5 * const mla_fns[4] = {
     gen_helper_sve_mla_b, gen_helper_sve_mla_h,
     gen_helper_sve_mla_s, gen_helper_sve_mla_d,
 };
-TRANS_FEAT(MLA, aa64_sve, do_zpzzz_ool, a, mla_fns[a->esz])
+TRANS_FEAT(MLA, aa64_sve, do_zpzzz_ool, a, gen_gvec_mla, mla_fns[a->esz])
 
 static gen_helper_gvec_5 * const mls_fns[4] = {
     gen_helper_sve_mls_b, gen_helper_sve_mls_h,
     gen_helper_sve_mls_s, gen_helper_sve_mls_d,
 };
-TRANS_FEAT(MLS, aa64_sve, do_zpzzz_ool, a, mls_fns[a->esz])
+TRANS_FEAT(MLS, aa64_sve, do_zpzzz_ool, a, gen_gvec_mls, mls_fns[a->esz])
 
 /*
  *** SVE Index Generation Group
@@ -60,6 +60,8 @@ DEF_HELPER_FLAGS_3(raise_interrupt, TCG_CALL_NO_WG, noreturn, env, int, int)
 DEF_HELPER_FLAGS_2(raise_exception, TCG_CALL_NO_WG, noreturn, env, int)
 DEF_HELPER_3(boundw, void, env, tl, int)
 DEF_HELPER_3(boundl, void, env, tl, int)
+DEF_HELPER_4(rep_stos, void, env, tl, int, int)
+DEF_HELPER_5(rep_movs, void, env, tl, tl, int, int)
 
 #ifndef CONFIG_USER_ONLY
 DEF_HELPER_1(rsm, void, env)
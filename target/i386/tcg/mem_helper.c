@@ -55,3 +55,112 @@ void helper_boundl(CPUX86State *env, target_ulong a0, int v)
         raise_exception_ra(env, EXCP05_BOUND, GETPC());
     }
 }
+
+/*
+ * Bulk parts of REP STOS and REP MOVS with DF=0.  These do the
+ * iterations that fit in the current page of each operand, except the
+ * last iteration, which is left to the translated code.  ECX, ESI and
+ * EDI are only updated after the copy, and each page is checked before
+ * it is written, so a fault leaves them at the first iteration not done.
+ * Pages that are not RAM are left to the translated code as well, so
+ * that devices see accesses of the element size.
+ */
+static target_ulong rep_addr_mask(int aflag)
+{
+    switch (aflag) {
+    case MO_16:
+        return 0xffff;
+    case MO_32:
+        return 0xffffffff;
+    default:
+        return -1;
+    }
+}
+
+/*
+ * Return how many elements of size 1 << @ot can be accessed from the
+ * linear address @addr, whose offset is in register @reg, without
+ * wrapping the offset or leaving the page.
+ */
+static target_ulong rep_limit(CPUX86State *env, int reg, int aflag,
+                              target_ulong addr, int ot)
+{
+    target_ulong amask = rep_addr_mask(aflag);
+    target_ulong to_wrap = (amask - (env->regs[reg] & amask)) >> ot;
+    target_ulong to_page = -(addr | TARGET_PAGE_MASK) >> ot;
+
+    return MIN(to_wrap, to_page);
+}
+
+static void rep_advance(CPUX86State *env, int reg, int aflag,
+                        target_ulong delta)
+{
+    target_ulong val = env->regs[reg] + delta;
+
+    switch (aflag) {
+    case MO_16:
+        env->regs[reg] = (env->regs[reg] & ~0xffff) | (val & 0xffff);
+        break;
+    case MO_32:
+        env->regs[reg] = (uint32_t)val;
+        break;
+    default:
+        env->regs[reg] = val;
+        break;
+    }
+}
+
+void helper_rep_stos(CPUX86State *env, target_ulong a0, int ot, int aflag)
+{
+    target_ulong count = env->regs[R_ECX] & rep_addr_mask(aflag);
+    uint64_t val = env->regs[R_EAX] & MAKE_64BIT_MASK(0, 8 << ot);
+    target_ulong n;
+
+    if (env->df != 1 || count <= 1) {
+        return;
+    }
+    /* Only fills with a repeated byte, as zeroing memory does, are done. */
+    if (val != (uint8_t)val * (0x0101010101010101ull >> (64 - (8 << ot)))) {
+        return;
+    }
+
+    n = MIN(count - 1, rep_limit(env, R_EDI, aflag, a0, ot));
+    if (n == 0) {
+        return;
+    }
+
+    n = cpu_memset_mmuidx_ra(env, a0, val, n << ot,
+                             cpu_mmu_index(env, false), GETPC()) >> ot;
+    rep_advance(env, R_EDI, aflag, n << ot);
+    rep_advance(env, R_ECX, aflag, -n);
+}
+
+void helper_rep_movs(CPUX86State *env, target_ulong dst, target_ulong src,
+                     int ot, int aflag)
+{
+    target_ulong count = env->regs[R_ECX] & rep_addr_mask(aflag);
+    target_ulong n;
+
+    if (env->df != 1 || count <= 1) {
+        return;
+    }
+
+    n = MIN(count - 1, rep_limit(env, R_EDI, aflag, dst, ot));
+    n = MIN(n, rep_limit(env, R_ESI, aflag, src, ot));
+    /*
+     * Copying element by element forward differs from memmove when the
+     * destination starts inside the source; only copy up to that point.
+     */
+    if (dst > src && dst - src < (n << ot)) {
+        n = (dst - src) >> ot;
+    }
+    if (n == 0) {
+        return;
+    }
+
+    n = cpu_memmove_mmuidx_ra(env, dst, src, n << ot,
+                              cpu_mmu_index(env, false), GETPC()) >> ot;
+    rep_advance(env, R_ESI, aflag, n << ot);
+    rep_advance(env, R_EDI, aflag, n << ot);
+    rep_advance(env, R_ECX, aflag, -n);
+}
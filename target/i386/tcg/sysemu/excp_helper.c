@@ -35,6 +35,7 @@ typedef struct TranslateResult {
     hwaddr paddr;
     int prot;
     int page_size;
+    bool page_size_exact;
 } TranslateResult;
 
 typedef enum TranslateFaultStage2 {
@@ -460,6 +461,9 @@ do_check_protect_pse36:
         if (nested_page_size > page_size) {
             page_size = nested_page_size;
         }
+        out->page_size_exact = nested_page_size == page_size;
+    } else {
+        out->page_size_exact = true;
     }
 
     out->paddr = paddr;
@@ -589,6 +593,7 @@ static bool get_physical_address(CPUX86State *env, vaddr addr,
 #endif
     out->prot = PAGE_READ | PAGE_WRITE | PAGE_EXEC;
     out->page_size = TARGET_PAGE_SIZE;
+    out->page_size_exact = true;
     return true;
 }
 
@@ -603,13 +608,19 @@ bool x86_cpu_tlb_fill(CPUState *cs, vaddr addr, int size,
     if (get_physical_address(env, addr, access_type, mmu_idx, &out, &err)) {
         /*
          * Even if 4MB pages, we map only one 4KB page in the cache to
-         * avoid filling it too fast.
+         * avoid filling it too fast.  The rest of the page is mapped
+         * on demand, without walking the page tables again.
          */
+        CPUTLBEntryFull full = {
+            .phys_addr = out.paddr & TARGET_PAGE_MASK,
+            .attrs = cpu_get_mem_attrs(env),
+            .prot = out.prot,
+            .lg_page_size = ctz32(out.page_size),
+            .lg_page_exact = out.page_size_exact,
+        };
+
         assert(out.prot & (1 << access_type));
-        tlb_set_page_with_attrs(cs, addr & TARGET_PAGE_MASK,
-                                out.paddr & TARGET_PAGE_MASK,
-                                cpu_get_mem_attrs(env),
-                                out.prot, mmu_idx, out.page_size);
+        tlb_set_page_full(cs, mmu_idx, addr & TARGET_PAGE_MASK, &full);
         return true;
     }
 
@@ -1328,13 +1328,40 @@ static void gen_outs(DisasContext *s, MemOp ot)
     gen_bpt_io(s, s->tmp2_i32, ot);
 }
 
+static void gen_movs_bulk(DisasContext *s, MemOp ot)
+{
+    TCGv src = tcg_temp_new();
+
+    gen_string_movl_A0_ESI(s);
+    tcg_gen_mov_tl(src, s->A0);
+    gen_string_movl_A0_EDI(s);
+    gen_helper_rep_movs(cpu_env, s->A0, src, tcg_constant_i32(ot),
+                        tcg_constant_i32(s->aflag));
+}
+
+static void gen_stos_bulk(DisasContext *s, MemOp ot)
+{
+    gen_string_movl_A0_EDI(s);
+    gen_helper_rep_stos(cpu_env, s->A0, tcg_constant_i32(ot),
+                        tcg_constant_i32(s->aflag));
+}
+
 /* Generate jumps to current or next instruction */
 static void gen_repz(DisasContext *s, MemOp ot,
-                     void (*fn)(DisasContext *s, MemOp ot))
+                     void (*fn)(DisasContext *s, MemOp ot),
+                     void (*bulk)(DisasContext *s, MemOp ot))
 {
     TCGLabel *l2;
     gen_update_cc_op(s);
     l2 = gen_jz_ecx_string(s);
+    /*
+     * Let a helper do whole pages at once, leaving at least one
+     * iteration for the code below.  Single-stepping must still
+     * see every iteration.
+     */
+    if (bulk && !(s->flags & HF_TF_MASK) && !s->base.singlestep_enabled) {
+        bulk(s, ot);
+    }
     fn(s, ot);
     gen_op_add_reg_im(s, s->aflag, R_ECX, -1);
     /*
@@ -1349,7 +1376,11 @@ static void gen_repz(DisasContext *s, MemOp ot,
 
 #define GEN_REPZ(op) \
     static inline void gen_repz_ ## op(DisasContext *s, MemOp ot) \
-    { gen_repz(s, ot, gen_##op); }
+    { gen_repz(s, ot, gen_##op, NULL); }
+
+#define GEN_REPZ_BULK(op) \
+    static inline void gen_repz_ ## op(DisasContext *s, MemOp ot) \
+    { gen_repz(s, ot, gen_##op, gen_##op##_bulk); }
 
 static void gen_repz2(DisasContext *s, MemOp ot, int nz,
                       void (*fn)(DisasContext *s, MemOp ot))
@@ -1371,8 +1402,8 @@ static void gen_repz2(DisasContext *s, MemOp ot, int nz,
     static inline void gen_repz_ ## op(DisasContext *s, MemOp ot, int nz) \
     { gen_repz2(s, ot, nz, gen_##op); }
 
-GEN_REPZ(movs)
-GEN_REPZ(stos)
+GEN_REPZ_BULK(movs)
+GEN_REPZ_BULK(stos)
 GEN_REPZ(lods)
 GEN_REPZ(ins)
 GEN_REPZ(outs)
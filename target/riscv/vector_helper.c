@@ -952,6 +952,35 @@ void HELPER(vec_rsubs64)(void *d, void *a, uint64_t b, uint32_t desc)
     }
 }
 
+#define GEN_VEC_MINMAXS(NAME, OP, TYPE, BITS)                           \
+void HELPER(vec_##NAME##s##BITS)(void *d, void *a, uint64_t b,          \
+                                 uint32_t desc)                         \
+{                                                                       \
+    intptr_t oprsz = simd_oprsz(desc);                                  \
+    intptr_t i;                                                         \
+                                                                        \
+    for (i = 0; i < oprsz; i += sizeof(TYPE)) {                         \
+        *(TYPE *)(d + i) = OP(*(TYPE *)(a + i), (TYPE)b);               \
+    }                                                                   \
+}
+
+GEN_VEC_MINMAXS(umin, MIN, uint8_t, 8)
+GEN_VEC_MINMAXS(umin, MIN, uint16_t, 16)
+GEN_VEC_MINMAXS(umin, MIN, uint32_t, 32)
+GEN_VEC_MINMAXS(umin, MIN, uint64_t, 64)
+GEN_VEC_MINMAXS(smin, MIN, int8_t, 8)
+GEN_VEC_MINMAXS(smin, MIN, int16_t, 16)
+GEN_VEC_MINMAXS(smin, MIN, int32_t, 32)
+GEN_VEC_MINMAXS(smin, MIN, int64_t, 64)
+GEN_VEC_MINMAXS(umax, MAX, uint8_t, 8)
+GEN_VEC_MINMAXS(umax, MAX, uint16_t, 16)
+GEN_VEC_MINMAXS(umax, MAX, uint32_t, 32)
+GEN_VEC_MINMAXS(umax, MAX, uint64_t, 64)
+GEN_VEC_MINMAXS(smax, MAX, int8_t, 8)
+GEN_VEC_MINMAXS(smax, MAX, int16_t, 16)
+GEN_VEC_MINMAXS(smax, MAX, int32_t, 32)
+GEN_VEC_MINMAXS(smax, MAX, int64_t, 64)
+
 /* Vector Widening Integer Add/Subtract */
 #define WOP_UUU_B uint16_t, uint8_t, uint8_t, uint16_t, uint16_t
 #define WOP_UUU_H uint32_t, uint16_t, uint16_t, uint32_t, uint32_t
@@ -2236,3 +2236,311 @@ void tcg_optimize(TCGContext *s)
         }
     }
 }
+
+/*
+ * Local value numbering.  Within a basic block, an operation that computes
+ * the same function of the same input values as an earlier one is replaced
+ * by a move from the earlier output, provided that output still holds the
+ * value.  Each temp counts the writes to it in its state field, so that
+ * "same value" is "same temp, same number of writes".
+ *
+ * Loads from host memory are included; any store, call or operation with
+ * side effects in between makes them miss.  Guest loads are only included
+ * in user mode, where they cannot be MMIO accesses.
+ */
+
+#define CSE_TABLE_BITS  6
+#define CSE_MAX_IARGS   6
+
+typedef struct CSEEntry {
+    TCGOp *op;
+    uint32_t hash;
+    uint32_t mem_gen;
+    uintptr_t gen[1 + CSE_MAX_IARGS];   /* output, then inputs */
+} CSEEntry;
+
+static bool cse_candidate(const TCGOp *op, const TCGOpDef *def,
+                          bool *reads_mem)
+{
+    *reads_mem = false;
+    if (def->nb_oargs != 1 || def->nb_iargs > CSE_MAX_IARGS ||
+        (def->flags & (TCG_OPF_BB_END | TCG_OPF_NOT_PRESENT))) {
+        return false;
+    }
+
+    switch (op->opc) {
+    CASE_OP_32_64(ld8u):
+    CASE_OP_32_64(ld8s):
+    CASE_OP_32_64(ld16u):
+    CASE_OP_32_64(ld16s):
+    case INDEX_op_ld32u_i64:
+    case INDEX_op_ld32s_i64:
+    case INDEX_op_ld_i32:
+    case INDEX_op_ld_i64:
+    case INDEX_op_ld_vec:
+    case INDEX_op_dupm_vec:
+#ifdef CONFIG_USER_ONLY
+    case INDEX_op_qemu_ld_i32:
+    case INDEX_op_qemu_ld_i64:
+#endif
+        *reads_mem = true;
+        return true;
+    default:
+        return !(def->flags & TCG_OPF_SIDE_EFFECTS);
+    }
+}
+
+static uint32_t cse_hash(const TCGOp *op, const TCGOpDef *def)
+{
+    int nb_args = def->nb_oargs + def->nb_iargs + def->nb_cargs;
+    uint64_t h = op->opc ^ (op->param1 << 8) ^ (op->param2 << 16);
+
+    for (int i = def->nb_oargs; i < nb_args; i++) {
+        h = (h ^ op->args[i]) * 0x9e3779b97f4a7c15ull;
+    }
+    return h ^ (h >> 32);
+}
+
+static bool cse_match(const CSEEntry *e, const TCGOp *op,
+                      const TCGOpDef *def, uint32_t mem_gen, bool reads_mem)
+{
+    const TCGOp *prev = e->op;
+    int nb_args = def->nb_oargs + def->nb_iargs + def->nb_cargs;
+    int i;
+
+    if (prev->opc != op->opc || prev->param1 != op->param1 ||
+        prev->param2 != op->param2) {
+        return false;
+    }
+    for (i = def->nb_oargs; i < nb_args; i++) {
+        if (prev->args[i] != op->args[i]) {
+            return false;
+        }
+    }
+    for (i = 0; i < def->nb_iargs; i++) {
+        if (arg_temp(op->args[def->nb_oargs + i])->state != e->gen[1 + i]) {
+            return false;
+        }
+    }
+    if (arg_temp(prev->args[0])->state != e->gen[0]) {
+        return false;
+    }
+    return !reads_mem || e->mem_gen == mem_gen;
+}
+
+int tcg_optimize_cse(TCGContext *s)
+{
+    CSEEntry table[1 << CSE_TABLE_BITS];
+    uint32_t mem_gen = 0;
+    TCGOp *op, *op_next;
+    int i, n = 0;
+
+    for (i = 0; i < s->nb_temps; i++) {
+        s->temps[i].state = 0;
+    }
+    memset(table, 0, sizeof(table));
+
+    QTAILQ_FOREACH_SAFE(op, &s->ops, link, op_next) {
+        const TCGOpDef *def = &tcg_op_defs[op->opc];
+        bool reads_mem;
+
+        if (op->opc == INDEX_op_call) {
+            for (i = 0; i < TCGOP_CALLO(op); i++) {
+                arg_temp(op->args[i])->state++;
+            }
+            if (!(tcg_call_flags(op) & TCG_CALL_NO_WRITE_GLOBALS)) {
+                for (i = 0; i < s->nb_globals; i++) {
+                    s->temps[i].state++;
+                }
+            }
+            mem_gen++;
+            continue;
+        }
+
+        if (def->flags & TCG_OPF_BB_END) {
+            memset(table, 0, sizeof(table));
+            continue;
+        }
+
+        if (cse_candidate(op, def, &reads_mem)) {
+            uint32_t h = cse_hash(op, def);
+            CSEEntry *e = &table[h & ((1 << CSE_TABLE_BITS) - 1)];
+            TCGTemp *dst = arg_temp(op->args[0]);
+
+            if (e->op && e->hash == h &&
+                cse_match(e, op, def, mem_gen, reads_mem)) {
+                TCGTemp *src = arg_temp(e->op->args[0]);
+
+                n++;
+                if (src == dst) {
+                    /* The output already holds the value. */
+                    tcg_op_remove(s, op);
+                    continue;
+                }
+                switch (dst->type) {
+                case TCG_TYPE_I32:
+                    op->opc = INDEX_op_mov_i32;
+                    break;
+                case TCG_TYPE_I64:
+                    op->opc = INDEX_op_mov_i64;
+                    break;
+                default:
+                    /* TCGOP_VECL and TCGOP_VECE remain unchanged.  */
+                    op->opc = INDEX_op_mov_vec;
+                    break;
+                }
+                op->args[1] = temp_arg(src);
+                dst->state++;
+                continue;
+            }
+
+            e->op = op;
+            e->hash = h;
+            e->mem_gen = mem_gen;
+            for (i = 0; i < def->nb_iargs; i++) {
+                e->gen[1 + i] = arg_temp(op->args[1 + i])->state;
+            }
+            e->gen[0] = ++dst->state;
+            continue;
+        }
+
+        /* Stores, barriers and guest memory accesses.  */
+        if (op->opc != INDEX_op_insn_start &&
+            (def->nb_oargs == 0 || (def->flags & TCG_OPF_SIDE_EFFECTS))) {
+            mem_gen++;
+        }
+        for (i = 0; i < def->nb_oargs; i++) {
+            arg_temp(op->args[i])->state++;
+        }
+    }
+    return n;
+}
+
+/*
+ * Redundant env store elimination.  Within a basic block, a store to the
+ * CPU state is dead if a later store to the same base overwrites all of
+ * it, and nothing in between can observe it: no load that may overlap,
+ * no helper call, and no operation that may raise an exception or leave
+ * the block.
+ */
+
+#define DSE_MAX_PENDING 16
+
+typedef struct DSEStore {
+    TCGOp *op;
+    TCGTemp *base;
+    intptr_t ofs;
+    int size;
+} DSEStore;
+
+static int env_access_size(TCGOpcode opc)
+{
+    switch (opc) {
+    CASE_OP_32_64(ld8u):
+    CASE_OP_32_64(ld8s):
+    CASE_OP_32_64(st8):
+        return 1;
+    CASE_OP_32_64(ld16u):
+    CASE_OP_32_64(ld16s):
+    CASE_OP_32_64(st16):
+        return 2;
+    case INDEX_op_ld32u_i64:
+    case INDEX_op_ld32s_i64:
+    case INDEX_op_ld_i32:
+    case INDEX_op_st32_i64:
+    case INDEX_op_st_i32:
+        return 4;
+    case INDEX_op_ld_i64:
+    case INDEX_op_st_i64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+static bool env_access_is_store(TCGOpcode opc)
+{
+    switch (opc) {
+    CASE_OP_32_64(st8):
+    CASE_OP_32_64(st16):
+    CASE_OP_32_64(st):
+    case INDEX_op_st32_i64:
+        return true;
+    default:
+        return false;
+    }
+}
+
+int tcg_optimize_stores(TCGContext *s)
+{
+    DSEStore pending[DSE_MAX_PENDING];
+    int nb_pending = 0;
+    TCGOp *op;
+    int i, j, n = 0;
+
+    QTAILQ_FOREACH(op, &s->ops, link) {
+        const TCGOpDef *def = &tcg_op_defs[op->opc];
+        int size = env_access_size(op->opc);
+
+        if (size) {
+            TCGTemp *base = arg_temp(op->args[1]);
+            intptr_t ofs = op->args[2];
+
+            if (base->kind != TEMP_FIXED) {
+                /* May alias the CPU state. */
+                if (!env_access_is_store(op->opc)) {
+                    nb_pending = 0;
+                }
+                continue;
+            }
+
+            for (i = j = 0; i < nb_pending; i++) {
+                DSEStore *p = &pending[i];
+                bool overlap = p->base == base &&
+                               p->ofs < ofs + size && ofs < p->ofs + p->size;
+
+                if (!env_access_is_store(op->opc)) {
+                    /* A load observes the pending stores it overlaps. */
+                    if (overlap) {
+                        continue;
+                    }
+                } else if (overlap && ofs <= p->ofs &&
+                           p->ofs + p->size <= ofs + size) {
+                    tcg_op_remove(s, p->op);
+                    n++;
+                    continue;
+                }
+                pending[j++] = *p;
+            }
+            nb_pending = j;
+
+            if (env_access_is_store(op->opc)) {
+                if (nb_pending == DSE_MAX_PENDING) {
+                    memmove(&pending[0], &pending[1],
+                            sizeof(pending[0]) * --nb_pending);
+                }
+                pending[nb_pending++] = (DSEStore) {
+                    .op = op, .base = base, .ofs = ofs, .size = size
+                };
+            }
+            continue;
+        }
+
+        switch (op->opc) {
+        CASE_OP_32_64_VEC(mov):
+        case INDEX_op_insn_start:
+        case INDEX_op_discard:
+        case INDEX_op_st_vec:
+            break;
+        default:
+            if (op->opc == INDEX_op_call || op->opc == INDEX_op_ld_vec ||
+                op->opc == INDEX_op_dupm_vec ||
+                (def->flags & (TCG_OPF_BB_END | TCG_OPF_SIDE_EFFECTS |
+                               TCG_OPF_NOT_PRESENT))) {
+                nb_pending = 0;
+            }
+            break;
+        }
+    }
+    return n;
+}
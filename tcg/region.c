@@ -287,6 +287,20 @@ size_t tcg_nb_tbs(void)
     return nb_tbs;
 }
 
+/* Any two TBs are at least sizeof(TranslationBlock) bytes apart. */
+size_t tcg_tb_index(const TranslationBlock *tb)
+{
+    size_t offset = (const void *)tb - region.start_aligned;
+
+    tcg_debug_assert(offset < region.total_size);
+    return offset / sizeof(TranslationBlock);
+}
+
+size_t tcg_tb_index_max(void)
+{
+    return region.total_size / sizeof(TranslationBlock);
+}
+
 static void tcg_region_tree_reset_all(void)
 {
     size_t i;
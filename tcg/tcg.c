@@ -168,6 +168,19 @@ TCGv_env cpu_env = 0;
 const void *tcg_code_gen_epilogue;
 uintptr_t tcg_splitwx_diff;
 
+/*
+ * Maximum number of guest globals per TB that the register allocator
+ * keeps in call-saved host registers across labels, instead of saving
+ * them at each branch and reloading them after each label.
+ */
+unsigned int tcg_global_regs;
+
+/*
+ * Whether to run value numbering and redundant env store elimination
+ * after the main optimization pass.
+ */
+bool tcg_cse_enabled = true;
+
 #ifndef CONFIG_TCG_INTERPRETER
 tcg_prologue_fn *tcg_qemu_tb_exec;
 #endif
@@ -1741,6 +1754,7 @@ bool tcg_op_supported(TCGOpcode op)
 }
 
 static TCGOp *tcg_op_alloc(TCGOpcode opc, unsigned nargs);
+static void tcg_op_link(TCGContext *s, TCGOp *op);
 
 void tcg_gen_callN(void *func, TCGTemp *ret, int nargs, TCGTemp **args)
 {
@@ -1821,7 +1835,7 @@ void tcg_gen_callN(void *func, TCGTemp *ret, int nargs, TCGTemp **args)
     op->args[pi++] = (uintptr_t)info;
     tcg_debug_assert(pi == total_args);
 
-    QTAILQ_INSERT_TAIL(&tcg_ctx->ops, op, link);
+    tcg_op_link(tcg_ctx, op);
 
     tcg_debug_assert(n_extend < ARRAY_SIZE(extend_free));
     for (i = 0; i < n_extend; ++i) {
@@ -2631,10 +2645,21 @@ static TCGOp *tcg_op_alloc(TCGOpcode opc, unsigned nargs)
     return op;
 }
 
+static void tcg_op_link(TCGContext *s, TCGOp *op)
+{
+#ifdef CONFIG_PLUGIN
+    if (s->emit_before_op) {
+        QTAILQ_INSERT_BEFORE(s->emit_before_op, op, link);
+        return;
+    }
+#endif
+    QTAILQ_INSERT_TAIL(&s->ops, op, link);
+}
+
 TCGOp *tcg_emit_op(TCGOpcode opc, unsigned nargs)
 {
     TCGOp *op = tcg_op_alloc(opc, nargs);
-    QTAILQ_INSERT_TAIL(&tcg_ctx->ops, op, link);
+    tcg_op_link(tcg_ctx, op);
     return op;
 }
 
@@ -2771,6 +2796,93 @@ reachable_code_pass(TCGContext *s)
     }
 }
 
+/*
+ * Choose the globals to keep in registers across the labels of this TB:
+ * those accessed in the most extended basic blocks, since each of those
+ * blocks would otherwise reload them.  Each gets its own call-saved host
+ * register, which survives calls to helpers that do not touch globals.
+ */
+static void __attribute__((noinline))
+carry_globals_pass(TCGContext *s)
+{
+    int nb_globals = s->nb_globals;
+    TCGRegSet free_regs;
+    int *ebbs, *last_ebb;
+    int i, ebb = 0;
+    TCGOp *op;
+
+    for (i = 0; i < s->nb_carry; i++) {
+        s->carry_temps[i]->carried = 0;
+    }
+    s->nb_carry = 0;
+    s->carry_regs = 0;
+
+    if (!tcg_global_regs) {
+        return;
+    }
+
+    ebbs = tcg_malloc(sizeof(int) * nb_globals * 2);
+    last_ebb = ebbs + nb_globals;
+    for (i = 0; i < nb_globals; i++) {
+        ebbs[i] = 0;
+        last_ebb[i] = -1;
+    }
+
+    QTAILQ_FOREACH(op, &s->ops, link) {
+        const TCGOpDef *def = &tcg_op_defs[op->opc];
+        int nb_args;
+
+        switch (op->opc) {
+        case INDEX_op_set_label:
+            ebb++;
+            continue;
+        case INDEX_op_call:
+            nb_args = TCGOP_CALLO(op) + TCGOP_CALLI(op);
+            break;
+        default:
+            nb_args = def->nb_oargs + def->nb_iargs;
+            break;
+        }
+        for (i = 0; i < nb_args; i++) {
+            int idx = temp_idx(arg_temp(op->args[i]));
+
+            if (idx < nb_globals && last_ebb[idx] != ebb) {
+                last_ebb[idx] = ebb;
+                ebbs[idx]++;
+            }
+        }
+    }
+
+    free_regs = ~tcg_target_call_clobber_regs & ~s->reserved_regs;
+    while (s->nb_carry < MIN(tcg_global_regs, TCG_MAX_GLOBAL_REGS)) {
+        TCGTemp *best = NULL;
+        TCGRegSet regs;
+        int best_ebbs = 1;
+
+        for (i = 0; i < nb_globals; i++) {
+            TCGTemp *ts = &s->temps[i];
+
+            if (ebbs[i] > best_ebbs && !ts->carried &&
+                ts->kind == TEMP_GLOBAL && !ts->indirect_reg &&
+                ts->type <= TCG_TYPE_I64 &&
+                (tcg_target_available_regs[ts->type] & free_regs)) {
+                best = ts;
+                best_ebbs = ebbs[i];
+            }
+        }
+        if (!best) {
+            break;
+        }
+
+        regs = tcg_target_available_regs[best->type] & free_regs;
+        best->carried = 1;
+        best->carry_reg = tcg_regset_first(regs);
+        tcg_regset_reset_reg(free_regs, best->carry_reg);
+        tcg_regset_set_reg(s->carry_regs, best->carry_reg);
+        s->carry_temps[s->nb_carry++] = best;
+    }
+}
+
 #define TS_DEAD  1
 #define TS_MEM   2
 
@@ -2808,6 +2920,23 @@ static void la_func_end(TCGContext *s, int ng, int nt)
     }
 }
 
+/*
+ * liveness analysis: branch or label: carried globals stay live in
+ * their register, in addition to being synced to memory.
+ */
+static void la_carry(TCGContext *s)
+{
+    int i;
+
+    for (i = 0; i < s->nb_carry; i++) {
+        TCGTemp *ts = s->carry_temps[i];
+
+        ts->state = TS_MEM;
+        *la_temp_pref(ts) = 0;
+        tcg_regset_set_reg(*la_temp_pref(ts), ts->carry_reg);
+    }
+}
+
 /* liveness analysis: end of basic block: all temps are dead, globals
    and local temps should be in memory. */
 static void la_bb_end(TCGContext *s, int ng, int nt)
@@ -2834,6 +2963,7 @@ static void la_bb_end(TCGContext *s, int ng, int nt)
         ts->state = state;
         la_reset_pref(ts);
     }
+    la_carry(s);
 }
 
 /* liveness analysis: sync globals back to memory.  */
@@ -2880,6 +3010,7 @@ static void la_bb_sync(TCGContext *s, int ng, int nt)
         }
         la_reset_pref(&s->temps[i]);
     }
+    la_carry(s);
 }
 
 /* liveness analysis: sync globals back to memory and kill.  */
@@ -3666,6 +3797,7 @@ static void temp_sync(TCGContext *s, TCGTemp *ts, TCGRegSet allocated_regs,
             if (free_or_dead
                 && tcg_out_sti(s, ts->type, ts->val,
                                ts->mem_base->reg, ts->mem_offset)) {
+                s->nb_spills++;
                 break;
             }
             temp_load(s, ts, tcg_target_available_regs[ts->type],
@@ -3675,6 +3807,7 @@ static void temp_sync(TCGContext *s, TCGTemp *ts, TCGRegSet allocated_regs,
         case TEMP_VAL_REG:
             tcg_out_st(s, ts->type, ts->reg,
                        ts->mem_base->reg, ts->mem_offset);
+            s->nb_spills++;
             break;
 
         case TEMP_VAL_MEM:
@@ -3859,6 +3992,7 @@ static void temp_load(TCGContext *s, TCGTemp *ts, TCGRegSet desired_regs,
                             preferred_regs, ts->indirect_base);
         tcg_out_ld(s, ts->type, reg, ts->mem_base->reg, ts->mem_offset);
         ts->mem_coherent = 1;
+        s->nb_reloads++;
         break;
     case TEMP_VAL_DEAD:
     default:
@@ -3871,9 +4005,13 @@ static void temp_load(TCGContext *s, TCGTemp *ts, TCGRegSet desired_regs,
    temporary registers needs to be allocated to store a constant.  */
 static void temp_save(TCGContext *s, TCGTemp *ts, TCGRegSet allocated_regs)
 {
-    /* The liveness analysis already ensures that globals are back
-       in memory. Keep an tcg_debug_assert for safety. */
-    tcg_debug_assert(ts->val_type == TEMP_VAL_MEM || temp_readonly(ts));
+    /*
+     * The liveness analysis already ensures that globals are back
+     * in memory, or synced if carried. Keep an tcg_debug_assert for
+     * safety.
+     */
+    tcg_debug_assert(ts->val_type == TEMP_VAL_MEM || temp_readonly(ts) ||
+                     (ts->carried && ts->mem_coherent));
 }
 
 /* save globals to their canonical location and assume they can be
@@ -3903,6 +4041,85 @@ static void sync_globals(TCGContext *s, TCGRegSet allocated_regs)
     }
 }
 
+/*
+ * Before a branch or label, move the carried globals into the registers
+ * that the code after each label expects them in.  If @reachable is false,
+ * control cannot fall through to the label and no code is needed.
+ */
+static void tcg_reg_alloc_carry(TCGContext *s, TCGRegSet allocated_regs,
+                                bool reachable)
+{
+    int i;
+
+    /* Release carried globals held in another register, ... */
+    for (i = 0; i < s->nb_carry; i++) {
+        TCGTemp *ts = s->carry_temps[i];
+
+        if (ts->val_type == TEMP_VAL_MEM ||
+            (ts->val_type == TEMP_VAL_REG && ts->reg == ts->carry_reg)) {
+            continue;
+        }
+        if (reachable) {
+            if (ts->val_type == TEMP_VAL_REG &&
+                !s->reg_to_temp[ts->carry_reg] &&
+                tcg_out_mov(s, ts->type, ts->carry_reg, ts->reg)) {
+                set_temp_val_reg(s, ts, ts->carry_reg);
+                continue;
+            }
+            temp_sync(s, ts, allocated_regs, 0, -1);
+        } else {
+            set_temp_val_nonreg(s, ts, TEMP_VAL_MEM);
+        }
+    }
+
+    /* ... so that only other temps can be in the way.  */
+    for (i = 0; i < s->nb_carry; i++) {
+        TCGTemp *ts = s->carry_temps[i];
+        TCGReg reg = ts->carry_reg;
+        TCGTemp *other = s->reg_to_temp[reg];
+
+        if (other && other != ts) {
+            if (reachable) {
+                tcg_reg_free(s, reg, allocated_regs);
+            } else {
+                temp_dead(s, other);
+            }
+        }
+        if (ts->val_type == TEMP_VAL_MEM) {
+            if (reachable) {
+                tcg_out_ld(s, ts->type, reg, ts->mem_base->reg,
+                           ts->mem_offset);
+                s->nb_reloads++;
+            }
+            set_temp_val_reg(s, ts, reg);
+            ts->mem_coherent = 1;
+        }
+    }
+}
+
+/* True if control can reach the label set by @op without branching to it. */
+static bool label_fallthrough(TCGOp *op)
+{
+    TCGOp *prev = QTAILQ_PREV(op, link);
+
+    while (prev && prev->opc == INDEX_op_insn_start) {
+        prev = QTAILQ_PREV(prev, link);
+    }
+    if (!prev) {
+        return true;
+    }
+    switch (prev->opc) {
+    case INDEX_op_br:
+    case INDEX_op_exit_tb:
+    case INDEX_op_goto_ptr:
+        return false;
+    case INDEX_op_call:
+        return !(tcg_call_flags(prev) & TCG_CALL_NO_RETURN);
+    default:
+        return true;
+    }
+}
+
 /* at the end of a basic block, we assume all temporaries are dead and
    all globals are stored at their canonical location. */
 static void tcg_reg_alloc_bb_end(TCGContext *s, TCGRegSet allocated_regs)
@@ -4218,6 +4435,15 @@ static void tcg_reg_alloc_op(TCGContext *s, const TCGOp *op)
     i_allocated_regs = s->reserved_regs;
     o_allocated_regs = s->reserved_regs;
 
+    /*
+     * Place the carried globals before loading the inputs of a conditional
+     * branch, so that the inputs stay out of the way.
+     */
+    if ((def->flags & TCG_OPF_COND_BRANCH) && s->nb_carry) {
+        tcg_reg_alloc_carry(s, i_allocated_regs, true);
+        i_allocated_regs |= s->carry_regs;
+    }
+
     /* satisfy input constraints */
     for (k = 0; k < nb_iargs; k++) {
         TCGRegSet i_preferred_regs, i_required_regs;
@@ -4423,6 +4649,9 @@ static void tcg_reg_alloc_op(TCGContext *s, const TCGOp *op)
     if (def->flags & TCG_OPF_COND_BRANCH) {
         tcg_reg_alloc_cbranch(s, i_allocated_regs);
     } else if (def->flags & TCG_OPF_BB_END) {
+        if (!(def->flags & TCG_OPF_BB_EXIT)) {
+            tcg_reg_alloc_carry(s, i_allocated_regs, true);
+        }
         tcg_reg_alloc_bb_end(s, i_allocated_regs);
     } else {
         if (def->flags & TCG_OPF_CALL_CLOBBER) {
@@ -4928,6 +5157,7 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, target_ulong pc_start)
     TCGProfile *prof = &s->prof;
 #endif
     int i, num_insns;
+    int nb_ops_in, nb_ops_opt, nb_ops_dse, nb_cse = 0;
     TCGOp *op;
 
 #ifdef CONFIG_PROFILER
@@ -4984,9 +5214,18 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, target_ulong pc_start)
     qatomic_set(&prof->opt_time, prof->opt_time - profile_getclock());
 #endif
 
+    nb_ops_in = s->nb_ops;
 #ifdef USE_TCG_OPTIMIZATIONS
     tcg_optimize(s);
 #endif
+    nb_ops_opt = s->nb_ops;
+#ifdef USE_TCG_OPTIMIZATIONS
+    if (tcg_cse_enabled) {
+        nb_cse = tcg_optimize_cse(s);
+        tcg_optimize_stores(s);
+    }
+#endif
+    nb_ops_dse = s->nb_ops;
 
 #ifdef CONFIG_PROFILER
     qatomic_set(&prof->opt_time, prof->opt_time + profile_getclock());
@@ -4994,6 +5233,7 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, target_ulong pc_start)
 #endif
 
     reachable_code_pass(s);
+    carry_globals_pass(s);
     liveness_pass_0(s);
     liveness_pass_1(s);
 
@@ -5027,6 +5267,10 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, target_ulong pc_start)
         FILE *logfile = qemu_log_trylock();
         if (logfile) {
             fprintf(logfile, "OP after optimization and liveness analysis:\n");
+            fprintf(logfile, " ---- ops: %d in, %d after optimize, "
+                    "%d reused by cse, %d after store elimination, "
+                    "%d after liveness\n", nb_ops_in, nb_ops_opt, nb_cse,
+                    nb_ops_dse, s->nb_ops);
             tcg_dump_ops(s, logfile, true);
             fprintf(logfile, "\n");
             qemu_log_unlock(logfile);
@@ -5041,6 +5285,8 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, target_ulong pc_start)
     tb->jmp_insn_offset[1] = TB_JMP_OFFSET_INVALID;
 
     tcg_reg_alloc_start(s);
+    s->nb_spills = 0;
+    s->nb_reloads = 0;
 
     /*
      * Reset the buffer pointers when restarting after overflow.
@@ -5096,6 +5342,7 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, target_ulong pc_start)
             temp_dead(s, arg_temp(op->args[0]));
             break;
         case INDEX_op_set_label:
+            tcg_reg_alloc_carry(s, s->reserved_regs, label_fallthrough(op));
             tcg_reg_alloc_bb_end(s, s->reserved_regs);
             tcg_out_label(s, arg_label(op->args[0]));
             break;
@@ -5161,9 +5408,36 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, target_ulong pc_start)
                         tcg_ptr_byte_diff(s->code_ptr, s->code_buf));
 #endif
 
+    qatomic_set(&s->regalloc_tb_count, s->regalloc_tb_count + 1);
+    qatomic_set(&s->regalloc_spill_count,
+                s->regalloc_spill_count + s->nb_spills);
+    qatomic_set(&s->regalloc_reload_count,
+                s->regalloc_reload_count + s->nb_reloads);
+
     return tcg_current_code_size(s);
 }
 
+void tcg_dump_regalloc_info(GString *buf)
+{
+    unsigned int n_ctxs = qatomic_read(&tcg_cur_ctxs);
+    size_t tbs = 0, spills = 0, reloads = 0;
+    unsigned int i;
+
+    for (i = 0; i < n_ctxs; i++) {
+        const TCGContext *s = qatomic_read(&tcg_ctxs[i]);
+
+        tbs += qatomic_read(&s->regalloc_tb_count);
+        spills += qatomic_read(&s->regalloc_spill_count);
+        reloads += qatomic_read(&s->regalloc_reload_count);
+    }
+
+    g_string_append_printf(buf, "global regs/TB      %u\n", tcg_global_regs);
+    g_string_append_printf(buf, "spills              %zu (%0.1f/TB)\n",
+                           spills, tbs ? (double)spills / tbs : 0);
+    g_string_append_printf(buf, "reloads             %zu (%0.1f/TB)\n",
+                           reloads, tbs ? (double)reloads / tbs : 0);
+}
+
 #ifdef CONFIG_PROFILER
 void tcg_dump_info(GString *buf)
 {
@@ -0,0 +1,281 @@
+/*
+ * Compare the compression methods available to multifd migration
+ *
+ * Each method compresses and decompresses the same set of guest-like
+ * pages, grouped in packets the way multifd sends them: zlib and zstd
+ * compress a whole packet as one stream, lz4 compresses every page on
+ * its own.  The speed of both directions and the compression ratio are
+ * reported for each kind of page content.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+#include "qemu/osdep.h"
+#include <zlib.h>
+#include "qemu/bswap.h"
+#ifdef CONFIG_ZSTD
+#include <zstd.h>
+#endif
+#ifdef CONFIG_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+
+#define PAGE_SIZE 4096
+#define PACKET_PAGES 128
+#define PACKET_SIZE (PAGE_SIZE * PACKET_PAGES)
+#define N_PACKETS 64
+
+typedef struct {
+    const char *name;
+    /* returns the compressed size, or 0 on failure */
+    size_t (*compress)(const uint8_t *src, uint8_t *dst, size_t dst_len,
+                       int level);
+    bool (*decompress)(const uint8_t *src, size_t src_len, uint8_t *dst);
+    int level;
+} Method;
+
+typedef void (*FillFn)(uint8_t *page, GRand *rand);
+
+/* Mostly zero, with a few scattered words, like page tables. */
+static void fill_sparse(uint8_t *page, GRand *rand)
+{
+    int i;
+
+    memset(page, 0, PAGE_SIZE);
+    for (i = 0; i < 16; i++) {
+        uint64_t v = g_rand_int(rand) | 0xffff800000000000ULL;
+
+        memcpy(page + g_rand_int_range(rand, 0, PAGE_SIZE / 8) * 8,
+               &v, sizeof(v));
+    }
+}
+
+/* Words from a small vocabulary, like page cache contents. */
+static void fill_text(uint8_t *page, GRand *rand)
+{
+    static const char *const words[] = {
+        "the ", "migration ", "of ", "guest ", "memory ", "page ", "dirty ",
+        "qemu ", "bitmap ", "and ", "to ", "channel ", "\n", "int ", "{ ",
+    };
+    int pos = 0;
+
+    while (pos < PAGE_SIZE) {
+        const char *w = words[g_rand_int_range(rand, 0, ARRAY_SIZE(words))];
+        int len = MIN(strlen(w), PAGE_SIZE - pos);
+
+        memcpy(page + pos, w, len);
+        pos += len;
+    }
+}
+
+/* Small integers in an array, like the data of a running program. */
+static void fill_ints(uint8_t *page, GRand *rand)
+{
+    uint32_t *p = (uint32_t *)page;
+    int i;
+
+    for (i = 0; i < PAGE_SIZE / sizeof(*p); i++) {
+        p[i] = g_rand_int_range(rand, 0, 1024);
+    }
+}
+
+/* Incompressible, like encrypted or already compressed data. */
+static void fill_random(uint8_t *page, GRand *rand)
+{
+    uint32_t *p = (uint32_t *)page;
+    int i;
+
+    for (i = 0; i < PAGE_SIZE / sizeof(*p); i++) {
+        p[i] = g_rand_int(rand);
+    }
+}
+
+/* All of the above, in proportions seen in a typical idle guest. */
+static void fill_mixed(uint8_t *page, GRand *rand)
+{
+    int kind = g_rand_int_range(rand, 0, 10);
+
+    if (kind < 4) {
+        fill_sparse(page, rand);
+    } else if (kind < 7) {
+        fill_text(page, rand);
+    } else if (kind < 9) {
+        fill_ints(page, rand);
+    } else {
+        fill_random(page, rand);
+    }
+}
+
+static size_t zlib_compress(const uint8_t *src, uint8_t *dst, size_t dst_len,
+                            int level)
+{
+    uLongf len = dst_len;
+
+    if (compress2(dst, &len, src, PACKET_SIZE, level) != Z_OK) {
+        return 0;
+    }
+    return len;
+}
+
+static bool zlib_decompress(const uint8_t *src, size_t src_len, uint8_t *dst)
+{
+    uLongf len = PACKET_SIZE;
+
+    return uncompress(dst, &len, src, src_len) == Z_OK && len == PACKET_SIZE;
+}
+
+#ifdef CONFIG_ZSTD
+static size_t zstd_compress(const uint8_t *src, uint8_t *dst, size_t dst_len,
+                            int level)
+{
+    size_t len = ZSTD_compress(dst, dst_len, src, PACKET_SIZE, level);
+
+    return ZSTD_isError(len) ? 0 : len;
+}
+
+static bool zstd_decompress(const uint8_t *src, size_t src_len, uint8_t *dst)
+{
+    return ZSTD_decompress(dst, PACKET_SIZE, src, src_len) == PACKET_SIZE;
+}
+#endif
+
+#ifdef CONFIG_LZ4
+/* Same packet layout as migration/multifd-lz4.c */
+static size_t lz4_compress(const uint8_t *src, uint8_t *dst, size_t dst_len,
+                           int level)
+{
+    static void *state;
+    size_t pos = 0;
+    int i;
+
+    if (!state) {
+        state = g_malloc(MAX(LZ4_sizeofState(), LZ4_sizeofStateHC()));
+    }
+    for (i = 0; i < PACKET_PAGES; i++) {
+        const char *page = (const char *)src + i * PAGE_SIZE;
+        char *out = (char *)dst + pos + 4;
+        int len;
+
+        if (level) {
+            len = LZ4_compress_HC_extStateHC(state, page, out, PAGE_SIZE,
+                                             PAGE_SIZE - 1, level);
+        } else {
+            len = LZ4_compress_fast_extState(state, page, out, PAGE_SIZE,
+                                             PAGE_SIZE - 1, 1);
+        }
+        if (len <= 0) {
+            memcpy(out, page, PAGE_SIZE);
+            len = PAGE_SIZE;
+        }
+        stl_be_p(dst + pos, len);
+        pos += 4 + len;
+    }
+    return pos;
+}
+
+static bool lz4_decompress(const uint8_t *src, size_t src_len, uint8_t *dst)
+{
+    size_t pos = 0;
+    int i;
+
+    for (i = 0; i < PACKET_PAGES; i++) {
+        char *page = (char *)dst + i * PAGE_SIZE;
+        int len = ldl_be_p(src + pos);
+
+        pos += 4;
+        if (len == PAGE_SIZE) {
+            memcpy(page, src + pos, PAGE_SIZE);
+        } else if (LZ4_decompress_safe((const char *)src + pos, page,
+                                       len, PAGE_SIZE) != PAGE_SIZE) {
+            return false;
+        }
+        pos += len;
+    }
+    return pos == src_len;
+}
+#endif
+
+static const Method methods[] = {
+    { "zlib-1", zlib_compress, zlib_decompress, 1 },
+#ifdef CONFIG_ZSTD
+    { "zstd-1", zstd_compress, zstd_decompress, 1 },
+#endif
+#ifdef CONFIG_LZ4
+    { "lz4", lz4_compress, lz4_decompress, 0 },
+    { "lz4hc-9", lz4_compress, lz4_decompress, 9 },
+#endif
+};
+
+static void run_bench(gconstpointer opaque)
+{
+    FillFn fill = (FillFn)opaque;
+    /* room for incompressible data plus the per-page headers */
+    size_t out_len = PACKET_SIZE * 2;
+    uint8_t *data = g_malloc(N_PACKETS * PACKET_SIZE);
+    uint8_t *out = g_malloc(out_len);
+    uint8_t *check = g_malloc(PACKET_SIZE);
+    GRand *rand = g_rand_new_with_seed(0x6d696772);
+    int i, m;
+
+    for (i = 0; i < N_PACKETS * PACKET_PAGES; i++) {
+        fill(data + i * PAGE_SIZE, rand);
+    }
+
+    for (m = 0; m < ARRAY_SIZE(methods); m++) {
+        const Method *method = &methods[m];
+        double t_comp = 0, t_decomp = 0;
+        size_t total = 0;
+
+        for (i = 0; i < N_PACKETS; i++) {
+            const uint8_t *packet = data + i * PACKET_SIZE;
+            size_t len;
+
+            g_test_timer_start();
+            len = method->compress(packet, out, out_len, method->level);
+            t_comp += g_test_timer_elapsed();
+            g_assert_cmpuint(len, >, 0);
+            total += len;
+
+            g_test_timer_start();
+            g_assert_true(method->decompress(out, len, check));
+            t_decomp += g_test_timer_elapsed();
+            g_assert_cmpmem(check, PACKET_SIZE, packet, PACKET_SIZE);
+        }
+
+        g_test_message("%-8s compress %8.1f MB/s, decompress %8.1f MB/s, "
+                       "ratio %5.2f", method->name,
+                       N_PACKETS * PACKET_SIZE / t_comp / 1e6,
+                       N_PACKETS * PACKET_SIZE / t_decomp / 1e6,
+                       (double)N_PACKETS * PACKET_SIZE / total);
+    }
+
+    g_rand_free(rand);
+    g_free(check);
+    g_free(out);
+    g_free(data);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        const char *name;
+        FillFn fill;
+    } contents[] = {
+        { "sparse", fill_sparse },
+        { "text", fill_text },
+        { "ints", fill_ints },
+        { "random", fill_random },
+        { "mixed", fill_mixed },
+    };
+    int i;
+
+    g_test_init(&argc, &argv, NULL);
+    for (i = 0; i < ARRAY_SIZE(contents); i++) {
+        g_autofree char *path = g_strdup_printf("/multifd/compression/%s",
+                                                contents[i].name);
+
+        g_test_add_data_func(path, (void *)contents[i].fill, run_bench);
+    }
+    return g_test_run();
+}
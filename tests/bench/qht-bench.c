@@ -21,6 +21,22 @@ struct thread_stats {
     size_t not_rm;
     size_t rz;
     size_t not_rz;
+    size_t jc_hit;
+    size_t vc_hit;
+};
+
+/*
+ * Per-thread model of the TCG lookup front-end: a direct-mapped jump
+ * cache, backed by an optional set-associative victim cache, in front
+ * of the shared qht.
+ */
+#define VC_BITS 8
+#define VC_SETS (1 << VC_BITS)
+#define VC_MAX_WAYS 16
+
+struct tb_lookup_cache {
+    long **jc;
+    long *vc[VC_SETS][VC_MAX_WAYS];
 };
 
 struct thread_info {
@@ -35,6 +51,7 @@ struct thread_info {
     uint64_t seed;
     bool write_op; /* writes alternate between insertions and removals */
     bool resize_down;
+    struct tb_lookup_cache *tlc;
 } QEMU_ALIGNED(64); /* avoid false sharing among threads */
 
 static struct qht ht;
@@ -61,6 +78,9 @@ static double resize_rate; /* 0.0 to 1.0 */
 static unsigned int n_rz_threads = 1;
 static QemuThread *rz_threads;
 static bool precompute_hash;
+static bool tb_lookup_mode;
+static unsigned int jc_bits = 12;
+static unsigned int vc_ways;
 
 static double update_rate; /* 0.0 to 1.0 */
 static uint64_t update_threshold;
@@ -93,7 +113,12 @@ static const char commands_string[] =
     " -R = enable auto-resize\n"
     " -S = resize rate (0.0 to 100.0)\n"
     " -D = delay (in us) between potential resizes\n"
-    " -N = number of resize threads";
+    " -N = number of resize threads\n"
+    "\n"
+    " -t = TB lookup mode: each thread is a vCPU with a private jump cache\n"
+    "      in front of the qht; -u and -R are ignored\n"
+    " -j = log2 of the number of jump cache entries (default 12)\n"
+    " -v = number of victim cache ways, 256 sets each (default 0 = off)";
 
 static void usage_complete(int argc, char *argv[])
 {
@@ -204,6 +229,58 @@ static void do_rw(struct thread_info *info)
     }
 }
 
+static unsigned int tlc_hash(long v, unsigned int bits)
+{
+    return (v ^ (v >> bits)) & ((1u << bits) - 1);
+}
+
+static void do_tb_lookup(struct thread_info *info)
+{
+    struct thread_stats *stats = &info->stats;
+    struct tb_lookup_cache *tlc = info->tlc;
+    uint64_t r = info->seed - 1;
+    long *p = &keys[r & (lookup_range - 1)];
+    unsigned int h = tlc_hash(*p, jc_bits);
+    long *old = tlc->jc[h];
+    long *found = NULL;
+    int i;
+
+    if (old && *old == *p) {
+        stats->jc_hit++;
+        return;
+    }
+
+    if (vc_ways) {
+        long **set = tlc->vc[tlc_hash(*p, VC_BITS)];
+
+        for (i = 0; i < vc_ways; i++) {
+            if (set[i] && *set[i] == *p) {
+                found = set[i];
+                set[i] = NULL;
+                stats->vc_hit++;
+                break;
+            }
+        }
+    }
+    if (!found) {
+        found = qht_lookup(&ht, p, hfunc(*p));
+        if (found) {
+            stats->rd++;
+        } else {
+            stats->not_rd++;
+            return;
+        }
+    }
+
+    if (old && vc_ways) {
+        long **set = tlc->vc[tlc_hash(*old, VC_BITS)];
+
+        memmove(&set[1], &set[0], sizeof(set[0]) * (vc_ways - 1));
+        set[0] = old;
+    }
+    tlc->jc[h] = found;
+}
+
 static void *thread_func(void *p)
 {
     struct thread_info *info = p;
@@ -237,6 +314,11 @@ static void prepare_thread_info(struct thread_info *info, int i)
     info->resize_down = true;
 
     memset(&info->stats, 0, sizeof(info->stats));
+
+    if (tb_lookup_mode) {
+        info->tlc = g_new0(struct tb_lookup_cache, 1);
+        info->tlc->jc = g_new0(long *, 1u << jc_bits);
+    }
 }
 
 static void
@@ -263,7 +345,8 @@ th_create_n(QemuThread **threads, struct thread_info **infos, const char *name,
 
 static void create_threads(void)
 {
-    th_create_n(&rw_threads, &rw_info, "rw", do_rw, 0, n_rw_threads);
+    th_create_n(&rw_threads, &rw_info, "rw",
+                tb_lookup_mode ? do_tb_lookup : do_rw, 0, n_rw_threads);
     th_create_n(&rz_threads, &rz_info, "rz", do_rz, n_rw_threads, n_rz_threads);
 }
 
@@ -286,6 +369,11 @@ static void pr_params(void)
     printf(" initial key range: %zu\n", init_range);
     printf(" lookup range:      %lu\n", lookup_range);
     printf(" update range:      %lu\n", update_range);
+    if (tb_lookup_mode) {
+        printf(" jump cache size:   %u\n", 1u << jc_bits);
+        printf(" victim cache:      %u sets x %u ways\n",
+               vc_ways ? VC_SETS : 0, vc_ways);
+    }
 }
 
 static void do_threshold(double rate, uint64_t *threshold)
@@ -330,6 +418,12 @@ static void htable_init(void)
     /* some sanity checks */
     g_assert_cmpuint(lookup_range, <=, n);
 
+    if (tb_lookup_mode) {
+        /* the code cache only grows between flushes */
+        update_rate = 0;
+        n_rz_threads = 0;
+    }
+
     /* compute thresholds */
     do_threshold(update_rate, &update_threshold);
     do_threshold(resize_rate, &resize_threshold);
@@ -384,6 +478,9 @@ static void add_stats(struct thread_stats *s, struct thread_info *info, int n)
 
         s->rz += stats->rz;
         s->not_rz += stats->not_rz;
+
+        s->jc_hit += stats->jc_hit;
+        s->vc_hit += stats->vc_hit;
     }
 }
 
@@ -402,6 +499,23 @@ static void pr_stats(void)
                s.rz, (double)s.rz / (s.rz + s.not_rz) * 100, s.rz + s.not_rz);
     }
 
+    if (tb_lookup_mode) {
+        size_t n = s.jc_hit + s.vc_hit + s.rd + s.not_rd;
+
+        printf(" Jump cache hits:   %.2f M (%.2f%% of %.2fM)\n",
+               (double)s.jc_hit / 1e6, (double)s.jc_hit / n * 100,
+               (double)n / 1e6);
+        printf(" Victim hits:       %.2f M (%.2f%%)\n",
+               (double)s.vc_hit / 1e6, (double)s.vc_hit / n * 100);
+        printf(" qht lookups:       %.2f M (%.2f%%)\n",
+               (double)(s.rd + s.not_rd) / 1e6,
+               (double)(s.rd + s.not_rd) / n * 100);
+        tx = n / 1e6 / duration;
+        printf(" Throughput:        %.2f MT/s\n", tx);
+        printf(" Throughput/thread: %.2f MT/s/thread\n", tx / n_rw_threads);
+        return;
+    }
+
     printf(" Read:              %.2f M (%.2f%% of %.2fM)\n",
            (double)s.rd / 1e6,
            (double)s.rd / (s.rd + s.not_rd) * 100,
@@ -445,7 +559,7 @@ static void parse_args(int argc, char *argv[])
     int c;
 
     for (;;) {
-        c = getopt(argc, argv, "d:D:g:k:K:l:hn:N:o:pr:Rs:S:u:");
+        c = getopt(argc, argv, "d:D:g:j:k:K:l:hn:N:o:pr:Rs:S:tu:v:");
         if (c < 0) {
             break;
         }
@@ -466,6 +580,9 @@ static void parse_args(int argc, char *argv[])
         case 'h':
             usage_complete(argc, argv);
             exit(0);
+        case 'j':
+            jc_bits = MIN(atoi(optarg), 24);
+            break;
         case 'k':
             init_size = atol(optarg);
             break;
@@ -503,12 +620,18 @@ static void parse_args(int argc, char *argv[])
                 resize_rate = 1.0;
             }
             break;
+        case 't':
+            tb_lookup_mode = true;
+            break;
         case 'u':
             update_rate = atof(optarg) / 100.0;
             if (update_rate > 1.0) {
                 update_rate = 1.0;
             }
             break;
+        case 'v':
+            vc_ways = MIN(atoi(optarg), VC_MAX_WAYS);
+            break;
         }
     }
 }
@@ -34,6 +34,8 @@ enum op {
     OP_FMA,
     OP_SQRT,
     OP_CMP,
+    OP_ROUND_TO_INT,
+    OP_TO_INT,
     OP_MAX_NR,
 };
 
@@ -45,6 +47,8 @@ static const char * const op_names[] = {
     [OP_FMA] = "mulAdd",
     [OP_SQRT] = "sqrt",
     [OP_CMP] = "cmp",
+    [OP_ROUND_TO_INT] = "roundToInt",
+    [OP_TO_INT] = "toInt",
     [OP_MAX_NR] = NULL,
 };
 
@@ -52,9 +56,13 @@ enum precision {
     PREC_SINGLE,
     PREC_DOUBLE,
     PREC_QUAD,
+    PREC_HALF,
+    PREC_BFLOAT,
     PREC_FLOAT32,
     PREC_FLOAT64,
     PREC_FLOAT128,
+    PREC_FLOAT16,
+    PREC_BFLOAT16,
     PREC_MAX_NR,
 };
 
@@ -93,6 +101,8 @@ union fp {
     float32 f32;
     float64 f64;
     float128 f128;
+    float16 f16;
+    bfloat16 bf16;
     uint64_t u64;
 };
 
@@ -171,6 +181,26 @@ static void update_random_ops(int n_ops, enum precision prec)
             random_ops[i] = r;
             break;
         }
+        case PREC_HALF:
+        case PREC_FLOAT16:
+        {
+            uint64_t r = random_ops[i];
+            do {
+                r = xorshift64star(r);
+            } while (!float16_is_normal(r));
+            random_ops[i] = r;
+            break;
+        }
+        case PREC_BFLOAT:
+        case PREC_BFLOAT16:
+        {
+            uint64_t r = random_ops[i];
+            do {
+                r = xorshift64star(r);
+            } while (!bfloat16_is_normal(r));
+            random_ops[i] = r;
+            break;
+        }
         case PREC_QUAD:
         case PREC_FLOAT128:
         {
@@ -212,6 +242,20 @@ static void fill_random(union fp *ops, int n_ops, enum precision prec,
                 ops[i].f64 = float64_chs(ops[i].f64);
             }
             break;
+        case PREC_HALF:
+        case PREC_FLOAT16:
+            ops[i].f16 = make_float16(random_ops[i]);
+            if (no_neg && float16_is_neg(ops[i].f16)) {
+                ops[i].f16 = float16_chs(ops[i].f16);
+            }
+            break;
+        case PREC_BFLOAT:
+        case PREC_BFLOAT16:
+            ops[i].bf16 = random_ops[i];
+            if (no_neg && bfloat16_is_neg(ops[i].bf16)) {
+                ops[i].bf16 = bfloat16_chs(ops[i].bf16);
+            }
+            break;
         case PREC_QUAD:
         case PREC_FLOAT128:
             ops[i].f128 = random_quad_ops[i];
@@ -270,6 +314,12 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = isgreater(a, b);
                     break;
+                case OP_ROUND_TO_INT:
+                    res.f = rintf(a);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = lrintf(a);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
@@ -305,6 +355,12 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = isgreater(a, b);
                     break;
+                case OP_ROUND_TO_INT:
+                    res.d = rint(a);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = llrint(a);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
@@ -340,6 +396,12 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = float32_compare_quiet(a, b, &soft_status);
                     break;
+                case OP_ROUND_TO_INT:
+                    res.f32 = float32_round_to_int(a, &soft_status);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = float32_to_int32(a, &soft_status);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
@@ -375,6 +437,12 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = float64_compare_quiet(a, b, &soft_status);
                     break;
+                case OP_ROUND_TO_INT:
+                    res.f64 = float64_round_to_int(a, &soft_status);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = float64_to_int64(a, &soft_status);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
@@ -410,6 +478,94 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = float128_compare_quiet(a, b, &soft_status);
                     break;
+                case OP_ROUND_TO_INT:
+                    res.f128 = float128_round_to_int(a, &soft_status);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = float128_to_int64(a, &soft_status);
+                    break;
+                default:
+                    g_assert_not_reached();
+                }
+            }
+            break;
+        case PREC_FLOAT16:
+            fill_random(ops, n_ops, prec, no_neg);
+            t0 = get_clock();
+            for (i = 0; i < OPS_PER_ITER; i++) {
+                float16 a = ops[0].f16;
+                float16 b = ops[1].f16;
+                float16 c = ops[2].f16;
+
+                switch (op) {
+                case OP_ADD:
+                    res.f16 = float16_add(a, b, &soft_status);
+                    break;
+                case OP_SUB:
+                    res.f16 = float16_sub(a, b, &soft_status);
+                    break;
+                case OP_MUL:
+                    res.f16 = float16_mul(a, b, &soft_status);
+                    break;
+                case OP_DIV:
+                    res.f16 = float16_div(a, b, &soft_status);
+                    break;
+                case OP_FMA:
+                    res.f16 = float16_muladd(a, b, c, 0, &soft_status);
+                    break;
+                case OP_SQRT:
+                    res.f16 = float16_sqrt(a, &soft_status);
+                    break;
+                case OP_CMP:
+                    res.u64 = float16_compare_quiet(a, b, &soft_status);
+                    break;
+                case OP_ROUND_TO_INT:
+                    res.f16 = float16_round_to_int(a, &soft_status);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = float16_to_int32(a, &soft_status);
+                    break;
+                default:
+                    g_assert_not_reached();
+                }
+            }
+            break;
+        case PREC_BFLOAT16:
+            fill_random(ops, n_ops, prec, no_neg);
+            t0 = get_clock();
+            for (i = 0; i < OPS_PER_ITER; i++) {
+                bfloat16 a = ops[0].bf16;
+                bfloat16 b = ops[1].bf16;
+                bfloat16 c = ops[2].bf16;
+
+                switch (op) {
+                case OP_ADD:
+                    res.bf16 = bfloat16_add(a, b, &soft_status);
+                    break;
+                case OP_SUB:
+                    res.bf16 = bfloat16_sub(a, b, &soft_status);
+                    break;
+                case OP_MUL:
+                    res.bf16 = bfloat16_mul(a, b, &soft_status);
+                    break;
+                case OP_DIV:
+                    res.bf16 = bfloat16_div(a, b, &soft_status);
+                    break;
+                case OP_FMA:
+                    res.bf16 = bfloat16_muladd(a, b, c, 0, &soft_status);
+                    break;
+                case OP_SQRT:
+                    res.bf16 = bfloat16_sqrt(a, &soft_status);
+                    break;
+                case OP_CMP:
+                    res.u64 = bfloat16_compare_quiet(a, b, &soft_status);
+                    break;
+                case OP_ROUND_TO_INT:
+                    res.bf16 = bfloat16_round_to_int(a, &soft_status);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = bfloat16_to_int32(a, &soft_status);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
@@ -440,7 +596,9 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
     GEN_BENCH(bench_ ## opname ## _double, double, PREC_DOUBLE, op, n_ops) \
     GEN_BENCH(bench_ ## opname ## _float32, float32, PREC_FLOAT32, op, n_ops) \
     GEN_BENCH(bench_ ## opname ## _float64, float64, PREC_FLOAT64, op, n_ops) \
-    GEN_BENCH(bench_ ## opname ## _float128, float128, PREC_FLOAT128, op, n_ops)
+    GEN_BENCH(bench_ ## opname ## _float128, float128, PREC_FLOAT128, op, n_ops) \
+    GEN_BENCH(bench_ ## opname ## _float16, float16, PREC_FLOAT16, op, n_ops) \
+    GEN_BENCH(bench_ ## opname ## _bfloat16, bfloat16, PREC_BFLOAT16, op, n_ops)
 
 GEN_BENCH_ALL_TYPES(add, OP_ADD, 2)
 GEN_BENCH_ALL_TYPES(sub, OP_SUB, 2)
@@ -448,6 +606,8 @@ GEN_BENCH_ALL_TYPES(mul, OP_MUL, 2)
 GEN_BENCH_ALL_TYPES(div, OP_DIV, 2)
 GEN_BENCH_ALL_TYPES(fma, OP_FMA, 3)
 GEN_BENCH_ALL_TYPES(cmp, OP_CMP, 2)
+GEN_BENCH_ALL_TYPES(round_to_int, OP_ROUND_TO_INT, 1)
+GEN_BENCH_ALL_TYPES(to_int, OP_TO_INT, 1)
 #undef GEN_BENCH_ALL_TYPES
 
 #define GEN_BENCH_ALL_TYPES_NO_NEG(name, op, n)                         \
@@ -455,7 +615,9 @@ GEN_BENCH_ALL_TYPES(cmp, OP_CMP, 2)
     GEN_BENCH_NO_NEG(bench_ ## name ## _double, double, PREC_DOUBLE, op, n) \
     GEN_BENCH_NO_NEG(bench_ ## name ## _float32, float32, PREC_FLOAT32, op, n) \
     GEN_BENCH_NO_NEG(bench_ ## name ## _float64, float64, PREC_FLOAT64, op, n) \
-    GEN_BENCH_NO_NEG(bench_ ## name ## _float128, float128, PREC_FLOAT128, op, n)
+    GEN_BENCH_NO_NEG(bench_ ## name ## _float128, float128, PREC_FLOAT128, op, n) \
+    GEN_BENCH_NO_NEG(bench_ ## name ## _float16, float16, PREC_FLOAT16, op, n) \
+    GEN_BENCH_NO_NEG(bench_ ## name ## _bfloat16, bfloat16, PREC_BFLOAT16, op, n)
 
 GEN_BENCH_ALL_TYPES_NO_NEG(sqrt, OP_SQRT, 1)
 #undef GEN_BENCH_ALL_TYPES_NO_NEG
@@ -470,6 +632,8 @@ GEN_BENCH_ALL_TYPES_NO_NEG(sqrt, OP_SQRT, 1)
         [PREC_FLOAT32]   = bench_ ## opname ## _float32,        \
         [PREC_FLOAT64]   = bench_ ## opname ## _float64,        \
         [PREC_FLOAT128]   = bench_ ## opname ## _float128,      \
+        [PREC_FLOAT16]   = bench_ ## opname ## _float16,        \
+        [PREC_BFLOAT16]  = bench_ ## opname ## _bfloat16,       \
     }
 
 static const bench_func_t bench_funcs[OP_MAX_NR][PREC_MAX_NR] = {
@@ -480,6 +644,8 @@ static const bench_func_t bench_funcs[OP_MAX_NR][PREC_MAX_NR] = {
     GEN_BENCH_FUNCS(fma, OP_FMA),
     GEN_BENCH_FUNCS(sqrt, OP_SQRT),
     GEN_BENCH_FUNCS(cmp, OP_CMP),
+    GEN_BENCH_FUNCS(round_to_int, OP_ROUND_TO_INT),
+    GEN_BENCH_FUNCS(to_int, OP_TO_INT),
 };
 
 #undef GEN_BENCH_FUNCS
@@ -518,7 +684,8 @@ static void usage_complete(int argc, char *argv[])
     fprintf(stderr, " -h = show this help message.\n");
     fprintf(stderr, " -o = floating point operation (%s). Default: %s\n",
             op_list, op_names[0]);
-    fprintf(stderr, " -p = floating point precision (single, double, quad[soft only]). "
+    fprintf(stderr, " -p = floating point precision (single, double, "
+            "quad[soft only], half[soft only], bfloat[soft only]). "
             "Default: single\n");
     fprintf(stderr, " -r = rounding mode (even, zero, down, up, tieaway). "
             "Default: even\n");
@@ -641,6 +808,10 @@ static void parse_args(int argc, char *argv[])
                 precision = PREC_DOUBLE;
             } else if (!strcmp(optarg, "quad")) {
                 precision = PREC_QUAD;
+            } else if (!strcmp(optarg, "half")) {
+                precision = PREC_HALF;
+            } else if (!strcmp(optarg, "bfloat")) {
+                precision = PREC_BFLOAT;
             } else {
                 fprintf(stderr, "Unsupported precision '%s'\n", optarg);
                 exit(EXIT_FAILURE);
@@ -687,6 +858,12 @@ static void parse_args(int argc, char *argv[])
         case PREC_QUAD:
             precision = PREC_FLOAT128;
             break;
+        case PREC_HALF:
+            precision = PREC_FLOAT16;
+            break;
+        case PREC_BFLOAT:
+            precision = PREC_BFLOAT16;
+            break;
         default:
             g_assert_not_reached();
         }
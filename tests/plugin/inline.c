@@ -0,0 +1,207 @@
+/*
+ * Check that inline ops on scoreboards, conditional callbacks and trace
+ * buffers give the same counts as the equivalent regular callbacks.
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <glib.h>
+
+#include <qemu-plugin.h>
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
+
+/* the conditional callback runs every COND_PERIOD executed TBs */
+#define COND_PERIOD 1000
+
+typedef struct {
+    uint64_t count_tb;
+    uint64_t count_tb_inline;
+    uint64_t count_insn;
+    uint64_t count_insn_inline;
+    uint64_t count_mem;
+    uint64_t count_mem_inline;
+    uint64_t tb_cond_track;
+    uint64_t count_tb_cond;
+    uint64_t last_tb_pc;
+    uint64_t count_insn_buffered;
+    uint64_t count_mem_buffered;
+} CPUCount;
+
+static struct qemu_plugin_scoreboard *counts;
+static qemu_plugin_u64 count_tb;
+static qemu_plugin_u64 count_tb_inline;
+static qemu_plugin_u64 count_insn;
+static qemu_plugin_u64 count_insn_inline;
+static qemu_plugin_u64 count_mem;
+static qemu_plugin_u64 count_mem_inline;
+static qemu_plugin_u64 tb_cond_track;
+static qemu_plugin_u64 count_tb_cond;
+static qemu_plugin_u64 last_tb_pc;
+static qemu_plugin_u64 count_insn_buffered;
+static qemu_plugin_u64 count_mem_buffered;
+static struct qemu_plugin_mem_buffer *trace_buf;
+
+static void check(const char *what, uint64_t expected, uint64_t found)
+{
+    if (expected != found) {
+        fprintf(stderr, "inline: %s is %" PRIu64 ", expected %" PRIu64 "\n",
+                what, found, expected);
+        g_assert_not_reached();
+    }
+}
+
+static void plugin_exit(qemu_plugin_id_t id, void *udata)
+{
+    g_autoptr(GString) report = g_string_new("");
+    uint64_t tb = 0;
+    int i;
+
+    for (i = 0; i < qemu_plugin_num_vcpus(); i++) {
+        uint64_t n = qemu_plugin_u64_get(count_tb, i);
+
+        check("tb inline", n, qemu_plugin_u64_get(count_tb_inline, i));
+        check("tb cond", n / COND_PERIOD,
+              qemu_plugin_u64_get(count_tb_cond, i));
+        check("tb cond track", n % COND_PERIOD,
+              qemu_plugin_u64_get(tb_cond_track, i));
+        check("insn inline", qemu_plugin_u64_get(count_insn, i),
+              qemu_plugin_u64_get(count_insn_inline, i));
+        check("mem inline", qemu_plugin_u64_get(count_mem, i),
+              qemu_plugin_u64_get(count_mem_inline, i));
+        check("insn buffered", qemu_plugin_u64_get(count_insn, i),
+              qemu_plugin_u64_get(count_insn_buffered, i));
+        check("mem buffered", qemu_plugin_u64_get(count_mem, i),
+              qemu_plugin_u64_get(count_mem_buffered, i));
+        tb += n;
+    }
+
+    g_string_printf(report, "tb: %" PRIu64 ", insn: %" PRIu64
+                    ", mem: %" PRIu64 "\n", tb,
+                    qemu_plugin_u64_sum(count_insn),
+                    qemu_plugin_u64_sum(count_mem));
+    qemu_plugin_outs(report->str);
+    qemu_plugin_scoreboard_free(counts);
+}
+
+static void vcpu_tb_exec(unsigned int cpu_index, void *udata)
+{
+    qemu_plugin_u64_add(count_tb, cpu_index, 1);
+}
+
+static void vcpu_tb_cond_exec(unsigned int cpu_index, void *udata)
+{
+    /* the inline store of this TB's address happens first */
+    check("last tb pc", (uintptr_t)udata,
+          qemu_plugin_u64_get(last_tb_pc, cpu_index));
+    qemu_plugin_u64_set(tb_cond_track, cpu_index, 0);
+    qemu_plugin_u64_add(count_tb_cond, cpu_index, 1);
+}
+
+static void vcpu_insn_exec(unsigned int cpu_index, void *udata)
+{
+    qemu_plugin_u64_add(count_insn, cpu_index, 1);
+}
+
+static void vcpu_mem_access(unsigned int cpu_index, qemu_plugin_meminfo_t info,
+                            uint64_t vaddr, void *udata)
+{
+    qemu_plugin_u64_add(count_mem, cpu_index, 1);
+}
+
+static void vcpu_trace_buf_full(unsigned int cpu_index,
+                                const struct qemu_plugin_mem_record *records,
+                                size_t n, void *udata)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        const struct qemu_plugin_mem_record *rec = &records[i];
+
+        if (rec->info == 0) {
+            check("buffered insn vaddr", rec->insn_vaddr, rec->vaddr);
+            qemu_plugin_u64_add(count_insn_buffered, cpu_index, 1);
+        } else {
+            qemu_plugin_u64_add(count_mem_buffered, cpu_index, 1);
+        }
+        check("buffered insn", (uintptr_t)rec->insn_vaddr,
+              (uintptr_t)rec->userdata);
+    }
+}
+
+static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
+{
+    uint64_t pc = qemu_plugin_tb_vaddr(tb);
+    size_t n = qemu_plugin_tb_n_insns(tb);
+    size_t i;
+
+    qemu_plugin_register_vcpu_tb_exec_cb(tb, vcpu_tb_exec,
+                                         QEMU_PLUGIN_CB_NO_REGS, NULL);
+    qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+        tb, QEMU_PLUGIN_INLINE_ADD_U64, count_tb_inline, 1);
+    qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+        tb, QEMU_PLUGIN_INLINE_ADD_U64, tb_cond_track, 1);
+    qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+        tb, QEMU_PLUGIN_INLINE_STORE_U64, last_tb_pc, pc);
+    qemu_plugin_register_vcpu_tb_exec_cond_cb(
+        tb, vcpu_tb_cond_exec, QEMU_PLUGIN_CB_NO_REGS,
+        QEMU_PLUGIN_COND_GE, tb_cond_track, COND_PERIOD, (void *)pc);
+
+    for (i = 0; i < n; i++) {
+        struct qemu_plugin_insn *insn = qemu_plugin_tb_get_insn(tb, i);
+
+        qemu_plugin_register_vcpu_insn_exec_cb(insn, vcpu_insn_exec,
+                                               QEMU_PLUGIN_CB_NO_REGS, NULL);
+        qemu_plugin_register_vcpu_insn_exec_inline_per_vcpu(
+            insn, QEMU_PLUGIN_INLINE_ADD_U64, count_insn_inline, 1);
+        qemu_plugin_register_vcpu_mem_cb(insn, vcpu_mem_access,
+                                         QEMU_PLUGIN_CB_NO_REGS,
+                                         QEMU_PLUGIN_MEM_RW, NULL);
+        qemu_plugin_register_vcpu_mem_inline_per_vcpu(
+            insn, QEMU_PLUGIN_MEM_RW, QEMU_PLUGIN_INLINE_ADD_U64,
+            count_mem_inline, 1);
+        qemu_plugin_register_vcpu_insn_exec_buffered(
+            insn, trace_buf, (void *)(uintptr_t)qemu_plugin_insn_vaddr(insn));
+        qemu_plugin_register_vcpu_mem_buffered(
+            insn, trace_buf, QEMU_PLUGIN_MEM_RW,
+            (void *)(uintptr_t)qemu_plugin_insn_vaddr(insn));
+    }
+}
+
+QEMU_PLUGIN_EXPORT
+int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
+                        int argc, char **argv)
+{
+    counts = qemu_plugin_scoreboard_new(sizeof(CPUCount));
+    count_tb = qemu_plugin_scoreboard_u64_in_struct(
+        counts, CPUCount, count_tb);
+    count_tb_inline = qemu_plugin_scoreboard_u64_in_struct(
+        counts, CPUCount, count_tb_inline);
+    count_insn = qemu_plugin_scoreboard_u64_in_struct(
+        counts, CPUCount, count_insn);
+    count_insn_inline = qemu_plugin_scoreboard_u64_in_struct(
+        counts, CPUCount, count_insn_inline);
+    count_mem = qemu_plugin_scoreboard_u64_in_struct(
+        counts, CPUCount, count_mem);
+    count_mem_inline = qemu_plugin_scoreboard_u64_in_struct(
+        counts, CPUCount, count_mem_inline);
+    tb_cond_track = qemu_plugin_scoreboard_u64_in_struct(
+        counts, CPUCount, tb_cond_track);
+    count_tb_cond = qemu_plugin_scoreboard_u64_in_struct(
+        counts, CPUCount, count_tb_cond);
+    last_tb_pc = qemu_plugin_scoreboard_u64_in_struct(
+        counts, CPUCount, last_tb_pc);
+    count_insn_buffered = qemu_plugin_scoreboard_u64_in_struct(
+        counts, CPUCount, count_insn_buffered);
+    count_mem_buffered = qemu_plugin_scoreboard_u64_in_struct(
+        counts, CPUCount, count_mem_buffered);
+    /* small, so that the buffer-full path is exercised */
+    trace_buf = qemu_plugin_register_vcpu_mem_buffer_cb(
+        id, vcpu_trace_buf_full, 64, NULL);
+
+    qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
+    qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
+    return 0;
+}
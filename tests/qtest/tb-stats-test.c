@@ -0,0 +1,124 @@
+/*
+ * QTest testcase for the TCG translation block statistics
+ *
+ * Boot the firmware with "-accel tcg,tb-stats=on" and check that the
+ * monitor lists the translation blocks it executed.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+#include "qapi/qmp/qdict.h"
+
+/* Return the number of TBs with statistics, according to @text. */
+static unsigned tb_hot_total(const char *text)
+{
+    unsigned shown, total;
+
+    g_assert_cmpint(sscanf(text, "%u of %u TBs", &shown, &total), ==, 2);
+    g_assert_cmpuint(shown, <=, total);
+    return total;
+}
+
+/* Return the execution count of the @row-th TB listed in @text. */
+static uint64_t tb_hot_execs(const char *text, int row)
+{
+    g_auto(GStrv) lines = g_strsplit(text, "\n", -1);
+    uint64_t pc, phys_pc, execs;
+    unsigned flags;
+
+    g_assert_cmpuint(g_strv_length(lines), >, row + 2);
+    g_assert_cmpint(sscanf(lines[row + 2], "%" SCNx64 " %" SCNx64 " %x %"
+                           SCNu64, &pc, &phys_pc, &flags, &execs), ==, 4);
+    return execs;
+}
+
+static void test_tb_hot(void)
+{
+    QTestState *qts;
+    char *text;
+    int i;
+
+    qts = qtest_init("-M pc -smp 2 -nodefaults -accel tcg,tb-stats=on");
+
+    /* Wait for the firmware to run some code. */
+    for (i = 0; i < 1000; i++) {
+        text = qtest_hmp(qts, "info tb-hot 5");
+        if (tb_hot_total(text) >= 5) {
+            break;
+        }
+        g_free(text);
+        g_usleep(10000);
+    }
+    g_assert_cmpuint(tb_hot_total(text), >=, 5);
+    g_assert_nonnull(strstr(text, "5 of "));
+    g_assert_nonnull(strstr(text, "execs"));
+
+    /* Sorted by decreasing execution count. */
+    g_assert_cmpuint(tb_hot_execs(text, 0), >, 0);
+    for (i = 1; i < 5; i++) {
+        g_assert_cmpuint(tb_hot_execs(text, i - 1), >=,
+                         tb_hot_execs(text, i));
+    }
+    g_free(text);
+
+    text = qtest_hmp(qts, "info tb-hot 3 translations");
+    g_assert_nonnull(strstr(text, "3 of "));
+    g_free(text);
+
+    text = qtest_hmp(qts, "info tb-hot 3 nonsense");
+    g_assert_nonnull(strstr(text, "nonsense"));
+    g_free(text);
+
+    text = qtest_hmp(qts, "info tb-hot 0");
+    g_assert_nonnull(strstr(text, "0 of "));
+    g_free(text);
+
+    qtest_quit(qts);
+}
+
+static void test_tb_hot_qmp(void)
+{
+    QTestState *qts;
+    QDict *resp;
+    const char *text;
+
+    qts = qtest_init("-M pc -nodefaults -accel tcg,tb-stats=on");
+
+    resp = qtest_qmp(qts, "{ 'execute': 'x-query-tb-hot',"
+                     "  'arguments': { 'count': 2, 'sort-by': 'insns' } }");
+    text = qdict_get_str(qdict_get_qdict(resp, "return"),
+                         "human-readable-text");
+    g_assert_nonnull(strstr(text, " TBs\n"));
+    qobject_unref(resp);
+
+    qtest_quit(qts);
+}
+
+static void test_tb_hot_disabled(void)
+{
+    QTestState *qts;
+    QDict *resp;
+
+    qts = qtest_init("-M pc -nodefaults -accel tcg");
+
+    resp = qtest_qmp(qts, "{ 'execute': 'x-query-tb-hot' }");
+    g_assert_nonnull(qdict_get_qdict(resp, "error"));
+    qobject_unref(resp);
+
+    qtest_quit(qts);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    if (qtest_has_accel("tcg")) {
+        qtest_add_func("/tb-stats/hot", test_tb_hot);
+        qtest_add_func("/tb-stats/hot-qmp", test_tb_hot_qmp);
+        qtest_add_func("/tb-stats/disabled", test_tb_hot_disabled);
+    }
+
+    return g_test_run();
+}
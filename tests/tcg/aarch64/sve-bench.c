@@ -0,0 +1,178 @@
+/*
+ * SVE predicated integer operations
+ *
+ * Check the results of the predicated operations that QEMU expands
+ * inline when the governing predicate is all true, both in that case
+ * and with a partial predicate, and report the time taken per element
+ * for each class of instruction.
+ *
+ * Usage: sve-bench [repeat-count]
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Not a multiple of any vector length, so the last iteration is partial. */
+#define N 1003
+
+typedef void sve_fn(int32_t *d, const int32_t *a, const int32_t *b, long n);
+typedef int32_t ref_fn(int32_t d, int32_t a, int32_t b);
+
+/*
+ * Loop over the arrays with a whilelo governing predicate in p0; @OP
+ * computes z0 from z0 (a), z1 (b) and z2 (the old value of d).
+ */
+#define SVE_LOOP(NAME, OP)                                              \
+static void NAME(int32_t *d, const int32_t *a, const int32_t *b, long n) \
+{                                                                       \
+    long i = 0;                                                         \
+                                                                        \
+    asm volatile("whilelo p0.s, %[i], %[n]\n"                           \
+                 "1:\n\t"                                               \
+                 "ld1w {z0.s}, p0/z, [%[a], %[i], lsl #2]\n\t"          \
+                 "ld1w {z1.s}, p0/z, [%[b], %[i], lsl #2]\n\t"          \
+                 "ld1w {z2.s}, p0/z, [%[d], %[i], lsl #2]\n\t"          \
+                 OP "\n\t"                                              \
+                 "st1w {z0.s}, p0, [%[d], %[i], lsl #2]\n\t"            \
+                 "incw %[i]\n\t"                                        \
+                 "whilelo p0.s, %[i], %[n]\n\t"                         \
+                 "b.first 1b"                                           \
+                 : [i] "+r"(i)                                          \
+                 : [a] "r"(a), [b] "r"(b), [d] "r"(d), [n] "r"(n)       \
+                 : "memory", "cc", "p0", "p1", "z0", "z1", "z2");       \
+}
+
+SVE_LOOP(sve_add, "add z0.s, p0/m, z0.s, z1.s")
+SVE_LOOP(sve_eor, "eor z0.s, p0/m, z0.s, z1.s")
+SVE_LOOP(sve_smax, "smax z0.s, p0/m, z0.s, z1.s")
+SVE_LOOP(sve_uabd, "uabd z0.s, p0/m, z0.s, z1.s")
+SVE_LOOP(sve_mul, "mul z0.s, p0/m, z0.s, z1.s")
+SVE_LOOP(sve_neg, "neg z0.s, p0/m, z1.s")
+SVE_LOOP(sve_abs, "abs z0.s, p0/m, z1.s")
+SVE_LOOP(sve_mla, "mla z2.s, p0/m, z0.s, z1.s\n\tmov z0.d, z2.d")
+SVE_LOOP(sve_sel, "cmpgt p1.s, p0/z, z0.s, z1.s\n\t"
+                  "sel z0.s, p1, z0.s, z1.s")
+SVE_LOOP(sve_add_partial, "cmpgt p1.s, p0/z, z0.s, z1.s\n\t"
+                          "add z0.s, p1/m, z0.s, z1.s")
+
+static int32_t ref_add(int32_t d, int32_t a, int32_t b)
+{
+    return (uint32_t)a + (uint32_t)b;
+}
+
+static int32_t ref_eor(int32_t d, int32_t a, int32_t b)
+{
+    return a ^ b;
+}
+
+static int32_t ref_smax(int32_t d, int32_t a, int32_t b)
+{
+    return a > b ? a : b;
+}
+
+static int32_t ref_uabd(int32_t d, int32_t a, int32_t b)
+{
+    return (uint32_t)a > (uint32_t)b ? (uint32_t)a - b : (uint32_t)b - a;
+}
+
+static int32_t ref_mul(int32_t d, int32_t a, int32_t b)
+{
+    return (uint32_t)a * (uint32_t)b;
+}
+
+static int32_t ref_neg(int32_t d, int32_t a, int32_t b)
+{
+    return -(uint32_t)b;
+}
+
+static int32_t ref_abs(int32_t d, int32_t a, int32_t b)
+{
+    return b < 0 ? -(uint32_t)b : b;
+}
+
+static int32_t ref_mla(int32_t d, int32_t a, int32_t b)
+{
+    return (uint32_t)d + (uint32_t)a * (uint32_t)b;
+}
+
+static int32_t ref_sel(int32_t d, int32_t a, int32_t b)
+{
+    return a > b ? a : b;
+}
+
+static int32_t ref_add_partial(int32_t d, int32_t a, int32_t b)
+{
+    return a > b ? (uint32_t)a + (uint32_t)b : a;
+}
+
+static const struct {
+    const char *name;
+    sve_fn *fn;
+    ref_fn *ref;
+} tests[] = {
+    { "add", sve_add, ref_add },
+    { "eor", sve_eor, ref_eor },
+    { "smax", sve_smax, ref_smax },
+    { "uabd", sve_uabd, ref_uabd },
+    { "mul", sve_mul, ref_mul },
+    { "neg", sve_neg, ref_neg },
+    { "abs", sve_abs, ref_abs },
+    { "mla", sve_mla, ref_mla },
+    { "sel", sve_sel, ref_sel },
+    { "add (partial predicate)", sve_add_partial, ref_add_partial },
+};
+
+static int32_t a[N], b[N], d[N], expect[N];
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    long reps = argc > 1 ? atol(argv[1]) : 10;
+    int failed = 0;
+    unsigned t;
+    long i, r;
+
+    for (t = 0; t < sizeof(tests) / sizeof(tests[0]); t++) {
+        uint32_t seed = 0x9e3779b9 * (t + 1);
+        double start;
+
+        for (i = 0; i < N; i++) {
+            seed = seed * 1103515245 + 12345;
+            a[i] = seed;
+            seed = seed * 1103515245 + 12345;
+            b[i] = (int32_t)seed >> (i & 15);
+            d[i] = i;
+            expect[i] = tests[t].ref(d[i], a[i], b[i]);
+        }
+
+        tests[t].fn(d, a, b, N);
+        for (i = 0; i < N; i++) {
+            if (d[i] != expect[i]) {
+                printf("FAIL %s: element %ld is 0x%08x, expected 0x%08x\n",
+                       tests[t].name, i, (uint32_t)d[i],
+                       (uint32_t)expect[i]);
+                failed = 1;
+                break;
+            }
+        }
+
+        start = now();
+        for (r = 0; r < reps; r++) {
+            tests[t].fn(d, a, b, N);
+        }
+        printf("%-24s %8.2f ns/element\n", tests[t].name,
+               (now() - start) / (reps * N));
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,170 @@
+/*
+ * Map and unmap a large amount of memory in small pieces
+ *
+ * Check that the pieces mapped without a hint do not overlap and keep
+ * their contents while the address space around them changes, and
+ * report the time taken per mmap, mprotect and munmap call.
+ *
+ * Usage: mmap-bench [total-MiB]
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#define PIECE (64 * 1024)
+/* Only write to some pieces, so that little memory is actually used. */
+#define MARK_EVERY 64
+
+static char **pieces;
+static long n_pieces;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *what, long n, double start)
+{
+    printf("%-32s %8.2f us/call\n", what, (now() - start) / n / 1e3);
+}
+
+static char *map_piece(void *addr, int flags)
+{
+    char *p = mmap(addr, PIECE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | flags, -1, 0);
+
+    assert(p != MAP_FAILED);
+    return p;
+}
+
+static int cmp_ptr(const void *a, const void *b)
+{
+    uintptr_t pa = (uintptr_t)*(char * const *)a;
+    uintptr_t pb = (uintptr_t)*(char * const *)b;
+
+    return pa < pb ? -1 : pa > pb;
+}
+
+static void check_pieces(void)
+{
+    char **sorted = malloc(n_pieces * sizeof(*sorted));
+    long i;
+
+    for (i = 0; i < n_pieces; i++) {
+        sorted[i] = pieces[i];
+        if (i % MARK_EVERY == 0) {
+            assert(pieces[i][PIECE - 1] == (char)(i / MARK_EVERY + 1));
+        }
+    }
+    qsort(sorted, n_pieces, sizeof(*sorted), cmp_ptr);
+    for (i = 1; i < n_pieces; i++) {
+        assert(sorted[i] - sorted[i - 1] >= PIECE);
+    }
+    free(sorted);
+}
+
+/* Pieces placed by mmap, in an address space that gets fragmented. */
+static void bench_unhinted(void)
+{
+    double start;
+    long i;
+
+    start = now();
+    for (i = 0; i < n_pieces; i++) {
+        pieces[i] = map_piece(NULL, 0);
+        if (i % MARK_EVERY == 0) {
+            pieces[i][PIECE - 1] = i / MARK_EVERY + 1;
+        }
+    }
+    report("mmap", n_pieces, start);
+    check_pieces();
+
+    /* Unmap every other piece, and map them again into the holes. */
+    start = now();
+    for (i = 1; i < n_pieces; i += 2) {
+        assert(munmap(pieces[i], PIECE) == 0);
+    }
+    report("munmap (every other piece)", n_pieces / 2, start);
+
+    start = now();
+    for (i = 1; i < n_pieces; i += 2) {
+        pieces[i] = map_piece(NULL, 0);
+        if (i % MARK_EVERY == 0) {
+            pieces[i][PIECE - 1] = i / MARK_EVERY + 1;
+        }
+    }
+    report("mmap (fragmented)", n_pieces / 2, start);
+    check_pieces();
+
+    start = now();
+    for (i = 0; i < n_pieces; i++) {
+        assert(mprotect(pieces[i], PIECE / 2, PROT_READ) == 0);
+    }
+    report("mprotect (half a piece)", n_pieces, start);
+    check_pieces();
+
+    start = now();
+    for (i = 0; i < n_pieces; i++) {
+        assert(munmap(pieces[i], PIECE) == 0);
+    }
+    report("munmap", n_pieces, start);
+}
+
+/* Pieces mapped and unmapped at fixed addresses within one region. */
+static void bench_fixed(void)
+{
+    size_t total = n_pieces * (size_t)PIECE;
+    char *region = mmap(NULL, total, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    double start;
+    long i;
+
+    assert(region != MAP_FAILED);
+
+    start = now();
+    for (i = 0; i < n_pieces; i++) {
+        pieces[i] = map_piece(region + i * (size_t)PIECE, MAP_FIXED);
+        assert(pieces[i] == region + i * (size_t)PIECE);
+        if (i % MARK_EVERY == 0) {
+            pieces[i][PIECE - 1] = i / MARK_EVERY + 1;
+        }
+    }
+    report("mmap (fixed)", n_pieces, start);
+    check_pieces();
+
+    start = now();
+    for (i = 0; i < n_pieces; i += 2) {
+        assert(mprotect(pieces[i], PIECE, PROT_NONE) == 0);
+    }
+    report("mprotect (fixed)", (n_pieces + 1) / 2, start);
+
+    start = now();
+    for (i = n_pieces - 1; i >= 0; i--) {
+        assert(munmap(pieces[i], PIECE) == 0);
+    }
+    report("munmap (fixed, top down)", n_pieces, start);
+}
+
+int main(int argc, char **argv)
+{
+    long mib = argc > 1 ? atol(argv[1]) : (sizeof(void *) == 4 ? 256 : 2048);
+
+    n_pieces = mib * (1024 * 1024 / PIECE);
+    pieces = calloc(n_pieces, sizeof(*pieces));
+    assert(pieces);
+
+    printf("%ld MiB in %ld pieces of %d KiB\n", mib, n_pieces, PIECE / 1024);
+    bench_unhinted();
+    bench_fixed();
+
+    free(pieces);
+    return EXIT_SUCCESS;
+}
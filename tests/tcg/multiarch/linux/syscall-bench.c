@@ -0,0 +1,158 @@
+/*
+ * Latency of common I/O syscalls
+ *
+ * Check the results of read, write, pread and pwrite on pipes, files
+ * and /dev/null, including the errors for bad buffers, and report the
+ * time taken per call.
+ *
+ * Usage: syscall-bench [iterations]
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define BUF_SIZE 4096
+
+static char buf[BUF_SIZE], ref[BUF_SIZE];
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *what, long n, double start)
+{
+    printf("%-32s %8.2f us/call\n", what, (now() - start) / n / 1e3);
+}
+
+static void check_errors(int fd)
+{
+    char *bad = mmap(NULL, getpagesize(), PROT_READ,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    assert(bad != MAP_FAILED);
+
+    /* An empty NULL buffer is fine. */
+    assert(pread(fd, NULL, 0, 0) == 0);
+    assert(pwrite(fd, NULL, 0, 0) == 0);
+
+    /* Reading into a read-only buffer, or from an unmapped one, faults. */
+    assert(pread(fd, bad, 1, 0) == -1 && errno == EFAULT);
+    assert(munmap(bad, getpagesize()) == 0);
+    assert(pwrite(fd, bad, 1, 0) == -1 && errno == EFAULT);
+    assert(write(fd, bad, 1) == -1 && errno == EFAULT);
+
+    assert(read(-1, buf, 1) == -1 && errno == EBADF);
+}
+
+static void bench_pipe(long n)
+{
+    double start;
+    int fds[2];
+    long i;
+
+    assert(pipe(fds) == 0);
+
+    start = now();
+    for (i = 0; i < n; i++) {
+        buf[0] = i;
+        assert(write(fds[1], buf, 64) == 64);
+        buf[0] = 0;
+        assert(read(fds[0], buf, 64) == 64);
+        assert(buf[0] == (char)i);
+    }
+    report("pipe write + read, 64 bytes", n, start);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void bench_file(long n)
+{
+    char name[] = "/tmp/syscall-bench-XXXXXX";
+    int fd = mkstemp(name);
+    double start;
+    long i;
+
+    assert(fd >= 0);
+    unlink(name);
+
+    for (i = 0; i < BUF_SIZE; i++) {
+        ref[i] = i * 7;
+    }
+    assert(write(fd, ref, BUF_SIZE) == BUF_SIZE);
+    assert(pread(fd, buf, BUF_SIZE, 0) == BUF_SIZE);
+    assert(memcmp(buf, ref, BUF_SIZE) == 0);
+    assert(pread(fd, buf, 100, BUF_SIZE - 10) == 10);
+    assert(memcmp(buf, ref + BUF_SIZE - 10, 10) == 0);
+    check_errors(fd);
+
+    start = now();
+    for (i = 0; i < n; i++) {
+        assert(pread(fd, buf, BUF_SIZE, 0) == BUF_SIZE);
+    }
+    report("pread, 4 KiB", n, start);
+    assert(memcmp(buf, ref, BUF_SIZE) == 0);
+
+    start = now();
+    for (i = 0; i < n; i++) {
+        assert(pwrite(fd, ref + (i & 63), 64, i & 63) == 64);
+    }
+    report("pwrite, 64 bytes", n, start);
+    assert(pread(fd, buf, 64, 63) == 64);
+    assert(memcmp(buf, ref + 63, 64) == 0);
+
+    close(fd);
+}
+
+static void bench_null(long n)
+{
+    int fd = open("/dev/null", O_RDWR);
+    double start;
+    long i;
+
+    assert(fd >= 0);
+
+    start = now();
+    for (i = 0; i < n; i++) {
+        assert(write(fd, buf, 1) == 1);
+    }
+    report("write, /dev/null", n, start);
+
+    start = now();
+    for (i = 0; i < n; i++) {
+        assert(read(fd, buf, 1) == 0);
+    }
+    report("read, /dev/null", n, start);
+
+    start = now();
+    for (i = 0; i < n; i++) {
+        syscall(SYS_getppid);
+    }
+    report("getppid", n, start);
+
+    close(fd);
+}
+
+int main(int argc, char **argv)
+{
+    long n = argc > 1 ? atol(argv[1]) : 100000;
+
+    bench_null(n);
+    bench_pipe(n);
+    bench_file(n);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,181 @@
+/*
+ * Test that concurrent memory syscalls do not race.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Each thread repeatedly maps, protects and unmaps memory, both at
+ * fixed addresses in a shared region and wherever mmap places it, and
+ * runs code from fresh mappings.  The pages of the shared region are
+ * interleaved between the threads, so that with host pages larger than
+ * the guest pages, the threads change the same host pages concurrently.
+ * Check that no mapping overlaps another one and that the contents of
+ * each page survive the operations of the other threads.
+ */
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "nop_func.h"
+
+#define N_THREADS 8
+#define PAGES_PER_THREAD 16
+#define N_ITERATIONS 2000
+
+static char *region;
+static long pagesize;
+
+static uint32_t xorshift32(uint32_t x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+static void fill(char *p, size_t len, uint32_t marker)
+{
+    size_t i;
+
+    for (i = 0; i < len; i += sizeof(marker)) {
+        memcpy(p + i, &marker, sizeof(marker));
+    }
+}
+
+static void check(const char *p, size_t len, uint32_t marker)
+{
+    size_t i;
+
+    for (i = 0; i < len; i += sizeof(marker)) {
+        assert(memcmp(p + i, &marker, sizeof(marker)) == 0);
+    }
+}
+
+static char *own_page(long thread, long i)
+{
+    return region + (i * N_THREADS + thread) * pagesize;
+}
+
+/* Change the pages of the shared region that this thread owns. */
+static void step_fixed(long thread, uint32_t r, uint32_t *markers)
+{
+    long i = r % PAGES_PER_THREAD;
+    char *p = own_page(thread, i);
+    char *q;
+
+    switch ((r >> 8) % 4) {
+    case 0:
+        /* Replace the page with a new one. */
+        q = mmap(p, pagesize, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+        assert(q == p);
+        markers[i] = r;
+        fill(p, pagesize, r);
+        break;
+    case 1:
+        /* Make the page read-only, and back. */
+        if (markers[i]) {
+            assert(mprotect(p, pagesize, PROT_READ) == 0);
+            check(p, pagesize, markers[i]);
+            assert(mprotect(p, pagesize, PROT_READ | PROT_WRITE) == 0);
+            fill(p, pagesize, markers[i]);
+        }
+        break;
+    case 2:
+        /* Drop the page, but keep the address space reserved. */
+        q = mmap(p, pagesize, PROT_NONE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+        assert(q == p);
+        markers[i] = 0;
+        break;
+    default:
+        if (markers[i]) {
+            check(p, pagesize, markers[i]);
+        }
+        break;
+    }
+}
+
+/* Map and unmap memory wherever mmap places it. */
+static void step_unhinted(long thread, uint32_t r)
+{
+    int prot = PROT_READ | PROT_WRITE | (sizeof(nop_func) ? PROT_EXEC : 0);
+    char *p = mmap(NULL, 2 * pagesize, prot,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    uint32_t marker = r | 1;
+
+    assert(p != MAP_FAILED);
+    assert(p + 2 * pagesize <= region ||
+           p >= region + N_THREADS * PAGES_PER_THREAD * pagesize);
+
+    fill(p, 2 * pagesize, marker);
+    if (sizeof(nop_func)) {
+        /* Create a small translation block. */
+        memcpy(p + pagesize, nop_func, sizeof(nop_func));
+        ((void (*)(void))(p + pagesize))();
+    }
+    sched_yield();
+    check(p, pagesize, marker);
+
+    /* Unmap the two pages separately, in either order. */
+    if (r & 2) {
+        assert(munmap(p, pagesize) == 0);
+        assert(munmap(p + pagesize, pagesize) == 0);
+    } else {
+        assert(munmap(p + pagesize, pagesize) == 0);
+        check(p, pagesize, marker);
+        assert(munmap(p, pagesize) == 0);
+    }
+}
+
+static void *thread_func(void *arg)
+{
+    long thread = (long)arg;
+    uint32_t markers[PAGES_PER_THREAD] = { 0 };
+    uint32_t r = 0x9e3779b9 * (thread + 1);
+    long i;
+
+    for (i = 0; i < N_ITERATIONS; i++) {
+        r = xorshift32(r);
+        if (r & 1) {
+            step_fixed(thread, r, markers);
+        } else {
+            step_unhinted(thread, r);
+        }
+    }
+
+    for (i = 0; i < PAGES_PER_THREAD; i++) {
+        if (markers[i]) {
+            check(own_page(thread, i), pagesize, markers[i]);
+        }
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    pthread_t threads[N_THREADS];
+    long i;
+    int ret;
+
+    pagesize = sysconf(_SC_PAGESIZE);
+    region = mmap(NULL, N_THREADS * PAGES_PER_THREAD * pagesize, PROT_NONE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(region != MAP_FAILED);
+
+    for (i = 0; i < N_THREADS; i++) {
+        ret = pthread_create(&threads[i], NULL, thread_func, (void *)i);
+        assert(ret == 0);
+    }
+    for (i = 0; i < N_THREADS; i++) {
+        ret = pthread_join(threads[i], NULL);
+        assert(ret == 0);
+    }
+
+    assert(munmap(region, N_THREADS * PAGES_PER_THREAD * pagesize) == 0);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+/*
+ * Unit-stride vector loads and stores with vl == VLMAX, next to and
+ * across a page boundary.  Accesses that stay within a page are done
+ * inline by the translator, the others by the helpers; both must give
+ * the same result, and fault on the first inaccessible byte.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <assert.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* Copy VLMAX elements from src to dst, and return the size in bytes. */
+extern size_t vcopy_e8m1(const void *src, void *dst);
+extern size_t vcopy_e64m1(const void *src, void *dst);
+extern size_t vcopy_e32m4(const void *src, void *dst);
+extern size_t vcopy_e64m8(const void *src, void *dst);
+
+asm(".pushsection .text\n"
+    ".globl vcopy_e8m1\n"
+    "vcopy_e8m1:\n"
+    "   vsetvli t0, zero, e8, m1, ta, ma\n"
+    "   vle8.v v8, (a0)\n"
+    "   vse8.v v8, (a1)\n"
+    "   mv a0, t0\n"
+    "   ret\n"
+    ".globl vcopy_e64m1\n"
+    "vcopy_e64m1:\n"
+    "   vsetvli t0, zero, e64, m1, ta, ma\n"
+    "   vle64.v v8, (a0)\n"
+    "   vse64.v v8, (a1)\n"
+    "   slli a0, t0, 3\n"
+    "   ret\n"
+    ".globl vcopy_e32m4\n"
+    "vcopy_e32m4:\n"
+    "   vsetvli t0, zero, e32, m4, ta, ma\n"
+    "   vle32.v v8, (a0)\n"
+    "   vse32.v v8, (a1)\n"
+    "   slli a0, t0, 2\n"
+    "   ret\n"
+    ".globl vcopy_e64m8\n"
+    "vcopy_e64m8:\n"
+    "   vsetvli t0, zero, e64, m8, ta, ma\n"
+    "   vle64.v v8, (a0)\n"
+    "   vse64.v v8, (a1)\n"
+    "   slli a0, t0, 3\n"
+    "   ret\n"
+    ".popsection");
+
+typedef size_t vcopy_fn(const void *src, void *dst);
+
+static vcopy_fn * const vcopy_fns[] = {
+    vcopy_e8m1, vcopy_e64m1, vcopy_e32m4, vcopy_e64m8,
+};
+
+static sigjmp_buf jmpbuf;
+static void *fault_addr;
+
+static void sigsegv_handler(int sig, siginfo_t *info, void *uc)
+{
+    fault_addr = info->si_addr;
+    siglongjmp(jmpbuf, 1);
+}
+
+static void test_copy(vcopy_fn *fn, char *src_page, char *dst_page,
+                      size_t page)
+{
+    size_t bytes = fn(src_page, dst_page);
+    size_t ofs;
+
+    /* From across the boundary to just inside the first page. */
+    for (ofs = 8; ofs <= bytes + 8; ofs += 8) {
+        char *src = src_page + page - ofs;
+        char *dst = dst_page + page - ofs;
+        size_t i;
+
+        for (i = 0; i < bytes; i++) {
+            src[i] = i * 7 + ofs;
+        }
+        memset(dst - 8, 0x55, bytes + 16);
+
+        assert(fn(src, dst) == bytes);
+        assert(memcmp(src, dst, bytes) == 0);
+        for (i = 0; i < 8; i++) {
+            assert(dst[-1 - i] == 0x55);
+            assert(dst[bytes + i] == 0x55);
+        }
+    }
+}
+
+static void test_fault(vcopy_fn *fn, char *buf, char *guard, size_t page)
+{
+    size_t bytes = fn(buf, buf + page);
+
+    /* Load crossing into the guard page. */
+    if (sigsetjmp(jmpbuf, 1) == 0) {
+        fn(guard - 8, buf);
+        abort();
+    }
+    assert(fault_addr == guard);
+
+    /* Store crossing into the guard page. */
+    if (sigsetjmp(jmpbuf, 1) == 0) {
+        fn(buf, guard - 8);
+        abort();
+    }
+    assert(fault_addr == guard);
+
+    /* Load within the guard page. */
+    if (sigsetjmp(jmpbuf, 1) == 0) {
+        fn(guard + page - bytes, buf);
+        abort();
+    }
+    assert(fault_addr == guard + page - bytes);
+}
+
+int main(void)
+{
+    struct sigaction sa = {
+        .sa_sigaction = sigsegv_handler,
+        .sa_flags = SA_SIGINFO,
+    };
+    size_t page = getpagesize();
+    char *buf;
+    int i;
+
+    /* Two source pages, two destination pages, one guard page. */
+    buf = mmap(NULL, 5 * page, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(buf != MAP_FAILED);
+    assert(mprotect(buf + 4 * page, page, PROT_NONE) == 0);
+    assert(sigaction(SIGSEGV, &sa, NULL) == 0);
+
+    for (i = 0; i < sizeof(vcopy_fns) / sizeof(vcopy_fns[0]); i++) {
+        test_copy(vcopy_fns[i], buf, buf + 2 * page, page);
+        test_fault(vcopy_fns[i], buf + 2 * page, buf + 4 * page, page);
+    }
+
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * REP MOVS/STOS across pages, with overlapping operands and faults.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#define _GNU_SOURCE
+#include <assert.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+static long page_size;
+static sigjmp_buf jmp_env;
+static uint64_t fault_rcx, fault_rdi;
+
+static void segv_handler(int sig, siginfo_t *info, void *puc)
+{
+    ucontext_t *uc = puc;
+
+    fault_rcx = uc->uc_mcontext.gregs[REG_RCX];
+    fault_rdi = uc->uc_mcontext.gregs[REG_RDI];
+    siglongjmp(jmp_env, 1);
+}
+
+static uint8_t *rep_stosb(uint8_t *dst, uint8_t val, size_t n)
+{
+    asm volatile("rep stosb" : "+D"(dst), "+c"(n) : "a"(val) : "memory");
+    assert(n == 0);
+    return dst;
+}
+
+static uint8_t *rep_stosw(uint8_t *dst, uint16_t val, size_t n)
+{
+    asm volatile("rep stosw" : "+D"(dst), "+c"(n) : "a"(val) : "memory");
+    assert(n == 0);
+    return dst;
+}
+
+static uint8_t *rep_stosq(uint8_t *dst, uint64_t val, size_t n)
+{
+    asm volatile("rep stosq" : "+D"(dst), "+c"(n) : "a"(val) : "memory");
+    assert(n == 0);
+    return dst;
+}
+
+static void rep_movsb(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    asm volatile("rep movsb"
+                 : "+D"(dst), "+S"(src), "+c"(n) : : "memory");
+    assert(n == 0);
+}
+
+static void rep_movsl(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    asm volatile("rep movsl"
+                 : "+D"(dst), "+S"(src), "+c"(n) : : "memory");
+    assert(n == 0);
+}
+
+static void check_fill(const uint8_t *p, size_t n, uint8_t val)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        assert(p[i] == val);
+    }
+}
+
+static void test_stos(uint8_t *buf)
+{
+    size_t len = 2 * page_size + 100;
+    uint8_t *start = buf + 17;
+    size_t i;
+
+    memset(buf, 0xaa, 3 * page_size);
+    assert(rep_stosb(start, 0, len) == start + len);
+    assert(buf[16] == 0xaa && start[len] == 0xaa);
+    check_fill(start, len, 0);
+
+    memset(buf, 0xaa, 3 * page_size);
+    assert(rep_stosq(start, 0x5555555555555555ull, len / 8) ==
+           start + len / 8 * 8);
+    assert(buf[16] == 0xaa && start[len / 8 * 8] == 0xaa);
+    check_fill(start, len / 8 * 8, 0x55);
+
+    /* Not a repeated byte. */
+    memset(buf, 0xaa, 3 * page_size);
+    assert(rep_stosw(start, 0x1234, len / 2) == start + len / 2 * 2);
+    for (i = 0; i < len / 2; i++) {
+        assert(start[2 * i] == 0x34 && start[2 * i + 1] == 0x12);
+    }
+    assert(start[len / 2 * 2] == 0xaa);
+}
+
+static void test_movs(uint8_t *buf)
+{
+    size_t len = page_size + 300;
+    uint8_t *src = buf + 5, *dst = buf + page_size + 1000;
+    uint8_t ref[32];
+    size_t i;
+
+    for (i = 0; i < 3 * page_size; i++) {
+        buf[i] = i * 7;
+    }
+    rep_movsb(dst, src, len);
+    for (i = 0; i < len; i++) {
+        assert(dst[i] == (uint8_t)((src - buf + i) * 7));
+    }
+
+    /* Destination just above the source replicates the first byte. */
+    for (i = 0; i < 3 * page_size; i++) {
+        buf[i] = i * 7;
+    }
+    rep_movsb(buf + 1, buf, len);
+    check_fill(buf, len + 1, 0);
+
+    /* Destination below the source behaves as memmove. */
+    for (i = 0; i < 3 * page_size; i++) {
+        buf[i] = i * 7;
+    }
+    rep_movsl(buf, buf + 6, len / 4);
+    for (i = 0; i < len / 4 * 4; i++) {
+        assert(buf[i] == (uint8_t)((i + 6) * 7));
+    }
+
+    /* Overlap within one element. */
+    for (i = 0; i < sizeof(ref); i++) {
+        buf[i] = ref[i] = i;
+    }
+    for (i = 0; i < 5; i++) {
+        memmove(ref + 2 + 4 * i, ref + 4 * i, 4);
+    }
+    rep_movsl(buf + 2, buf, 5);
+    assert(memcmp(buf, ref, sizeof(ref)) == 0);
+}
+
+static void test_fault(uint8_t *buf)
+{
+    struct sigaction sa = {
+        .sa_sigaction = segv_handler,
+        .sa_flags = SA_SIGINFO,
+    };
+    uint8_t *start = buf + page_size - 123;
+    size_t n = 1000;
+
+    sigaction(SIGSEGV, &sa, NULL);
+    assert(mprotect(buf + page_size, page_size, PROT_NONE) == 0);
+    memset(buf, 0xaa, page_size);
+
+    if (sigsetjmp(jmp_env, 1) == 0) {
+        rep_stosb(start, 0, n);
+        abort();
+    }
+    /* The iterations before the faulting page are done, no others. */
+    assert(fault_rdi == (uintptr_t)(buf + page_size));
+    assert(fault_rcx == n - 123);
+    check_fill(start, 123, 0);
+    assert(start[-1] == 0xaa);
+
+    assert(mprotect(buf + page_size, page_size,
+                    PROT_READ | PROT_WRITE) == 0);
+}
+
+int main(void)
+{
+    uint8_t *buf;
+
+    page_size = sysconf(_SC_PAGESIZE);
+    buf = mmap(NULL, 3 * page_size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(buf != MAP_FAILED);
+
+    test_stos(buf);
+    test_movs(buf);
+    test_fault(buf);
+    return 0;
+}